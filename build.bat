@@ -1 +1,12 @@
+glslc shaders\triangle.vert -o shaders\triangle.vert.spv
+glslc shaders\triangle.frag -o shaders\triangle.frag.spv
+glslc shaders\scan.comp -o shaders\scan.comp.spv
+glslc shaders\scan_add.comp -o shaders\scan_add.comp.spv
+glslc shaders\object.vert -o shaders\object.vert.spv
+glslc shaders\cull.comp -o shaders\cull.comp.spv
+glslc shaders\instance.vert -o shaders\instance.vert.spv
+glslc shaders\replay.comp -o shaders\replay.comp.spv
 clang -std=c++17 main.cpp -omain.exe -I%VULKAN_SDK%\include\ -l%VULKAN_SDK%\Lib\vulkan-1 -lSDL2main -lSDL2
+clang -std=c++17 tools\asset_pack.cpp -oasset_pack.exe -I%VULKAN_SDK%\include\
+clang -std=c++17 tools\replay.cpp -oreplay.exe -I%VULKAN_SDK%\include\ -l%VULKAN_SDK%\Lib\vulkan-1
+clang -std=c++17 tests\tests.cpp -orun_tests.exe -I%VULKAN_SDK%\include\ -lSDL2main -lSDL2
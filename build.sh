@@ -1 +1,12 @@
-clang -std=c++17 main.cpp -lSDL2 -lstdc++ -lvulkan
\ No newline at end of file
+glslc shaders/triangle.vert -o shaders/triangle.vert.spv
+glslc shaders/triangle.frag -o shaders/triangle.frag.spv
+glslc shaders/scan.comp -o shaders/scan.comp.spv
+glslc shaders/scan_add.comp -o shaders/scan_add.comp.spv
+glslc shaders/object.vert -o shaders/object.vert.spv
+glslc shaders/cull.comp -o shaders/cull.comp.spv
+glslc shaders/instance.vert -o shaders/instance.vert.spv
+glslc shaders/replay.comp -o shaders/replay.comp.spv
+clang -std=c++17 main.cpp -lSDL2 -lstdc++ -lvulkan
+clang -std=c++17 tools/asset_pack.cpp -o asset_pack -lstdc++
+clang -std=c++17 tools/replay.cpp -o replay -lstdc++ -lvulkan
+clang -std=c++17 tests/tests.cpp -o run_tests -lSDL2 -lstdc++
@@ -1,4 +1,9 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <thread>
 #include <vector>
 
 #include <vulkan/vulkan.h>
@@ -8,29 +13,26 @@
 #include <SDL2/SDL_main.h>
 #include <SDL2/SDL_vulkan.h>
 
-typedef int8_t    i8;
-typedef int16_t   i16;
-typedef int32_t   i32;
-typedef int64_t   i64;
-typedef ptrdiff_t isize;
-typedef intptr_t  iptr;
-
-typedef uint8_t   u8;
-typedef uint16_t  u16;
-typedef uint32_t  u32;
-typedef uint64_t  u64;
-typedef size_t    usize;
-typedef uintptr_t uptr;
-
-typedef float  f32;
-typedef double f64;
-
-#define CHECK_RESULT(VR) if ((VR) != VK_SUCCESS) { printf("VULKAN ERROR %d (%x): %s(%d)\n", (VR), (VR), __FILE__, __LINE__); std::exit((VR)); }
-
-// macro to help with Get_X(Args args..., u32 *count, X *array) calling pattern where array must be called with nullptr to retrive the required count value
-// allocates space for appends the resulting array to the end of a vector
-#define COUNT_APPEND_HELPER(VECTOR, FUNC, ARGS...) ([&]() { u32 count = 0; FUNC(ARGS, &count, nullptr); VECTOR.resize(VECTOR.size() + count); return FUNC(ARGS, &count, VECTOR.data()+(VECTOR.size()-count)); })()
-#define COUNT_APPEND_HELPER0(VECTOR, FUNC)         ([&]() { u32 count = 0; FUNC(      &count, nullptr); VECTOR.resize(VECTOR.size() + count); return FUNC(      &count, VECTOR.data()+(VECTOR.size()-count)); })()
+#include "src/common.h"
+#include "src/api_features.h"
+#include "src/arena.h"
+#include "src/gpu_allocator.h"
+#include "src/upload.h"
+#include "src/descriptors.h"
+#include "src/pipelines.h"
+#include "src/recording.h"
+#include "src/profiler.h"
+#include "src/headless.h"
+#include "src/render_graph.h"
+#include "src/compute.h"
+#include "src/indirect.h"
+#include "src/pacing.h"
+#include "src/assets.h"
+#include "src/streaming.h"
+#include "src/startup.h"
+#include "src/batches.h"
+#include "src/faults.h"
+#include "src/replay.h"
 
 // simple macro to safely and easily compare command-line arguments
 #define STREQ(STR, EXPR) (strncmp((STR), (EXPR), sizeof(STR)/sizeof(*(STR))) == 0)
@@ -38,24 +40,135 @@ typedef double f64;
 struct Queue_Family_Details {
     u32                     index;
     VkQueueFamilyProperties props;
+    bool                    present_support;
+    bool                    suitable;        // can execute graphics, transfer and (with a surface) present work, see check_queue_family_suitability
+};
+
+// A queue chosen for a role (graphics, async compute, transfer)
+// Roles that could not be given a dedicated family share the graphics family; when that family has spare queues they get their own queue index
+struct Queue_Selection {
+    u32 family_index;
+    u32 queue_index;
 };
 
 struct Physical_Device_Detials {
-    VkPhysicalDevice           handle;
-    VkPhysicalDeviceProperties props;
-    std::vector<Queue_Family_Details> queue_families;
+    VkPhysicalDevice                 handle;
+    VkPhysicalDeviceProperties       props;
+    VkPhysicalDeviceMemoryProperties mem_props;
+    std::vector<Queue_Family_Details> queue_families; // every queue family of the device, suitable or not
+    bool                             suitable;       // see check_physical_device_suitability
+
+    // filled in by select_physical_device_queues/score_physical_device
+    Queue_Selection graphics_queue;
+    Queue_Selection compute_queue;
+    Queue_Selection transfer_queue;
+    u64             score;
+};
+
+// Per-frame resources
+// One set exists for each frame that may be in flight on the GPU at once, so the CPU can record frame N+1 while the GPU still executes frame N
+// The command pool is reset wholesale once the frame's fence has signalled, which is cheaper than resetting individual command buffers
+// With timeline semaphores the frames share one semaphore that counts finished frames instead, see the main loop
+struct Frame {
+    VkCommandPool   cmd_pool;
+    VkCommandBuffer cmd_buf;
+    VkFence         in_flight;       // signalled once the GPU has finished executing this frame's command buffer, VK_NULL_HANDLE with timeline semaphores
+    VkSemaphore     image_acquired;  // signalled once the presentation engine has released the acquired swapchain image
 };
 
-std::vector<Physical_Device_Detials> get_suitable_physical_devices_and_queue_families(VkInstance &vk_instance, VkSurfaceKHR &vk_surface, bool log_devices = false);
+// The swapchain and everything that is created per swapchain image
+// Image views and framebuffers are created once per image and reused every frame; render-finished semaphores are recycled across recreations
+struct Swapchain {
+    VkSwapchainKHR           handle;
+    VkSurfaceFormatKHR       format;
+    VkExtent2D               extent;
+    VkPresentModeKHR         present_mode;
+    std::vector<VkImage>     images;
+    std::vector<VkImageView> image_views;
+    std::vector<VkFramebuffer> framebuffers;
+    std::vector<VkSemaphore> render_finished;  // per image rather than per frame, see the main loop
+    u64                      retired_at_frame; // frame number at which this swapchain was replaced
+};
+
+// A frame wait that times out this many times in a row is taken for a hung GPU, and recovered from like a lost device
+const u64 FRAME_WAIT_TIMEOUT  = 1000000000; // ns
+const u32 FRAME_WAIT_ATTEMPTS = 10;
+
+// How a device session ended, see run_device_session
+enum Session_Result {
+    SESSION_DONE,        // the window was closed, the frame count was reached or a benchmark ran
+    SESSION_DEVICE_LOST, // the device was lost while rendering and everything on it has been destroyed
+    SESSION_NO_DEVICE,   // no suitable physical device was found
+};
+
+// Destroys the device when an error escapes the session before its frame loop. Whatever was created on the device by then is left
+// to the process exit, but the device itself must not outlive the instance that main() destroys next
+struct Session_Device_Guard {
+    VkDevice device;
+
+    ~Session_Device_Guard();
+};
+
+Session_Device_Guard::~Session_Device_Guard()
+{
+    if (device == VK_NULL_HANDLE) return;
+    vkDeviceWaitIdle(device);
+    vkDestroyDevice(device, nullptr);
+}
+
+// Run device sessions until one ends for good; returns the process exit code, 0 unless a Vulkan error or repeated device losses ended the run
+i32 run_device_sessions(SDL_Window *window, VkInstance vk_instance, VkSurfaceKHR vk_surface, u32 vk_instance_version, Startup_Timer &startup, Startup_Preload &preload, Device_Recovery &recovery, Command_Capture *capture);
+
+// Create the device and everything on it, render until the session ends and destroy it all again
+Session_Result run_device_session(SDL_Window *window, VkInstance vk_instance, VkSurfaceKHR vk_surface, u32 vk_instance_version, Startup_Timer &startup, Startup_Preload &preload, Device_Recovery &recovery, Command_Capture *capture);
+
+VkSurfaceFormatKHR select_surface_format(VkPhysicalDevice &vk_physical_device, VkSurfaceKHR &vk_surface);
+bool create_swapchain(VkPhysicalDevice &vk_physical_device, VkDevice &vk_device, VkSurfaceKHR &vk_surface, SDL_Window *window, VkPresentModeKHR requested_present_mode, VkRenderPass render_pass, u64 frame_number, Swapchain &swapchain, std::vector<Swapchain> &retired_swapchains, std::vector<VkSemaphore> &spare_semaphores);
+void destroy_swapchain(VkDevice &vk_device, Swapchain &swapchain, std::vector<VkSemaphore> &spare_semaphores);
+void destroy_retired_swapchains(VkDevice &vk_device, u64 frame_number, u64 frames_in_flight, std::vector<Swapchain> &retired_swapchains, std::vector<VkSemaphore> &spare_semaphores);
+
+// returns the suitable devices sorted by score, best first
+// `cache_path` may be nullptr to always query every device, see device_cache_read
+std::vector<Physical_Device_Detials> get_suitable_physical_devices_and_queue_families(VkInstance &vk_instance, VkSurfaceKHR &vk_surface, bool prefer_high_performance, bool log_devices, const char *cache_path);
 
 // program arguments
 bool main_list_supporeted_extensions = false;
 bool main_list_physical_devices_info = false;
-bool main_prefer_high_performance_device = false; // TODO: unimplemented
+bool main_profile = false;
+const char *main_trace_path = nullptr; // per-frame profiler trace, CSV or JSON by extension
+bool main_prefer_high_performance_device = false;
 bool main_disabled_validation_layer = false;
-
+u32  main_max_api_version = VK_API_VERSION_1_3; // the instance asks for the highest version up to this one, see src/api_features.h
+u32  main_frames_in_flight = 2;
+VkPresentModeKHR main_present_mode = VK_PRESENT_MODE_FIFO_KHR;
+u64  main_frame_count = 0; // stop after this many frames, 0 runs until the window is closed
+bool main_headless = false; // no window, surface or swapchain; frames are rendered offscreen and read back
+const char *main_screenshot_path = nullptr; // headless only: the last frame is written here as a PPM
+const char *main_bench = nullptr; // run this benchmark instead of the render loop
+const char *main_capture_path = nullptr; // capture the commands of every frame into this file, see src/capture_format.h
+const char *main_replay_path = "captures"; // captures, or directories of them, for the replay benchmark, see src/replay.h
+const char *main_pipeline_cache_path = "pipeline_cache.bin";
+const char *main_device_cache_path = "device_cache.bin"; // device enumeration results of the previous run, see get_suitable_physical_devices_and_queue_families
+const char *main_asset_path = "assets"; // directory of OBJ/PPM files and their assets.pack, see src/assets.h
+const char *main_stream_path = nullptr; // stream this asset pack in and out while rendering, see src/streaming.h
+u64  main_stream_budget = 0; // bytes, 0 uses half of the device-local heaps
+u64  main_stream_rate = 8 << 20; // bytes uploaded by the streamer per frame at most
+u32  main_record_threads = 1; // threads recording draws, 1 records inline into the frame's primary command buffer
+u32  main_draw_count = 1;
+bool main_no_bindless = false; // use the per-draw descriptor set fallback even when descriptor indexing is supported
+bool main_gpu_driven = false; // cull objects in a compute pass and draw them with indirect draws, see src/indirect.h
+bool main_instanced = false; // animate, cull and sort objects on the CPU and draw them instanced, see src/batches.h
+f64  main_target_fps = 0.0; // frame pacer target, 0 runs uncapped, see src/pacing.h
+u32  main_input_probe_ms = 0; // push a synthetic input event this often to measure input-to-present latency without an input device
+
+// tests/tests.cpp builds everything else in this file into the test program, which has an entry point of its own
+#ifndef APP_NO_MAIN
 int main(i32 argc, char** argv)
 {
+    // every phase up to the first frame is timed, see src/startup.h
+    Startup_Timer startup = {};
+    startup_timer_init(startup);
+
     //
     // PARSE ARGUMENTS
     //
@@ -63,8 +176,118 @@ int main(i32 argc, char** argv)
     for (i32 i = 1 ; i < argc; i++) {
         if      (STREQ("-x", argv[i]) || STREQ("--list-extensions", argv[i])) main_list_supporeted_extensions = true;
         else if (STREQ("-d", argv[i]) || STREQ("--list-devices",    argv[i])) main_list_physical_devices_info = true;
+        else if (STREQ("-q", argv[i]) || STREQ("--profile",         argv[i])) main_profile = true;
+        else if (STREQ("-o", argv[i]) || STREQ("--trace", argv[i]))
+        {
+            if (i + 1 < argc) { main_trace_path = argv[++i]; main_profile = true; }
+            else std::cout << "Missing value for argument: " << argv[i] << std::endl;
+        }
         else if (STREQ("-p", argv[i]) || STREQ("--high-perf",       argv[i])) main_prefer_high_performance_device = true;
         else if (STREQ("-z", argv[i]) || STREQ("--no-validate",     argv[i])) main_disabled_validation_layer = true;
+        else if (STREQ("-V", argv[i]) || STREQ("--vulkan", argv[i]))
+        {
+            u32 major = 0, minor = 0;
+            if (i + 1 < argc && sscanf(argv[++i], "%u.%u", &major, &minor) == 2 && major == 1) main_max_api_version = VK_MAKE_API_VERSION(0, 1, std::min(minor, 3u), 0);
+            else std::cout << "Expected a Vulkan version from 1.0 to 1.3 for argument: " << argv[i] << std::endl;
+        }
+        else if (STREQ("-f", argv[i]) || STREQ("--frames-in-flight", argv[i]))
+        {
+            if (i + 1 < argc) main_frames_in_flight = std::max(1, atoi(argv[++i]));
+            else std::cout << "Missing value for argument: " << argv[i] << std::endl;
+        }
+        else if (STREQ("-m", argv[i]) || STREQ("--present-mode", argv[i]))
+        {
+            if (i + 1 < argc)
+            {
+                i++;
+                if      (STREQ("fifo",         argv[i])) main_present_mode = VK_PRESENT_MODE_FIFO_KHR;
+                else if (STREQ("fifo-relaxed", argv[i])) main_present_mode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+                else if (STREQ("mailbox",      argv[i])) main_present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+                else if (STREQ("immediate",    argv[i])) main_present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+                else std::cout << "Unkown present mode: " << argv[i] << std::endl;
+            }
+            else std::cout << "Missing value for argument: " << argv[i] << std::endl;
+        }
+        else if (STREQ("-n", argv[i]) || STREQ("--frame-count", argv[i]))
+        {
+            if (i + 1 < argc) main_frame_count = strtoull(argv[++i], nullptr, 10);
+            else std::cout << "Missing value for argument: " << argv[i] << std::endl;
+        }
+        else if (STREQ("-t", argv[i]) || STREQ("--threads", argv[i]))
+        {
+            if (i + 1 < argc) main_record_threads = std::max(1, atoi(argv[++i]));
+            else std::cout << "Missing value for argument: " << argv[i] << std::endl;
+        }
+        else if (STREQ("-g", argv[i]) || STREQ("--draw-count", argv[i]))
+        {
+            if (i + 1 < argc) main_draw_count = std::max(1, atoi(argv[++i]));
+            else std::cout << "Missing value for argument: " << argv[i] << std::endl;
+        }
+        else if (STREQ("-c", argv[i]) || STREQ("--pipeline-cache", argv[i]))
+        {
+            if (i + 1 < argc) main_pipeline_cache_path = argv[++i];
+            else std::cout << "Missing value for argument: " << argv[i] << std::endl;
+        }
+        else if (STREQ("-e", argv[i]) || STREQ("--device-cache", argv[i]))
+        {
+            if (i + 1 < argc) { i++; main_device_cache_path = STREQ("none", argv[i]) ? nullptr : argv[i]; }
+            else std::cout << "Missing value for argument: " << argv[i] << std::endl;
+        }
+        else if (STREQ("-a", argv[i]) || STREQ("--assets", argv[i]))
+        {
+            if (i + 1 < argc) main_asset_path = argv[++i];
+            else std::cout << "Missing value for argument: " << argv[i] << std::endl;
+        }
+        else if (STREQ("--stream", argv[i]))
+        {
+            if (i + 1 < argc) main_stream_path = argv[++i];
+            else std::cout << "Missing value for argument: " << argv[i] << std::endl;
+        }
+        else if (STREQ("--stream-budget", argv[i]))
+        {
+            if (i + 1 < argc) main_stream_budget = strtoull(argv[++i], nullptr, 10) << 20;
+            else std::cout << "Missing value for argument: " << argv[i] << std::endl;
+        }
+        else if (STREQ("--stream-rate", argv[i]))
+        {
+            if (i + 1 < argc) main_stream_rate = std::max(1ull, strtoull(argv[++i], nullptr, 10)) << 20;
+            else std::cout << "Missing value for argument: " << argv[i] << std::endl;
+        }
+        else if (STREQ("-H", argv[i]) || STREQ("--headless", argv[i])) main_headless = true;
+        else if (STREQ("--no-bindless", argv[i])) main_no_bindless = true;
+        else if (STREQ("-G", argv[i]) || STREQ("--gpu-driven", argv[i])) main_gpu_driven = true;
+        else if (STREQ("-I", argv[i]) || STREQ("--instanced", argv[i])) main_instanced = true;
+        else if (STREQ("-r", argv[i]) || STREQ("--fps", argv[i]))
+        {
+            if (i + 1 < argc) main_target_fps = std::max(0.0, atof(argv[++i]));
+            else std::cout << "Missing value for argument: " << argv[i] << std::endl;
+        }
+        else if (STREQ("-l", argv[i]) || STREQ("--input-probe", argv[i]))
+        {
+            if (i + 1 < argc) main_input_probe_ms = std::max(1, atoi(argv[++i]));
+            else std::cout << "Missing value for argument: " << argv[i] << std::endl;
+        }
+        else if (STREQ("-s", argv[i]) || STREQ("--screenshot", argv[i]))
+        {
+            if (i + 1 < argc) main_screenshot_path = argv[++i];
+            else std::cout << "Missing value for argument: " << argv[i] << std::endl;
+        }
+        else if (STREQ("-b", argv[i]) || STREQ("--bench", argv[i]))
+        {
+            if (i + 1 < argc) main_bench = argv[++i];
+            else std::cout << "Missing value for argument: " << argv[i] << std::endl;
+        }
+        else if (STREQ("-C", argv[i]) || STREQ("--capture", argv[i]))
+        {
+            if (i + 1 < argc) { main_capture_path = argv[++i]; main_replay_path = main_capture_path; }
+            else std::cout << "Missing value for argument: " << argv[i] << std::endl;
+        }
+        else if (STREQ("-F", argv[i]) || STREQ("--inject-fault", argv[i]))
+        {
+            Fault fault = {};
+            if (i + 1 < argc && fault_parse(argv[++i], fault)) fault_injector.faults.push_back(fault);
+            else std::cout << "Expected site:result@call for argument: " << argv[i] << std::endl;
+        }
         else
         {
             std::cout << "Unkown argument: " << argv[i] << std::endl;
@@ -72,8 +295,33 @@ int main(i32 argc, char** argv)
     }
     std::cout << std::endl;
 
+    // a headless run has no window to close, so it always stops after a fixed number of frames
+    if (main_headless && main_frame_count == 0) main_frame_count = 300;
+    // both draw the same grid of objects; the GPU-driven path takes precedence
+    if (main_gpu_driven) main_instanced = false;
+    // captures hold the commands recorded inline into the frame's command buffer; the other paths' draws are left out, see src/capture_format.h
+    if (main_capture_path && !main_bench && (main_gpu_driven || main_instanced || main_record_threads > 1))
+    {
+        std::cout << "Note: instanced, indirect and multi-threaded draws are not captured" << std::endl;
+    }
+
+    // Files needed before the first frame are read while the instance and device are created, see src/startup.h
+    Startup_Preload preload = {};
+    preload.pipeline_cache_path = main_pipeline_cache_path;
+    preload.shader_paths = { SHADER_DIR "triangle.vert.spv", SHADER_DIR "triangle.frag.spv" };
+    if (main_gpu_driven)
+    {
+        preload.shader_paths.push_back(SHADER_DIR "object.vert.spv");
+        preload.shader_paths.push_back(SHADER_DIR "cull.comp.spv");
+    }
+    if (main_instanced) preload.shader_paths.push_back(SHADER_DIR "instance.vert.spv");
+    preload.asset_pack_path = main_stream_path;
+    startup_preload_begin(preload);
+    startup_phase(startup, "arguments");
+
     //
     // SDL INIT
+    // Skipped entirely in headless mode, which must work on machines without a display
     //
 
     /*  This also exists, but initialises a tonne of additional subsytems for things like
@@ -81,22 +329,28 @@ int main(i32 argc, char** argv)
 
         SDL_Init(SDL_INIT_EVERYTHING); */
 
-    SDL_InitSubSystem(SDL_INIT_VIDEO);
-
-    SDL_Window *window = SDL_CreateWindow(
-        "Vulkan Demo",                                          //  Title
-        SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,       //  Pos X / Pos Y
-        640, 480,                                               //  Width / height
-        SDL_WINDOW_VULKAN                                       //  Flags: May be chained with OR
-    );
-    if(window == NULL)
+    SDL_Window *window = nullptr;
+    if (!main_headless)
     {
-        std::cerr << "Error: Failed to create window instance. Check availability of Vulkan drivers." << std::endl;
-        return -1;
+        SDL_InitSubSystem(SDL_INIT_VIDEO);
+
+        window = SDL_CreateWindow(
+            "Vulkan Demo",                                          //  Title
+            SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,       //  Pos X / Pos Y
+            640, 480,                                               //  Width / height
+            SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE                //  Flags: May be chained with OR
+        );
+        if(window == NULL)
+        {
+            std::cerr << "Error: Failed to create window instance. Check availability of Vulkan drivers." << std::endl;
+            startup_preload_wait(preload);
+            return -1;
+        }
     }
-    bool window_is_open = true;
+    startup_phase(startup, "window");
 
-    SDL_Surface* sdl_surface = SDL_GetWindowSurface(window);
+    /*  SDL_GetWindowSurface/SDL_UpdateWindowSurface must not be used on this window: the software surface path
+        cannot be combined with Vulkan presentation, every frame is presented through the swapchain instead */
 
     //
     // VULKAN DEVICE INIT
@@ -108,13 +362,16 @@ int main(i32 argc, char** argv)
     // Create Vulkan instance
     // This is the highest-level interface of the API that is used to create device interfaces and select required extensions
     VkInstance vk_instance = {};
+    u32        vk_instance_version = api_instance_version(main_max_api_version);
+    try
     {
         // our application info (for the driver)
         VkApplicationInfo app_info = {};
         app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
         app_info.pApplicationName = "Vulkan Demo";
         app_info.pEngineName      = "Demo Engine";
-        app_info.apiVersion       = VK_API_VERSION_1_0;
+        // the highest version both the loader and -V allow; the device may support less, see api_features_query
+        app_info.apiVersion       = vk_instance_version;
 
         // INSTANCE EXTENSIONS
 
@@ -146,13 +403,25 @@ int main(i32 argc, char** argv)
         // create list of extension requirements
         std::vector<const char*> extensions = {};
 
-        // query SDL extension requirements
-        if (!COUNT_APPEND_HELPER(extensions, SDL_Vulkan_GetInstanceExtensions, window))
+        // query SDL extension requirements; rendering offscreen needs no instance extensions
+        if (!main_headless && !COUNT_APPEND_HELPER(extensions, SDL_Vulkan_GetInstanceExtensions, window))
         {
             std::cerr << SDL_GetError() << std::endl;
+            startup_preload_wait(preload);
             return -1;
         }
 
+        // optional: needed to query the descriptor indexing features on a Vulkan 1.0 instance
+        {
+            std::vector<VkExtensionProperties> available = {};
+            vr = COUNT_APPEND_HELPER(available, vkEnumerateInstanceExtensionProperties, nullptr);
+            CHECK_RESULT(vr);
+            for (const auto &extension : available)
+            {
+                if (STREQ(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+            }
+        }
+
         // log extension requirements
         std::cout << "Requiring extensions:" << std::endl;
         for (int i = 0; i < extensions.size(); i++)
@@ -191,58 +460,222 @@ int main(i32 argc, char** argv)
         std::cout << "Creating instance..." << std::endl;
         vr = vkCreateInstance(&instance_info, NULL, &vk_instance);
         CHECK_RESULT(vr);
-    };
+    }
+    catch (const Vulkan_Error &error)
+    {
+        vulkan_error_report(error);
+        startup_preload_wait(preload);
+        return error.result;
+    }
 
     // Create Vulkan surface
     // This functions as a platform-independent abstraction of a graphical window render-target
+    // Headless runs have no surface; device selection then ignores presentation support
     VkSurfaceKHR vk_surface = {};
-    SDL_Vulkan_CreateSurface(window, vk_instance, &vk_surface);
+    if (!main_headless) SDL_Vulkan_CreateSurface(window, vk_instance, &vk_surface);
+    startup_phase(startup, "instance");
+
+    //
+    // DEVICE SESSIONS
+    // Everything from the device down is created by run_device_session, which renders until the window is closed or the frame count
+    // is reached. When the device is lost while rendering, the session destroys everything on it and the next session builds it all
+    // again, on whichever device is then the best match. The instance, surface and window outlive the sessions
+    // Any other Vulkan error, and a device loss outside of the frame loop, ends the process with the error's code once the session has
+    // destroyed its device
+    //
+
+    Device_Recovery recovery = {};
+    Command_Capture capture = {}; // every session appends its frames, so a capture spans device losses
+    i32 exit_code = run_device_sessions(window, vk_instance, vk_surface, vk_instance_version, startup, preload, recovery,
+                                        main_capture_path && !main_bench ? &capture : nullptr);
+    device_recovery_print_summary(recovery);
+
+    if (main_capture_path && !main_bench)
+    {
+        if (capture_write(capture, main_capture_path)) printf("Captured %u frames (%.1f KB) to %s\n", capture.frame_count, capture.commands.size() / 1024.0, main_capture_path);
+        else std::cout << "Failed to write " << main_capture_path << std::endl;
+    }
+
+    //
+    // CLEANUP
+    //
+
+    startup_preload_wait(preload);
+    asset_pack_close(preload.asset_pack);
+    if (vk_surface != VK_NULL_HANDLE) vkDestroySurfaceKHR(vk_instance, vk_surface, nullptr);
+    vkDestroyInstance(vk_instance, NULL);
+    // sdl
+    if (window) SDL_DestroyWindow(window);
+
+    return exit_code;
+};
+#endif
+
+i32 run_device_sessions(SDL_Window *window, VkInstance vk_instance, VkSurfaceKHR vk_surface, u32 vk_instance_version, Startup_Timer &startup, Startup_Preload &preload, Device_Recovery &recovery, Command_Capture *capture)
+{
+    i32 exit_code = 0;
+    try
+    {
+        u32 lost_before_first_frame = 0; // sessions in a row that lost the device without rendering a frame
+        for (;;)
+        {
+            u64 frames_before = recovery.frames;
+            Session_Result result = run_device_session(window, vk_instance, vk_surface, vk_instance_version, startup, preload, recovery, capture);
+            if (result == SESSION_DONE) break;
+            if (result == SESSION_NO_DEVICE)
+            {
+                std::cerr << "No suitable physical devices found" << std::endl;
+                exit_code = -1;
+                break;
+            }
+
+            lost_before_first_frame = recovery.frames == frames_before ? lost_before_first_frame + 1 : 0;
+            if (lost_before_first_frame == 3)
+            {
+                std::cerr << "The device was lost " << lost_before_first_frame << " times in a row before a frame was rendered, giving up" << std::endl;
+                exit_code = VK_ERROR_DEVICE_LOST;
+                break;
+            }
+            recovery.count++;
+            std::cout << "Rebuilding the device after " << recovery.frames << " frames..." << std::endl << std::endl;
+        }
+    }
+    catch (const Vulkan_Error &error)
+    {
+        vulkan_error_report(error);
+        exit_code = error.result;
+    }
+    return exit_code;
+}
+
+Session_Result run_device_session(SDL_Window *window, VkInstance vk_instance, VkSurfaceKHR vk_surface, u32 vk_instance_version, Startup_Timer &startup, Startup_Preload &preload, Device_Recovery &recovery, Command_Capture *capture)
+{
+    VkResult vr = VK_SUCCESS;
+    bool window_is_open = true;
+    bool device_lost = false;
 
-    // Create device interface and the queue
+    // Create device interface and the queues
     // The device is the main API interface for creating and managing GPU resources
-    // The queue is responsible for executing workloads on the device
+    // The queues are responsible for executing workloads on the device
     // Queue creation is tightly coupled with device creation, so both are created here
-    // The queue family index is an integer that is required by several other functions
+    // The queue family indices are integers that are required by several other functions
     // The physical device is retained to query cababilities only; it carries little API functionality
     VkPhysicalDevice vk_physical_device = {};
+    VkPhysicalDeviceProperties       vk_physical_device_props = {};
+    VkPhysicalDeviceMemoryProperties vk_physical_device_mem_props = {};
     VkDevice         vk_device = {};
-    u32              vk_queue_family_index = 0; // TODO: implement selection logic
+    u32              vk_queue_family_index = 0;          // graphics + transfer + present
     VkQueue          vk_queue = {};
+    u32              vk_compute_queue_family_index = 0;  // async compute, may alias the graphics family/queue
+    VkQueue          vk_compute_queue = {};
+    u32              vk_transfer_queue_family_index = 0; // uploads, may alias the graphics family/queue
+    VkQueue          vk_transfer_queue = {};
+    VkPhysicalDeviceFeatures vk_enabled_features = {};
+    u32              vk_timestamp_valid_bits = 0;        // of the graphics family, 0 if it cannot write timestamps
+    bool             vk_descriptor_indexing = false;     // bindless descriptors, see src/descriptors.h
+    bool             vk_draw_indirect_count = false;     // VK_KHR_draw_indirect_count, see src/indirect.h
+    Api_Features     vk_api_features = {};               // timeline semaphores, dynamic rendering, synchronization2, see src/api_features.h
     {
-        // select physical device and queue family to execute on
-        // TOOD: implement selection logic
-        u32                     target_physical_device_index = 0;
-        VkQueueFamilyProperties target_queue_family_properties = {};
-
-        std::vector<Physical_Device_Detials> suitable_physical_devices = get_suitable_physical_devices_and_queue_families(vk_instance, vk_surface, main_list_physical_devices_info);
-        if(suitable_physical_devices.size() < 1)
+        // select physical device and queue families to execute on
+        // devices come back sorted by score, so the first one is the best match
+        // a rebuild after a device loss queries every device again; the lost one may have changed or gone
+        std::vector<Physical_Device_Detials> suitable_physical_devices = get_suitable_physical_devices_and_queue_families(vk_instance, vk_surface, main_prefer_high_performance_device, main_list_physical_devices_info,
+                                                                                                                 recovery.count > 0 ? nullptr : main_device_cache_path);
+        if(suitable_physical_devices.size() < 1) return SESSION_NO_DEVICE;
+        startup_phase(startup, "device selection");
+        Physical_Device_Detials &selected = suitable_physical_devices[0];
+        vk_physical_device             = selected.handle;
+        vk_physical_device_props       = selected.props;
+        vk_physical_device_mem_props   = selected.mem_props;
+        vk_queue_family_index          = selected.graphics_queue.family_index;
+        vk_compute_queue_family_index  = selected.compute_queue.family_index;
+        vk_transfer_queue_family_index = selected.transfer_queue.family_index;
+        vk_timestamp_valid_bits        = selected.queue_families[vk_queue_family_index].props.timestampValidBits;
+
+        // Configure queues
+        // one create info per distinct family, with enough queues for every role that was given its own queue index
+        std::vector<VkDeviceQueueCreateInfo> queue_infos = {};
+        std::vector<f32> queue_priorities(3, 1.0);
+        for (Queue_Selection *queue : {&selected.graphics_queue, &selected.compute_queue, &selected.transfer_queue})
         {
-            std::cerr << "No suitable physical devices found" << std::endl;
-            std::exit(-1);
-        };
-        // TODO: smarter selection of
-        vk_physical_device    = suitable_physical_devices[0].handle;
-        vk_queue_family_index = suitable_physical_devices[0].queue_families[0].index;
-
-        // Configure queue
-        // this demo will only require a single queue with graphics and transfer capabilities
-        VkDeviceQueueCreateInfo queue_info = {};
-        queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queue_info.queueFamilyIndex = vk_queue_family_index;
-        f32 queue_priority = 1.0;
-        queue_info.pQueuePriorities = &queue_priority;
-        queue_info.queueCount       = 1;
+            bool found = false;
+            for (auto &queue_info : queue_infos)
+            {
+                if (queue_info.queueFamilyIndex != queue->family_index) continue;
+                queue_info.queueCount = std::max(queue_info.queueCount, queue->queue_index + 1);
+                found = true;
+            }
+            if (found) continue;
+
+            VkDeviceQueueCreateInfo queue_info = {};
+            queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+            queue_info.queueFamilyIndex = queue->family_index;
+            queue_info.pQueuePriorities = queue_priorities.data();
+            queue_info.queueCount       = queue->queue_index + 1;
+            queue_infos.push_back(queue_info);
+        }
 
         // Configure logical device - is used to interface with physical device
         std::vector<const char *> extension_names = {};
-        extension_names.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        if (!main_headless) extension_names.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+        // Optional features are only enabled when something uses them
+        // The profiler's pipeline statistics need inheritedQueries as well when draws are recorded into secondary command buffers
+        VkPhysicalDeviceFeatures supported_features = {};
+        vkGetPhysicalDeviceFeatures(vk_physical_device, &supported_features);
+        if (main_profile)
+        {
+            vk_enabled_features.pipelineStatisticsQuery = supported_features.pipelineStatisticsQuery;
+            vk_enabled_features.inheritedQueries        = supported_features.inheritedQueries;
+        }
+
+        std::vector<VkExtensionProperties> available_extensions = {};
+        vr = COUNT_APPEND_HELPER(available_extensions, vkEnumerateDeviceExtensionProperties, vk_physical_device, nullptr);
+        CHECK_RESULT(vr);
+        auto has_extension = [&](const char *name) {
+            for (const auto &extension : available_extensions) if (STREQ(extension.extensionName, name)) return true;
+            return false;
+        };
+
+        // The GPU-driven path draws with multi-draw indirect and finds each object through firstInstance, see src/indirect.h
+        // VK_KHR_draw_indirect_count lets it draw only the objects that survived culling instead of one (possibly empty) command per object
+        if (main_gpu_driven || (main_bench && STREQ("indirect", main_bench)))
+        {
+            vk_enabled_features.multiDrawIndirect         = supported_features.multiDrawIndirect;
+            vk_enabled_features.drawIndirectFirstInstance = supported_features.drawIndirectFirstInstance;
+            vk_draw_indirect_count = has_extension(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+            if (vk_draw_indirect_count) extension_names.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        }
+
+        // Bindless descriptors need VK_EXT_descriptor_indexing (which depends on VK_KHR_maintenance3) and a handful of its features
+        // Without them the descriptor heap falls back to per-draw sets from per-frame pools
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptor_indexing_features = {};
+        {
+            bool has_descriptor_indexing = has_extension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+            bool has_maintenance3        = has_extension(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+
+            vk_descriptor_indexing = !main_no_bindless && has_descriptor_indexing && has_maintenance3 &&
+                                     descriptor_indexing_query_features(vk_instance, vk_physical_device, descriptor_indexing_features);
+            if (vk_descriptor_indexing)
+            {
+                extension_names.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+                extension_names.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+            }
+            std::cout << "Descriptors: " << (vk_descriptor_indexing ? "bindless (VK_EXT_descriptor_indexing)" : "per-draw sets from per-frame pools") << std::endl;
+        }
+
+        // The modern features replace their Vulkan 1.0 counterparts where the device has them
+        api_features_query(vk_api_features, vk_instance, vk_physical_device, vk_instance_version, vk_physical_device_props.apiVersion, has_extension, extension_names);
 
         VkDeviceCreateInfo device_info = {};
         device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
         device_info.ppEnabledExtensionNames = extension_names.data();
         device_info.enabledExtensionCount = extension_names.size();
-        device_info.pQueueCreateInfos    = &queue_info;
-        device_info.queueCreateInfoCount = 1;
+        device_info.pQueueCreateInfos    = queue_infos.data();
+        device_info.queueCreateInfoCount = queue_infos.size();
+        device_info.pEnabledFeatures     = &vk_enabled_features;
+        if (vk_descriptor_indexing) device_info.pNext = &descriptor_indexing_features;
+        device_info.pNext = api_features_chain(vk_api_features, (void *)device_info.pNext);
 
         // Create logical device
         std::cout << "Creating device..." << std::endl;
@@ -263,163 +696,999 @@ int main(i32 argc, char** argv)
             };
         }
 
-        // Retrieve the queue
-        std::cout << "Retrieving device queue..." << std::endl;
-        // All queue families have at least 1 queue, so queue index 0 can be safely retrieved
-        vkGetDeviceQueue(vk_device, vk_queue_family_index, 0, &vk_queue);
-    };
-
-    //  Swapchain creation
-    //  This application assumes that there will only ever be one swapchain because things like screen resize don't occur during runtime
-    const u32 vk_swapchain_min_image_count = 3;
-    VkSwapchainKHR vk_swapchain = {};
-    {
-        //  Query available hardware extensions and surface properties
-        VkSurfaceCapabilitiesKHR surface_capabilities = {};
-        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(vk_physical_device, vk_surface, &surface_capabilities);
-
-        //  Define swapchain interface
-        VkSwapchainCreateInfoKHR swapchain_info = {};
-        swapchain_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-        swapchain_info.presentMode = VK_PRESENT_MODE_FIFO_KHR;
-        swapchain_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-        swapchain_info.imageFormat = VK_FORMAT_B8G8R8A8_UNORM;
-        swapchain_info.imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
-        swapchain_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        swapchain_info.compositeAlpha  = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-        swapchain_info.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
-        swapchain_info.minImageCount = vk_swapchain_min_image_count;
-        swapchain_info.imageArrayLayers = 1;
-        swapchain_info.surface = vk_surface;
-        swapchain_info.imageExtent = surface_capabilities.currentExtent;
-        swapchain_info.clipped = VK_TRUE;
-
-        std::cout << "Creating swapchain..." << std::endl;
-        vr = vkCreateSwapchainKHR(vk_device, &swapchain_info, nullptr, &vk_swapchain);
-        CHECK_RESULT(vr);
+        // Retrieve the queues
+        std::cout << "Retrieving device queues..." << std::endl;
+        vkGetDeviceQueue(vk_device, selected.graphics_queue.family_index, selected.graphics_queue.queue_index, &vk_queue);
+        vkGetDeviceQueue(vk_device, selected.compute_queue.family_index,  selected.compute_queue.queue_index,  &vk_compute_queue);
+        vkGetDeviceQueue(vk_device, selected.transfer_queue.family_index, selected.transfer_queue.queue_index, &vk_transfer_queue);
     };
+    Session_Device_Guard device_guard = {};
+    device_guard.device = vk_device;
+    startup_phase(startup, "device");
+
+    // GPU memory allocator
+    // Every buffer and image is sub-allocated from large blocks, see src/gpu_allocator.h
+    Gpu_Allocator gpu_allocator = {};
+    gpu_allocator_init(gpu_allocator, vk_device, vk_physical_device_mem_props, gpu_memory_functions_vulkan());
+
+    Device_Context device_context = {};
+    device_context.instance        = vk_instance;
+    device_context.physical_device = vk_physical_device;
+    device_context.props           = vk_physical_device_props;
+    device_context.mem_props       = vk_physical_device_mem_props;
+    device_context.device          = vk_device;
+    device_context.graphics_queue  = vk_queue;
+    device_context.graphics_family = vk_queue_family_index;
+    device_context.compute_queue   = vk_compute_queue;
+    device_context.compute_family  = vk_compute_queue_family_index;
+    device_context.transfer_queue  = vk_transfer_queue;
+    device_context.transfer_family = vk_transfer_queue_family_index;
+    device_context.allocator       = &gpu_allocator;
+    device_context.enabled_features = vk_enabled_features;
+    device_context.descriptor_indexing = vk_descriptor_indexing;
+    device_context.draw_indirect_count = vk_draw_indirect_count;
+    api_features_load(device_context, vk_api_features);
+    api_features_print(device_context);
+
+    // Benchmarks run on the selected device instead of the render loop
+    if (main_bench)
+    {
+        if      (STREQ("upload",         main_bench)) upload_benchmark(device_context);
+        else if (STREQ("pipeline-cache", main_bench)) pipeline_cache_benchmark(device_context, main_pipeline_cache_path);
+        else if (STREQ("descriptors",    main_bench)) descriptor_benchmark(device_context);
+        else if (STREQ("render-graph",   main_bench)) render_graph_benchmark(device_context);
+        else if (STREQ("compute",        main_bench)) compute_benchmark(device_context);
+        else if (STREQ("indirect",       main_bench)) indirect_benchmark(device_context);
+        else if (STREQ("batches",        main_bench)) batch_benchmark(device_context, std::max(1u, std::thread::hardware_concurrency()));
+        else if (STREQ("assets",         main_bench)) asset_benchmark(device_context, main_asset_path);
+        else if (STREQ("arena",          main_bench)) arena_benchmark();
+        else if (STREQ("recording",      main_bench)) recording_benchmark(device_context, main_record_threads > 1 ? main_record_threads : std::max(1u, std::thread::hardware_concurrency()));
+        else if (STREQ("replay",         main_bench)) replay_benchmark(device_context, main_replay_path);
+        else std::cout << "Unkown benchmark: " << main_bench << std::endl;
+
+        window_is_open = false;
+    }
 
-    //  Retrieve images from swapchain
-    std::vector<VkImage> swapchain_images = {};
-    vr = COUNT_APPEND_HELPER(swapchain_images, vkGetSwapchainImagesKHR, vk_device, vk_swapchain);
-    CHECK_RESULT(vr);
+    // Staging uploads
+    // Streamed vertex, index and texture data goes through the transfer queue; pending copies are flushed once per frame, see the main loop
+    // Each frame in flight may hold one upload semaphore, so there must be more batches than frames in flight
+    Upload_Context upload = {};
+    upload_init(upload, device_context, 32 << 20, std::max<u32>(4, main_frames_in_flight + 1));
+    startup_phase(startup, "device resources");
 
     //
     // VULKAN PIPELINE INIT
     // With the primary Vulkan interfaces initialized, we can start creating our app's graphics pipeline
     //
 
-    // Command pool creation
-    // This abstracts the backing allocation for command buffers; each command buffer must be created in association with a specific command pool
-    // Synchronisation of command execution must be done explicitly in the pipeline; the command pool must not be reset while it is being executed on the queue
-    VkCommandPool cmd_pool = {};
+    // Pipelines are compiled through a pipeline cache that persists across runs, and shader modules are shared between pipelines
+    // The render pass only depends on the surface format, which does not change when the swapchain is recreated
+    // Its attachment stays in COLOR_ATTACHMENT_OPTIMAL; the frame graph transitions the target around it, see below
+    // With dynamic rendering there is no render pass; pipelines are created for the target format instead
+    Pipeline_Cache      pipeline_cache = {};
+    Shader_Module_Cache shader_modules = {};
+    VkFormat            target_format = VK_FORMAT_UNDEFINED;
+    VkRenderPass        render_pass = {};
+    VkPipelineLayout    triangle_layout = {};
+    VkPipeline          triangle_pipeline = {};
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        startup_preload_wait(preload);
+        vr = pipeline_cache_create_from_data(vk_device, vk_physical_device_props, main_pipeline_cache_path, preload.pipeline_cache_data, pipeline_cache);
+        CHECK_RESULT(vr);
+        shader_modules.preloaded = preload.shaders; // a copy, so a session that rebuilds the device does not read them again
+
+        target_format = main_headless ? HEADLESS_FORMAT : select_surface_format(vk_physical_device, vk_surface).format;
+        if (!device_context.dynamic_rendering) render_pass = create_color_render_pass(vk_device, target_format);
+        triangle_layout   = create_triangle_pipeline_layout(vk_device);
+        triangle_pipeline = create_triangle_pipeline(vk_device, pipeline_cache.handle, shader_modules, render_pass, triangle_layout, 0, SHADER_DIR "triangle.vert.spv", nullptr, target_format);
+
+        f64 ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Pipelines created in " << ms << "ms (pipeline cache: " << (pipeline_cache.loaded_bytes > 0 ? "warm" : "cold") << ")" << std::endl;
+    }
+    startup_phase(startup, "pipelines");
+
+    // GPU-driven scene, see src/indirect.h: -g objects culled by a compute pass and drawn with indirect draws
+    Gpu_Scene      gpu_scene = {};
+    Gpu_Scene_Mode gpu_scene_mode = GPU_SCENE_CPU;
+    if (main_gpu_driven)
     {
-        VkCommandPoolCreateInfo info = {};
-        info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-        // Flags we may want to use:
+        std::vector<Gpu_Object> objects = {};
+        gpu_scene_fill_grid(objects, main_draw_count);
+        gpu_scene_create(gpu_scene, device_context, pipeline_cache.handle, shader_modules, render_pass, objects, main_frames_in_flight, target_format);
+        gpu_scene_mode = gpu_scene_best_mode(gpu_scene);
+        std::cout << "GPU-driven rendering of " << main_draw_count << " objects (" << gpu_scene_mode_name(gpu_scene_mode) << ")" << std::endl;
+    }
+
+    // Instanced batches, see src/batches.h: the same grid of -g objects, moving, culled and sorted on the CPU across -t threads
+    Batch_Objects  batch_objects = {};
+    Batch_Renderer batch_renderer = {};
+    if (main_instanced)
+    {
+        const char *simd = nullptr;
+        batch_cull_function(&simd);
+        batch_objects_fill_grid(batch_objects, main_draw_count);
+        batch_renderer_create(batch_renderer, device_context, pipeline_cache.handle, shader_modules, render_pass, main_draw_count, main_frames_in_flight, target_format);
+        std::cout << "Instanced rendering of " << main_draw_count << " objects in " << BATCH_KEY_COUNT << " batches on [" << main_record_threads << "] threads (" << simd << " culling)" << std::endl;
+    }
+
+    // Asset streaming, see src/streaming.h: a camera moves along the assets of the pack, which lie one unit apart, and requests
+    // everything within `stream_view_distance` of it every frame, nearest first
+    const i32  stream_view_distance = 16;
+    Asset_Pack stream_pack = {};
+    Streamer   streamer = {};
+    bool       streaming = false;
+    if (main_stream_path)
+    {
+        // opened by the preload thread
+        stream_pack = preload.asset_pack;
+        streaming = preload.asset_pack_valid && stream_pack.header->mesh_count + stream_pack.header->texture_count > 0;
+        if (streaming)
+        {
+            streamer_init(streamer, device_context, upload, stream_pack, 2, main_stream_budget, main_stream_rate, main_frames_in_flight);
+            printf("Streaming %u assets from %s, %.1f MB budget, at most %.1f MB uploaded per frame\n", (u32)streamer.assets.size(), main_stream_path, streamer.budget / 1e6, streamer.frame_upload_bytes / 1e6);
+        }
+        else std::cout << "Cannot stream " << main_stream_path << ": not a valid asset pack" << std::endl;
+    }
+    startup_phase(startup, "scene");
+
+    //  Swapchain creation
+    //  The swapchain is rebuilt whenever it goes out of date or the window is resized, see the main loop
+    //  A replaced swapchain is retired rather than destroyed straight away, so frames still in flight can finish presenting to it
+    Swapchain                swapchain = {};
+    std::vector<Swapchain>   retired_swapchains = {};
+    std::vector<VkSemaphore> spare_semaphores = {}; // render-finished semaphores recycled from destroyed swapchains
+    bool swapchain_dirty = false;
+    if (!main_headless)
+    {
+        std::cout << "Creating swapchain..." << std::endl;
+        swapchain_dirty = !create_swapchain(vk_physical_device, vk_device, vk_surface, window, main_present_mode, render_pass, 0, swapchain, retired_swapchains, spare_semaphores);
+    }
+
+    //  Headless render targets, one image and readback buffer per frame in flight, see src/headless.h
+    Headless_Target headless = {};
+    if (main_headless)
+    {
+        std::cout << "Creating headless render targets..." << std::endl;
+        headless_target_create(headless, gpu_allocator, vk_device, render_pass, { 640, 480 }, main_frames_in_flight);
+    }
+    startup_phase(startup, "render targets");
+
+    // Per-frame command pools, command buffers and synchronisation primitives
+    // Command pool: abstracts the backing allocation for command buffers; each command buffer must be created in association with a specific command pool
+    // Synchronisation of command execution must be done explicitly in the pipeline; the command pool must not be reset while it is being executed on the queue,
+    // which is why every frame in flight owns its own pool and a fence that tells us when the GPU is done with it
+    std::vector<Frame> frames(main_frames_in_flight);
+    std::cout << "Creating resources for [" << frames.size() << "] frames in flight..." << std::endl;
+    for (auto &frame : frames)
+    {
+        VkCommandPoolCreateInfo pool_info = {};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
         // VK_COMMAND_POOL_CREATE_TRANSIENT_BIT : implementation hint, indicates command pool will be reset in a short timeframe
-        // VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT : enables the use of vkResetCommandBuffer. currently we will use only a single command buffer, so we can just reset the command pool directly
-        info.flags = 0;
+        // VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT is not needed; we reset the whole pool once per frame instead of individual command buffers
+        pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        pool_info.queueFamilyIndex = vk_queue_family_index; // the command pool needs to know which queue family it will be used for
 
-        info.queueFamilyIndex = vk_queue_family_index; // the command pool needs to know which queue family it will be used for
+        vr = vkCreateCommandPool(vk_device, &pool_info, nullptr, &frame.cmd_pool);
+        CHECK_RESULT(vr);
+
+        // Command buffer allocation
+        // This is the API endpoint for recording API instructions, after which they are submitted to the queue for execution
+        // This is a primary command buffer, so that commands can be recorded to it and then directly executed on a queue
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandPool = frame.cmd_pool;
+        alloc_info.commandBufferCount = 1;
 
-        // Create command pool
-        std::cout << "Creating command pool..." << std::endl;
-        vr = vkCreateCommandPool(vk_device, &info, nullptr, &cmd_pool);
+        vr = vkAllocateCommandBuffers(vk_device, &alloc_info, &frame.cmd_buf);
+        CHECK_RESULT(vr);
+
+        // the fence starts signalled so that the first wait on each frame returns immediately
+        if (!device_context.timeline_semaphore)
+        {
+            VkFenceCreateInfo fence_info = {};
+            fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+            vr = vkCreateFence(vk_device, &fence_info, nullptr, &frame.in_flight);
+            CHECK_RESULT(vr);
+        }
+
+        VkSemaphoreCreateInfo semaphore_info = {};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        vr = vkCreateSemaphore(vk_device, &semaphore_info, nullptr, &frame.image_acquired);
         CHECK_RESULT(vr);
     }
 
-    // Command buffer allocation
-    // This is the API endpoint for recording API instructions, after which they are submitted to the queue for execution
-    // Once execution has finished, their containing command pool must be reset so that commands may be recorded for the next execution
-    // This is a primary command buffer, so that commands can be recorded to it and then directly executed on a queue
-    VkCommandBuffer cmd_buf = {};
+    // Timeline semaphore: frame N signals N + 1 once it has finished on the GPU, so waiting for frame N - frames_in_flight
+    // to finish is a wait for the value N - frames_in_flight + 1, and one semaphore covers every frame in flight
+    VkSemaphore frame_timeline = VK_NULL_HANDLE;
+    if (device_context.timeline_semaphore)
     {
-        VkCommandBufferAllocateInfo info = {};
-        info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        info.commandPool = cmd_pool;
-        info.commandBufferCount = 1;
+        VkSemaphoreTypeCreateInfo type_info = {};
+        type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        type_info.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphore_info = {};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphore_info.pNext = &type_info;
 
-        // Allocate command buffer
-        std::cout << "Allocating command buffer..." << std::endl;
-        vr = vkAllocateCommandBuffers(vk_device, &info, &cmd_buf);
+        vr = vkCreateSemaphore(vk_device, &semaphore_info, nullptr, &frame_timeline);
         CHECK_RESULT(vr);
     }
 
-    // //  Command buffer begin recording config
-    // VkCommandBufferBeginInfo cmd_buf_begin_info = {};
-    // cmd_buf_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    // cmd_buf_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    // Parallel recording: every recording thread owns a command pool per frame in flight for its secondary command buffers, see src/recording.h
+    Job_System        jobs;
+    Parallel_Recorder recorder = {};
+    job_system_init(jobs, main_record_threads);
+    parallel_recorder_init(recorder, vk_device, vk_queue_family_index, main_record_threads, frames.size());
+    recorder.rendering_format = target_format;
+    // Profiling, see src/profiler.h; results arrive frames_in_flight frames late
+    Gpu_Profiler gpu_profiler = {};
+    if (main_profile)
+    {
+        bool statistics = vk_enabled_features.pipelineStatisticsQuery && (main_record_threads == 1 || vk_enabled_features.inheritedQueries);
+        gpu_profiler_init(gpu_profiler, device_context, vk_timestamp_valid_bits, statistics, frames.size(), main_trace_path);
+        if (statistics && main_record_threads > 1) recorder.inherited_statistics = GPU_PROFILER_STATISTICS;
+    }
 
-    // //  Begin recording to command buffer
-    // vr = vkBeginCommandBuffer(cmd_buf, &cmd_buf_begin_info);
-    // CHECK_RESULT(vr);
+    if (main_record_threads > 1 && !main_gpu_driven && !main_instanced) std::cout << "Recording " << main_draw_count << " draws per frame on [" << main_record_threads << "] threads" << std::endl;
+
+    // The frame being recorded and its render target, set by the main loop before the frame graph executes
+    u64           frame_number = 0;
+    u32           image_index = 0;
+    VkFramebuffer framebuffer = {};  // VK_NULL_HANDLE with dynamic rendering, which draws to target_view directly
+    VkImageView   target_view = {};
+    VkExtent2D    extent = {};
+
+    //  Frame graph
+    //  The passes of a frame and the resources they use; the graph places every layout transition and barrier between them, see src/render_graph.h
+    //  The swapchain image arrives with the acquire semaphore waited on at COLOR_ATTACHMENT_OUTPUT and has to end up ready to present;
+    //  headless targets are copied into their readback buffer, which the CPU reads once the frame's fence has signalled
+    //  In GPU-driven mode a cull pass writes the draw commands of the frame first; each frame in flight has its own, so they start out idle
+    Render_Graph frame_graph = {};
+    u32 graph_target = 0;
+    u32 graph_readback = 0;
+    u32 graph_draw_commands = 0;
+    u32 graph_draw_count = 0;
+    {
+        if (main_headless) graph_target = render_graph_import_image(frame_graph, "headless target", VK_IMAGE_ASPECT_COLOR_BIT, { 0, 0, VK_IMAGE_LAYOUT_UNDEFINED }, {});
+        else               graph_target = render_graph_import_image(frame_graph, "swapchain image", VK_IMAGE_ASPECT_COLOR_BIT, { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED },
+                                                                    { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR });
 
-    // //  Frame color
-    // VkClearColorValue color = {{1.0, 0.0, 1.0}};
+        std::vector<Render_Graph_Access> scene_accesses = { { graph_target, RENDER_GRAPH_COLOR_ATTACHMENT } };
+        if (main_gpu_driven && gpu_scene_mode != GPU_SCENE_CPU)
+        {
+            graph_draw_commands = render_graph_import_buffer(frame_graph, "draw commands", {}, {});
+            graph_draw_count    = render_graph_import_buffer(frame_graph, "draw count", {}, {});
+            render_graph_add_pass(frame_graph, "cull", { { graph_draw_commands, RENDER_GRAPH_STORAGE_WRITE }, { graph_draw_count, RENDER_GRAPH_STORAGE_WRITE } }, [&](VkCommandBuffer cmd_buf) {
+                if (main_profile) gpu_profiler_begin_region(gpu_profiler, cmd_buf, "cull");
+                gpu_scene_record_cull(gpu_scene, cmd_buf, frame_number % frames.size(), gpu_scene_grid_view(main_draw_count, frame_number * 0.01f), gpu_scene_mode, capture);
+                if (main_profile) gpu_profiler_end_region(gpu_profiler, cmd_buf);
+            });
+            scene_accesses.push_back({ graph_draw_commands, RENDER_GRAPH_INDIRECT });
+            scene_accesses.push_back({ graph_draw_count, RENDER_GRAPH_INDIRECT });
+        }
 
-    // //  Image range definition
-    // VkImageSubresourceRange image_range = {};
-    // image_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    // image_range.baseMipLevel = 0;
-    // image_range.levelCount = 1;
-    // image_range.baseArrayLayer = 0;
-    // image_range.layerCount = 1;
+        render_graph_add_pass(frame_graph, "scene", scene_accesses, [&](VkCommandBuffer cmd_buf) {
+            //  Clear color, pulsing so that progress is visible on screen
+            f32 pulse = 0.5f + 0.5f * std::sin(frame_number * 0.02f);
+            VkClearValue clear_value = {};
+            clear_value.color = {{pulse, 0.0, 1.0, 1.0}};
+
+            //  with secondary command buffers, timestamps can only be written outside of the render pass
+            //  the GPU-driven and instanced paths record a handful of commands, so they are always recorded inline
+            bool secondaries = job_system_thread_count(jobs) > 1 && !main_gpu_driven && !main_instanced;
+            if (main_profile) gpu_profiler_begin_region(gpu_profiler, cmd_buf, "render pass");
+            if (device_context.dynamic_rendering)
+            {
+                //  the same clear and store as the render pass, on the image view itself
+                VkRenderingAttachmentInfo color_attachment = {};
+                color_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+                color_attachment.imageView = target_view;
+                color_attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+                color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+                color_attachment.clearValue = clear_value;
+
+                VkRenderingInfo rendering_info = {};
+                rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+                rendering_info.flags = secondaries ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
+                rendering_info.renderArea.extent = extent;
+                rendering_info.layerCount = 1;
+                rendering_info.colorAttachmentCount = 1;
+                rendering_info.pColorAttachments = &color_attachment;
+                device_context.cmd_begin_rendering(cmd_buf, &rendering_info);
+            }
+            else
+            {
+                VkRenderPassBeginInfo render_pass_begin_info = {};
+                render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                render_pass_begin_info.renderPass = render_pass;
+                render_pass_begin_info.framebuffer = framebuffer;
+                render_pass_begin_info.renderArea.extent = extent;
+                render_pass_begin_info.clearValueCount = 1;
+                render_pass_begin_info.pClearValues = &clear_value;
+                vkCmdBeginRenderPass(cmd_buf, &render_pass_begin_info, secondaries ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+            }
+            capture_begin_pass(capture);
 
-    // vkCmdClearColorImage(cmd_buf, swapchain_images[0], VK_IMAGE_LAYOUT_GENERAL, &color, 1, &image_range);
+            //  A grid of spinning triangles, recorded across the job system's threads when there is more than one
+            //  or a larger grid that the view pans across, culled and drawn by the GPU-driven path or in instanced batches
+            if (main_gpu_driven)
+            {
+                gpu_scene_record_draws(gpu_scene, cmd_buf, frame_number % frames.size(), extent, gpu_scene_grid_view(main_draw_count, frame_number * 0.01f), gpu_scene_mode);
+            }
+            else if (main_instanced)
+            {
+                batch_renderer_record_draws(batch_renderer, cmd_buf, frame_number % frames.size(), extent, gpu_scene_grid_view(main_draw_count, frame_number * 0.01f));
+            }
+            else if (secondaries)
+            {
+                parallel_record_triangle_grid(recorder, jobs, frame_number % frames.size(), cmd_buf, render_pass, framebuffer, extent,
+                                              triangle_pipeline, triangle_layout, main_draw_count, frame_number * 0.01f);
+            }
+            else
+            {
+                record_triangle_grid(cmd_buf, triangle_pipeline, triangle_layout, extent, 0, main_draw_count, main_draw_count, frame_number * 0.01f, capture);
+            }
+
+            capture_end_pass(capture);
+            if (device_context.dynamic_rendering) device_context.cmd_end_rendering(cmd_buf);
+            else                                  vkCmdEndRenderPass(cmd_buf);
+            if (main_profile) gpu_profiler_end_region(gpu_profiler, cmd_buf);
+        });
+
+        if (main_headless)
+        {
+            graph_readback = render_graph_import_buffer(frame_graph, "readback buffer", {}, { VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED });
+            render_graph_add_pass(frame_graph, "readback", { { graph_target, RENDER_GRAPH_TRANSFER_SRC }, { graph_readback, RENDER_GRAPH_TRANSFER_DST } },
+                                  [&](VkCommandBuffer cmd_buf) { headless_target_record_readback(headless, cmd_buf, image_index); }, true);
+        }
+
+        render_graph_compile(frame_graph, &device_context);
+        if (render_graph_validate(frame_graph) > 0) std::cout << "Warning: the frame graph's barriers failed validation" << std::endl;
+        if (main_list_physical_devices_info) render_graph_log(frame_graph);
+    }
+    startup_phase(startup, "frame resources");
 
     //
     // MAIN LOOP
+    // acquire -> record -> submit -> present
+    // The CPU only blocks on a frame's fence (or the frame timeline), i.e. when it gets frames_in_flight frames ahead of the GPU
     //
 
-    while(window_is_open)
+    Frame_Pacer pacer = {};
+    frame_pacer_init(pacer, main_target_fps);
+    Input_Latency input_latency = {};
+
+    // Synthetic input for latency measurements: SDL_PushEvent may be called from any thread, and the events go through the same
+    // queue and timestamping as real input
+    u32 input_probe_event = (u32)-1;
+    Input_Probe input_probe = {};
+    if (!main_headless && main_input_probe_ms > 0)
     {
-        SDL_Event event;
-        int queue_state = SDL_PollEvent(&event);
+        input_probe_event = SDL_RegisterEvents(1);
+        input_probe.thread = std::thread([&]() {
+            while (!input_probe.quit)
+            {
+                SDL_Event probe = {};
+                probe.type = input_probe_event;
+                SDL_PushEvent(&probe);
+                std::this_thread::sleep_for(std::chrono::milliseconds(main_input_probe_ms));
+            }
+        });
+    }
+
+    // CPU-side data that only lives for one frame, reset once the frame's fence is signalled
+    Arena frame_arena = {};
+    arena_init(frame_arena, 64 << 10);
 
-        if(queue_state > 0)
+    auto loop_start = std::chrono::steady_clock::now();
+    f64 loop_start_cpu = process_cpu_seconds();
+    u64 loop_start_allocations = heap_allocations();
+
+    // CPU time spent recording and submitting frames: the per-frame overhead the API path decides, see api_features_print
+    f64 record_seconds = 0.0;
+    f64 submit_seconds = 0.0;
+
+    Vulkan_Error failure = {}; // an error other than a device loss that ended the frame loop
+
+    try
+    {
+        while(window_is_open)
         {
-            if(event.type == SDL_QUIT)
+            // Handle events until the next frame is due: whatever is pending is drained, and the rest of the frame's slot is spent blocked
+            // in SDL_WaitEventTimeout, which returns as soon as something arrives. Only the sub-millisecond remainder is slept off
+            for (;;)
             {
-                window_is_open = false;
-                break;
+                SDL_Event event;
+                i32 timeout_ms = (i32)(frame_pacer_remaining(pacer) * 1000.0);
+                bool got_event = false;
+                if (!main_headless) got_event = (timeout_ms > 0 ? SDL_WaitEventTimeout(&event, timeout_ms) : SDL_PollEvent(&event)) > 0;
+                if (!got_event)
+                {
+                    frame_pacer_sleep(pacer);
+                    break;
+                }
+
+                if(event.type == SDL_QUIT)
+                {
+                    window_is_open = false;
+                }
+                if(event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+                {
+                    swapchain_dirty = true;
+                }
+                if (event.type == SDL_KEYDOWN || event.type == SDL_MOUSEBUTTONDOWN || event.type == SDL_MOUSEMOTION || event.type == input_probe_event)
+                {
+                    input_latency_record_event(input_latency, event.common.timestamp);
+                }
+            };
+            if (!window_is_open) break;
+
+            Frame &frame = frames[frame_number % frames.size()];
+
+            // wait for the GPU to finish the last submission that used this frame's resources
+            // a wait that keeps timing out means the GPU has hung, which is handled as a lost device
+            if (!device_context.timeline_semaphore || frame_number >= frames.size())
+            {
+                u64 finished = frame_number - frames.size() + 1;
+                VkSemaphoreWaitInfo wait_info = {};
+                wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+                wait_info.semaphoreCount = 1;
+                wait_info.pSemaphores = &frame_timeline;
+                wait_info.pValues = &finished;
+                for (u32 attempt = 1; ; attempt++)
+                {
+                    if (device_context.timeline_semaphore) vr = FAULT_INJECT(FAULT_SITE_WAIT, device_context.wait_semaphores(vk_device, &wait_info, FRAME_WAIT_TIMEOUT));
+                    else                                   vr = FAULT_INJECT(FAULT_SITE_WAIT, vkWaitForFences(vk_device, 1, &frame.in_flight, VK_TRUE, FRAME_WAIT_TIMEOUT));
+                    if (vr != VK_TIMEOUT) break;
+                    if (attempt == FRAME_WAIT_ATTEMPTS)
+                    {
+                        vr = VK_ERROR_DEVICE_LOST;
+                        break;
+                    }
+                    printf("Warning: frame %llu has not finished after %.0f s\n", (unsigned long long)(frame_number - frames.size()), attempt * FRAME_WAIT_TIMEOUT / 1e9);
+                }
+                CHECK_RESULT(vr);
+            }
+            arena_reset(frame_arena);
+
+            // the render target of this frame
+            if (main_headless)
+            {
+                // the last frame rendered into this slot has completed, so its readback can be hashed before the slot is reused
+                image_index = frame_number % frames.size();
+                headless_target_read(headless, image_index);
+                framebuffer = headless.framebuffers[image_index];
+                target_view = headless.image_views[image_index];
+                extent = headless.extent;
+                render_graph_set_image(frame_graph, graph_target, headless.images[image_index]);
+                render_graph_set_buffer(frame_graph, graph_readback, headless.readback_buffers[image_index]);
+            }
+            else
+            {
+                // every frame that could still reference a retired swapchain has now completed
+                destroy_retired_swapchains(vk_device, frame_number, frames.size(), retired_swapchains, spare_semaphores);
+
+                if (swapchain_dirty)
+                {
+                    // a minimised window has a zero-sized surface; sleep until something happens instead of spinning
+                    if (!create_swapchain(vk_physical_device, vk_device, vk_surface, window, main_present_mode, render_pass, frame_number, swapchain, retired_swapchains, spare_semaphores))
+                    {
+                        SDL_WaitEvent(nullptr);
+                        continue;
+                    }
+                    swapchain_dirty = false;
+                }
+
+                vr = FAULT_INJECT(FAULT_SITE_ACQUIRE, vkAcquireNextImageKHR(vk_device, swapchain.handle, UINT64_MAX, frame.image_acquired, VK_NULL_HANDLE, &image_index));
+                if (vr == VK_ERROR_OUT_OF_DATE_KHR || vr == VK_NOT_READY || vr == VK_TIMEOUT)
+                {
+                    // nothing was acquired and the frame's fence is untouched, so this frame slot can simply be retried
+                    if (vr == VK_ERROR_OUT_OF_DATE_KHR) swapchain_dirty = true;
+                    continue;
+                }
+                // a suboptimal image has been acquired and its semaphore will signal, so render and present it before rebuilding
+                if (vr == VK_SUBOPTIMAL_KHR) swapchain_dirty = true;
+                else CHECK_RESULT(vr);
+
+                framebuffer = swapchain.framebuffers[image_index];
+                target_view = swapchain.image_views[image_index];
+                extent = swapchain.extent;
+                render_graph_set_image(frame_graph, graph_target, swapchain.images[image_index]);
             }
 
-            int status = SDL_UpdateWindowSurface(window); //   Render any changes to the surface to the screen (swap front/back buffers)
+            // the frame only starts once it has a target; a retried acquire is neither paced nor does it repeat the frame's CPU work
+            frame_pacer_begin_frame(pacer);
 
-            if(status != 0)
+            if (streaming)
             {
-                const char *message = SDL_GetError();
-                std::cerr << "Error: " << message << std::endl;
-            };
-        };
-    };
+                streamer_update(streamer, frame_number);
+                u32 asset_count = streamer.assets.size();
+                f32 camera = fmodf(frame_number * 0.25f, (f32)asset_count);
+                for (i32 position = (i32)camera - stream_view_distance; position <= (i32)camera + stream_view_distance; position++)
+                {
+                    u32 asset = ((position % (i32)asset_count) + asset_count) % asset_count;
+                    streamer_request(streamer, asset, fabsf(position - camera));
+                    streamer_use(streamer, asset, frame_number);
+                }
+            }
+
+            // written straight into this frame's instance buffer, which the GPU is done with
+            if (main_instanced)
+            {
+                batch_renderer_prepare(batch_renderer, batch_objects, jobs, frame_number % frames.size(), gpu_scene_grid_view(main_draw_count, frame_number * 0.01f), 1.0f / 60.0f);
+            }
+
+            if (main_gpu_driven && gpu_scene_mode != GPU_SCENE_CPU)
+            {
+                render_graph_set_buffer(frame_graph, graph_draw_commands, gpu_scene.commands[frame_number % frames.size()]);
+                render_graph_set_buffer(frame_graph, graph_draw_count,    gpu_scene.counts[frame_number % frames.size()]);
+            }
+
+            // the fence is only reset once we know work will be submitted that signals it again
+            if (!device_context.timeline_semaphore)
+            {
+                vr = vkResetFences(vk_device, 1, &frame.in_flight);
+                CHECK_RESULT(vr);
+            }
+            auto record_start = std::chrono::steady_clock::now();
+            vr = vkResetCommandPool(vk_device, frame.cmd_pool, 0);
+            CHECK_RESULT(vr);
+            parallel_recorder_begin_frame(recorder, frame_number % frames.size());
+
+            //  Command buffer begin recording config
+            VkCommandBufferBeginInfo cmd_buf_begin_info = {};
+            cmd_buf_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            cmd_buf_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+            //  Begin recording to command buffer
+            vr = vkBeginCommandBuffer(frame.cmd_buf, &cmd_buf_begin_info);
+            CHECK_RESULT(vr);
+            if (main_profile) gpu_profiler_begin_frame(gpu_profiler, frame.cmd_buf, frame_number % frames.size(), frame_number);
+
+            //  Every pass of the frame, with the barriers between them
+            capture_frame(capture, extent);
+            render_graph_execute(frame_graph, frame.cmd_buf, &frame_arena);
+
+            if (main_profile) gpu_profiler_end_frame(gpu_profiler, frame.cmd_buf);
+            vr = vkEndCommandBuffer(frame.cmd_buf);
+            CHECK_RESULT(vr);
+            record_seconds += std::chrono::duration<f64>(std::chrono::steady_clock::now() - record_start).count();
+
+            //  Submit everything uploaded this frame; the frame waits on it wherever the data may be consumed
+            VkSemaphore upload_done = VK_NULL_HANDLE;
+            upload_flush(upload, &upload_done);
+
+            //  Submit; rendering waits on the acquire, presentation waits on rendering
+            //  the wait stage matches the render pass's external dependency so the layout transition happens after the acquire
+            //  headless frames have nothing to acquire or present
+            //  on the timeline path the frame also signals frame_number + 1 on the frame timeline, and no fence
+            auto submit_start = std::chrono::steady_clock::now();
+            u64 frame_done = frame_number + 1;
+            if (device_context.synchronization2)
+            {
+                Arena_Vector<VkSemaphoreSubmitInfo> waits(&frame_arena);
+                Arena_Vector<VkSemaphoreSubmitInfo> signals(&frame_arena);
+                if (!main_headless)                    waits.push_back({ VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO, nullptr, frame.image_acquired, 0, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, 0 });
+                if (upload_done != VK_NULL_HANDLE)     waits.push_back({ VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO, nullptr, upload_done, 0, UPLOAD_CONSUMER_STAGES, 0 });
+                if (!main_headless)                    signals.push_back({ VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO, nullptr, swapchain.render_finished[image_index], 0, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, 0 });
+                if (device_context.timeline_semaphore) signals.push_back({ VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO, nullptr, frame_timeline, frame_done, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, 0 });
+
+                VkCommandBufferSubmitInfo cmd_buf_info = {};
+                cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+                cmd_buf_info.commandBuffer = frame.cmd_buf;
+
+                VkSubmitInfo2 submit_info = {};
+                submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+                submit_info.waitSemaphoreInfoCount = waits.size();
+                submit_info.pWaitSemaphoreInfos = waits.data();
+                submit_info.commandBufferInfoCount = 1;
+                submit_info.pCommandBufferInfos = &cmd_buf_info;
+                submit_info.signalSemaphoreInfoCount = signals.size();
+                submit_info.pSignalSemaphoreInfos = signals.data();
+
+                vr = FAULT_INJECT(FAULT_SITE_SUBMIT, device_context.queue_submit2(vk_queue, 1, &submit_info, frame.in_flight));
+                CHECK_RESULT(vr);
+            }
+            else
+            {
+                Arena_Vector<VkSemaphore>          wait_semaphores(&frame_arena);
+                Arena_Vector<VkPipelineStageFlags> wait_stages(&frame_arena);
+                Arena_Vector<VkSemaphore>          signal_semaphores(&frame_arena);
+                Arena_Vector<u64>                  signal_values(&frame_arena); // ignored for the binary semaphores
+                if (!main_headless)            { wait_semaphores.push_back(frame.image_acquired); wait_stages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT); }
+                if (upload_done != VK_NULL_HANDLE) { wait_semaphores.push_back(upload_done);          wait_stages.push_back(UPLOAD_CONSUMER_STAGES); }
+                if (!main_headless)                    { signal_semaphores.push_back(swapchain.render_finished[image_index]); signal_values.push_back(0); }
+                if (device_context.timeline_semaphore) { signal_semaphores.push_back(frame_timeline);                         signal_values.push_back(frame_done); }
+
+                VkTimelineSemaphoreSubmitInfo timeline_info = {};
+                timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+                timeline_info.signalSemaphoreValueCount = signal_values.size();
+                timeline_info.pSignalSemaphoreValues = signal_values.data();
+
+                VkSubmitInfo submit_info = {};
+                submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                if (device_context.timeline_semaphore) submit_info.pNext = &timeline_info;
+                submit_info.waitSemaphoreCount = wait_semaphores.size();
+                submit_info.pWaitSemaphores = wait_semaphores.data();
+                submit_info.pWaitDstStageMask = wait_stages.data();
+                submit_info.commandBufferCount = 1;
+                submit_info.pCommandBuffers = &frame.cmd_buf;
+                submit_info.signalSemaphoreCount = signal_semaphores.size();
+                submit_info.pSignalSemaphores = signal_semaphores.data();
+
+                vr = FAULT_INJECT(FAULT_SITE_SUBMIT, vkQueueSubmit(vk_queue, 1, &submit_info, frame.in_flight));
+                CHECK_RESULT(vr);
+            }
+            submit_seconds += std::chrono::duration<f64>(std::chrono::steady_clock::now() - submit_start).count();
+
+            if (!main_headless)
+            {
+                VkPresentInfoKHR present_info = {};
+                present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+                present_info.waitSemaphoreCount = 1;
+                present_info.pWaitSemaphores = &swapchain.render_finished[image_index];
+                present_info.swapchainCount = 1;
+                present_info.pSwapchains = &swapchain.handle;
+                present_info.pImageIndices = &image_index;
+
+                vr = FAULT_INJECT(FAULT_SITE_PRESENT, vkQueuePresentKHR(vk_queue, &present_info));
+                if (vr == VK_ERROR_OUT_OF_DATE_KHR || vr == VK_SUBOPTIMAL_KHR) swapchain_dirty = true;
+                else CHECK_RESULT(vr);
+                input_latency_frame_presented(input_latency, SDL_GetTicks());
+            }
+
+            if (frame_number == 0)
+            {
+                startup_phase(startup, "first frame");
+                if (recovery.count == 0) startup_print_summary(startup, &preload, "Startup");
+                else
+                {
+                    recovery.ms.push_back(startup_total_ms(startup));
+                    startup_print_summary(startup, nullptr, "Device recovery");
+                }
+            }
+
+            // the frame count covers every device of the run
+            frame_number++;
+            if (main_frame_count != 0 && recovery.frames + frame_number >= main_frame_count) window_is_open = false;
+        }
+    }
+    catch (const Vulkan_Error &error)
+    {
+        if (error.result == VK_ERROR_DEVICE_LOST)
+        {
+            // everything on the device is destroyed below and main() builds it again; the recovery is timed from here on
+            printf("\nDevice lost at frame %llu: ", (unsigned long long)frame_number);
+            vulkan_error_report(error);
+            device_lost = true;
+            startup_timer_init(startup);
+        }
+        else
+        {
+            // any other error ends the run, but only once everything on the device is destroyed: main() destroys the instance next
+            failure = error;
+        }
+        // a device that failed may well report its loss while it is torn down
+        vulkan_device_lost = true;
+    }
+    bool failed = failure.result != VK_SUCCESS;
+
+    f64 loop_seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - loop_start).count();
+    f64 loop_cpu_seconds = process_cpu_seconds() - loop_start_cpu;
+    u64 loop_allocations = heap_allocations() - loop_start_allocations;
+
+    input_probe_stop(input_probe);
+
+    // wait for all frames in flight before reporting and tearing anything down
+    // on a lost device this returns straight away, and nothing rendered can be read back or reported
+    vr = vkDeviceWaitIdle(vk_device);
+    CHECK_RESULT(vr);
+    recovery.frames += frame_number;
+
+    // hash the frames still in flight, oldest first, and report the checksum of the whole run
+    if (main_headless && !main_bench && !device_lost && !failed)
+    {
+        for (u64 i = 0; i < frames.size(); i++) headless_target_read(headless, (frame_number + i) % frames.size());
+        printf("Image checksum: %016llx over %llu frames of %ux%u\n", (unsigned long long)headless.checksum, (unsigned long long)headless.frames_read, headless.extent.width, headless.extent.height);
+
+        if (main_screenshot_path && frame_number > 0)
+        {
+            if (headless_target_write_ppm(headless, (frame_number - 1) % frames.size(), main_screenshot_path)) std::cout << "Wrote the last frame to " << main_screenshot_path << std::endl;
+            else std::cout << "Failed to write " << main_screenshot_path << std::endl;
+        }
+    }
+
+    // report frame throughput
+    if (!main_bench && !device_lost && !failed)
+    {
+        f64 seconds = loop_seconds;
+        std::cout << std::endl << (main_headless ? "Rendered " : "Presented ") << frame_number << " frames in " << seconds << "s";
+        if (frame_number > 0 && seconds > 0.0)
+        {
+            std::cout << " (" << frame_number / seconds << " fps, " << seconds * 1000.0 / frame_number << " ms/frame)";
+        }
+        std::cout << std::endl;
+
+        // CPU time of every thread, so 100% is one core kept busy for the whole run
+        if (seconds > 0.0) printf("CPU usage: %.1f%% of a core (%.3fs CPU over %.3fs)\n", loop_cpu_seconds * 100.0 / seconds, loop_cpu_seconds, seconds);
+        if (frame_number > 0) printf("Frame arena peak: %zu bytes\n", frame_arena.peak);
+        if (frame_number > 0 && HEAP_ALLOCATIONS_COUNTED) printf("Heap allocations: %.2f per frame\n", (f64)loop_allocations / frame_number);
+        if (frame_number > 0)
+        {
+            printf("Submission overhead: %.1f us recording + %.1f us submitting per frame, on the ", record_seconds * 1e6 / frame_number, submit_seconds * 1e6 / frame_number);
+            api_features_print(device_context);
+        }
+        frame_pacer_print_summary(pacer);
+        if (!main_headless) input_latency_print_summary(input_latency);
+        if (streaming) streamer_print_summary(streamer);
+    }
 
     //
     // CLEANUP
     //
 
     // pipeline
-    vkDestroyCommandPool(vk_device, cmd_pool, nullptr);
+    render_graph_destroy(frame_graph, device_context);
+    if (main_profile) gpu_profiler_destroy(gpu_profiler);
+    job_system_destroy(jobs);
+    parallel_recorder_destroy(recorder);
+    for (auto &frame : frames)
+    {
+        vkDestroySemaphore(vk_device, frame.image_acquired, nullptr);
+        vkDestroyFence(vk_device, frame.in_flight, nullptr);
+        vkDestroyCommandPool(vk_device, frame.cmd_pool, nullptr);
+    }
+    vkDestroySemaphore(vk_device, frame_timeline, nullptr);
+    if (!device_lost && !failed)
+    {
+        vr = pipeline_cache_save(vk_device, pipeline_cache, main_pipeline_cache_path);
+        CHECK_RESULT(vr);
+    }
+    vkDestroyPipeline(vk_device, triangle_pipeline, nullptr);
+    vkDestroyPipelineLayout(vk_device, triangle_layout, nullptr);
+    vkDestroyRenderPass(vk_device, render_pass, nullptr); // VK_NULL_HANDLE with dynamic rendering
+    shader_module_cache_destroy(vk_device, shader_modules);
+    pipeline_cache_destroy(vk_device, pipeline_cache);
+    // memory
+    arena_destroy(frame_arena);
+    if (main_gpu_driven) gpu_scene_destroy(gpu_scene, gpu_allocator);
+    if (main_instanced) batch_renderer_destroy(batch_renderer, gpu_allocator);
+    if (streaming) streamer_destroy(streamer); // the pack itself is closed by main()
+    if (main_headless) headless_target_destroy(headless, gpu_allocator, vk_device);
+    upload_destroy(upload, gpu_allocator);
+    gpu_allocator_log_stats(gpu_allocator);
+    gpu_allocator_destroy(gpu_allocator);
     // vulkan
-    vkDestroySwapchainKHR(vk_device, vk_swapchain, nullptr);
-    vkDestroySurfaceKHR(vk_instance, vk_surface, nullptr);
+    destroy_retired_swapchains(vk_device, UINT64_MAX, 0, retired_swapchains, spare_semaphores);
+    destroy_swapchain(vk_device, swapchain, spare_semaphores);
+    for (auto &semaphore : spare_semaphores) vkDestroySemaphore(vk_device, semaphore, nullptr);
     vkDestroyDevice(vk_device, NULL);
-    vkDestroyInstance(vk_instance, NULL);
-    // sdl
-    SDL_DestroyWindow(window);
+    device_guard.device = VK_NULL_HANDLE;
 
-    return 0;
+    vulkan_device_lost = false;
+    if (failed) throw failure;
+    if (!device_lost) return SESSION_DONE;
+    startup_phase(startup, "teardown");
+    return SESSION_DEVICE_LOST;
 };
 
+// SWAPCHAIN MANAGEMENT
+
+const char *present_mode_name(VkPresentModeKHR present_mode)
+{
+    switch (present_mode)
+    {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:    return "IMMEDIATE";
+        case VK_PRESENT_MODE_MAILBOX_KHR:      return "MAILBOX";
+        case VK_PRESENT_MODE_FIFO_KHR:         return "FIFO";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+        default:                               return "UNKNOWN";
+    }
+}
+
+// Use the requested present mode if the surface supports it, otherwise walk the fallback chain from the requested mode onwards:
+// MAILBOX -> IMMEDIATE -> FIFO
+// MAILBOX and IMMEDIATE both render uncapped, trading tearing for latency in the IMMEDIATE case; FIFO is the only mode the spec guarantees
+VkPresentModeKHR select_present_mode(std::vector<VkPresentModeKHR> &available, VkPresentModeKHR requested)
+{
+    auto is_available = [&](VkPresentModeKHR mode) { return std::find(available.begin(), available.end(), mode) != available.end(); };
+    if (is_available(requested)) return requested;
+
+    const VkPresentModeKHR fallback_chain[] = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_KHR };
+    bool past_requested = false;
+    for (VkPresentModeKHR mode : fallback_chain)
+    {
+        past_requested = past_requested || mode == requested;
+        if (past_requested && is_available(mode)) return mode;
+    }
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+// Prefer 8-bit BGRA, otherwise take the first format the surface offers
+// The choice only depends on the surface, so it stays the same across swapchain recreations and the render pass can be created once
+VkSurfaceFormatKHR select_surface_format(VkPhysicalDevice &vk_physical_device, VkSurfaceKHR &vk_surface)
+{
+    std::vector<VkSurfaceFormatKHR> surface_formats = {};
+    VkResult vr = COUNT_APPEND_HELPER(surface_formats, vkGetPhysicalDeviceSurfaceFormatsKHR, vk_physical_device, vk_surface);
+    CHECK_RESULT(vr);
+
+    for (auto &format : surface_formats)
+    {
+        if (format.format == VK_FORMAT_B8G8R8A8_UNORM && format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) return format;
+    }
+    return surface_formats[0];
+}
+
+// Create a swapchain for the current surface size, replacing `swapchain` if it already holds one
+// The old swapchain is passed as oldSwapchain so the driver can hand over its resources, then moved to `retired_swapchains`
+// instead of being destroyed, which would otherwise need a vkDeviceWaitIdle to make sure no frame in flight still uses it
+// Returns false, leaving `swapchain` untouched, when the surface has a zero extent (e.g. the window is minimised)
+bool create_swapchain(VkPhysicalDevice &vk_physical_device, VkDevice &vk_device, VkSurfaceKHR &vk_surface, SDL_Window *window, VkPresentModeKHR requested_present_mode, VkRenderPass render_pass, u64 frame_number, Swapchain &swapchain, std::vector<Swapchain> &retired_swapchains, std::vector<VkSemaphore> &spare_semaphores)
+{
+    VkResult vr = VK_SUCCESS;
+
+    //  Query surface properties
+    VkSurfaceCapabilitiesKHR surface_capabilities = {};
+    vr = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(vk_physical_device, vk_surface, &surface_capabilities);
+    CHECK_RESULT(vr);
+
+    //  A current extent of 0xFFFFFFFF means the surface size is determined by the swapchain, so ask SDL for the drawable size
+    VkExtent2D extent = surface_capabilities.currentExtent;
+    if (extent.width == UINT32_MAX)
+    {
+        i32 width = 0, height = 0;
+        SDL_Vulkan_GetDrawableSize(window, &width, &height);
+        extent.width  = std::clamp<u32>(width,  surface_capabilities.minImageExtent.width,  surface_capabilities.maxImageExtent.width);
+        extent.height = std::clamp<u32>(height, surface_capabilities.minImageExtent.height, surface_capabilities.maxImageExtent.height);
+    }
+    if (extent.width == 0 || extent.height == 0) return false;
+
+    std::vector<VkPresentModeKHR> present_modes = {};
+    vr = COUNT_APPEND_HELPER(present_modes, vkGetPhysicalDeviceSurfacePresentModesKHR, vk_physical_device, vk_surface);
+    CHECK_RESULT(vr);
+    VkPresentModeKHR present_mode = select_present_mode(present_modes, requested_present_mode);
+
+    //  The render pass was created for this format, see select_surface_format
+    VkSurfaceFormatKHR surface_format = select_surface_format(vk_physical_device, vk_surface);
+
+    //  Triple buffering, within what the surface allows (a max of 0 means there is no limit)
+    u32 min_image_count = std::max(3u, surface_capabilities.minImageCount);
+    if (surface_capabilities.maxImageCount > 0) min_image_count = std::min(min_image_count, surface_capabilities.maxImageCount);
+
+    //  Define swapchain interface
+    VkSwapchainCreateInfoKHR swapchain_info = {};
+    swapchain_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    swapchain_info.presentMode = present_mode;
+    swapchain_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    swapchain_info.imageFormat = surface_format.format;
+    swapchain_info.imageColorSpace = surface_format.colorSpace;
+    swapchain_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    swapchain_info.compositeAlpha  = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    swapchain_info.preTransform = surface_capabilities.currentTransform;
+    swapchain_info.minImageCount = min_image_count;
+    swapchain_info.imageArrayLayers = 1;
+    swapchain_info.surface = vk_surface;
+    swapchain_info.imageExtent = extent;
+    swapchain_info.clipped = VK_TRUE;
+    swapchain_info.oldSwapchain = swapchain.handle;
+
+    Swapchain new_swapchain = {};
+    new_swapchain.format = surface_format;
+    new_swapchain.extent = extent;
+    new_swapchain.present_mode = present_mode;
+    vr = vkCreateSwapchainKHR(vk_device, &swapchain_info, nullptr, &new_swapchain.handle);
+    CHECK_RESULT(vr);
+
+    //  Retrieve images from swapchain
+    vr = COUNT_APPEND_HELPER(new_swapchain.images, vkGetSwapchainImagesKHR, vk_device, new_swapchain.handle);
+    CHECK_RESULT(vr);
+
+    //  Create one view, framebuffer and render-finished semaphore per image, reusing semaphores of previously destroyed swapchains
+    //  Dynamic rendering draws to the views directly; without a render pass the framebuffers stay VK_NULL_HANDLE
+    for (auto &image : new_swapchain.images)
+    {
+        VkImageViewCreateInfo view_info = {};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = surface_format.format;
+        view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        view_info.subresourceRange.levelCount = 1;
+        view_info.subresourceRange.layerCount = 1;
+
+        VkImageView view = {};
+        vr = vkCreateImageView(vk_device, &view_info, nullptr, &view);
+        CHECK_RESULT(vr);
+        new_swapchain.image_views.push_back(view);
+
+        VkFramebuffer framebuffer = {};
+        if (render_pass != VK_NULL_HANDLE)
+        {
+            VkFramebufferCreateInfo framebuffer_info = {};
+            framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebuffer_info.renderPass = render_pass;
+            framebuffer_info.attachmentCount = 1;
+            framebuffer_info.pAttachments = &view;
+            framebuffer_info.width = extent.width;
+            framebuffer_info.height = extent.height;
+            framebuffer_info.layers = 1;
+
+            vr = vkCreateFramebuffer(vk_device, &framebuffer_info, nullptr, &framebuffer);
+            CHECK_RESULT(vr);
+        }
+        new_swapchain.framebuffers.push_back(framebuffer);
+
+        VkSemaphore semaphore = {};
+        if (spare_semaphores.size() > 0)
+        {
+            semaphore = spare_semaphores.back();
+            spare_semaphores.pop_back();
+        }
+        else
+        {
+            VkSemaphoreCreateInfo semaphore_info = {};
+            semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            vr = vkCreateSemaphore(vk_device, &semaphore_info, nullptr, &semaphore);
+            CHECK_RESULT(vr);
+        }
+        new_swapchain.render_finished.push_back(semaphore);
+    }
+
+    std::cout << "Swapchain: " << extent.width << "x" << extent.height << ", " << new_swapchain.images.size() << " images, present mode " << present_mode_name(present_mode);
+    if (present_mode != requested_present_mode) std::cout << " (" << present_mode_name(requested_present_mode) << " unavailable)";
+    std::cout << std::endl;
+
+    if (swapchain.handle != VK_NULL_HANDLE)
+    {
+        swapchain.retired_at_frame = frame_number;
+        retired_swapchains.push_back(std::move(swapchain));
+    }
+    swapchain = std::move(new_swapchain);
+    return true;
+}
+
+void destroy_swapchain(VkDevice &vk_device, Swapchain &swapchain, std::vector<VkSemaphore> &spare_semaphores)
+{
+    for (auto &framebuffer : swapchain.framebuffers) vkDestroyFramebuffer(vk_device, framebuffer, nullptr);
+    for (auto &view : swapchain.image_views) vkDestroyImageView(vk_device, view, nullptr);
+    spare_semaphores.insert(spare_semaphores.end(), swapchain.render_finished.begin(), swapchain.render_finished.end());
+    vkDestroySwapchainKHR(vk_device, swapchain.handle, nullptr);
+    swapchain = {};
+}
+
+// Destroy retired swapchains once every frame that may have rendered to them has completed
+// After waiting on the fence of frame N, all frames up to N - frames_in_flight are known to be finished
+// Vulkan 1.0 offers no way to know when a present itself has completed; the frame's fence is the accepted proxy
+void destroy_retired_swapchains(VkDevice &vk_device, u64 frame_number, u64 frames_in_flight, std::vector<Swapchain> &retired_swapchains, std::vector<VkSemaphore> &spare_semaphores)
+{
+    for (usize i = 0; i < retired_swapchains.size();)
+    {
+        if (retired_swapchains[i].retired_at_frame + frames_in_flight <= frame_number)
+        {
+            destroy_swapchain(vk_device, retired_swapchains[i], spare_semaphores);
+            retired_swapchains.erase(retired_swapchains.begin() + i);
+        }
+        else i++;
+    }
+}
+
 // DEVICE QUEURYING AND SUITABILITY CHECKING
 
+// Without a surface (headless) presentation support is not queried and not required
 bool check_queue_family_suitability(VkSurfaceKHR &vk_surface, VkPhysicalDevice &physical_device, Queue_Family_Details &queue_family)
 {
-    VkBool32 surface_support = true;
-    vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, queue_family.index, vk_surface, &surface_support);
-    if (!surface_support) return false;
+    VkBool32 surface_support = false;
+    if (vk_surface != VK_NULL_HANDLE) vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, queue_family.index, vk_surface, &surface_support);
+    queue_family.present_support = surface_support;
+    if (vk_surface != VK_NULL_HANDLE && !surface_support) return false;
 
     // check support for graphics and transfer commands
     if (!(queue_family.props.queueFlags & VK_QUEUE_GRAPHICS_BIT)) return false;
@@ -428,22 +1697,103 @@ bool check_queue_family_suitability(VkSurfaceKHR &vk_surface, VkPhysicalDevice &
     return true;
 }
 
-bool check_physical_device_suitability(VkSurfaceKHR &vk_surface, Physical_Device_Detials &physical_device)
+// The surface queries are built in `scratch`, which the caller resets per device
+bool check_physical_device_suitability(VkSurfaceKHR &vk_surface, Physical_Device_Detials &physical_device, Arena &scratch)
 {
     VkResult vr =  VK_SUCCESS;
 
-    if (physical_device.queue_families.size() < 1) return false;
+    // at least one family must be able to execute graphics work and present it (when there is a surface)
+    bool has_suitable_queue_family = false;
+    for (auto &queue_family : physical_device.queue_families) if (queue_family.suitable) { has_suitable_queue_family = true; break; }
+    if (!has_suitable_queue_family) return false;
+    if (vk_surface == VK_NULL_HANDLE) return true;
 
-    bool present_fifo_support = false;
-    std::vector<VkPresentModeKHR> present_modes;
+    // any present mode will do, select_present_mode falls back to whatever the surface offers
+    Arena_Vector<VkPresentModeKHR> present_modes(&scratch);
     vr = COUNT_APPEND_HELPER(present_modes, vkGetPhysicalDeviceSurfacePresentModesKHR, physical_device.handle, vk_surface);
     CHECK_RESULT(vr);
-    for (auto &present_mode : present_modes) if (present_mode == VK_PRESENT_MODE_FIFO_KHR) { present_fifo_support = true; break; }
-    if (!present_fifo_support) return false;
+    if (present_modes.size() < 1) return false;
+
+    Arena_Vector<VkSurfaceFormatKHR> surface_formats(&scratch);
+    vr = COUNT_APPEND_HELPER(surface_formats, vkGetPhysicalDeviceSurfaceFormatsKHR, physical_device.handle, vk_surface);
+    CHECK_RESULT(vr);
+    if (surface_formats.size() < 1) return false;
 
     return true;
 }
 
+// Pick a queue for each role on a device
+// graphics: the first suitable family (graphics + transfer + present)
+// compute:  a family with compute but no graphics, so compute work can overlap with the graphics queue
+// transfer: a family with transfer but neither graphics nor compute, usually backed by dedicated copy engines
+// A role without a dedicated family falls back to the graphics family, using a separate queue of that family when it exposes more than one
+void select_physical_device_queues(Physical_Device_Detials &physical_device)
+{
+    i32 graphics = -1, compute = -1, transfer = -1;
+    for (u32 i = 0; i < physical_device.queue_families.size(); i++)
+    {
+        Queue_Family_Details &queue_family = physical_device.queue_families[i];
+        VkQueueFlags flags = queue_family.props.queueFlags;
+
+        if (graphics < 0 && queue_family.suitable) graphics = i;
+        if (compute  < 0 && (flags & VK_QUEUE_COMPUTE_BIT)  && !(flags & VK_QUEUE_GRAPHICS_BIT)) compute = i;
+        if (transfer < 0 && (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) transfer = i;
+    }
+    if (graphics < 0) return;
+    if (compute  < 0) compute  = graphics;
+    if (transfer < 0) transfer = graphics;
+
+    // hand out queues of a family in order, sharing the last one once the family runs out
+    std::vector<u32> queues_taken(physical_device.queue_families.size(), 0);
+    auto take_queue = [&](i32 i) {
+        Queue_Family_Details &queue_family = physical_device.queue_families[i];
+        Queue_Selection selection = {};
+        selection.family_index = queue_family.index;
+        selection.queue_index  = std::min(queues_taken[i]++, queue_family.props.queueCount - 1);
+        return selection;
+    };
+    physical_device.graphics_queue = take_queue(graphics);
+    physical_device.compute_queue  = take_queue(compute);
+    physical_device.transfer_queue = take_queue(transfer);
+}
+
+VkDeviceSize get_device_local_memory_size(VkPhysicalDeviceMemoryProperties &mem_props)
+{
+    VkDeviceSize size = 0;
+    for (u32 i = 0; i < mem_props.memoryHeapCount; i++)
+    {
+        if (mem_props.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) size += mem_props.memoryHeaps[i].size;
+    }
+    return size;
+}
+
+// Score a device for selection, higher is better
+// Only depends on the queried details, so it can be evaluated against a mocked device list
+// bits 60..63: device type rank
+// bits 20..59: device-local memory in MiB
+// bits  0..19: tie-breakers: dedicated compute/transfer queues, then the maximum 2D image dimension
+// Without --high-perf integrated GPUs rank above discrete ones for their lower power draw
+u64 score_physical_device(Physical_Device_Detials &physical_device, bool prefer_high_performance)
+{
+    u64 type_rank = 0;
+    switch (physical_device.props.deviceType)
+    {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:   type_rank = prefer_high_performance ? 4 : 3; break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: type_rank = prefer_high_performance ? 3 : 4; break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:    type_rank = 2; break;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:            type_rank = 1; break;
+        default:                                     type_rank = 0; break;
+    }
+
+    u64 vram_mib = std::min<u64>(get_device_local_memory_size(physical_device.mem_props) >> 20, (1ull << 40) - 1);
+
+    u64 tie_breaker = std::min<u64>(physical_device.props.limits.maxImageDimension2D >> 4, 0x3FFFF);
+    if (physical_device.compute_queue.family_index  != physical_device.graphics_queue.family_index) tie_breaker |= 1 << 19;
+    if (physical_device.transfer_queue.family_index != physical_device.graphics_queue.family_index) tie_breaker |= 1 << 18;
+
+    return (type_rank << 60) | (vram_mib << 20) | tie_breaker;
+}
+
 void log_physical_device_props(VkPhysicalDeviceProperties &props) {
     // log name
     std::cout << props.deviceName << std::endl;
@@ -458,6 +1808,26 @@ void log_physical_device_props(VkPhysicalDeviceProperties &props) {
     std::cout << std::endl;
 }
 
+void log_memory_heaps(VkPhysicalDeviceMemoryProperties &mem_props) {
+    std::cout << "memory heaps: [" << mem_props.memoryHeapCount << "]" << std::endl;
+    for (u32 i = 0; i < mem_props.memoryHeapCount; i++)
+    {
+        std::cout << "heap " << i << ":\t" << (mem_props.memoryHeaps[i].size >> 20) << " MiB";
+        std::cout << (mem_props.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ? "\tDEVICE_LOCAL" : "") << std::endl;
+    }
+}
+
+void log_device_selection(Physical_Device_Detials &physical_device) {
+    std::cout << physical_device.props.deviceName << " (score 0x" << std::hex << physical_device.score << std::dec << ", " << (get_device_local_memory_size(physical_device.mem_props) >> 20) << " MiB device-local)" << std::endl;
+
+    Queue_Selection &graphics = physical_device.graphics_queue;
+    Queue_Selection &compute  = physical_device.compute_queue;
+    Queue_Selection &transfer = physical_device.transfer_queue;
+    std::cout << "\tgraphics: family " << graphics.family_index << " queue " << graphics.queue_index << std::endl;
+    std::cout << "\tcompute:  family " << compute.family_index  << " queue " << compute.queue_index  << (compute.family_index  != graphics.family_index ? " (dedicated)" : "") << std::endl;
+    std::cout << "\ttransfer: family " << transfer.family_index << " queue " << transfer.queue_index << (transfer.family_index != graphics.family_index ? " (dedicated)" : "") << std::endl;
+}
+
 void log_queue_family_props(VkQueueFamilyProperties &props, u32 index) {
     // log family index and count
     std::cout << "family " << index << ":\tcount:\t" << props.queueCount << "\tflags: | ";
@@ -476,7 +1846,148 @@ void log_queue_family_props(VkQueueFamilyProperties &props, u32 index) {
     std::cout << std::endl;
 }
 
-std::vector<Physical_Device_Detials> get_suitable_physical_devices_and_queue_families(VkInstance &vk_instance, VkSurfaceKHR &vk_surface, bool log)
+// DEVICE ENUMERATION CACHE
+// The queue families of every device, their present support and the result of the surface checks are written to a file after a
+// full enumeration; the next run reuses them when the same devices come back in the same order with the same driver versions,
+// which skips the per-family and per-surface queries (slow under the validation layer)
+// Present support may change with the window system, so it is queried again for the selected family before a cached result is used
+
+#define DEVICE_CACHE_MAGIC   0x56454456 // "VDEV"
+#define DEVICE_CACHE_VERSION 2
+
+struct Device_Cache_Header {
+    u32 magic;
+    u32 version;
+    u32 device_count;
+    u32 has_surface;
+};
+
+// followed by `queue_family_count` Device_Cache_Queue_Family
+struct Device_Cache_Entry {
+    u32 vendor_id;
+    u32 device_id;
+    u32 driver_version;
+    u32 api_version;
+    u8  pipeline_cache_uuid[VK_UUID_SIZE];
+    u32 suitable;
+    u32 queue_family_count;
+};
+
+// Queue_Family_Details with fixed-size flags, so the file has no padding and a flag read back is known to be 0 or 1
+struct Device_Cache_Queue_Family {
+    u32                     index;
+    VkQueueFamilyProperties props;
+    u32                     present_support;
+    u32                     suitable;
+};
+
+bool device_cache_entry_matches(const Device_Cache_Entry &entry, const VkPhysicalDeviceProperties &props)
+{
+    return entry.vendor_id == props.vendorID && entry.device_id == props.deviceID && entry.driver_version == props.driverVersion &&
+           entry.api_version == props.apiVersion && memcmp(entry.pipeline_cache_uuid, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+// Fill in the queue families and suitability of `physical_devices` from the cache at `path`; false if it does not match them
+bool device_cache_read(const char *path, bool has_surface, std::vector<Physical_Device_Detials> &physical_devices)
+{
+    std::vector<u8> data = {};
+    if (!read_file(path, data)) return false;
+
+    usize offset = 0;
+    auto read = [&](void *dst, usize size) {
+        if (data.size() - offset < size) return false;
+        memcpy(dst, data.data() + offset, size);
+        offset += size;
+        return true;
+    };
+
+    Device_Cache_Header header = {};
+    if (!read(&header, sizeof(header))) return false;
+    if (header.magic != DEVICE_CACHE_MAGIC || header.version != DEVICE_CACHE_VERSION) return false;
+    if (header.device_count != physical_devices.size() || header.has_surface != (u32)has_surface) return false;
+
+    for (auto &physical_device : physical_devices)
+    {
+        Device_Cache_Entry entry = {};
+        if (!read(&entry, sizeof(entry)) || !device_cache_entry_matches(entry, physical_device.props)) return false;
+
+        // the count is checked against the file before anything is sized by it; a corrupt one must not allocate gigabytes
+        if (entry.suitable > 1 || (data.size() - offset) / sizeof(Device_Cache_Queue_Family) < entry.queue_family_count) return false;
+        physical_device.suitable = entry.suitable != 0;
+        physical_device.queue_families.resize(entry.queue_family_count);
+        for (auto &queue_family : physical_device.queue_families)
+        {
+            Device_Cache_Queue_Family cached = {};
+            read(&cached, sizeof(cached));
+            if (cached.present_support > 1 || cached.suitable > 1) return false;
+            queue_family.index           = cached.index;
+            queue_family.props           = cached.props;
+            queue_family.present_support = cached.present_support != 0;
+            queue_family.suitable        = cached.suitable != 0;
+        }
+    }
+    return offset == data.size();
+}
+
+void device_cache_write(const char *path, bool has_surface, std::vector<Physical_Device_Detials> &physical_devices)
+{
+    std::vector<u8> data = {};
+    auto append = [&](const void *src, usize size) { data.insert(data.end(), (const u8 *)src, (const u8 *)src + size); };
+
+    Device_Cache_Header header = {};
+    header.magic        = DEVICE_CACHE_MAGIC;
+    header.version      = DEVICE_CACHE_VERSION;
+    header.device_count = physical_devices.size();
+    header.has_surface  = has_surface;
+    append(&header, sizeof(header));
+
+    for (auto &physical_device : physical_devices)
+    {
+        Device_Cache_Entry entry = {};
+        entry.vendor_id          = physical_device.props.vendorID;
+        entry.device_id          = physical_device.props.deviceID;
+        entry.driver_version     = physical_device.props.driverVersion;
+        entry.api_version        = physical_device.props.apiVersion;
+        memcpy(entry.pipeline_cache_uuid, physical_device.props.pipelineCacheUUID, VK_UUID_SIZE);
+        entry.suitable           = physical_device.suitable;
+        entry.queue_family_count = physical_device.queue_families.size();
+        append(&entry, sizeof(entry));
+        for (auto &queue_family : physical_device.queue_families)
+        {
+            Device_Cache_Queue_Family cached = {};
+            cached.index           = queue_family.index;
+            cached.props           = queue_family.props;
+            cached.present_support = queue_family.present_support;
+            cached.suitable        = queue_family.suitable;
+            append(&cached, sizeof(cached));
+        }
+    }
+
+    if (!write_file(path, data.data(), data.size())) std::cout << "Failed to write device cache " << path << std::endl;
+}
+
+// Query the queue families of a device and check it, see check_queue_family_suitability/check_physical_device_suitability
+void query_physical_device(VkSurfaceKHR &vk_surface, Physical_Device_Detials &physical_device, Arena &scratch)
+{
+    Arena_Vector<VkQueueFamilyProperties> queue_family_props(&scratch);
+    COUNT_APPEND_HELPER(queue_family_props, vkGetPhysicalDeviceQueueFamilyProperties, physical_device.handle);
+
+    physical_device.queue_families.clear();
+    for (u32 index = 0; index < queue_family_props.size(); index++)
+    {
+        Queue_Family_Details queue_family = {};
+        queue_family.index = index;
+        queue_family.props = queue_family_props[index];
+
+        // families unsuitable for graphics are kept, they may still serve as dedicated compute or transfer families
+        queue_family.suitable = check_queue_family_suitability(vk_surface, physical_device.handle, queue_family);
+        physical_device.queue_families.push_back(queue_family);
+    }
+
+    physical_device.suitable = check_physical_device_suitability(vk_surface, physical_device, scratch);
+}
+
+std::vector<Physical_Device_Detials> get_suitable_physical_devices_and_queue_families(VkInstance &vk_instance, VkSurfaceKHR &vk_surface, bool prefer_high_performance, bool log, const char *cache_path)
 {
     VkResult vr = VK_SUCCESS;
 
@@ -492,65 +2003,103 @@ std::vector<Physical_Device_Detials> get_suitable_physical_devices_and_queue_fam
         std::cout << std::endl << "Querying [" << physical_device_handles.size() << "] physical devices:" << std::endl;
     }
 
-    // populate physical devices
-    for (auto& handle : physical_device_handles)
+    // properties are needed either way, they are the cache key
+    std::vector<Physical_Device_Detials> all_devices(physical_device_handles.size());
+    for (u32 i = 0; i < physical_device_handles.size(); i++)
     {
-        Physical_Device_Detials physical_device = {};
-        physical_device.handle = handle;
-
-        // get properties
-        vkGetPhysicalDeviceProperties(handle, &physical_device.props);
+        all_devices[i].handle = physical_device_handles[i];
+        vkGetPhysicalDeviceProperties(all_devices[i].handle, &all_devices[i].props);
+        vkGetPhysicalDeviceMemoryProperties(all_devices[i].handle, &all_devices[i].mem_props);
+    }
 
-        // get queue families
-        std::vector<VkQueueFamilyProperties> queue_family_props;
-        COUNT_APPEND_HELPER(queue_family_props, vkGetPhysicalDeviceQueueFamilyProperties, handle);
+    bool has_surface = vk_surface != VK_NULL_HANDLE;
+    bool cached = cache_path && device_cache_read(cache_path, has_surface, all_devices);
 
-        if (log)
+    // the cached present support is only trusted if the family the best device would render with can still present
+    if (cached && has_surface)
+    {
+        Physical_Device_Detials *best = nullptr;
+        for (auto &physical_device : all_devices)
         {
-            log_physical_device_props(physical_device.props);
-            std::cout << "queue families: [" << queue_family_props.size() << "]" << std::endl;
+            if (!physical_device.suitable) continue;
+            select_physical_device_queues(physical_device);
+            physical_device.score = score_physical_device(physical_device, prefer_high_performance);
+            if (!best || physical_device.score > best->score) best = &physical_device;
         }
 
-        for (u32 index = 0; index < queue_family_props.size(); index++)
+        VkBool32 surface_support = false;
+        if (best) vkGetPhysicalDeviceSurfaceSupportKHR(best->handle, best->graphics_queue.family_index, vk_surface, &surface_support);
+        cached = best && surface_support;
+    }
+
+    if (!cached)
+    {
+        // per-device query results, dropped again before the next device
+        Arena scratch = {};
+        arena_init(scratch, 4 << 10);
+        for (auto &physical_device : all_devices)
         {
-            Queue_Family_Details queue_family = {};
-            queue_family.index = index;
-            queue_family.props = queue_family_props[index];
+            arena_reset(scratch);
+            query_physical_device(vk_surface, physical_device, scratch);
+        }
+        arena_destroy(scratch);
 
-            if (log)
-            {
-                log_queue_family_props(queue_family_props[index], index);
-            }
+        if (cache_path) device_cache_write(cache_path, has_surface, all_devices);
+    }
+    if (cached) std::cout << "Device enumeration: reused from " << cache_path << std::endl;
+    else        std::cout << "Device enumeration: queried [" << all_devices.size() << "] devices" << std::endl;
 
-            if (check_queue_family_suitability(vk_surface, handle, queue_family))
-            {
-                physical_device.queue_families.push_back(queue_family);
-            }
+    // populate physical devices
+    for (auto &physical_device : all_devices)
+    {
+        if (log)
+        {
+            log_physical_device_props(physical_device.props);
+            log_memory_heaps(physical_device.mem_props);
+            std::cout << "queue families: [" << physical_device.queue_families.size() << "]" << std::endl;
+            for (auto &queue_family : physical_device.queue_families) log_queue_family_props(queue_family.props, queue_family.index);
+            std::cout << std::endl;
         }
 
-        if (log) std::cout << std::endl;
-
-        if (check_physical_device_suitability(vk_surface, physical_device))
+        if (physical_device.suitable)
         {
+            select_physical_device_queues(physical_device);
+            physical_device.score = score_physical_device(physical_device, prefer_high_performance);
             physical_devices.push_back(physical_device);
         }
     }
 
+    // best device first; ties keep the driver's enumeration order
+    std::stable_sort(physical_devices.begin(), physical_devices.end(), [](const Physical_Device_Detials &a, const Physical_Device_Detials &b) { return a.score > b.score; });
+
     // log list of suitable devices and queues
     if (log)
     {
-        std::cout << "Suitable devices and queue families:" << std::endl;
+        std::cout << "Suitable devices and queue families (" << (prefer_high_performance ? "preferring high performance" : "preferring low power") << "):" << std::endl;
         for (auto& device : physical_devices)
         {
             std::cout << device.props.deviceName << ": ";
             for (auto& queue_family : device.queue_families)
             {
-                std::cout << queue_family.index << " ";
+                if (queue_family.suitable) std::cout << queue_family.index << " ";
             }
             std::cout << std::endl;
         }
         std::cout << std::endl;
     }
 
+    // log the selection decision
+    if (physical_devices.size() > 0)
+    {
+        std::cout << "Selected device: ";
+        log_device_selection(physical_devices[0]);
+        if (log) for (u32 i = 1; i < physical_devices.size(); i++)
+        {
+            std::cout << "Candidate device: ";
+            log_device_selection(physical_devices[i]);
+        }
+        std::cout << std::endl;
+    }
+
     return physical_devices;
 }
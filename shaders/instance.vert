@@ -0,0 +1,29 @@
+#version 450
+
+// A triangle per instance of the batch renderer, see src/batches.h
+// The instance data is written by the CPU every frame into a per-frame vertex buffer that advances once per instance
+
+layout(location = 0) in vec4 instance_transform; // world-space position xy, scale, angle
+layout(location = 1) in vec4 instance_color;     // RGBA8 unorm
+
+layout(push_constant) uniform Push_Constants {
+    vec2  view_center;
+    float view_scale;  // world units to clip space
+    float time;
+    vec4  tint;        // the batch's material
+} pc;
+
+layout(location = 0) out vec4 out_color;
+
+const vec2 positions[3] = vec2[](vec2(0.0, -0.5), vec2(0.5, 0.5), vec2(-0.5, 0.5));
+
+void main()
+{
+    vec2  p = positions[gl_VertexIndex];
+    float a = instance_transform.w;
+    float s = sin(a), c = cos(a);
+    p = vec2(p.x * c - p.y * s, p.x * s + p.y * c) * instance_transform.z + instance_transform.xy;
+
+    gl_Position = vec4((p - pc.view_center) * pc.view_scale, 0.0, 1.0);
+    out_color   = instance_color * pc.tint;
+}
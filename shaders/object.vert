@@ -0,0 +1,37 @@
+#version 450
+
+// A triangle per object of the GPU-driven path, see src/indirect.h
+// The object is found through gl_InstanceIndex, which starts at the draw's firstInstance; cull.comp stores the object index there
+
+struct Object {
+    vec4  bounds; // world-space center xyz, radius
+    vec4  color;
+    float scale;
+    float angle;
+    vec2  pad;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Objects { Object objects[]; };
+
+layout(push_constant) uniform Push_Constants {
+    vec2  view_center;
+    float view_scale;  // world units to clip space
+    float time;
+} pc;
+
+layout(location = 0) out vec4 out_color;
+
+const vec2 positions[3] = vec2[](vec2(0.0, -0.5), vec2(0.5, 0.5), vec2(-0.5, 0.5));
+
+void main()
+{
+    Object object = objects[gl_InstanceIndex];
+
+    vec2  p = positions[gl_VertexIndex];
+    float a = object.angle + pc.time;
+    float s = sin(a), c = cos(a);
+    p = vec2(p.x * c - p.y * s, p.x * s + p.y * c) * object.scale + object.bounds.xy;
+
+    gl_Position = vec4((p - pc.view_center) * pc.view_scale, 0.0, 1.0);
+    out_color   = object.color;
+}
@@ -0,0 +1,13 @@
+#version 450
+
+// VARIANT is a specialization constant so the same module can produce distinct pipelines, see the pipeline cache benchmark
+
+layout(constant_id = 0) const int VARIANT = 0;
+
+layout(location = 0) in  vec4 in_color;
+layout(location = 0) out vec4 out_color;
+
+void main()
+{
+    out_color = vec4(in_color.rgb * (1.0 - float(VARIANT) / 256.0), in_color.a);
+}
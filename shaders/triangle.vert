@@ -0,0 +1,24 @@
+#version 450
+
+// A single triangle positioned entirely by push constants; no vertex buffers are bound
+
+layout(push_constant) uniform Push_Constants {
+    vec4  color;
+    vec2  offset;
+    float scale;
+    float angle;
+} pc;
+
+layout(location = 0) out vec4 out_color;
+
+const vec2 positions[3] = vec2[](vec2(0.0, -0.5), vec2(0.5, 0.5), vec2(-0.5, 0.5));
+
+void main()
+{
+    vec2  p = positions[gl_VertexIndex];
+    float s = sin(pc.angle), c = cos(pc.angle);
+    p = vec2(p.x * c - p.y * s, p.x * s + p.y * c) * pc.scale + pc.offset;
+
+    gl_Position = vec4(p, 0.0, 1.0);
+    out_color   = pc.color;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "common.h"
+
+//
+// API VERSION AND MODERN FEATURES
+// The instance asks for the highest version the loader supports, at most the one given with `-V`; the device's version caps it further
+// On a Vulkan 1.2+ device, three features replace their 1.0 counterparts whenever the driver has them, each from the core version
+// that promoted it or otherwise from its KHR extension:
+//  - timeline semaphores: one semaphore counts the finished frames instead of a fence per frame in flight, see the main loop
+//  - dynamic rendering: the scene is drawn with vkCmdBeginRendering on an image view, without render pass or framebuffer objects
+//  - synchronization2: the frame graph's barriers go through vkCmdPipelineBarrier2 and frames through vkQueueSubmit2
+// Anything that is missing falls back to the Vulkan 1.0 path, which is also what `-V 1.0` forces
+//
+
+// Drop the patch number, so versions compare by major and minor only
+u32 api_version_base(u32 version)
+{
+    return VK_MAKE_API_VERSION(0, VK_API_VERSION_MAJOR(version), VK_API_VERSION_MINOR(version), 0);
+}
+
+// The highest instance version the loader supports, at most `max_version`; a Vulkan 1.0 loader has no vkEnumerateInstanceVersion
+u32 api_instance_version(u32 max_version)
+{
+    u32 version = VK_API_VERSION_1_0;
+    auto enumerate_instance_version = (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(VK_NULL_HANDLE, "vkEnumerateInstanceVersion");
+    if (enumerate_instance_version && enumerate_instance_version(&version) != VK_SUCCESS) version = VK_API_VERSION_1_0;
+    return std::min(api_version_base(version), max_version);
+}
+
+// What api_features_query found; the feature structs are chained into VkDeviceCreateInfo by api_features_chain
+struct Api_Features {
+    u32  api_version;        // the lower of the instance's and the device's version
+    bool timeline_semaphore;
+    bool dynamic_rendering;
+    bool synchronization2;
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timeline_semaphore_features;
+    VkPhysicalDeviceDynamicRenderingFeatures  dynamic_rendering_features;
+    VkPhysicalDeviceSynchronization2Features  synchronization2_features;
+};
+
+// Find out which modern features the device supports; the extensions the supported ones need are appended to `extension_names`
+// `has_extension(name)` tells whether the device offers a device extension
+template<typename Has_Extension>
+void api_features_query(Api_Features &features, VkInstance instance, VkPhysicalDevice physical_device, u32 instance_version, u32 device_version,
+                        Has_Extension has_extension, std::vector<const char *> &extension_names)
+{
+    features = {};
+    features.api_version = std::min(instance_version, api_version_base(device_version));
+    features.timeline_semaphore_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    features.dynamic_rendering_features.sType  = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+    features.synchronization2_features.sType   = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+
+    // Vulkan 1.1 is treated like 1.0: timeline semaphores are only core from 1.2 on, and the extension path
+    // of dynamic rendering needs the 1.2 core of VK_KHR_depth_stencil_resolve
+    if (features.api_version < VK_API_VERSION_1_2) return;
+
+    bool core_1_3 = features.api_version >= VK_API_VERSION_1_3;
+    bool dynamic_rendering_available = core_1_3 || has_extension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+    bool synchronization2_available  = core_1_3 || has_extension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+
+    // only structs of features the device knows about may be chained into the query
+    VkPhysicalDeviceTimelineSemaphoreFeatures timeline_semaphore = features.timeline_semaphore_features;
+    VkPhysicalDeviceDynamicRenderingFeatures  dynamic_rendering  = features.dynamic_rendering_features;
+    VkPhysicalDeviceSynchronization2Features  synchronization2   = features.synchronization2_features;
+    void *chain = &timeline_semaphore;
+    if (dynamic_rendering_available) { dynamic_rendering.pNext = chain; chain = &dynamic_rendering; }
+    if (synchronization2_available)  { synchronization2.pNext  = chain; chain = &synchronization2; }
+
+    auto get_features2 = (PFN_vkGetPhysicalDeviceFeatures2)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2");
+    if (!get_features2) return;
+    VkPhysicalDeviceFeatures2 features2 = {};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = chain;
+    get_features2(physical_device, &features2);
+
+    features.timeline_semaphore = timeline_semaphore.timelineSemaphore;
+    features.dynamic_rendering  = dynamic_rendering_available && dynamic_rendering.dynamicRendering;
+    features.synchronization2   = synchronization2_available && synchronization2.synchronization2;
+    features.timeline_semaphore_features.timelineSemaphore = features.timeline_semaphore;
+    features.dynamic_rendering_features.dynamicRendering   = features.dynamic_rendering;
+    features.synchronization2_features.synchronization2    = features.synchronization2;
+
+    if (features.dynamic_rendering && !core_1_3) extension_names.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+    if (features.synchronization2  && !core_1_3) extension_names.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+}
+
+// Prepend the feature structs of the supported features to the device create info's pNext chain `next`, returning the new head
+void *api_features_chain(Api_Features &features, void *next)
+{
+    if (features.timeline_semaphore) { features.timeline_semaphore_features.pNext = next; next = &features.timeline_semaphore_features; }
+    if (features.dynamic_rendering)  { features.dynamic_rendering_features.pNext  = next; next = &features.dynamic_rendering_features; }
+    if (features.synchronization2)   { features.synchronization2_features.pNext   = next; next = &features.synchronization2_features; }
+    return next;
+}
+
+// Record the enabled features in the context and load their entry points, under their core names from the version that promoted
+// them and under their KHR names before that
+void api_features_load(Device_Context &ctx, Api_Features &features)
+{
+    bool core_1_3 = features.api_version >= VK_API_VERSION_1_3;
+
+    ctx.api_version        = features.api_version;
+    ctx.timeline_semaphore = features.timeline_semaphore;
+    ctx.dynamic_rendering  = features.dynamic_rendering;
+    ctx.synchronization2   = features.synchronization2;
+
+    if (ctx.timeline_semaphore) ctx.wait_semaphores = (PFN_vkWaitSemaphores)vkGetDeviceProcAddr(ctx.device, "vkWaitSemaphores");
+    if (ctx.dynamic_rendering)
+    {
+        ctx.cmd_begin_rendering = (PFN_vkCmdBeginRendering)vkGetDeviceProcAddr(ctx.device, core_1_3 ? "vkCmdBeginRendering" : "vkCmdBeginRenderingKHR");
+        ctx.cmd_end_rendering   = (PFN_vkCmdEndRendering)vkGetDeviceProcAddr(ctx.device, core_1_3 ? "vkCmdEndRendering" : "vkCmdEndRenderingKHR");
+    }
+    if (ctx.synchronization2)
+    {
+        ctx.cmd_pipeline_barrier2 = (PFN_vkCmdPipelineBarrier2)vkGetDeviceProcAddr(ctx.device, core_1_3 ? "vkCmdPipelineBarrier2" : "vkCmdPipelineBarrier2KHR");
+        ctx.queue_submit2         = (PFN_vkQueueSubmit2)vkGetDeviceProcAddr(ctx.device, core_1_3 ? "vkQueueSubmit2" : "vkQueueSubmit2KHR");
+    }
+}
+
+void api_features_print(Device_Context &ctx)
+{
+    printf("Vulkan %u.%u path: %s, %s, %s\n", VK_API_VERSION_MAJOR(ctx.api_version), VK_API_VERSION_MINOR(ctx.api_version),
+           ctx.timeline_semaphore ? "timeline semaphores" : "frame fences",
+           ctx.dynamic_rendering  ? "dynamic rendering"   : "render pass and framebuffers",
+           ctx.synchronization2   ? "synchronization2"    : "vkCmdPipelineBarrier");
+}
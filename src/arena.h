@@ -0,0 +1,280 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "common.h"
+
+//
+// HEAP ALLOCATION COUNTER
+// Built with COUNT_HEAP_ALLOCATIONS defined (e.g. clang -DCOUNT_HEAP_ALLOCATIONS ...), every form of the global operator new is
+// counted, so the frame loop and the arena benchmark can report the allocations a frame makes. It replaces the program's global
+// allocator, so it is off by default
+//
+
+#ifdef COUNT_HEAP_ALLOCATIONS
+std::atomic<u64> heap_allocation_count(0);
+
+// `alignment` 0 for the unaligned forms; over-aligned blocks keep malloc's pointer just below the address handed out
+void *heap_counted_allocate(usize size, usize alignment)
+{
+    heap_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    if (alignment == 0) return malloc(size);
+
+    void *base = malloc(size + alignment + sizeof(void *));
+    if (!base) return nullptr;
+    uptr aligned = ((uptr)base + sizeof(void *) + alignment - 1) & ~(uptr)(alignment - 1);
+    ((void **)aligned)[-1] = base;
+    return (void *)aligned;
+}
+
+void heap_counted_free(void *data, usize alignment)
+{
+    if (!data) return;
+    free(alignment == 0 ? data : ((void **)data)[-1]);
+}
+
+void *heap_counted_allocate_or_throw(usize size, usize alignment)
+{
+    void *data = heap_counted_allocate(size, alignment);
+    if (!data) throw std::bad_alloc();
+    return data;
+}
+
+void *operator new(usize size)                                                             { return heap_counted_allocate_or_throw(size, 0); }
+void *operator new[](usize size)                                                           { return heap_counted_allocate_or_throw(size, 0); }
+void *operator new(usize size, const std::nothrow_t &) noexcept                            { return heap_counted_allocate(size, 0); }
+void *operator new[](usize size, const std::nothrow_t &) noexcept                          { return heap_counted_allocate(size, 0); }
+void *operator new(usize size, std::align_val_t alignment)                                 { return heap_counted_allocate_or_throw(size, (usize)alignment); }
+void *operator new[](usize size, std::align_val_t alignment)                               { return heap_counted_allocate_or_throw(size, (usize)alignment); }
+void *operator new(usize size, std::align_val_t alignment, const std::nothrow_t &) noexcept   { return heap_counted_allocate(size, (usize)alignment); }
+void *operator new[](usize size, std::align_val_t alignment, const std::nothrow_t &) noexcept { return heap_counted_allocate(size, (usize)alignment); }
+
+void operator delete(void *data) noexcept                                                  { heap_counted_free(data, 0); }
+void operator delete[](void *data) noexcept                                                { heap_counted_free(data, 0); }
+void operator delete(void *data, usize) noexcept                                           { heap_counted_free(data, 0); }
+void operator delete[](void *data, usize) noexcept                                         { heap_counted_free(data, 0); }
+void operator delete(void *data, const std::nothrow_t &) noexcept                          { heap_counted_free(data, 0); }
+void operator delete[](void *data, const std::nothrow_t &) noexcept                        { heap_counted_free(data, 0); }
+void operator delete(void *data, std::align_val_t alignment) noexcept                      { heap_counted_free(data, (usize)alignment); }
+void operator delete[](void *data, std::align_val_t alignment) noexcept                    { heap_counted_free(data, (usize)alignment); }
+void operator delete(void *data, usize, std::align_val_t alignment) noexcept               { heap_counted_free(data, (usize)alignment); }
+void operator delete[](void *data, usize, std::align_val_t alignment) noexcept             { heap_counted_free(data, (usize)alignment); }
+void operator delete(void *data, std::align_val_t alignment, const std::nothrow_t &) noexcept   { heap_counted_free(data, (usize)alignment); }
+void operator delete[](void *data, std::align_val_t alignment, const std::nothrow_t &) noexcept { heap_counted_free(data, (usize)alignment); }
+#endif
+
+#ifdef COUNT_HEAP_ALLOCATIONS
+#define HEAP_ALLOCATIONS_COUNTED true
+#else
+#define HEAP_ALLOCATIONS_COUNTED false
+#endif
+
+// Heap allocations made so far, always 0 unless HEAP_ALLOCATIONS_COUNTED
+u64 heap_allocations()
+{
+#ifdef COUNT_HEAP_ALLOCATIONS
+    return heap_allocation_count.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+
+//
+// FRAME ARENA
+// A bump allocator for CPU-side data that only lives until the end of a frame (or a flush): barrier arrays, wait lists, query results
+// Allocating is a pointer increment and nothing is freed on its own; arena_reset releases everything at once
+// Memory comes in blocks. When more than one block was needed since the last reset, the reset replaces them with a single block
+// big enough for all of them, so a steady frame loop settles on one block and stops allocating from the heap altogether
+//
+
+struct Arena_Block {
+    u8   *data;
+    usize size;
+};
+
+struct Arena {
+    std::vector<Arena_Block> blocks;     // the last one is being allocated from
+    usize                    used;       // bytes of the last block handed out
+    usize                    allocated;  // bytes handed out since the last reset, including padding
+    usize                    peak;       // the most `allocated` ever reached
+    usize                    block_size; // minimum size of a new block
+};
+
+void arena_init(Arena &arena, usize block_size)
+{
+    arena = {};
+    arena.block_size = block_size;
+}
+
+void arena_destroy(Arena &arena)
+{
+    for (auto &block : arena.blocks) free(block.data);
+    arena = {};
+}
+
+void *arena_alloc(Arena &arena, usize size, usize alignment)
+{
+    if (arena.blocks.size() > 0)
+    {
+        Arena_Block &block = arena.blocks.back();
+        uptr address = (uptr)block.data + arena.used;
+        usize padding = ((address + alignment - 1) & ~(uptr)(alignment - 1)) - address;
+        if (arena.used + padding + size <= block.size)
+        {
+            arena.used += padding + size;
+            arena.allocated += padding + size;
+            arena.peak = std::max(arena.peak, arena.allocated);
+            return block.data + arena.used - size;
+        }
+    }
+
+    // malloc alignment covers every type the arena is used for; over-aligned requests get room to align within the block
+    Arena_Block block = {};
+    block.size = std::max(arena.block_size, size + alignment);
+    block.data = (u8 *)malloc(block.size);
+    if (!block.data) throw std::bad_alloc();
+    arena.blocks.push_back(block);
+    arena.used = 0;
+    return arena_alloc(arena, size, alignment);
+}
+
+// Give back `size` bytes at `data` when they are the most recent allocation, so only temporaries freed in LIFO order get their
+// bytes back; anything else, including the old storage of a growing vector (its new buffer is allocated first), stays until the reset
+void arena_free(Arena &arena, void *data, usize size)
+{
+    if (arena.blocks.size() == 0) return;
+    Arena_Block &block = arena.blocks.back();
+    if ((u8 *)data + size == block.data + arena.used)
+    {
+        arena.used -= size;
+        arena.allocated -= size;
+    }
+}
+
+void arena_reset(Arena &arena)
+{
+    if (arena.blocks.size() > 1)
+    {
+        usize size = 0;
+        for (auto &block : arena.blocks) { size += block.size; free(block.data); }
+        arena.blocks.clear();
+        arena.blocks.push_back({ (u8 *)malloc(size), size });
+        if (!arena.blocks.back().data) throw std::bad_alloc();
+    }
+    arena.used = 0;
+    arena.allocated = 0;
+}
+
+// STL allocator on top of an arena, e.g. Arena_Vector<VkImageMemoryBarrier> barriers(Arena_Allocator<VkImageMemoryBarrier>(&arena))
+// Without an arena it falls back to the heap, so functions can take an optional `Arena *`
+// Containers using it must not outlive the arena's next reset
+template<typename T>
+struct Arena_Allocator {
+    typedef T value_type;
+    Arena *arena;
+
+    Arena_Allocator(Arena *arena = nullptr) : arena(arena) {}
+    template<typename U> Arena_Allocator(const Arena_Allocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(usize count)
+    {
+        if (arena) return (T *)arena_alloc(*arena, count * sizeof(T), alignof(T));
+        return (T *)::operator new(count * sizeof(T));
+    }
+
+    void deallocate(T *data, usize count)
+    {
+        if (arena) arena_free(*arena, data, count * sizeof(T));
+        else ::operator delete(data);
+    }
+};
+
+template<typename T, typename U> bool operator==(const Arena_Allocator<T> &a, const Arena_Allocator<U> &b) { return a.arena == b.arena; }
+template<typename T, typename U> bool operator!=(const Arena_Allocator<T> &a, const Arena_Allocator<U> &b) { return a.arena != b.arena; }
+
+template<typename T> using Arena_Vector = std::vector<T, Arena_Allocator<T>>;
+
+//
+// BENCHMARK
+// `--bench arena`: the per-frame vector patterns of the main loop (wait lists, barrier batches, COUNT_APPEND_HELPER queries),
+// built with the heap and with a frame arena that is reset every frame
+//
+
+// Stands in for a vkGet*/vkEnumerate* query that returns `count` items
+VkResult arena_benchmark_query(u32 items, u32 *count, VkImageMemoryBarrier *barriers)
+{
+    if (!barriers) { *count = items; return VK_SUCCESS; }
+    for (u32 i = 0; i < *count; i++) barriers[i] = {};
+    return VK_SUCCESS;
+}
+
+template<typename Vector>
+u64 arena_benchmark_frame(typename Vector::allocator_type allocator, u32 batches, u32 queries)
+{
+    u64 checksum = 0;
+
+    Vector wait_list(allocator);
+    for (u32 i = 0; i < 3; i++) wait_list.push_back({});
+    checksum += wait_list.size();
+
+    for (u32 batch = 0; batch < batches; batch++)
+    {
+        Vector barriers(4, VkImageMemoryBarrier{}, allocator);
+        checksum += barriers.size();
+    }
+
+    for (u32 query = 0; query < queries; query++)
+    {
+        Vector results(allocator);
+        VkResult vr = COUNT_APPEND_HELPER(results, arena_benchmark_query, 1 + query % 8);
+        CHECK_RESULT(vr);
+        checksum += results.size();
+    }
+    return checksum;
+}
+
+void arena_benchmark()
+{
+    const u32 frame_count = 20000;
+    const u32 batches = 16;
+    const u32 queries = 64;
+
+    std::cout << std::endl << "Frame arena benchmark: " << frame_count << " frames of a 3 entry wait list, " << batches << " barrier batches and " << queries << " queries" << std::endl;
+
+    u64 checksum = 0;
+    {
+        u64 allocations = heap_allocations();
+        auto start = std::chrono::steady_clock::now();
+        for (u32 frame = 0; frame < frame_count; frame++) checksum += arena_benchmark_frame<std::vector<VkImageMemoryBarrier>>({}, batches, queries);
+        f64 ns = std::chrono::duration<f64, std::nano>(std::chrono::steady_clock::now() - start).count() / frame_count;
+        allocations = heap_allocations() - allocations;
+        printf("  %-14s %10.1f ns/frame", "std::allocator", ns);
+        if (HEAP_ALLOCATIONS_COUNTED) printf(" %8.2f heap allocations/frame", (f64)allocations / frame_count);
+        printf("\n");
+    }
+    {
+        Arena arena = {};
+        arena_init(arena, 4 << 10);
+        u64 allocations = heap_allocations();
+        auto start = std::chrono::steady_clock::now();
+        for (u32 frame = 0; frame < frame_count; frame++)
+        {
+            arena_reset(arena);
+            checksum += arena_benchmark_frame<Arena_Vector<VkImageMemoryBarrier>>(Arena_Allocator<VkImageMemoryBarrier>(&arena), batches, queries);
+        }
+        f64 ns = std::chrono::duration<f64, std::nano>(std::chrono::steady_clock::now() - start).count() / frame_count;
+        allocations = heap_allocations() - allocations;
+        printf("  %-14s %10.1f ns/frame", "frame arena", ns);
+        if (HEAP_ALLOCATIONS_COUNTED) printf(" %8.2f heap allocations/frame", (f64)allocations / frame_count);
+        printf(" (%zu bytes per frame, %zu arena blocks)\n", arena.peak, arena.blocks.size());
+        arena_destroy(arena);
+    }
+    volatile u64 sink = checksum; // keeps the frames from being optimised away
+    (void)sink;
+}
@@ -0,0 +1,367 @@
+#pragma once
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "common.h"
+
+//
+// ASSET PACK FORMAT
+// One file holds any number of meshes and textures, laid out exactly as they are uploaded: vertices and u32 indices ready for
+// vkCmdCopyBuffer, and every mip level of a texture in its final VkFormat (RGBA8 or a block-compressed format such as BC1), tightly
+// packed as vkCmdCopyBufferToImage expects it with bufferRowLength 0. Loading a pack is mapping the file and validating the tables;
+// the data blocks are copied from the mapping straight into the staging ring, see src/assets.h
+//
+// Packs are written offline by tools/asset_pack.cpp from OBJ meshes and PPM images, whose (slow, text based) parsers live here too
+// since the asset benchmark uses them as the naive baseline. This header makes no Vulkan calls so the tool does not link Vulkan
+//
+// Layout: Asset_Header | Asset_Mesh[mesh_count] | Asset_Texture[texture_count] | data blocks, each ASSET_ALIGNMENT aligned
+// All fields are little-endian; the version changes whenever a struct below does
+//
+
+#define ASSET_MAGIC       0x4B415056u // "VPAK"
+#define ASSET_VERSION     1
+#define ASSET_ALIGNMENT   256         // covers every texel block size and optimalBufferCopyOffsetAlignment in practice
+#define ASSET_MAX_MIPS    16
+#define ASSET_NAME_LENGTH 48
+
+struct Asset_Header {
+    u32 magic;
+    u32 version;
+    u32 mesh_count;
+    u32 texture_count;
+    u64 file_size;
+    u64 meshes_offset;
+    u64 textures_offset;
+    u64 reserved;
+};
+
+struct Asset_Vertex {
+    f32 position[3];
+    f32 normal[3];
+    f32 uv[2];
+};
+
+struct Asset_Mesh {
+    char name[ASSET_NAME_LENGTH];
+    u32  vertex_count;
+    u32  index_count;          // u32 indices, three per triangle
+    u64  vertex_offset;        // Asset_Vertex[vertex_count]
+    u64  index_offset;
+    f32  bounds[4];            // bounding sphere: centre xyz, radius
+};
+
+struct Asset_Texture {
+    char name[ASSET_NAME_LENGTH];
+    u32  format;               // VkFormat
+    u32  width;
+    u32  height;
+    u32  mip_count;
+    u64  mip_offsets[ASSET_MAX_MIPS];
+    u64  mip_sizes[ASSET_MAX_MIPS];
+};
+
+static_assert(sizeof(Asset_Header)  == 48,  "Asset_Header layout changed, bump ASSET_VERSION");
+static_assert(sizeof(Asset_Vertex)  == 32,  "Asset_Vertex layout changed, bump ASSET_VERSION");
+static_assert(sizeof(Asset_Mesh)    == 88,  "Asset_Mesh layout changed, bump ASSET_VERSION");
+static_assert(sizeof(Asset_Texture) == 320, "Asset_Texture layout changed, bump ASSET_VERSION");
+
+u64 asset_align(u64 offset)
+{
+    return (offset + ASSET_ALIGNMENT - 1) & ~(u64)(ASSET_ALIGNMENT - 1);
+}
+
+// Bytes per 4x4 block for block-compressed formats, per texel otherwise; 0 for formats packs do not store
+u32 asset_format_block_bytes(u32 format, u32 *block_extent)
+{
+    *block_extent = 1;
+    switch (format)
+    {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:       return 4;
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK: *block_extent = 4; return 8;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+        case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_4x4_SRGB_BLOCK: *block_extent = 4; return 16;
+        default:                            return 0;
+    }
+}
+
+// Size of mip `level` of a `width` x `height` texture
+u64 asset_mip_size(u32 format, u32 width, u32 height, u32 level)
+{
+    u32 block_extent = 1;
+    u64 block_bytes = asset_format_block_bytes(format, &block_extent);
+    u64 w = std::max(1u, width >> level), h = std::max(1u, height >> level);
+    return ((w + block_extent - 1) / block_extent) * ((h + block_extent - 1) / block_extent) * block_bytes;
+}
+
+//
+// MAPPED FILES
+//
+
+struct Mapped_File {
+    const u8 *data;
+    u64       size;
+#ifdef _WIN32
+    HANDLE    file;
+    HANDLE    mapping;
+#else
+    int       fd;
+#endif
+};
+
+// Map a whole file read-only; the pages are only read from disk when they are touched
+bool mapped_file_open(Mapped_File &mapped, const char *path)
+{
+    mapped = {};
+#ifdef _WIN32
+    mapped.file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (mapped.file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size = {};
+    GetFileSizeEx(mapped.file, &size);
+    mapped.size = size.QuadPart;
+    if (mapped.size > 0)
+    {
+        mapped.mapping = CreateFileMappingA(mapped.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapped.mapping) mapped.data = (const u8 *)MapViewOfFile(mapped.mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (!mapped.data)
+    {
+        if (mapped.mapping) CloseHandle(mapped.mapping);
+        CloseHandle(mapped.file);
+        mapped = {};
+        return false;
+    }
+#else
+    mapped.fd = open(path, O_RDONLY);
+    if (mapped.fd < 0) return false;
+    struct stat info = {};
+    fstat(mapped.fd, &info);
+    mapped.size = info.st_size;
+    void *data = mapped.size > 0 ? mmap(nullptr, mapped.size, PROT_READ, MAP_PRIVATE, mapped.fd, 0) : MAP_FAILED;
+    if (data == MAP_FAILED)
+    {
+        close(mapped.fd);
+        mapped = {};
+        return false;
+    }
+    // the data blocks are read front to back exactly once; ask for aggressive readahead
+    madvise(data, mapped.size, MADV_SEQUENTIAL);
+    madvise(data, mapped.size, MADV_WILLNEED);
+    mapped.data = (const u8 *)data;
+#endif
+    return true;
+}
+
+void mapped_file_close(Mapped_File &mapped)
+{
+    if (!mapped.data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(mapped.data);
+    CloseHandle(mapped.mapping);
+    CloseHandle(mapped.file);
+#else
+    munmap((void *)mapped.data, mapped.size);
+    close(mapped.fd);
+#endif
+    mapped = {};
+}
+
+//
+// PACK TABLES
+//
+
+struct Asset_Pack {
+    Mapped_File          file;
+    const Asset_Header  *header;
+    const Asset_Mesh    *meshes;
+    const Asset_Texture *textures;
+};
+
+bool asset_range_is_valid(const Asset_Pack &pack, u64 offset, u64 size)
+{
+    return offset <= pack.file.size && size <= pack.file.size - offset;
+}
+
+// Map a pack and check that every table entry lies within the file; the data itself is not touched
+bool asset_pack_open(Asset_Pack &pack, const char *path)
+{
+    pack = {};
+    if (!mapped_file_open(pack.file, path)) return false;
+
+    bool ok = pack.file.size >= sizeof(Asset_Header);
+    if (ok)
+    {
+        pack.header = (const Asset_Header *)pack.file.data;
+        ok = pack.header->magic == ASSET_MAGIC && pack.header->version == ASSET_VERSION && pack.header->file_size == pack.file.size
+          && asset_range_is_valid(pack, pack.header->meshes_offset,   (u64)pack.header->mesh_count    * sizeof(Asset_Mesh))
+          && asset_range_is_valid(pack, pack.header->textures_offset, (u64)pack.header->texture_count * sizeof(Asset_Texture));
+    }
+    if (ok)
+    {
+        pack.meshes   = (const Asset_Mesh *)(pack.file.data + pack.header->meshes_offset);
+        pack.textures = (const Asset_Texture *)(pack.file.data + pack.header->textures_offset);
+        for (u32 i = 0; ok && i < pack.header->mesh_count; i++)
+        {
+            const Asset_Mesh &mesh = pack.meshes[i];
+            ok = asset_range_is_valid(pack, mesh.vertex_offset, (u64)mesh.vertex_count * sizeof(Asset_Vertex))
+              && asset_range_is_valid(pack, mesh.index_offset,  (u64)mesh.index_count  * sizeof(u32));
+        }
+        for (u32 i = 0; ok && i < pack.header->texture_count; i++)
+        {
+            const Asset_Texture &texture = pack.textures[i];
+            u32 block_extent = 1;
+            ok = asset_format_block_bytes(texture.format, &block_extent) != 0 && texture.mip_count >= 1 && texture.mip_count <= ASSET_MAX_MIPS;
+            for (u32 level = 0; ok && level < texture.mip_count; level++)
+            {
+                ok = texture.mip_sizes[level] == asset_mip_size(texture.format, texture.width, texture.height, level)
+                  && asset_range_is_valid(pack, texture.mip_offsets[level], texture.mip_sizes[level]);
+            }
+        }
+    }
+
+    if (!ok)
+    {
+        mapped_file_close(pack.file);
+        pack = {};
+    }
+    return ok;
+}
+
+void asset_pack_close(Asset_Pack &pack)
+{
+    mapped_file_close(pack.file);
+    pack = {};
+}
+
+//
+// SOURCE FORMATS
+// Straightforward text parsing, used offline by the converter and as the baseline of `--bench assets`
+//
+
+struct Obj_Index {
+    i32 position, uv, normal;
+    bool operator==(const Obj_Index &other) const { return position == other.position && uv == other.uv && normal == other.normal; }
+};
+
+struct Obj_Index_Hash {
+    usize operator()(const Obj_Index &index) const { return (usize)index.position * 73856093u ^ (usize)index.uv * 19349663u ^ (usize)index.normal * 83492791u; }
+};
+
+// Parse one "v", "v/vt", "v//vn" or "v/vt/vn" face corner; OBJ indices are 1-based, negative ones count back from the end
+const char *parse_obj_corner(const char *text, Obj_Index &index, usize position_count, usize uv_count, usize normal_count)
+{
+    char *end = nullptr;
+    index = { -1, -1, -1 };
+    i32 *fields[3] = { &index.position, &index.uv, &index.normal };
+    usize counts[3] = { position_count, uv_count, normal_count };
+    for (u32 field = 0; field < 3; field++)
+    {
+        if (*text != '/' || field == 0)
+        {
+            long value = strtol(text, &end, 10);
+            if (end != text) *fields[field] = value < 0 ? (i32)(counts[field] + value) : (i32)(value - 1);
+            text = end;
+        }
+        if (*text != '/') break;
+        text++;
+    }
+    return text;
+}
+
+// Load an OBJ file as an indexed triangle list; polygons are fanned, missing normals and texture coordinates are zero
+bool parse_obj(const char *path, std::vector<Asset_Vertex> &vertices, std::vector<u32> &indices)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) return false;
+
+    std::vector<f32> positions, uvs, normals;
+    std::unordered_map<Obj_Index, u32, Obj_Index_Hash> unique;
+    vertices.clear();
+    indices.clear();
+
+    char line[1024];
+    while (fgets(line, sizeof(line), file))
+    {
+        f32 x = 0.0f, y = 0.0f, z = 0.0f;
+        if      (line[0] == 'v' && line[1] == ' ' && sscanf(line + 2, "%f %f %f", &x, &y, &z) == 3) positions.insert(positions.end(), { x, y, z });
+        else if (line[0] == 'v' && line[1] == 't' && sscanf(line + 3, "%f %f", &x, &y) == 2)        uvs.insert(uvs.end(), { x, y });
+        else if (line[0] == 'v' && line[1] == 'n' && sscanf(line + 3, "%f %f %f", &x, &y, &z) == 3) normals.insert(normals.end(), { x, y, z });
+        else if (line[0] == 'f' && line[1] == ' ')
+        {
+            u32 corners[64];
+            u32 corner_count = 0;
+            const char *text = line + 2;
+            while (corner_count < 64)
+            {
+                while (*text == ' ' || *text == '\t') text++;
+                if (*text == '\0' || *text == '\n' || *text == '\r') break;
+
+                Obj_Index index = {};
+                const char *next = parse_obj_corner(text, index, positions.size() / 3, uvs.size() / 2, normals.size() / 3);
+                if (next == text || index.position < 0 || (usize)index.position >= positions.size() / 3) { fclose(file); return false; }
+                text = next;
+
+                auto found = unique.find(index);
+                if (found == unique.end())
+                {
+                    Asset_Vertex vertex = {};
+                    memcpy(vertex.position, &positions[index.position * 3], sizeof(vertex.position));
+                    if (index.uv >= 0 && (usize)index.uv < uvs.size() / 2)                memcpy(vertex.uv,     &uvs[index.uv * 2],         sizeof(vertex.uv));
+                    if (index.normal >= 0 && (usize)index.normal < normals.size() / 3)    memcpy(vertex.normal, &normals[index.normal * 3], sizeof(vertex.normal));
+                    found = unique.emplace(index, (u32)vertices.size()).first;
+                    vertices.push_back(vertex);
+                }
+                corners[corner_count++] = found->second;
+            }
+            for (u32 i = 2; i < corner_count; i++) indices.insert(indices.end(), { corners[0], corners[i - 1], corners[i] });
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+// Load a binary PPM (P6, maxval 255) as RGBA8 with opaque alpha
+bool parse_ppm(const char *path, u32 &width, u32 &height, std::vector<u8> &rgba)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) return false;
+
+    u32 maxval = 0;
+    bool ok = fscanf(file, "P6 %u %u %u", &width, &height, &maxval) == 3 && maxval == 255 && fgetc(file) != EOF && width > 0 && height > 0;
+    if (ok)
+    {
+        std::vector<u8> rgb((usize)width * height * 3);
+        ok = fread(rgb.data(), 1, rgb.size(), file) == rgb.size();
+        rgba.resize((usize)width * height * 4);
+        for (usize i = 0; ok && i < (usize)width * height; i++)
+        {
+            rgba[i * 4 + 0] = rgb[i * 3 + 0];
+            rgba[i * 4 + 1] = rgb[i * 3 + 1];
+            rgba[i * 4 + 2] = rgb[i * 3 + 2];
+            rgba[i * 4 + 3] = 255;
+        }
+    }
+    fclose(file);
+    return ok;
+}
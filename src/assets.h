@@ -0,0 +1,309 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "gpu_allocator.h"
+#include "upload.h"
+#include "asset_format.h"
+
+//
+// ASSET LOADING
+// Meshes and textures are created device-local and filled through the upload ring; from a pack the source of every copy is the
+// file mapping itself, so the only copy the CPU makes is the one into the staging buffer, see src/asset_format.h
+//
+
+struct Gpu_Mesh {
+    VkBuffer       vertex_buffer;
+    Gpu_Allocation vertex_allocation;
+    VkBuffer       index_buffer;
+    Gpu_Allocation index_allocation;
+    u32            vertex_count;
+    u32            index_count;
+};
+
+struct Gpu_Texture {
+    VkImage        image;
+    Gpu_Allocation allocation;
+    VkFormat       format;
+    VkExtent2D     extent;
+    u32            mip_count;
+};
+
+void gpu_mesh_create(Gpu_Mesh &mesh, Upload_Context &upload, Gpu_Allocator &allocator, const Asset_Vertex *vertices, u32 vertex_count, const u32 *indices, u32 index_count)
+{
+    VkResult vr = VK_SUCCESS;
+
+    mesh = {};
+    mesh.vertex_count = vertex_count;
+    mesh.index_count = index_count;
+
+    VkBufferCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    info.size = std::max<VkDeviceSize>(1, (VkDeviceSize)vertex_count * sizeof(Asset_Vertex));
+    info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    upload_apply_sharing(upload, info);
+    vr = gpu_create_buffer(allocator, info, GPU_MEMORY_USAGE_DEVICE_LOCAL, mesh.vertex_buffer, mesh.vertex_allocation);
+    CHECK_RESULT(vr);
+
+    info.size = std::max<VkDeviceSize>(1, (VkDeviceSize)index_count * sizeof(u32));
+    info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    vr = gpu_create_buffer(allocator, info, GPU_MEMORY_USAGE_DEVICE_LOCAL, mesh.index_buffer, mesh.index_allocation);
+    CHECK_RESULT(vr);
+
+    upload_buffer(upload, mesh.vertex_buffer, 0, vertices, (VkDeviceSize)vertex_count * sizeof(Asset_Vertex));
+    upload_buffer(upload, mesh.index_buffer,  0, indices,  (VkDeviceSize)index_count  * sizeof(u32));
+}
+
+void gpu_mesh_destroy(Gpu_Mesh &mesh, Gpu_Allocator &allocator)
+{
+    gpu_destroy_buffer(allocator, mesh.index_buffer, mesh.index_allocation);
+    gpu_destroy_buffer(allocator, mesh.vertex_buffer, mesh.vertex_allocation);
+    mesh = {};
+}
+
+// Sampling is all a loaded texture needs; BC and ASTC formats additionally depend on their device feature
+bool gpu_texture_format_is_supported(Device_Context &ctx, VkFormat format)
+{
+    VkFormatProperties props = {};
+    vkGetPhysicalDeviceFormatProperties(ctx.physical_device, format, &props);
+    return (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+// `mips[level]` holds `sizes[level]` bytes laid out as asset_mip_size describes; every level must fit in the upload ring
+// Returns false, creating nothing, when the format is unsupported or a level is too large
+bool gpu_texture_create(Gpu_Texture &texture, Upload_Context &upload, Device_Context &ctx, VkFormat format, u32 width, u32 height, u32 mip_count, const u8 *const *mips, const u64 *sizes)
+{
+    VkResult vr = VK_SUCCESS;
+
+    texture = {};
+    if (!gpu_texture_format_is_supported(ctx, format)) return false;
+    for (u32 level = 0; level < mip_count; level++) if (sizes[level] > upload.capacity) return false;
+
+    texture.format = format;
+    texture.extent = { width, height };
+    texture.mip_count = mip_count;
+
+    VkImageCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    info.imageType = VK_IMAGE_TYPE_2D;
+    info.format = format;
+    info.extent = { width, height, 1 };
+    info.mipLevels = mip_count;
+    info.arrayLayers = 1;
+    info.samples = VK_SAMPLE_COUNT_1_BIT;
+    info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    upload_apply_sharing(upload, info);
+    vr = gpu_create_image(*ctx.allocator, info, GPU_MEMORY_USAGE_DEVICE_LOCAL, texture.image, texture.allocation);
+    CHECK_RESULT(vr);
+
+    for (u32 level = 0; level < mip_count; level++)
+    {
+        VkBufferImageCopy region = {};
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = level;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { std::max(1u, width >> level), std::max(1u, height >> level), 1 };
+        upload_image(upload, texture.image, region, mips[level], sizes[level], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+    return true;
+}
+
+void gpu_texture_destroy(Gpu_Texture &texture, Gpu_Allocator &allocator)
+{
+    gpu_destroy_image(allocator, texture.image, texture.allocation);
+    texture = {};
+}
+
+void asset_pack_upload_mesh(Asset_Pack &pack, u32 index, Upload_Context &upload, Gpu_Allocator &allocator, Gpu_Mesh &mesh)
+{
+    const Asset_Mesh &entry = pack.meshes[index];
+    gpu_mesh_create(mesh, upload, allocator, (const Asset_Vertex *)(pack.file.data + entry.vertex_offset), entry.vertex_count,
+                    (const u32 *)(pack.file.data + entry.index_offset), entry.index_count);
+}
+
+bool asset_pack_upload_texture(Asset_Pack &pack, u32 index, Upload_Context &upload, Device_Context &ctx, Gpu_Texture &texture)
+{
+    const Asset_Texture &entry = pack.textures[index];
+    const u8 *mips[ASSET_MAX_MIPS];
+    for (u32 level = 0; level < entry.mip_count; level++) mips[level] = pack.file.data + entry.mip_offsets[level];
+    return gpu_texture_create(texture, upload, ctx, (VkFormat)entry.format, entry.width, entry.height, entry.mip_count, mips, entry.mip_sizes);
+}
+
+//
+// BENCHMARK
+// `--bench assets` loads the same content twice from the directory given with `--assets`: once from its OBJ and PPM files through
+// the text parsers, once from the pack the converter wrote next to them (assets.pack), see README.md for creating a dataset
+// The OS file cache is dropped for every file before each run where the platform allows it, so both runs read from disk
+// Everything loaded is destroyed every ASSET_BENCH_RESIDENT_BYTES, so datasets larger than device memory can be used
+//
+
+#define ASSET_BENCH_RESIDENT_BYTES (512ull << 20)
+
+// Drop the cached pages of a file; returns false when the platform offers no way to
+bool drop_file_cache(const char *path)
+{
+#if defined(_WIN32) || defined(__APPLE__)
+    (void)path;
+    return false;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    bool ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return ok;
+#endif
+}
+
+struct Asset_Bench_Set {
+    std::vector<Gpu_Mesh>    meshes;
+    std::vector<Gpu_Texture> textures;
+    u64                      bytes;       // uploaded since the set was last released
+    u64                      triangles;
+    u32                      mesh_count;  // over the whole run
+    u32                      texture_count;
+    u32                      skipped;
+};
+
+// Wait for the uploads of everything in the set and destroy it; called when the set is over budget and at the end of a run
+void asset_bench_release(Asset_Bench_Set &set, Upload_Context &upload, Gpu_Allocator &allocator)
+{
+    upload_wait(upload, upload_flush(upload));
+    for (auto &mesh : set.meshes) gpu_mesh_destroy(mesh, allocator);
+    for (auto &texture : set.textures) gpu_texture_destroy(texture, allocator);
+    set.meshes.clear();
+    set.textures.clear();
+    set.bytes = 0;
+}
+
+void asset_bench_add_mesh(Asset_Bench_Set &set, Upload_Context &upload, Gpu_Allocator &allocator, Gpu_Mesh &mesh)
+{
+    set.meshes.push_back(mesh);
+    set.bytes += (u64)mesh.vertex_count * sizeof(Asset_Vertex) + (u64)mesh.index_count * sizeof(u32);
+    set.triangles += mesh.index_count / 3;
+    set.mesh_count++;
+    if (set.bytes >= ASSET_BENCH_RESIDENT_BYTES) asset_bench_release(set, upload, allocator);
+}
+
+void asset_bench_add_texture(Asset_Bench_Set &set, Upload_Context &upload, Gpu_Allocator &allocator, Gpu_Texture &texture, u64 bytes)
+{
+    set.textures.push_back(texture);
+    set.bytes += bytes;
+    set.texture_count++;
+    if (set.bytes >= ASSET_BENCH_RESIDENT_BYTES) asset_bench_release(set, upload, allocator);
+}
+
+void asset_benchmark(Device_Context &ctx, const char *directory)
+{
+    namespace fs = std::filesystem;
+
+    std::vector<std::string> sources;
+    std::error_code error;
+    for (auto &entry : fs::directory_iterator(directory, error))
+    {
+        std::string extension = entry.path().extension().string();
+        if (extension == ".obj" || extension == ".ppm") sources.push_back(entry.path().string());
+    }
+    std::sort(sources.begin(), sources.end());
+    std::string pack_path = (fs::path(directory) / "assets.pack").string();
+
+    if (error || sources.size() == 0 || !fs::exists(pack_path))
+    {
+        std::cout << "Asset benchmark: " << directory << " needs OBJ/PPM files and the assets.pack converted from them, see README.md" << std::endl;
+        return;
+    }
+
+    Upload_Context upload = {};
+    upload_init(upload, ctx, 64ull << 20);
+
+    u64 source_bytes = 0;
+    bool cold = true;
+    for (auto &path : sources) { source_bytes += fs::file_size(path, error); cold = drop_file_cache(path.c_str()) && cold; }
+    u64 pack_bytes = fs::file_size(pack_path, error);
+    cold = drop_file_cache(pack_path.c_str()) && cold;
+
+    std::cout << std::endl << "Asset benchmark: " << directory << ", " << (cold ? "cold" : "warm (the file cache cannot be dropped here)") << " file cache" << std::endl;
+    auto print_row = [&](const char *name, u64 bytes, f64 seconds, Asset_Bench_Set &set) {
+        printf("  %-20s %9.1f MB on disk %8.3f s %9.1f MB/s  %5u meshes (%llu triangles) %5u textures",
+               name, bytes / 1e6, seconds, bytes / seconds / 1e6, set.mesh_count, (unsigned long long)set.triangles, set.texture_count);
+        if (set.skipped > 0) printf(" (%u skipped)", set.skipped);
+        printf("\n");
+    };
+
+    // naive: read and parse every source file, then upload the result as RGBA8 without mips
+    {
+        Asset_Bench_Set set = {};
+        std::vector<Asset_Vertex> vertices;
+        std::vector<u32>          indices;
+        std::vector<u8>           rgba;
+        auto start = std::chrono::steady_clock::now();
+
+        for (auto &path : sources)
+        {
+            u32 width = 0, height = 0;
+            if (fs::path(path).extension() == ".obj")
+            {
+                if (!parse_obj(path.c_str(), vertices, indices)) { set.skipped++; continue; }
+                Gpu_Mesh mesh = {};
+                gpu_mesh_create(mesh, upload, *ctx.allocator, vertices.data(), vertices.size(), indices.data(), indices.size());
+                asset_bench_add_mesh(set, upload, *ctx.allocator, mesh);
+            }
+            else
+            {
+                if (!parse_ppm(path.c_str(), width, height, rgba)) { set.skipped++; continue; }
+                const u8 *mip = rgba.data();
+                u64 size = rgba.size();
+                Gpu_Texture texture = {};
+                if (!gpu_texture_create(texture, upload, ctx, VK_FORMAT_R8G8B8A8_UNORM, width, height, 1, &mip, &size)) { set.skipped++; continue; }
+                asset_bench_add_texture(set, upload, *ctx.allocator, texture, size);
+            }
+        }
+        asset_bench_release(set, upload, *ctx.allocator);
+
+        f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+        print_row("read + parse", source_bytes, seconds, set);
+    }
+
+    // pack: map the file and upload straight from the mapping
+    {
+        Asset_Bench_Set set = {};
+        auto start = std::chrono::steady_clock::now();
+
+        Asset_Pack pack = {};
+        if (!asset_pack_open(pack, pack_path.c_str()))
+        {
+            std::cout << "  " << pack_path << " is not a valid asset pack (version " << ASSET_VERSION << ")" << std::endl;
+        }
+        else
+        {
+            for (u32 i = 0; i < pack.header->mesh_count; i++)
+            {
+                Gpu_Mesh mesh = {};
+                asset_pack_upload_mesh(pack, i, upload, *ctx.allocator, mesh);
+                asset_bench_add_mesh(set, upload, *ctx.allocator, mesh);
+            }
+            for (u32 i = 0; i < pack.header->texture_count; i++)
+            {
+                Gpu_Texture texture = {};
+                if (!asset_pack_upload_texture(pack, i, upload, ctx, texture)) { set.skipped++; continue; }
+                u64 bytes = 0;
+                for (u32 level = 0; level < pack.textures[i].mip_count; level++) bytes += pack.textures[i].mip_sizes[level];
+                asset_bench_add_texture(set, upload, *ctx.allocator, texture, bytes);
+            }
+            asset_bench_release(set, upload, *ctx.allocator);
+            asset_pack_close(pack);
+
+            f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+            print_row("mmap pack", pack_bytes, seconds, set);
+        }
+    }
+
+    upload_destroy(upload, *ctx.allocator);
+}
@@ -0,0 +1,539 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BATCH_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#include "common.h"
+#include "gpu_allocator.h"
+#include "indirect.h"
+#include "jobs.h"
+#include "pipelines.h"
+
+//
+// INSTANCED BATCH RENDERER
+// For large numbers of dynamic objects that all change every frame. Transforms live in structure-of-arrays form so animating and
+// culling them streams through a few dense arrays, 4 or 8 objects per instruction (SSE, or AVX where the CPU has it)
+// Every frame, across the job system's threads:
+//  1. each chunk of objects is animated, frustum culled and counted per batch key (pipeline, material)
+//  2. a prefix sum over the counts gives every (key, chunk) pair its range of instances; this is the sort, a counting sort by key
+//  3. each chunk writes its visible instances straight into the frame's persistently mapped instance buffer, at those ranges
+// The draws are then one vkCmdDraw per non-empty key, with the key's range as firstInstance/instanceCount, and the pipeline bound
+// once per pipeline because keys are ordered pipeline first
+//
+// Instance buffers are written by the CPU every frame, so there is one per frame in flight
+//
+
+#define BATCH_PIPELINE_COUNT 4  // variants of triangle.frag
+#define BATCH_MATERIAL_COUNT 8  // tints pushed per draw
+#define BATCH_KEY_COUNT      (BATCH_PIPELINE_COUNT * BATCH_MATERIAL_COUNT)
+#define BATCH_CHUNK_SIZE     16384
+
+u16 batch_key(u32 pipeline, u32 material)
+{
+    return pipeline * BATCH_MATERIAL_COUNT + material;
+}
+
+// Padded to a multiple of 8 with objects that are never visible, so the SIMD loops have no remainder
+struct Batch_Objects {
+    u32              count;
+    std::vector<f32> x, y, z, radius; // bounding sphere, the center is the object's position
+    std::vector<f32> vx, vy;          // velocity, world units per second
+    std::vector<f32> scale;
+    std::vector<f32> angle;
+    std::vector<u32> color;           // RGBA8
+    std::vector<u16> key;             // see batch_key
+    f32              extent;          // objects move within [-extent, extent] on x and y
+};
+
+// Matches the vertex inputs of shaders/instance.vert
+struct Batch_Instance {
+    f32 position[2];
+    f32 scale;
+    f32 angle;
+    u32 color;
+};
+
+// Matches Push_Constants in shaders/instance.vert
+struct Batch_Push_Constants {
+    Gpu_Scene_View view;
+    f32            tint[4];
+};
+
+// `count` objects on the same grid as gpu_scene_fill_grid, drifting in different directions and spread over every batch key
+void batch_objects_fill_grid(Batch_Objects &objects, u32 count)
+{
+    u32 side = std::max(1u, (u32)std::ceil(std::sqrt((f64)count)));
+    u32 padded = (count + 7) & ~7u;
+
+    objects = {};
+    objects.count = count;
+    objects.extent = side * 0.5f;
+    for (auto *array : { &objects.x, &objects.y, &objects.z, &objects.vx, &objects.vy, &objects.scale, &objects.angle }) array->resize(padded, 0.0f);
+    objects.radius.resize(padded, -INFINITY); // fails every plane test
+    objects.color.resize(padded, 0);
+    objects.key.resize(padded, 0);
+
+    for (u32 i = 0; i < count; i++)
+    {
+        objects.x[i] = (i % side) + 0.5f - side * 0.5f;
+        objects.y[i] = (i / side) + 0.5f - side * 0.5f;
+        objects.vx[i] = 0.5f * std::sin(i * 0.71f);
+        objects.vy[i] = 0.5f * std::cos(i * 0.53f);
+        objects.scale[i] = 0.5f;
+        objects.radius[i] = objects.scale[i] * 0.7072f; // the farthest vertex of the triangle is sqrt(0.5) away
+        objects.angle[i] = i * 0.1f;
+
+        u32 r = (u32)(255.0f * (0.5f + 0.5f * std::sin(i * 0.37f)));
+        u32 b = (u32)(255.0f * (0.5f + 0.5f * std::cos(i * 0.11f)));
+        objects.color[i] = r | (255u << 8) | (b << 16) | (255u << 24);
+
+        // neighbours get different keys, so every batch is spread over the whole grid
+        u32 hash = i * 2654435761u;
+        objects.key[i] = batch_key((hash >> 8) % BATCH_PIPELINE_COUNT, (hash >> 16) % BATCH_MATERIAL_COUNT);
+    }
+}
+
+// Move objects [first, first + count) by `dt` seconds, bouncing off the edges of the grid
+// Plain loops over the SoA arrays, which the compiler vectorizes
+void batch_objects_animate(Batch_Objects &objects, u32 first, u32 count, f32 dt)
+{
+    f32 extent = objects.extent;
+    f32 *x = objects.x.data(), *y = objects.y.data(), *vx = objects.vx.data(), *vy = objects.vy.data(), *angle = objects.angle.data();
+    for (u32 i = first; i < first + count; i++)
+    {
+        x[i] += vx[i] * dt;
+        y[i] += vy[i] * dt;
+        vx[i] = (x[i] < -extent || x[i] > extent) ? -vx[i] : vx[i];
+        vy[i] = (y[i] < -extent || y[i] > extent) ? -vy[i] : vy[i];
+        angle[i] += dt;
+    }
+}
+
+// Cull objects [first, first + count) against `planes` (positive inside) and write the indices of the visible ones to `visible`
+// Returns how many were written; `first` and `count` are multiples of 8 except for the very end of the padded arrays
+typedef u32 (*Batch_Cull_Function)(const Batch_Objects &objects, const f32 planes[6][4], u32 first, u32 count, u32 *visible);
+
+// The same test as gpu_scene_is_visible, one object at a time
+u32 batch_cull_scalar(const Batch_Objects &objects, const f32 planes[6][4], u32 first, u32 count, u32 *visible)
+{
+    u32 written = 0;
+    for (u32 i = first; i < first + count; i++)
+    {
+        bool inside = true;
+        for (u32 p = 0; p < 6; p++)
+        {
+            inside &= planes[p][0] * objects.x[i] + planes[p][1] * objects.y[i] + planes[p][2] * objects.z[i] + planes[p][3] >= -objects.radius[i];
+        }
+        visible[written] = i;
+        written += inside;
+    }
+    return written;
+}
+
+#ifdef BATCH_X86
+// Indices are written unconditionally and the write position only advances past visible ones, so there is no branch per object
+u32 batch_cull_sse(const Batch_Objects &objects, const f32 planes[6][4], u32 first, u32 count, u32 *visible)
+{
+    u32 written = 0;
+    u32 end = first + count;
+    u32 i = first;
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&objects.x[i]);
+        __m128 y = _mm_loadu_ps(&objects.y[i]);
+        __m128 z = _mm_loadu_ps(&objects.z[i]);
+        __m128 neg_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&objects.radius[i]));
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (u32 p = 0; p < 6; p++)
+        {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(planes[p][0])), _mm_mul_ps(y, _mm_set1_ps(planes[p][1]))),
+                                  _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(planes[p][2])), _mm_set1_ps(planes[p][3])));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, neg_radius));
+        }
+
+        u32 mask = _mm_movemask_ps(inside);
+        for (u32 lane = 0; lane < 4; lane++)
+        {
+            visible[written] = i + lane;
+            written += (mask >> lane) & 1;
+        }
+    }
+    return written + batch_cull_scalar(objects, planes, i, end - i, visible + written);
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BATCH_AVX 1
+__attribute__((target("avx")))
+u32 batch_cull_avx(const Batch_Objects &objects, const f32 planes[6][4], u32 first, u32 count, u32 *visible)
+{
+    u32 written = 0;
+    u32 end = first + count;
+    u32 i = first;
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(&objects.x[i]);
+        __m256 y = _mm256_loadu_ps(&objects.y[i]);
+        __m256 z = _mm256_loadu_ps(&objects.z[i]);
+        __m256 neg_radius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&objects.radius[i]));
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (u32 p = 0; p < 6; p++)
+        {
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(planes[p][0])), _mm256_mul_ps(y, _mm256_set1_ps(planes[p][1]))),
+                                     _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(planes[p][2])), _mm256_set1_ps(planes[p][3])));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, neg_radius, _CMP_GE_OQ));
+        }
+
+        u32 mask = _mm256_movemask_ps(inside);
+        for (u32 lane = 0; lane < 8; lane++)
+        {
+            visible[written] = i + lane;
+            written += (mask >> lane) & 1;
+        }
+    }
+    return written + batch_cull_scalar(objects, planes, i, end - i, visible + written);
+}
+#endif
+
+// CPUID says AVX is there and XGETBV says the OS saves the YMM registers
+bool batch_cpu_has_avx()
+{
+    u32 info[4] = {};
+#if defined(_MSC_VER) && !defined(__clang__)
+    __cpuid((int *)info, 1);
+#else
+    if (!__get_cpuid(1, &info[0], &info[1], &info[2], &info[3])) return false;
+#endif
+    bool osxsave = info[2] & (1u << 27);
+    bool avx     = info[2] & (1u << 28);
+    if (!osxsave || !avx) return false;
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    u64 xcr0 = _xgetbv(0);
+#else
+    u32 lo = 0, hi = 0;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    u64 xcr0 = ((u64)hi << 32) | lo;
+#endif
+    return (xcr0 & 6) == 6;
+}
+#endif
+
+// The widest culling loop this build and CPU support
+Batch_Cull_Function batch_cull_function(const char **name = nullptr)
+{
+    const char *unused = nullptr;
+    const char *&selected = name ? *name : unused;
+#if defined(BATCH_X86) && defined(BATCH_AVX)
+    if (batch_cpu_has_avx()) { selected = "avx"; return batch_cull_avx; }
+#endif
+#ifdef BATCH_X86
+    selected = "sse";
+    return batch_cull_sse;
+#else
+    selected = "scalar";
+    return batch_cull_scalar;
+#endif
+}
+
+struct Batch_Renderer {
+    VkDevice                    device;
+    u32                         capacity;            // objects
+    Batch_Cull_Function         cull;
+
+    std::vector<VkBuffer>       instance_buffers;    // [frame]: capacity Batch_Instances, persistently mapped
+    std::vector<Gpu_Allocation> instance_allocations;
+
+    // scratch of the frame being prepared
+    std::vector<u32>            visible;             // [chunk * BATCH_CHUNK_SIZE + i]: indices of the visible objects of each chunk
+    std::vector<u32>            visible_counts;      // [chunk]
+    std::vector<u32>            chunk_offsets;       // [chunk * BATCH_KEY_COUNT + key]: visible objects per key, then the chunk's first instance of the key
+
+    // the batches of the last prepared frame
+    u32                         batch_first[BATCH_KEY_COUNT];
+    u32                         batch_count[BATCH_KEY_COUNT];
+    u32                         visible_total;
+
+    VkPipelineLayout            layout;
+    VkPipeline                  pipelines[BATCH_PIPELINE_COUNT];
+};
+
+// `render_pass` is the pass the instances are drawn in, or VK_NULL_HANDLE with the `rendering_format` of dynamic rendering
+// Without either no pipelines are created and the renderer can only prepare frames
+void batch_renderer_create(Batch_Renderer &renderer, Device_Context &ctx, VkPipelineCache pipeline_cache, Shader_Module_Cache &modules, VkRenderPass render_pass,
+                           u32 capacity, u32 frame_count, VkFormat rendering_format = VK_FORMAT_UNDEFINED)
+{
+    VkResult vr = VK_SUCCESS;
+
+    renderer = {};
+    renderer.device = ctx.device;
+    renderer.capacity = (capacity + 7) & ~7u;
+    renderer.cull = batch_cull_function();
+
+    // host-visible and mapped for the lifetime of the renderer; the CPU writes each frame's instances straight into them
+    renderer.instance_buffers.resize(frame_count);
+    renderer.instance_allocations.resize(frame_count);
+    for (u32 f = 0; f < frame_count; f++)
+    {
+        VkBufferCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        info.size = std::max<VkDeviceSize>(1, renderer.capacity) * sizeof(Batch_Instance);
+        info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        vr = gpu_create_buffer(*ctx.allocator, info, GPU_MEMORY_USAGE_DYNAMIC, renderer.instance_buffers[f], renderer.instance_allocations[f]);
+        CHECK_RESULT(vr);
+    }
+
+    u32 chunk_count = (renderer.capacity + BATCH_CHUNK_SIZE - 1) / BATCH_CHUNK_SIZE;
+    renderer.visible.resize((usize)chunk_count * BATCH_CHUNK_SIZE);
+    renderer.visible_counts.resize(chunk_count);
+    renderer.chunk_offsets.resize((usize)chunk_count * BATCH_KEY_COUNT);
+
+    if (render_pass == VK_NULL_HANDLE && rendering_format == VK_FORMAT_UNDEFINED) return;
+
+    VkPushConstantRange push_range = {};
+    push_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    push_range.size = sizeof(Batch_Push_Constants);
+
+    VkPipelineLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_range;
+    vr = vkCreatePipelineLayout(ctx.device, &layout_info, nullptr, &renderer.layout);
+    CHECK_RESULT(vr);
+
+    VkVertexInputBindingDescription binding = {};
+    binding.binding = 0;
+    binding.stride = sizeof(Batch_Instance);
+    binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    VkVertexInputAttributeDescription attributes[2] = {};
+    attributes[0].location = 0;
+    attributes[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    attributes[0].offset = offsetof(Batch_Instance, position);
+    attributes[1].location = 1;
+    attributes[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+    attributes[1].offset = offsetof(Batch_Instance, color);
+
+    VkPipelineVertexInputStateCreateInfo vertex_input = {};
+    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input.vertexBindingDescriptionCount = 1;
+    vertex_input.pVertexBindingDescriptions = &binding;
+    vertex_input.vertexAttributeDescriptionCount = 2;
+    vertex_input.pVertexAttributeDescriptions = attributes;
+
+    // the variants darken the color a little each, so every pipeline is a distinct one
+    for (u32 p = 0; p < BATCH_PIPELINE_COUNT; p++)
+    {
+        renderer.pipelines[p] = create_triangle_pipeline(ctx.device, pipeline_cache, modules, render_pass, renderer.layout, p * 32, SHADER_DIR "instance.vert.spv", &vertex_input, rendering_format);
+    }
+}
+
+void batch_renderer_destroy(Batch_Renderer &renderer, Gpu_Allocator &allocator)
+{
+    for (u32 p = 0; p < BATCH_PIPELINE_COUNT; p++) vkDestroyPipeline(renderer.device, renderer.pipelines[p], nullptr);
+    vkDestroyPipelineLayout(renderer.device, renderer.layout, nullptr);
+    for (usize f = 0; f < renderer.instance_buffers.size(); f++) gpu_destroy_buffer(allocator, renderer.instance_buffers[f], renderer.instance_allocations[f]);
+    renderer = {};
+}
+
+// Animate the objects by `dt` seconds (0 leaves them where they are), cull them against `view` and write the visible ones into the
+// instance buffer of frame `frame_index`, sorted by key; must be called once the GPU is done with that frame
+void batch_renderer_prepare(Batch_Renderer &renderer, Batch_Objects &objects, Job_System &jobs, u32 frame_index, const Gpu_Scene_View &view, f32 dt)
+{
+    f32 planes[6][4];
+    gpu_scene_frustum(view, planes);
+
+    u32 padded = std::min<u32>(objects.x.size(), renderer.capacity);
+    u32 chunk_count = (padded + BATCH_CHUNK_SIZE - 1) / BATCH_CHUNK_SIZE;
+
+    // 1. animate, cull and count per key
+    job_system_parallel_for(jobs, chunk_count, [&](u32, u32 chunk) {
+        u32 first = chunk * BATCH_CHUNK_SIZE;
+        u32 count = std::min<u32>(BATCH_CHUNK_SIZE, padded - first);
+        if (dt != 0.0f) batch_objects_animate(objects, first, count, dt);
+
+        u32 *visible = &renderer.visible[first];
+        u32 visible_count = renderer.cull(objects, planes, first, count, visible);
+        renderer.visible_counts[chunk] = visible_count;
+
+        u32 *key_counts = &renderer.chunk_offsets[(usize)chunk * BATCH_KEY_COUNT];
+        for (u32 key = 0; key < BATCH_KEY_COUNT; key++) key_counts[key] = 0;
+        for (u32 i = 0; i < visible_count; i++) key_counts[objects.key[visible[i]]]++;
+    });
+
+    // 2. every key's instances are contiguous, and within a key the chunks follow each other in order
+    u32 total = 0;
+    for (u32 key = 0; key < BATCH_KEY_COUNT; key++)
+    {
+        renderer.batch_first[key] = total;
+        for (u32 chunk = 0; chunk < chunk_count; chunk++)
+        {
+            u32 &offset = renderer.chunk_offsets[(usize)chunk * BATCH_KEY_COUNT + key];
+            u32 count = offset;
+            offset = total;
+            total += count;
+        }
+        renderer.batch_count[key] = total - renderer.batch_first[key];
+    }
+    renderer.visible_total = total;
+
+    // 3. write the instances; each (key, chunk) range is written by one thread, front to back
+    Batch_Instance *instances = (Batch_Instance *)renderer.instance_allocations[frame_index].mapped;
+    job_system_parallel_for(jobs, chunk_count, [&](u32, u32 chunk) {
+        u32 cursors[BATCH_KEY_COUNT];
+        memcpy(cursors, &renderer.chunk_offsets[(usize)chunk * BATCH_KEY_COUNT], sizeof(cursors));
+
+        const u32 *visible = &renderer.visible[chunk * BATCH_CHUNK_SIZE];
+        for (u32 i = 0; i < renderer.visible_counts[chunk]; i++)
+        {
+            u32 object = visible[i];
+            Batch_Instance instance;
+            instance.position[0] = objects.x[object];
+            instance.position[1] = objects.y[object];
+            instance.scale = objects.scale[object];
+            instance.angle = objects.angle[object];
+            instance.color = objects.color[object];
+            instances[cursors[objects.key[object]]++] = instance;
+        }
+    });
+}
+
+// Record the draws of frame `frame_index` inside a render pass compatible with the one the renderer was created for
+// Returns the number of draw calls recorded
+u32 batch_renderer_record_draws(Batch_Renderer &renderer, VkCommandBuffer cmd_buf, u32 frame_index, VkExtent2D extent, const Gpu_Scene_View &view)
+{
+    VkViewport viewport = {};
+    viewport.width = (f32)extent.width;
+    viewport.height = (f32)extent.height;
+    viewport.maxDepth = 1.0f;
+    VkRect2D scissor = {};
+    scissor.extent = extent;
+
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(cmd_buf, 0, 1, &renderer.instance_buffers[frame_index], &offset);
+
+    Batch_Push_Constants push_constants = {};
+    push_constants.view = view;
+
+    u32 calls = 0;
+    i32 bound_pipeline = -1;
+    for (u32 key = 0; key < BATCH_KEY_COUNT; key++)
+    {
+        if (renderer.batch_count[key] == 0) continue;
+
+        i32 pipeline = key / BATCH_MATERIAL_COUNT;
+        if (pipeline != bound_pipeline)
+        {
+            // dynamic state and push constants survive pipeline changes with the same layout, but have to be set once
+            vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer.pipelines[pipeline]);
+            if (bound_pipeline < 0)
+            {
+                vkCmdSetViewport(cmd_buf, 0, 1, &viewport);
+                vkCmdSetScissor(cmd_buf, 0, 1, &scissor);
+            }
+            bound_pipeline = pipeline;
+        }
+
+        u32 material = key % BATCH_MATERIAL_COUNT;
+        push_constants.tint[0] = 1.0f - material * 0.08f;
+        push_constants.tint[1] = 1.0f;
+        push_constants.tint[2] = 0.5f + material * 0.06f;
+        push_constants.tint[3] = 1.0f;
+        vkCmdPushConstants(cmd_buf, renderer.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push_constants), &push_constants);
+
+        vkCmdDraw(cmd_buf, 3, renderer.batch_count[key], 0, renderer.batch_first[key]);
+        calls++;
+    }
+    return calls;
+}
+
+//
+// BENCHMARK
+// Objects per millisecond through cull + sort + upload (batch_renderer_prepare without animation) at 100k and 1M objects, on 1
+// thread with the scalar loop and on 1 to N threads with the SIMD one, `--bench batches`
+// The view shows about a quarter of the objects. Every run is checked against a scalar count of the visible objects per key
+//
+
+void batch_benchmark(Device_Context &ctx, u32 max_threads)
+{
+    const u32 object_counts[] = { 100000, 1000000 };
+    const u32 frame_count     = 20;
+
+    const char *simd = nullptr;
+    Batch_Cull_Function simd_cull = batch_cull_function(&simd);
+
+    std::vector<u32> thread_counts = {};
+    for (u32 threads = 1; threads < max_threads; threads *= 2) thread_counts.push_back(threads);
+    thread_counts.push_back(max_threads);
+
+    std::cout << std::endl << "Batch benchmark: cull + sort + upload over " << frame_count << " frames, " << BATCH_KEY_COUNT << " keys, " << simd << " culling" << std::endl;
+
+    // no pipelines are created, only the instance buffer and scratch are needed
+    Shader_Module_Cache modules = {};
+    Batch_Objects       objects = {};
+    for (u32 object_count : object_counts)
+    {
+        batch_objects_fill_grid(objects, object_count);
+        Gpu_Scene_View view = gpu_scene_grid_view(object_count, 0.0f);
+
+        // the reference: visible objects per key, one at a time
+        f32 planes[6][4];
+        gpu_scene_frustum(view, planes);
+        u32 expected[BATCH_KEY_COUNT] = {};
+        u32 expected_total = 0;
+        for (u32 i = 0; i < object_count; i++)
+        {
+            f32 bounds[4] = { objects.x[i], objects.y[i], objects.z[i], objects.radius[i] };
+            if (!gpu_scene_is_visible(planes, bounds)) continue;
+            expected[objects.key[i]]++;
+            expected_total++;
+        }
+        printf("  %u objects, %u visible\n", object_count, expected_total);
+
+        Batch_Renderer renderer = {};
+        batch_renderer_create(renderer, ctx, VK_NULL_HANDLE, modules, VK_NULL_HANDLE, object_count, 1);
+
+        auto run = [&](const char *name, Batch_Cull_Function cull, u32 threads) {
+            Job_System jobs;
+            job_system_init(jobs, threads);
+            renderer.cull = cull;
+
+            f64 seconds = 0.0;
+            for (u32 frame = 0; frame <= frame_count; frame++)
+            {
+                auto start = std::chrono::steady_clock::now();
+                batch_renderer_prepare(renderer, objects, jobs, 0, view, 0.0f);
+                // the first frame faults the instance buffer and scratch in
+                if (frame > 0) seconds += std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+            }
+            job_system_destroy(jobs);
+
+            bool match = renderer.visible_total == expected_total;
+            for (u32 key = 0; key < BATCH_KEY_COUNT; key++) match &= renderer.batch_count[key] == expected[key];
+
+            f64 ms = seconds * 1000.0 / frame_count;
+            printf("    %-7s %3u threads %8.3f ms/frame %10.0f objects/ms%s\n", name, threads, ms, object_count / ms, match ? "" : "  MISMATCH");
+        };
+
+        run("scalar", batch_cull_scalar, 1);
+        for (u32 threads : thread_counts) run(simd, simd_cull, threads);
+
+        batch_renderer_destroy(renderer, *ctx.allocator);
+    }
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <vector>
+
+#include "common.h"
+#include "pipeline_cache.h"
+
+//
+// FRAME CAPTURE FORMAT
+// `--capture <path>` records the commands the CPU issues for every frame into a compact binary stream, which `--bench replay` and
+// tools/replay.cpp execute again, headless, to time recording and submitting on their own, see src/replay.h
+// Commands are captured by pipeline role rather than handle: replay binds its own pipeline for the role and pushes the same
+// constants, so a capture replays on any device, and without one on the null backend
+//
+// Layout: Capture_Header | commands
+// A command is its Capture_Op byte followed by its operands as LEB128 varints; push constants are a varint size and the raw bytes
+// Every frame starts with CAPTURE_OP_FRAME; draws only appear between CAPTURE_OP_BEGIN_PASS and CAPTURE_OP_END_PASS, dispatches outside
+// All fields are little-endian; the version changes whenever the header or an op does
+//
+
+#define CAPTURE_MAGIC                   0x50414356u // "VCAP"
+#define CAPTURE_VERSION                 1
+#define CAPTURE_MAX_PUSH_CONSTANTS      128         // the minimum maxPushConstantsSize, so every device can replay every capture
+#define CAPTURE_TRIANGLE_PUSH_CONSTANTS 32          // sizeof(Triangle_Push_Constants)
+
+struct Capture_Header {
+    u32 magic;
+    u32 version;
+    u32 frame_count;
+    u32 reserved;
+    u64 command_bytes;
+};
+
+static_assert(sizeof(Capture_Header) == 24, "Capture_Header layout changed, bump CAPTURE_VERSION");
+
+enum Capture_Op {
+    CAPTURE_OP_FRAME,      // width, height of the frame's render target
+    CAPTURE_OP_BEGIN_PASS, // a render pass over the whole target, cleared on load
+    CAPTURE_OP_END_PASS,
+    CAPTURE_OP_PIPELINE,   // Capture_Pipeline
+    CAPTURE_OP_VIEWPORT,   // viewport and scissor over the whole target
+    CAPTURE_OP_PUSH,       // size, bytes; at offset 0, for the stages of the bound pipeline
+    CAPTURE_OP_DRAW,       // vertex count, instance count, first vertex, first instance
+    CAPTURE_OP_DISPATCH,   // group counts x, y, z
+    CAPTURE_OP_COUNT,
+};
+
+enum Capture_Pipeline {
+    CAPTURE_PIPELINE_TRIANGLE, // triangle.vert/frag with Triangle_Push_Constants, see src/pipelines.h
+    CAPTURE_PIPELINE_CULL,     // the GPU-driven cull pass, see src/indirect.h; replayed with a compute pipeline that does no work
+    CAPTURE_PIPELINE_COUNT,
+};
+
+//
+// CAPTURE
+// The capture_* calls append to a Command_Capture and do nothing when it is nullptr, so recording code calls them unconditionally
+// A capture is only written to from one thread: multi-threaded recording is not captured, see main
+//
+
+struct Command_Capture {
+    std::vector<u8> commands;
+    u32             frame_count;
+};
+
+void capture_varint(std::vector<u8> &out, u64 value)
+{
+    do
+    {
+        u8 byte = value & 0x7f;
+        value >>= 7;
+        out.push_back(byte | (value ? 0x80 : 0));
+    } while (value);
+}
+
+void capture_frame(Command_Capture *capture, VkExtent2D extent)
+{
+    if (!capture) return;
+    capture->commands.push_back(CAPTURE_OP_FRAME);
+    capture_varint(capture->commands, extent.width);
+    capture_varint(capture->commands, extent.height);
+    capture->frame_count++;
+}
+
+void capture_begin_pass(Command_Capture *capture)
+{
+    if (capture) capture->commands.push_back(CAPTURE_OP_BEGIN_PASS);
+}
+
+void capture_end_pass(Command_Capture *capture)
+{
+    if (capture) capture->commands.push_back(CAPTURE_OP_END_PASS);
+}
+
+void capture_pipeline(Command_Capture *capture, Capture_Pipeline pipeline)
+{
+    if (!capture) return;
+    capture->commands.push_back(CAPTURE_OP_PIPELINE);
+    capture_varint(capture->commands, pipeline);
+}
+
+void capture_viewport(Command_Capture *capture)
+{
+    if (capture) capture->commands.push_back(CAPTURE_OP_VIEWPORT);
+}
+
+void capture_push_constants(Command_Capture *capture, const void *data, u32 size)
+{
+    if (!capture) return;
+    capture->commands.push_back(CAPTURE_OP_PUSH);
+    capture_varint(capture->commands, size);
+    capture->commands.insert(capture->commands.end(), (const u8 *)data, (const u8 *)data + size);
+}
+
+void capture_draw(Command_Capture *capture, u32 vertex_count, u32 instance_count, u32 first_vertex, u32 first_instance)
+{
+    if (!capture) return;
+    capture->commands.push_back(CAPTURE_OP_DRAW);
+    capture_varint(capture->commands, vertex_count);
+    capture_varint(capture->commands, instance_count);
+    capture_varint(capture->commands, first_vertex);
+    capture_varint(capture->commands, first_instance);
+}
+
+void capture_dispatch(Command_Capture *capture, u32 group_count_x, u32 group_count_y, u32 group_count_z)
+{
+    if (!capture) return;
+    capture->commands.push_back(CAPTURE_OP_DISPATCH);
+    capture_varint(capture->commands, group_count_x);
+    capture_varint(capture->commands, group_count_y);
+    capture_varint(capture->commands, group_count_z);
+}
+
+bool capture_write(Command_Capture &capture, const char *path)
+{
+    Capture_Header header = {};
+    header.magic = CAPTURE_MAGIC;
+    header.version = CAPTURE_VERSION;
+    header.frame_count = capture.frame_count;
+    header.command_bytes = capture.commands.size();
+
+    std::vector<u8> data(sizeof(header));
+    memcpy(data.data(), &header, sizeof(header));
+    data.insert(data.end(), capture.commands.begin(), capture.commands.end());
+    return write_file(path, data.data(), data.size());
+}
+
+//
+// READING
+// capture_read validates every command once, so replay can decode them without checking the operands again
+//
+
+struct Capture_Command {
+    Capture_Op op;
+    u32        operands[4];
+    u32        push_size;
+    const u8  *push_data;  // into the file's data
+};
+
+struct Capture_File {
+    std::vector<u8>    data;
+    Capture_Header     header;
+    std::vector<usize> frames;        // offset of every frame's CAPTURE_OP_FRAME in `data`, and the end of the commands last
+    u64                command_count; // including the CAPTURE_OP_FRAME of every frame
+};
+
+bool capture_read_varint(const std::vector<u8> &data, usize &offset, u32 &value)
+{
+    u64 result = 0;
+    for (u32 shift = 0; shift < 35; shift += 7)
+    {
+        if (offset >= data.size()) return false;
+        u8 byte = data[offset++];
+        result |= (u64)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) break;
+        if (shift == 28) return false;
+    }
+    if (result > UINT32_MAX) return false;
+    value = (u32)result;
+    return true;
+}
+
+// Decode the command at `offset` and move `offset` past it; false if it is malformed
+bool capture_decode(const std::vector<u8> &data, usize &offset, Capture_Command &command)
+{
+    static const u32 operand_counts[CAPTURE_OP_COUNT] = { 2, 0, 0, 1, 0, 1, 4, 3 };
+
+    if (offset >= data.size() || data[offset] >= CAPTURE_OP_COUNT) return false;
+    command.op = (Capture_Op)data[offset++];
+    for (u32 i = 0; i < operand_counts[command.op]; i++)
+    {
+        if (!capture_read_varint(data, offset, command.operands[i])) return false;
+    }
+
+    if (command.op == CAPTURE_OP_PUSH)
+    {
+        command.push_size = command.operands[0];
+        command.push_data = data.data() + offset;
+        if (command.push_size > CAPTURE_MAX_PUSH_CONSTANTS || command.push_size % 4 != 0 || data.size() - offset < command.push_size) return false;
+        offset += command.push_size;
+    }
+    return true;
+}
+
+bool capture_read(const char *path, Capture_File &file)
+{
+    file = {};
+    if (!read_file(path, file.data) || file.data.size() < sizeof(Capture_Header)) return false;
+    memcpy(&file.header, file.data.data(), sizeof(Capture_Header));
+    if (file.header.magic != CAPTURE_MAGIC || file.header.version != CAPTURE_VERSION) return false;
+    if (file.header.command_bytes != file.data.size() - sizeof(Capture_Header)) return false;
+
+    // passes must be closed before the next frame, draws need a pass and a pipeline, dispatches need no pass and the cull pipeline
+    bool in_pass = false;
+    i32  pipeline = -1;
+    usize offset = sizeof(Capture_Header);
+    while (offset < file.data.size())
+    {
+        usize start = offset;
+        Capture_Command command = {};
+        if (!capture_decode(file.data, offset, command)) return false;
+        file.command_count++;
+
+        switch (command.op)
+        {
+            case CAPTURE_OP_FRAME:
+                if (in_pass || command.operands[0] == 0 || command.operands[1] == 0) return false;
+                file.frames.push_back(start);
+                pipeline = -1;
+                break;
+            case CAPTURE_OP_BEGIN_PASS: if (in_pass) return false; in_pass = true; break;
+            case CAPTURE_OP_END_PASS:   if (!in_pass) return false; in_pass = false; break;
+            case CAPTURE_OP_PIPELINE:
+                if (command.operands[0] >= CAPTURE_PIPELINE_COUNT) return false;
+                pipeline = command.operands[0];
+                break;
+            case CAPTURE_OP_VIEWPORT:   if (pipeline < 0) return false; break;
+            case CAPTURE_OP_PUSH:
+                if (pipeline < 0 || (pipeline == CAPTURE_PIPELINE_TRIANGLE && command.push_size > CAPTURE_TRIANGLE_PUSH_CONSTANTS)) return false;
+                break;
+            case CAPTURE_OP_DRAW:       if (!in_pass || pipeline != CAPTURE_PIPELINE_TRIANGLE) return false; break;
+            case CAPTURE_OP_DISPATCH:   if (in_pass || pipeline != CAPTURE_PIPELINE_CULL) return false; break;
+            default:                    return false;
+        }
+        if (file.frames.size() == 0) return false;
+    }
+    if (in_pass || file.frames.size() != file.header.frame_count) return false;
+
+    file.frames.push_back(file.data.size());
+    return true;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+// Shared typedefs and helper macros
+// The project is built as a single translation unit: main.cpp includes the modules under src/ directly, see build.sh
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <vulkan/vulkan.h>
+
+typedef int8_t    i8;
+typedef int16_t   i16;
+typedef int32_t   i32;
+typedef int64_t   i64;
+typedef ptrdiff_t isize;
+typedef intptr_t  iptr;
+
+typedef uint8_t   u8;
+typedef uint16_t  u16;
+typedef uint32_t  u32;
+typedef uint64_t  u64;
+typedef size_t    usize;
+typedef uintptr_t uptr;
+
+typedef float  f32;
+typedef double f64;
+
+// Vulkan results
+// Success codes (VK_SUBOPTIMAL_KHR, VK_NOT_READY, VK_TIMEOUT, ...) are not errors: CHECK_RESULT lets them through and the caller decides
+// what they mean. Errors are thrown as a Vulkan_Error that says where they happened. main() recovers from VK_ERROR_DEVICE_LOST by
+// rebuilding everything on the device, and exits with the code of any other error, see vulkan_error_report
+struct Vulkan_Error {
+    VkResult    result;
+    const char *file;
+    i32         line;
+};
+
+// Set while a lost device is torn down, where every call may report the loss again and has to be let through
+bool vulkan_device_lost = false;
+
+inline void vulkan_check(VkResult vr, const char *file, i32 line)
+{
+    if (vr >= 0 || (vr == VK_ERROR_DEVICE_LOST && vulkan_device_lost)) return;
+    throw Vulkan_Error{ vr, file, line };
+}
+
+#define CHECK_RESULT(VR) vulkan_check((VR), __FILE__, __LINE__)
+
+const char *vulkan_result_name(VkResult vr)
+{
+    switch (vr)
+    {
+        case VK_SUCCESS:                        return "VK_SUCCESS";
+        case VK_NOT_READY:                      return "VK_NOT_READY";
+        case VK_TIMEOUT:                        return "VK_TIMEOUT";
+        case VK_INCOMPLETE:                     return "VK_INCOMPLETE";
+        case VK_SUBOPTIMAL_KHR:                 return "VK_SUBOPTIMAL_KHR";
+        case VK_ERROR_OUT_OF_HOST_MEMORY:       return "VK_ERROR_OUT_OF_HOST_MEMORY";
+        case VK_ERROR_OUT_OF_DEVICE_MEMORY:     return "VK_ERROR_OUT_OF_DEVICE_MEMORY";
+        case VK_ERROR_INITIALIZATION_FAILED:    return "VK_ERROR_INITIALIZATION_FAILED";
+        case VK_ERROR_DEVICE_LOST:              return "VK_ERROR_DEVICE_LOST";
+        case VK_ERROR_EXTENSION_NOT_PRESENT:    return "VK_ERROR_EXTENSION_NOT_PRESENT";
+        case VK_ERROR_FEATURE_NOT_PRESENT:      return "VK_ERROR_FEATURE_NOT_PRESENT";
+        case VK_ERROR_INCOMPATIBLE_DRIVER:      return "VK_ERROR_INCOMPATIBLE_DRIVER";
+        case VK_ERROR_SURFACE_LOST_KHR:         return "VK_ERROR_SURFACE_LOST_KHR";
+        case VK_ERROR_OUT_OF_DATE_KHR:          return "VK_ERROR_OUT_OF_DATE_KHR";
+        default:                                return "unknown result";
+    }
+}
+
+void vulkan_error_report(const Vulkan_Error &error)
+{
+    printf("VULKAN ERROR %d (%s): %s(%d)\n", error.result, vulkan_result_name(error.result), error.file, error.line);
+}
+
+// macro to help with Get_X(Args args..., u32 *count, X *array) calling pattern where array must be called with nullptr to retrive the required count value
+// allocates space for appends the resulting array to the end of a vector
+#define COUNT_APPEND_HELPER(VECTOR, FUNC, ARGS...) ([&]() { u32 count = 0; FUNC(ARGS, &count, nullptr); VECTOR.resize(VECTOR.size() + count); return FUNC(ARGS, &count, VECTOR.data()+(VECTOR.size()-count)); })()
+#define COUNT_APPEND_HELPER0(VECTOR, FUNC)         ([&]() { u32 count = 0; FUNC(      &count, nullptr); VECTOR.resize(VECTOR.size() + count); return FUNC(      &count, VECTOR.data()+(VECTOR.size()-count)); })()
+
+struct Gpu_Allocator;
+
+// The device-level handles created in main(), bundled for subsystems and benchmarks that need more than one or two of them
+// Queues of different roles may alias each other when the device has no dedicated family for a role, see select_physical_device_queues
+struct Device_Context {
+    VkInstance                       instance;
+    VkPhysicalDevice                 physical_device;
+    VkPhysicalDeviceProperties       props;
+    VkPhysicalDeviceMemoryProperties mem_props;
+    VkDevice                         device;
+    VkQueue                          graphics_queue;
+    u32                              graphics_family;
+    VkQueue                          compute_queue;
+    u32                              compute_family;
+    VkQueue                          transfer_queue;
+    u32                              transfer_family;
+    Gpu_Allocator                   *allocator;
+    VkPhysicalDeviceFeatures         enabled_features;
+    bool                             descriptor_indexing; // VK_EXT_descriptor_indexing is enabled with the features the bindless heap needs
+    bool                             draw_indirect_count; // VK_KHR_draw_indirect_count is enabled
+
+    // the negotiated API version and the modern features enabled on top of it, with their entry points, see src/api_features.h
+    u32                              api_version;
+    bool                             timeline_semaphore;
+    bool                             dynamic_rendering;
+    bool                             synchronization2;
+    PFN_vkWaitSemaphores             wait_semaphores;
+    PFN_vkCmdBeginRendering          cmd_begin_rendering;
+    PFN_vkCmdEndRendering            cmd_end_rendering;
+    PFN_vkCmdPipelineBarrier2        cmd_pipeline_barrier2;
+    PFN_vkQueueSubmit2               queue_submit2;
+};
@@ -0,0 +1,809 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "common.h"
+#include "gpu_allocator.h"
+#include "pipeline_cache.h"
+#include "pipelines.h"
+
+//
+// COMPUTE
+// Compute pipelines read and write storage buffers through one descriptor set and take their parameters in push constants
+// Dispatches can be recorded into any command buffer of a compute-capable family, so the same pipelines run inline on the graphics
+// queue or on the async compute queue (see select_physical_device_queues)
+//
+// Compute_Queue submits numbered batches on the compute family the way upload batches are submitted on the transfer family: every batch
+// has its own fence, can wait on a semaphore signalled by graphics work it consumes, and can signal a semaphore that the graphics
+// submission consuming its results waits on. Graphics work submitted in between is not ordered against the batch, so the two overlap
+//
+
+// Stages that consume compute results; graphics submissions wait on a compute semaphore at these stages
+#define COMPUTE_CONSUMER_STAGES (VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT)
+
+#define COMPUTE_MAX_BUFFERS 8
+
+struct Compute_Pipeline {
+    VkDescriptorSetLayout set_layout;         // binding i is storage buffer i, for i < buffer_count
+    VkPipelineLayout      layout;
+    VkPipeline            pipeline;
+    u32                   buffer_count;
+    u32                   push_constant_size;
+    u32                   local_size_x;       // specialization constant 0, the shaders declare local_size_x_id = 0
+};
+
+// Largest workgroup width up to `preferred` the device supports
+u32 compute_local_size(Device_Context &ctx, u32 preferred)
+{
+    return std::min({ preferred, ctx.props.limits.maxComputeWorkGroupSize[0], ctx.props.limits.maxComputeWorkGroupInvocations });
+}
+
+// Workgroups needed to cover `count` items when every workgroup handles `per_group`
+u32 compute_group_count(u64 count, u64 per_group)
+{
+    return (u32)((count + per_group - 1) / per_group);
+}
+
+Compute_Pipeline compute_pipeline_create(VkDevice device, VkPipelineCache pipeline_cache, Shader_Module_Cache &modules, const char *path,
+                                         u32 buffer_count, u32 push_constant_size, u32 local_size_x)
+{
+    VkResult vr = VK_SUCCESS;
+
+    Compute_Pipeline pipeline = {};
+    pipeline.buffer_count = buffer_count;
+    pipeline.push_constant_size = push_constant_size;
+    pipeline.local_size_x = local_size_x;
+
+    VkDescriptorSetLayoutBinding bindings[COMPUTE_MAX_BUFFERS] = {};
+    for (u32 i = 0; i < buffer_count; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo set_layout_info = {};
+    set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    set_layout_info.bindingCount = buffer_count;
+    set_layout_info.pBindings = bindings;
+    vr = vkCreateDescriptorSetLayout(device, &set_layout_info, nullptr, &pipeline.set_layout);
+    CHECK_RESULT(vr);
+
+    VkPushConstantRange push_range = {};
+    push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_range.size = push_constant_size;
+
+    VkPipelineLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &pipeline.set_layout;
+    layout_info.pushConstantRangeCount = push_constant_size > 0 ? 1 : 0;
+    layout_info.pPushConstantRanges = &push_range;
+    vr = vkCreatePipelineLayout(device, &layout_info, nullptr, &pipeline.layout);
+    CHECK_RESULT(vr);
+
+    VkSpecializationMapEntry local_size_entry = {};
+    local_size_entry.constantID = 0;
+    local_size_entry.size = sizeof(local_size_x);
+
+    VkSpecializationInfo specialization = {};
+    specialization.mapEntryCount = 1;
+    specialization.pMapEntries = &local_size_entry;
+    specialization.dataSize = sizeof(local_size_x);
+    specialization.pData = &local_size_x;
+
+    VkComputePipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = shader_module_load(device, modules, path);
+    pipeline_info.stage.pName = "main";
+    pipeline_info.stage.pSpecializationInfo = &specialization;
+    pipeline_info.layout = pipeline.layout;
+    pipeline_info.basePipelineIndex = -1;
+    vr = vkCreateComputePipelines(device, pipeline_cache, 1, &pipeline_info, nullptr, &pipeline.pipeline);
+    CHECK_RESULT(vr);
+
+    return pipeline;
+}
+
+void compute_pipeline_destroy(VkDevice device, Compute_Pipeline &pipeline)
+{
+    vkDestroyPipeline(device, pipeline.pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipeline.layout, nullptr);
+    vkDestroyDescriptorSetLayout(device, pipeline.set_layout, nullptr);
+    pipeline = {};
+}
+
+// A pool for `set_count` sets of up to COMPUTE_MAX_BUFFERS storage buffers each
+// Compute sets bind the same buffers every time they are used, so they are written once and live as long as the pool
+VkDescriptorPool compute_descriptor_pool_create(VkDevice device, u32 set_count)
+{
+    VkDescriptorPoolSize pool_size = {};
+    pool_size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_size.descriptorCount = set_count * COMPUTE_MAX_BUFFERS;
+
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = set_count;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+
+    VkDescriptorPool pool = {};
+    VkResult vr = vkCreateDescriptorPool(device, &pool_info, nullptr, &pool);
+    CHECK_RESULT(vr);
+    return pool;
+}
+
+// Allocate a set for `pipeline` and bind `buffers[i]` to binding i
+VkDescriptorSet compute_descriptor_set_create(VkDevice device, VkDescriptorPool pool, Compute_Pipeline &pipeline, const VkDescriptorBufferInfo *buffers)
+{
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = pool;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &pipeline.set_layout;
+
+    VkDescriptorSet set = {};
+    VkResult vr = vkAllocateDescriptorSets(device, &alloc_info, &set);
+    CHECK_RESULT(vr);
+
+    VkWriteDescriptorSet writes[COMPUTE_MAX_BUFFERS] = {};
+    for (u32 i = 0; i < pipeline.buffer_count; i++)
+    {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &buffers[i];
+    }
+    vkUpdateDescriptorSets(device, pipeline.buffer_count, writes, 0, nullptr);
+    return set;
+}
+
+void compute_bind(VkCommandBuffer cmd_buf, Compute_Pipeline &pipeline, VkDescriptorSet set, const void *push_constants)
+{
+    vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline);
+    vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.layout, 0, 1, &set, 0, nullptr);
+    if (pipeline.push_constant_size > 0) vkCmdPushConstants(cmd_buf, pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, pipeline.push_constant_size, push_constants);
+}
+
+void compute_dispatch(VkCommandBuffer cmd_buf, Compute_Pipeline &pipeline, VkDescriptorSet set, const void *push_constants, u32 group_count_x, u32 group_count_y = 1, u32 group_count_z = 1)
+{
+    compute_bind(cmd_buf, pipeline, set, push_constants);
+    vkCmdDispatch(cmd_buf, group_count_x, group_count_y, group_count_z);
+}
+
+// The group counts are read from a VkDispatchIndirectCommand at `offset` in `args`, which needs VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+// GPU-written arguments must be made visible with VK_ACCESS_INDIRECT_COMMAND_READ_BIT at VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
+void compute_dispatch_indirect(VkCommandBuffer cmd_buf, Compute_Pipeline &pipeline, VkDescriptorSet set, const void *push_constants, VkBuffer args, VkDeviceSize offset)
+{
+    compute_bind(cmd_buf, pipeline, set, push_constants);
+    vkCmdDispatchIndirect(cmd_buf, args, offset);
+}
+
+// Global memory barrier, e.g. between dispatches that write and read the same buffer
+void compute_barrier(VkCommandBuffer cmd_buf, VkPipelineStageFlags src_stages, VkAccessFlags src_access, VkPipelineStageFlags dst_stages, VkAccessFlags dst_access)
+{
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    vkCmdPipelineBarrier(cmd_buf, src_stages, dst_stages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+//
+// ASYNC COMPUTE QUEUE
+//
+
+struct Compute_Batch {
+    VkCommandBuffer cmd_buf;
+    VkFence         fence;
+    VkSemaphore     semaphore;
+    u64             serial;    // 0 while the slot is unused
+    bool            in_flight;
+};
+
+struct Compute_Queue {
+    VkDevice      device;
+    VkQueue       queue;
+    u32           family;
+    u32           queue_families[2]; // compute family, then the graphics family that consumes the results
+    u32           queue_family_count;
+    bool          async;             // runs on a different queue than graphics, so batches can overlap graphics submissions
+    VkCommandPool cmd_pool;
+
+    std::vector<Compute_Batch> batches;
+    u64           recording_serial;  // batch between compute_queue_begin and compute_queue_submit, 0 when none
+    u64           submitted_serial;
+    u64           completed_serial;
+};
+
+// `async` false submits on the graphics queue instead, e.g. to compare against async compute; everything else behaves the same
+void compute_queue_init(Compute_Queue &compute, Device_Context &ctx, bool async = true, u32 batch_count = 4)
+{
+    VkResult vr = VK_SUCCESS;
+
+    compute = {};
+    compute.device = ctx.device;
+    compute.queue  = async ? ctx.compute_queue  : ctx.graphics_queue;
+    compute.family = async ? ctx.compute_family : ctx.graphics_family;
+    compute.async  = compute.queue != ctx.graphics_queue;
+    compute.queue_families[0]  = compute.family;
+    compute.queue_families[1]  = ctx.graphics_family;
+    compute.queue_family_count = compute.family == ctx.graphics_family ? 1 : 2;
+
+    VkCommandPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT; // batches complete out of step with each other
+    pool_info.queueFamilyIndex = compute.family;
+    vr = vkCreateCommandPool(compute.device, &pool_info, nullptr, &compute.cmd_pool);
+    CHECK_RESULT(vr);
+
+    compute.batches.resize(batch_count);
+    for (auto &batch : compute.batches)
+    {
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandPool = compute.cmd_pool;
+        alloc_info.commandBufferCount = 1;
+        vr = vkAllocateCommandBuffers(compute.device, &alloc_info, &batch.cmd_buf);
+        CHECK_RESULT(vr);
+
+        VkFenceCreateInfo fence_info = {};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        vr = vkCreateFence(compute.device, &fence_info, nullptr, &batch.fence);
+        CHECK_RESULT(vr);
+
+        VkSemaphoreCreateInfo semaphore_info = {};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        vr = vkCreateSemaphore(compute.device, &semaphore_info, nullptr, &batch.semaphore);
+        CHECK_RESULT(vr);
+    }
+}
+
+void compute_queue_destroy(Compute_Queue &compute)
+{
+    for (auto &batch : compute.batches)
+    {
+        vkDestroySemaphore(compute.device, batch.semaphore, nullptr);
+        vkDestroyFence(compute.device, batch.fence, nullptr);
+    }
+    vkDestroyCommandPool(compute.device, compute.cmd_pool, nullptr);
+    compute = {};
+}
+
+// Buffers written by compute batches and read on the graphics queue (or the other way around) must be shared between both
+// families when they differ, instead of transferring ownership with a release/acquire barrier pair every frame
+void compute_queue_apply_sharing(Compute_Queue &compute, VkBufferCreateInfo &info)
+{
+    info.sharingMode           = compute.queue_family_count > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    info.queueFamilyIndexCount = compute.queue_family_count > 1 ? compute.queue_family_count : 0;
+    info.pQueueFamilyIndices   = compute.queue_family_count > 1 ? compute.queue_families : nullptr;
+}
+
+// Mark every batch that has finished as complete, oldest first, without blocking
+void compute_queue_reclaim(Compute_Queue &compute)
+{
+    while (compute.completed_serial < compute.submitted_serial)
+    {
+        Compute_Batch &batch = compute.batches[(compute.completed_serial + 1) % compute.batches.size()];
+        if (batch.in_flight)
+        {
+            VkResult vr = vkGetFenceStatus(compute.device, batch.fence);
+            if (vr == VK_NOT_READY) break;
+            CHECK_RESULT(vr);
+            batch.in_flight = false;
+        }
+        compute.completed_serial = batch.serial;
+    }
+}
+
+// Block until batch `serial` has completed
+void compute_queue_wait(Compute_Queue &compute, u64 serial)
+{
+    if (serial <= compute.completed_serial || serial > compute.submitted_serial) return;
+
+    Compute_Batch &batch = compute.batches[serial % compute.batches.size()];
+    VkResult vr = vkWaitForFences(compute.device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+    CHECK_RESULT(vr);
+    compute_queue_reclaim(compute);
+}
+
+bool compute_queue_is_complete(Compute_Queue &compute, u64 serial)
+{
+    compute_queue_reclaim(compute);
+    return serial <= compute.completed_serial;
+}
+
+// Start recording the next batch; waits for the batch that last used the slot when all of them are in flight
+VkCommandBuffer compute_queue_begin(Compute_Queue &compute)
+{
+    VkResult vr = VK_SUCCESS;
+
+    u64 serial = compute.submitted_serial + 1;
+    Compute_Batch &batch = compute.batches[serial % compute.batches.size()];
+    if (batch.in_flight) compute_queue_wait(compute, batch.serial);
+
+    vr = vkResetCommandBuffer(batch.cmd_buf, 0);
+    CHECK_RESULT(vr);
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vr = vkBeginCommandBuffer(batch.cmd_buf, &begin_info);
+    CHECK_RESULT(vr);
+
+    compute.recording_serial = serial;
+    return batch.cmd_buf;
+}
+
+// Submit the batch started by compute_queue_begin; returns its batch number
+// `wait_semaphore` (optional) is a semaphore signalled by graphics work the batch consumes, waited on at `wait_stages`
+// When `signal_semaphore` is given it receives a semaphore the consuming graphics submission MUST wait on (at COMPUTE_CONSUMER_STAGES)
+// before this slot comes around again
+u64 compute_queue_submit(Compute_Queue &compute, VkSemaphore wait_semaphore = VK_NULL_HANDLE, VkPipelineStageFlags wait_stages = 0, VkSemaphore *signal_semaphore = nullptr)
+{
+    VkResult vr = VK_SUCCESS;
+
+    u64 serial = compute.recording_serial;
+    Compute_Batch &batch = compute.batches[serial % compute.batches.size()];
+
+    vr = vkEndCommandBuffer(batch.cmd_buf);
+    CHECK_RESULT(vr);
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &batch.cmd_buf;
+    if (wait_semaphore != VK_NULL_HANDLE)
+    {
+        submit_info.waitSemaphoreCount = 1;
+        submit_info.pWaitSemaphores = &wait_semaphore;
+        submit_info.pWaitDstStageMask = &wait_stages;
+    }
+    if (signal_semaphore)
+    {
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &batch.semaphore;
+        *signal_semaphore = batch.semaphore;
+    }
+
+    vr = vkResetFences(compute.device, 1, &batch.fence);
+    CHECK_RESULT(vr);
+    vr = vkQueueSubmit(compute.queue, 1, &submit_info, batch.fence);
+    CHECK_RESULT(vr);
+
+    batch.serial    = serial;
+    batch.in_flight = true;
+    compute.submitted_serial = serial;
+    compute.recording_serial = 0;
+    return serial;
+}
+
+//
+// PREFIX SUM
+// Inclusive prefix sum of u32s with shaders/scan.comp and shaders/scan_add.comp
+// Level 0 scans blocks of the input into the output and writes the total of every block to level 1, which is scanned the same way in place,
+// until a level fits in one block. The add pass then walks back down, adding the scanned totals of the preceding blocks to every block
+//
+
+#define PREFIX_SUM_ITEMS_PER_THREAD 4 // ITEMS in the shaders
+#define PREFIX_SUM_MAX_LEVELS 8
+
+// Matches Push_Constants in shaders/scan.comp and shaders/scan_add.comp
+struct Prefix_Sum_Push_Constants {
+    u32 count;
+    u32 write_sums;
+};
+
+struct Prefix_Sum {
+    Compute_Pipeline            scan;
+    Compute_Pipeline            add;
+    VkDescriptorPool            descriptor_pool;
+    u32                         block_size;      // elements per workgroup
+
+    u32                         level_count;
+    u32                         counts[PREFIX_SUM_MAX_LEVELS];
+    VkBuffer                    sums[PREFIX_SUM_MAX_LEVELS];            // sums[i] holds the block totals of level i; sums[0] is unused, level 0 is the output
+    Gpu_Allocation              sum_allocations[PREFIX_SUM_MAX_LEVELS];
+    VkDescriptorSet             scan_sets[PREFIX_SUM_MAX_LEVELS];
+    VkDescriptorSet             add_sets[PREFIX_SUM_MAX_LEVELS];
+
+    VkBuffer                    args;            // one VkDispatchIndirectCommand per level, for prefix_sum_record with `indirect`
+    Gpu_Allocation              args_allocation;
+};
+
+// Scan `count` elements of `input` into `output`; both need VK_BUFFER_USAGE_STORAGE_BUFFER_BIT and may be the same buffer
+void prefix_sum_create(Prefix_Sum &sum, Device_Context &ctx, VkPipelineCache pipeline_cache, Shader_Module_Cache &modules, VkBuffer input, VkBuffer output, u32 count)
+{
+    VkResult vr = VK_SUCCESS;
+
+    sum = {};
+    u32 local_size = compute_local_size(ctx, 256);
+    sum.scan = compute_pipeline_create(ctx.device, pipeline_cache, modules, SHADER_DIR "scan.comp.spv",     3, sizeof(Prefix_Sum_Push_Constants), local_size);
+    sum.add  = compute_pipeline_create(ctx.device, pipeline_cache, modules, SHADER_DIR "scan_add.comp.spv", 2, sizeof(Prefix_Sum_Push_Constants), local_size);
+    sum.block_size = local_size * PREFIX_SUM_ITEMS_PER_THREAD;
+    sum.descriptor_pool = compute_descriptor_pool_create(ctx.device, PREFIX_SUM_MAX_LEVELS * 2);
+
+    // levels until one block holds all the totals
+    sum.counts[0] = count;
+    sum.level_count = 1;
+    while (sum.counts[sum.level_count - 1] > sum.block_size && sum.level_count < PREFIX_SUM_MAX_LEVELS)
+    {
+        sum.counts[sum.level_count] = compute_group_count(sum.counts[sum.level_count - 1], sum.block_size);
+        sum.level_count++;
+    }
+
+    for (u32 level = 1; level < sum.level_count; level++)
+    {
+        VkBufferCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        info.size = (VkDeviceSize)sum.counts[level] * sizeof(u32);
+        info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        vr = gpu_create_buffer(*ctx.allocator, info, GPU_MEMORY_USAGE_DEVICE_LOCAL, sum.sums[level], sum.sum_allocations[level]);
+        CHECK_RESULT(vr);
+    }
+
+    for (u32 level = 0; level < sum.level_count; level++)
+    {
+        VkBuffer level_input  = level == 0 ? input  : sum.sums[level];
+        VkBuffer level_output = level == 0 ? output : sum.sums[level];
+        bool     last         = level + 1 == sum.level_count;
+
+        // the last level writes no totals; binding its own buffer keeps the set valid
+        VkDescriptorBufferInfo scan_buffers[3] = {
+            { level_input,  0, VK_WHOLE_SIZE },
+            { level_output, 0, VK_WHOLE_SIZE },
+            { last ? level_output : sum.sums[level + 1], 0, VK_WHOLE_SIZE },
+        };
+        sum.scan_sets[level] = compute_descriptor_set_create(ctx.device, sum.descriptor_pool, sum.scan, scan_buffers);
+
+        if (last) continue;
+        VkDescriptorBufferInfo add_buffers[2] = {
+            { level_output,          0, VK_WHOLE_SIZE },
+            { sum.sums[level + 1],   0, VK_WHOLE_SIZE },
+        };
+        sum.add_sets[level] = compute_descriptor_set_create(ctx.device, sum.descriptor_pool, sum.add, add_buffers);
+    }
+
+    // both passes of a level dispatch the same number of workgroups
+    VkBufferCreateInfo args_info = {};
+    args_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    args_info.size = sizeof(VkDispatchIndirectCommand) * PREFIX_SUM_MAX_LEVELS;
+    args_info.usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    args_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    vr = gpu_create_buffer(*ctx.allocator, args_info, GPU_MEMORY_USAGE_DYNAMIC, sum.args, sum.args_allocation);
+    CHECK_RESULT(vr);
+
+    VkDispatchIndirectCommand *args = (VkDispatchIndirectCommand *)sum.args_allocation.mapped;
+    for (u32 level = 0; level < sum.level_count; level++) args[level] = { compute_group_count(sum.counts[level], sum.block_size), 1, 1 };
+}
+
+void prefix_sum_destroy(Prefix_Sum &sum, Device_Context &ctx)
+{
+    gpu_destroy_buffer(*ctx.allocator, sum.args, sum.args_allocation);
+    for (u32 level = 1; level < sum.level_count; level++) gpu_destroy_buffer(*ctx.allocator, sum.sums[level], sum.sum_allocations[level]);
+    vkDestroyDescriptorPool(ctx.device, sum.descriptor_pool, nullptr);
+    compute_pipeline_destroy(ctx.device, sum.add);
+    compute_pipeline_destroy(ctx.device, sum.scan);
+    sum = {};
+}
+
+// Record the whole scan; `indirect` reads every workgroup count from `args` instead of passing it to vkCmdDispatch
+// Starts with a barrier against earlier compute work on the queue, so consecutive scans into the same output are ordered
+void prefix_sum_record(Prefix_Sum &sum, VkCommandBuffer cmd_buf, bool indirect = false)
+{
+    const VkAccessFlags shader_access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    compute_barrier(cmd_buf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, shader_access);
+
+    auto dispatch = [&](Compute_Pipeline &pipeline, VkDescriptorSet set, u32 level) {
+        Prefix_Sum_Push_Constants push_constants = {};
+        push_constants.count = sum.counts[level];
+        push_constants.write_sums = level + 1 < sum.level_count;
+
+        if (indirect) compute_dispatch_indirect(cmd_buf, pipeline, set, &push_constants, sum.args, sizeof(VkDispatchIndirectCommand) * level);
+        else          compute_dispatch(cmd_buf, pipeline, set, &push_constants, compute_group_count(sum.counts[level], sum.block_size));
+    };
+
+    for (u32 level = 0; level < sum.level_count; level++)
+    {
+        dispatch(sum.scan, sum.scan_sets[level], level);
+        compute_barrier(cmd_buf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, shader_access);
+    }
+    for (u32 level = sum.level_count - 1; level-- > 0;)
+    {
+        dispatch(sum.add, sum.add_sets[level], level);
+        compute_barrier(cmd_buf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, shader_access);
+    }
+}
+
+//
+// BENCHMARK
+// Prefix sum throughput over 10M elements and overlap with graphics work, `--bench compute`
+// The scan is checked against the CPU once, then timed with direct and indirect dispatches. The overlap runs draw a triangle grid on
+// the graphics queue while the scan runs, first with the scan on the graphics queue and then on the compute queue; the frame's final
+// graphics submission waits on the compute semaphore the way a frame consuming compute results would
+//
+
+void compute_benchmark(Device_Context &ctx)
+{
+    const u32        element_count = 10000000;
+    const u32        iterations    = 10;
+    const u32        frame_count   = 10;
+    const u32        draw_count    = 20000;
+    const VkExtent2D extent        = { 512, 512 };
+
+    VkResult vr = VK_SUCCESS;
+
+    Shader_Module_Cache modules = {};
+    VkDeviceSize data_size = (VkDeviceSize)element_count * sizeof(u32);
+
+    Compute_Queue graphics_compute = {};
+    Compute_Queue async_compute = {};
+    compute_queue_init(graphics_compute, ctx, false);
+    compute_queue_init(async_compute, ctx, true);
+
+    // input in host-visible memory so it can be written once; output and block totals are device-local
+    // the scan runs on both families, only the input has to survive the switch, the rest is overwritten by every scan
+    VkBuffer       input = {}, output = {}, readback = {};
+    Gpu_Allocation input_allocation = {}, output_allocation = {}, readback_allocation = {};
+    {
+        VkBufferCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        info.size = data_size;
+        info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        compute_queue_apply_sharing(async_compute, info);
+        vr = gpu_create_buffer(*ctx.allocator, info, GPU_MEMORY_USAGE_DYNAMIC, input, input_allocation);
+        CHECK_RESULT(vr);
+
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        info.queueFamilyIndexCount = 0;
+        info.pQueueFamilyIndices = nullptr;
+        info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        vr = gpu_create_buffer(*ctx.allocator, info, GPU_MEMORY_USAGE_DEVICE_LOCAL, output, output_allocation);
+        CHECK_RESULT(vr);
+
+        info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        vr = gpu_create_buffer(*ctx.allocator, info, GPU_MEMORY_USAGE_READBACK, readback, readback_allocation);
+        CHECK_RESULT(vr);
+    }
+
+    // small values so the sum of every element fits in 32 bits
+    std::vector<u32> expected(element_count);
+    u32 *values = (u32 *)input_allocation.mapped;
+    u32 state = 0x12345678;
+    for (u32 i = 0; i < element_count; i++) { state = state * 1664525u + 1013904223u; values[i] = state >> 28; }
+
+    auto cpu_start = std::chrono::steady_clock::now();
+    u32 running = 0;
+    for (u32 i = 0; i < element_count; i++) { running += values[i]; expected[i] = running; }
+    f64 cpu_seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - cpu_start).count();
+
+    // the scan is recorded for the compute family; it is compatible with the graphics family, which supports compute as well
+    Prefix_Sum sum = {};
+    prefix_sum_create(sum, ctx, VK_NULL_HANDLE, modules, input, output, element_count);
+
+    std::cout << std::endl << "Compute benchmark: inclusive prefix sum over " << element_count << " u32, " << sum.block_size / PREFIX_SUM_ITEMS_PER_THREAD
+              << " threads x " << PREFIX_SUM_ITEMS_PER_THREAD << " elements per workgroup, " << sum.level_count << " levels";
+    std::cout << (async_compute.async ? " (dedicated compute queue)" : " (compute queue aliases the graphics queue, no overlap expected)") << std::endl;
+
+    // correctness, on the compute queue the later runs use
+    {
+        VkCommandBuffer cmd_buf = compute_queue_begin(async_compute);
+        prefix_sum_record(sum, cmd_buf);
+        compute_barrier(cmd_buf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+        VkBufferCopy region = { 0, 0, data_size };
+        vkCmdCopyBuffer(cmd_buf, output, readback, 1, &region);
+        compute_barrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+        compute_queue_wait(async_compute, compute_queue_submit(async_compute));
+
+        // readback memory is host-coherent, see gpu_memory_usage_flags
+        const u32 *results = (const u32 *)readback_allocation.mapped;
+        u32 mismatches = 0, first_mismatch = 0;
+        for (u32 i = 0; i < element_count; i++)
+        {
+            if (results[i] == expected[i]) continue;
+            if (mismatches++ == 0) first_mismatch = i;
+        }
+        if (mismatches == 0) printf("  verify     ok\n");
+        else printf("  verify     FAILED: %u mismatches, first at %u (%u, expected %u)\n", mismatches, first_mismatch, results[first_mismatch], expected[first_mismatch]);
+    }
+
+    printf("  %-9s %8.3f ms/scan  %8.1f M elements/s\n", "cpu", cpu_seconds * 1000.0, element_count / cpu_seconds / 1e6);
+    for (bool indirect : { false, true })
+    {
+        auto start = std::chrono::steady_clock::now();
+        u64 serial = 0;
+        for (u32 i = 0; i < iterations; i++)
+        {
+            VkCommandBuffer cmd_buf = compute_queue_begin(async_compute);
+            prefix_sum_record(sum, cmd_buf, indirect);
+            serial = compute_queue_submit(async_compute);
+        }
+        compute_queue_wait(async_compute, serial);
+
+        f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+        printf("  %-9s %8.3f ms/scan  %8.1f M elements/s\n", indirect ? "indirect" : "direct", seconds * 1000.0 / iterations, (f64)element_count * iterations / seconds / 1e6);
+    }
+
+    // graphics load: a triangle grid drawn into an offscreen target
+    VkRenderPass        render_pass = create_present_render_pass(ctx.device, VK_FORMAT_B8G8R8A8_UNORM, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    VkPipelineLayout    layout      = create_triangle_pipeline_layout(ctx.device);
+    VkPipeline          pipeline    = create_triangle_pipeline(ctx.device, VK_NULL_HANDLE, modules, render_pass, layout);
+
+    VkImage        image = {};
+    Gpu_Allocation image_allocation = {};
+    VkImageView    image_view = {};
+    VkFramebuffer  framebuffer = {};
+    {
+        VkImageCreateInfo image_info = {};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = VK_FORMAT_B8G8R8A8_UNORM;
+        image_info.extent = { extent.width, extent.height, 1 };
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        vr = gpu_create_image(*ctx.allocator, image_info, GPU_MEMORY_USAGE_DEVICE_LOCAL, image, image_allocation);
+        CHECK_RESULT(vr);
+
+        VkImageViewCreateInfo view_info = {};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = image_info.format;
+        view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        view_info.subresourceRange.levelCount = 1;
+        view_info.subresourceRange.layerCount = 1;
+        vr = vkCreateImageView(ctx.device, &view_info, nullptr, &image_view);
+        CHECK_RESULT(vr);
+
+        VkFramebufferCreateInfo framebuffer_info = {};
+        framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebuffer_info.renderPass = render_pass;
+        framebuffer_info.attachmentCount = 1;
+        framebuffer_info.pAttachments = &image_view;
+        framebuffer_info.width = extent.width;
+        framebuffer_info.height = extent.height;
+        framebuffer_info.layers = 1;
+        vr = vkCreateFramebuffer(ctx.device, &framebuffer_info, nullptr, &framebuffer);
+        CHECK_RESULT(vr);
+    }
+
+    VkCommandPool   graphics_pool = {};
+    VkCommandBuffer graphics_cmd_buf = {};
+    VkFence         frame_fence = {};
+    {
+        VkCommandPoolCreateInfo pool_info = {};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.queueFamilyIndex = ctx.graphics_family;
+        vr = vkCreateCommandPool(ctx.device, &pool_info, nullptr, &graphics_pool);
+        CHECK_RESULT(vr);
+
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandPool = graphics_pool;
+        alloc_info.commandBufferCount = 1;
+        vr = vkAllocateCommandBuffers(ctx.device, &alloc_info, &graphics_cmd_buf);
+        CHECK_RESULT(vr);
+
+        VkFenceCreateInfo fence_info = {};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        vr = vkCreateFence(ctx.device, &fence_info, nullptr, &frame_fence);
+        CHECK_RESULT(vr);
+
+        // the draws are the same every frame, so the command buffer is recorded once
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        vr = vkBeginCommandBuffer(graphics_cmd_buf, &begin_info);
+        CHECK_RESULT(vr);
+
+        VkClearValue clear_value = {};
+        VkRenderPassBeginInfo render_pass_begin_info = {};
+        render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        render_pass_begin_info.renderPass = render_pass;
+        render_pass_begin_info.framebuffer = framebuffer;
+        render_pass_begin_info.renderArea.extent = extent;
+        render_pass_begin_info.clearValueCount = 1;
+        render_pass_begin_info.pClearValues = &clear_value;
+        vkCmdBeginRenderPass(graphics_cmd_buf, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+        record_triangle_grid(graphics_cmd_buf, pipeline, layout, extent, 0, draw_count, draw_count, 0.0f);
+        vkCmdEndRenderPass(graphics_cmd_buf);
+
+        vr = vkEndCommandBuffer(graphics_cmd_buf);
+        CHECK_RESULT(vr);
+    }
+
+    // one frame: draws on the graphics queue, the scan on `compute` (unless null), then a graphics submission that consumes the scan
+    auto run_frame = [&](bool draw, Compute_Queue *compute) {
+        VkSubmitInfo submit_info = {};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        if (draw)
+        {
+            submit_info.commandBufferCount = 1;
+            submit_info.pCommandBuffers = &graphics_cmd_buf;
+            vr = vkQueueSubmit(ctx.graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
+            CHECK_RESULT(vr);
+        }
+
+        VkSemaphore compute_semaphore = VK_NULL_HANDLE;
+        if (compute)
+        {
+            VkCommandBuffer cmd_buf = compute_queue_begin(*compute);
+            prefix_sum_record(sum, cmd_buf);
+            compute_queue_submit(*compute, VK_NULL_HANDLE, 0, &compute_semaphore);
+        }
+
+        // the fence covers everything submitted to the graphics queue before it, and the scan through the semaphore
+        VkPipelineStageFlags wait_stages = COMPUTE_CONSUMER_STAGES;
+        submit_info = {};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.waitSemaphoreCount = compute_semaphore != VK_NULL_HANDLE ? 1 : 0;
+        submit_info.pWaitSemaphores = &compute_semaphore;
+        submit_info.pWaitDstStageMask = &wait_stages;
+        vr = vkResetFences(ctx.device, 1, &frame_fence);
+        CHECK_RESULT(vr);
+        vr = vkQueueSubmit(ctx.graphics_queue, 1, &submit_info, frame_fence);
+        CHECK_RESULT(vr);
+        vr = vkWaitForFences(ctx.device, 1, &frame_fence, VK_TRUE, UINT64_MAX);
+        CHECK_RESULT(vr);
+        if (compute) compute_queue_reclaim(*compute);
+    };
+
+    std::cout << "Overlap: " << draw_count << " triangles at " << extent.width << "x" << extent.height << " and one scan per frame, " << frame_count << " frames" << std::endl;
+
+    struct Scenario { const char *name; bool draw; Compute_Queue *compute; };
+    const Scenario scenarios[] = {
+        { "graphics only",           true,  nullptr           },
+        { "compute only",            false, &async_compute    },
+        { "serial (graphics queue)", true,  &graphics_compute },
+        { "async (compute queue)",   true,  &async_compute    },
+    };
+
+    f64 frame_ms[4] = {};
+    for (u32 s = 0; s < 4; s++)
+    {
+        const Scenario &scenario = scenarios[s];
+        run_frame(scenario.draw, scenario.compute); // warm up
+
+        auto start = std::chrono::steady_clock::now();
+        for (u32 frame = 0; frame < frame_count; frame++) run_frame(scenario.draw, scenario.compute);
+        frame_ms[s] = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count() * 1000.0 / frame_count;
+
+        // overlap: how much of the shorter workload was hidden behind the longer one
+        if (s < 2) printf("  %-24s %8.3f ms/frame\n", scenario.name, frame_ms[s]);
+        else printf("  %-24s %8.3f ms/frame  %5.1f%% hidden\n", scenario.name, frame_ms[s],
+                    100.0 * std::max(0.0, frame_ms[0] + frame_ms[1] - frame_ms[s]) / std::min(frame_ms[0], frame_ms[1]));
+    }
+
+    vr = vkDeviceWaitIdle(ctx.device);
+    CHECK_RESULT(vr);
+    vkDestroyFence(ctx.device, frame_fence, nullptr);
+    vkDestroyCommandPool(ctx.device, graphics_pool, nullptr);
+    vkDestroyFramebuffer(ctx.device, framebuffer, nullptr);
+    vkDestroyImageView(ctx.device, image_view, nullptr);
+    gpu_destroy_image(*ctx.allocator, image, image_allocation);
+    vkDestroyPipeline(ctx.device, pipeline, nullptr);
+    vkDestroyPipelineLayout(ctx.device, layout, nullptr);
+    vkDestroyRenderPass(ctx.device, render_pass, nullptr);
+
+    prefix_sum_destroy(sum, ctx);
+    compute_queue_destroy(async_compute);
+    compute_queue_destroy(graphics_compute);
+    gpu_destroy_buffer(*ctx.allocator, readback, readback_allocation);
+    gpu_destroy_buffer(*ctx.allocator, output, output_allocation);
+    gpu_destroy_buffer(*ctx.allocator, input, input_allocation);
+    shader_module_cache_destroy(ctx.device, modules);
+}
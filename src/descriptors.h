@@ -0,0 +1,506 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "common.h"
+#include "gpu_allocator.h"
+
+//
+// BINDLESS DESCRIPTORS
+// With VK_EXT_descriptor_indexing every texture and storage buffer lives in one global descriptor set that is bound once per frame
+// Resources are registered into slots handed out by a free list and shaders index the arrays with slots passed in push constants, so
+// drawing needs no descriptor work at all and a descriptor is only written when a resource is registered
+// Devices without the extension fall back to a small set per draw, allocated from per-frame pools that are reset when the frame's
+// fence has signalled; the slots then only index CPU-side copies of the descriptors
+//
+
+#define DESCRIPTOR_HEAP_MAX_TEXTURES 4096
+#define DESCRIPTOR_HEAP_MAX_BUFFERS  4096
+#define DESCRIPTOR_HEAP_FALLBACK_SETS_PER_POOL 1024
+#define DESCRIPTOR_SLOT_INVALID (~0u)
+
+// binding 0: combined image samplers, binding 1: storage buffers; the fallback layout has the same bindings with one descriptor each
+#define DESCRIPTOR_BINDING_TEXTURES 0
+#define DESCRIPTOR_BINDING_BUFFERS  1
+
+struct Descriptor_Slot_List {
+    std::vector<u32> free;
+    u32              next;     // slots below this have been handed out at least once
+    u32              capacity;
+};
+
+struct Descriptor_Fallback_Frame {
+    std::vector<VkDescriptorPool> pools;
+    u32                           used;     // pools[0..used) have been allocated from this frame
+};
+
+struct Descriptor_Heap {
+    VkDevice                             device;
+    bool                                 bindless;
+    VkDescriptorSetLayout                layout;
+
+    Descriptor_Slot_List                 textures;
+    Descriptor_Slot_List                 buffers;
+
+    // slots released during a frame are reused once that frame index comes around again, when no submitted work can still read them
+    std::vector<std::vector<u32>>        retired_textures;
+    std::vector<std::vector<u32>>        retired_buffers;
+    u32                                  frame_index;
+
+    // bindless
+    VkDescriptorPool                     pool;
+    VkDescriptorSet                      set;
+
+    // fallback
+    std::vector<VkDescriptorImageInfo>   texture_infos;
+    std::vector<VkDescriptorBufferInfo>  buffer_infos;
+    std::vector<Descriptor_Fallback_Frame> frames;
+
+    u64                                  descriptor_writes;
+    u64                                  sets_allocated;
+};
+
+// Fill `features` with the descriptor indexing features the bindless heap needs and return whether the device supports all of them
+// Needs VK_KHR_get_physical_device_properties2 on the instance; the device must also expose VK_EXT_descriptor_indexing and VK_KHR_maintenance3
+bool descriptor_indexing_query_features(VkInstance instance, VkPhysicalDevice physical_device, VkPhysicalDeviceDescriptorIndexingFeaturesEXT &features)
+{
+    features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+    auto get_features2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+    if (!get_features2) return false;
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported = {};
+    supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2 features2 = {};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &supported;
+    get_features2(physical_device, &features2);
+
+    features.runtimeDescriptorArray                        = supported.runtimeDescriptorArray;
+    features.descriptorBindingPartiallyBound               = supported.descriptorBindingPartiallyBound;
+    features.descriptorBindingUpdateUnusedWhilePending     = supported.descriptorBindingUpdateUnusedWhilePending;
+    features.descriptorBindingSampledImageUpdateAfterBind  = supported.descriptorBindingSampledImageUpdateAfterBind;
+    features.descriptorBindingStorageBufferUpdateAfterBind = supported.descriptorBindingStorageBufferUpdateAfterBind;
+    features.shaderSampledImageArrayNonUniformIndexing     = supported.shaderSampledImageArrayNonUniformIndexing;
+    features.shaderStorageBufferArrayNonUniformIndexing    = supported.shaderStorageBufferArrayNonUniformIndexing;
+
+    return features.runtimeDescriptorArray && features.descriptorBindingPartiallyBound && features.descriptorBindingUpdateUnusedWhilePending &&
+           features.descriptorBindingSampledImageUpdateAfterBind && features.descriptorBindingStorageBufferUpdateAfterBind;
+}
+
+u32 descriptor_slot_allocate(Descriptor_Slot_List &list)
+{
+    if (!list.free.empty())
+    {
+        u32 slot = list.free.back();
+        list.free.pop_back();
+        return slot;
+    }
+    if (list.next < list.capacity) return list.next++;
+    return DESCRIPTOR_SLOT_INVALID;
+}
+
+// `bindless` must only be set when the device was created with the features from descriptor_indexing_query_features
+// `frame_count` is the number of frames in flight, see descriptor_heap_begin_frame
+void descriptor_heap_init(Descriptor_Heap &heap, Device_Context &ctx, bool bindless, u32 frame_count)
+{
+    VkResult vr = VK_SUCCESS;
+
+    heap = {};
+    heap.device   = ctx.device;
+    heap.bindless = bindless;
+    heap.retired_textures.resize(frame_count);
+    heap.retired_buffers.resize(frame_count);
+
+    heap.textures.capacity = DESCRIPTOR_HEAP_MAX_TEXTURES;
+    heap.buffers.capacity  = DESCRIPTOR_HEAP_MAX_BUFFERS;
+    if (bindless)
+    {
+        // the update-after-bind limits are separate from (and usually much larger than) the regular per-stage limits
+        auto get_properties2 = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(ctx.instance, "vkGetPhysicalDeviceProperties2KHR");
+        VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexing_props = {};
+        indexing_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+        VkPhysicalDeviceProperties2 props2 = {};
+        props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        props2.pNext = &indexing_props;
+        get_properties2(ctx.physical_device, &props2);
+
+        // combined image samplers count against both the sampler and the sampled image limits
+        u32 max_textures = std::min(indexing_props.maxPerStageDescriptorUpdateAfterBindSampledImages, indexing_props.maxDescriptorSetUpdateAfterBindSampledImages);
+        max_textures = std::min(max_textures, std::min(indexing_props.maxPerStageDescriptorUpdateAfterBindSamplers, indexing_props.maxDescriptorSetUpdateAfterBindSamplers));
+        heap.textures.capacity = std::min(heap.textures.capacity, max_textures);
+        heap.buffers.capacity  = std::min(heap.buffers.capacity,  std::min(indexing_props.maxPerStageDescriptorUpdateAfterBindStorageBuffers, indexing_props.maxDescriptorSetUpdateAfterBindStorageBuffers));
+    }
+    else
+    {
+        heap.texture_infos.resize(heap.textures.capacity);
+        heap.buffer_infos.resize(heap.buffers.capacity);
+        heap.frames.resize(frame_count);
+    }
+
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    bindings[0].binding         = DESCRIPTOR_BINDING_TEXTURES;
+    bindings[0].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = bindless ? heap.textures.capacity : 1;
+    bindings[0].stageFlags      = VK_SHADER_STAGE_ALL;
+    bindings[1].binding         = DESCRIPTOR_BINDING_BUFFERS;
+    bindings[1].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = bindless ? heap.buffers.capacity : 1;
+    bindings[1].stageFlags      = VK_SHADER_STAGE_ALL;
+
+    // partially bound: unregistered slots may hold no descriptor at all
+    // update unused while pending: slots can be (re)written while command buffers that bind the set are in flight
+    VkDescriptorBindingFlagsEXT binding_flags[2] = {};
+    binding_flags[0] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    binding_flags[1] = binding_flags[0];
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT binding_flags_info = {};
+    binding_flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    binding_flags_info.bindingCount  = 2;
+    binding_flags_info.pBindingFlags = binding_flags;
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = 2;
+    layout_info.pBindings    = bindings;
+    if (bindless)
+    {
+        layout_info.pNext = &binding_flags_info;
+        layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    }
+    vr = vkCreateDescriptorSetLayout(ctx.device, &layout_info, nullptr, &heap.layout);
+    CHECK_RESULT(vr);
+
+    if (!bindless) return;
+
+    VkDescriptorPoolSize pool_sizes[2] = {};
+    pool_sizes[0].type            = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    pool_sizes[0].descriptorCount = heap.textures.capacity;
+    pool_sizes[1].type            = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_sizes[1].descriptorCount = heap.buffers.capacity;
+
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.flags         = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    pool_info.maxSets       = 1;
+    pool_info.poolSizeCount = 2;
+    pool_info.pPoolSizes    = pool_sizes;
+    vr = vkCreateDescriptorPool(ctx.device, &pool_info, nullptr, &heap.pool);
+    CHECK_RESULT(vr);
+
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool     = heap.pool;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts        = &heap.layout;
+    vr = vkAllocateDescriptorSets(ctx.device, &alloc_info, &heap.set);
+    CHECK_RESULT(vr);
+}
+
+void descriptor_heap_destroy(Descriptor_Heap &heap)
+{
+    for (auto &frame : heap.frames)
+    {
+        for (VkDescriptorPool pool : frame.pools) vkDestroyDescriptorPool(heap.device, pool, nullptr);
+    }
+    if (heap.pool) vkDestroyDescriptorPool(heap.device, heap.pool, nullptr);
+    vkDestroyDescriptorSetLayout(heap.device, heap.layout, nullptr);
+    heap = {};
+}
+
+// Call once the fence of the frame that last used `frame_index` has signalled
+// Recycles the slots released during that frame and, on the fallback path, resets its descriptor pools
+void descriptor_heap_begin_frame(Descriptor_Heap &heap, u32 frame_index)
+{
+    VkResult vr = VK_SUCCESS;
+
+    heap.frame_index = frame_index;
+
+    auto &retired_textures = heap.retired_textures[frame_index];
+    auto &retired_buffers  = heap.retired_buffers[frame_index];
+    heap.textures.free.insert(heap.textures.free.end(), retired_textures.begin(), retired_textures.end());
+    heap.buffers.free.insert(heap.buffers.free.end(), retired_buffers.begin(), retired_buffers.end());
+    retired_textures.clear();
+    retired_buffers.clear();
+
+    if (heap.bindless) return;
+
+    Descriptor_Fallback_Frame &frame = heap.frames[frame_index];
+    for (u32 i = 0; i < frame.used; i++)
+    {
+        vr = vkResetDescriptorPool(heap.device, frame.pools[i], 0);
+        CHECK_RESULT(vr);
+    }
+    frame.used = 0;
+}
+
+// Returns DESCRIPTOR_SLOT_INVALID when every slot is in use
+u32 descriptor_heap_register_texture(Descriptor_Heap &heap, VkSampler sampler, VkImageView view, VkImageLayout layout)
+{
+    u32 slot = descriptor_slot_allocate(heap.textures);
+    if (slot == DESCRIPTOR_SLOT_INVALID) return slot;
+
+    VkDescriptorImageInfo image_info = {};
+    image_info.sampler     = sampler;
+    image_info.imageView   = view;
+    image_info.imageLayout = layout;
+
+    if (!heap.bindless)
+    {
+        heap.texture_infos[slot] = image_info;
+        return slot;
+    }
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet          = heap.set;
+    write.dstBinding      = DESCRIPTOR_BINDING_TEXTURES;
+    write.dstArrayElement = slot;
+    write.descriptorCount = 1;
+    write.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo      = &image_info;
+    vkUpdateDescriptorSets(heap.device, 1, &write, 0, nullptr);
+    heap.descriptor_writes++;
+    return slot;
+}
+
+// Returns DESCRIPTOR_SLOT_INVALID when every slot is in use
+u32 descriptor_heap_register_buffer(Descriptor_Heap &heap, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    u32 slot = descriptor_slot_allocate(heap.buffers);
+    if (slot == DESCRIPTOR_SLOT_INVALID) return slot;
+
+    VkDescriptorBufferInfo buffer_info = {};
+    buffer_info.buffer = buffer;
+    buffer_info.offset = offset;
+    buffer_info.range  = range;
+
+    if (!heap.bindless)
+    {
+        heap.buffer_infos[slot] = buffer_info;
+        return slot;
+    }
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet          = heap.set;
+    write.dstBinding      = DESCRIPTOR_BINDING_BUFFERS;
+    write.dstArrayElement = slot;
+    write.descriptorCount = 1;
+    write.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo     = &buffer_info;
+    vkUpdateDescriptorSets(heap.device, 1, &write, 0, nullptr);
+    heap.descriptor_writes++;
+    return slot;
+}
+
+// The slot stays valid for work recorded in the current frame and is reused once the frame has completed
+// Releasing DESCRIPTOR_SLOT_INVALID, as returned when the heap was full, does nothing
+void descriptor_heap_release_texture(Descriptor_Heap &heap, u32 slot)
+{
+    if (slot == DESCRIPTOR_SLOT_INVALID) return;
+    heap.retired_textures[heap.frame_index].push_back(slot);
+}
+
+void descriptor_heap_release_buffer(Descriptor_Heap &heap, u32 slot)
+{
+    if (slot == DESCRIPTOR_SLOT_INVALID) return;
+    heap.retired_buffers[heap.frame_index].push_back(slot);
+}
+
+VkDescriptorPool descriptor_heap_create_fallback_pool(Descriptor_Heap &heap)
+{
+    VkDescriptorPoolSize pool_sizes[2] = {};
+    pool_sizes[0].type            = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    pool_sizes[0].descriptorCount = DESCRIPTOR_HEAP_FALLBACK_SETS_PER_POOL;
+    pool_sizes[1].type            = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_sizes[1].descriptorCount = DESCRIPTOR_HEAP_FALLBACK_SETS_PER_POOL;
+
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets       = DESCRIPTOR_HEAP_FALLBACK_SETS_PER_POOL;
+    pool_info.poolSizeCount = 2;
+    pool_info.pPoolSizes    = pool_sizes;
+
+    VkDescriptorPool pool = {};
+    VkResult vr = vkCreateDescriptorPool(heap.device, &pool_info, nullptr, &pool);
+    CHECK_RESULT(vr);
+    return pool;
+}
+
+// The set to bind for a draw that reads `texture` and `buffer` (either may be DESCRIPTOR_SLOT_INVALID)
+// Bindless: always the global set, the slots go to the shader in push constants
+// Fallback: a set from the current frame's pools holding just these two descriptors
+VkDescriptorSet descriptor_heap_draw_set(Descriptor_Heap &heap, u32 texture, u32 buffer)
+{
+    if (heap.bindless) return heap.set;
+
+    VkResult vr = VK_SUCCESS;
+
+    // allocate from the current pool and move on to the next one (creating it the first time) when it runs out
+    Descriptor_Fallback_Frame &frame = heap.frames[heap.frame_index];
+    if (frame.used == 0)
+    {
+        if (frame.pools.empty()) frame.pools.push_back(descriptor_heap_create_fallback_pool(heap));
+        frame.used = 1;
+    }
+
+    VkDescriptorSet set = {};
+    for (;;)
+    {
+        VkDescriptorSetAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.descriptorPool     = frame.pools[frame.used - 1];
+        alloc_info.descriptorSetCount = 1;
+        alloc_info.pSetLayouts        = &heap.layout;
+        vr = vkAllocateDescriptorSets(heap.device, &alloc_info, &set);
+        if (vr == VK_SUCCESS) break;
+        if (vr != VK_ERROR_OUT_OF_POOL_MEMORY && vr != VK_ERROR_FRAGMENTED_POOL) CHECK_RESULT(vr);
+
+        if (frame.used == frame.pools.size()) frame.pools.push_back(descriptor_heap_create_fallback_pool(heap));
+        frame.used++;
+    }
+    heap.sets_allocated++;
+
+    VkWriteDescriptorSet writes[2] = {};
+    u32 write_count = 0;
+    if (texture != DESCRIPTOR_SLOT_INVALID)
+    {
+        VkWriteDescriptorSet &write = writes[write_count++];
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet          = set;
+        write.dstBinding      = DESCRIPTOR_BINDING_TEXTURES;
+        write.descriptorCount = 1;
+        write.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo      = &heap.texture_infos[texture];
+    }
+    if (buffer != DESCRIPTOR_SLOT_INVALID)
+    {
+        VkWriteDescriptorSet &write = writes[write_count++];
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet          = set;
+        write.dstBinding      = DESCRIPTOR_BINDING_BUFFERS;
+        write.descriptorCount = 1;
+        write.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo     = &heap.buffer_infos[buffer];
+    }
+    vkUpdateDescriptorSets(heap.device, write_count, writes, 0, nullptr);
+    heap.descriptor_writes += write_count;
+    return set;
+}
+
+// Descriptor work per second for a frame of `draw_count` draws, each with its own texture and buffer, on both paths
+// The bindless path registers every resource once and then only re-registers the few that change per frame; the fallback
+// path has to allocate and write a set for every draw
+void descriptor_benchmark(Device_Context &ctx)
+{
+    const u32 draw_count        = 2000;
+    const u32 frame_count       = 200;
+    const u32 changes_per_frame = 64; // textures re-registered per frame, e.g. streamed in or out
+
+    VkResult vr = VK_SUCCESS;
+
+    // one small texture and buffer that every slot points at; the descriptors are never read
+    VkImage        image = {};
+    Gpu_Allocation image_allocation = {};
+    VkImageView    image_view = {};
+    VkSampler      sampler = {};
+    VkBuffer       buffer = {};
+    Gpu_Allocation buffer_allocation = {};
+    {
+        VkImageCreateInfo image_info = {};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+        image_info.extent = { 4, 4, 1 };
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        vr = gpu_create_image(*ctx.allocator, image_info, GPU_MEMORY_USAGE_DEVICE_LOCAL, image, image_allocation);
+        CHECK_RESULT(vr);
+
+        VkImageViewCreateInfo view_info = {};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = image_info.format;
+        view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        view_info.subresourceRange.levelCount = 1;
+        view_info.subresourceRange.layerCount = 1;
+        vr = vkCreateImageView(ctx.device, &view_info, nullptr, &image_view);
+        CHECK_RESULT(vr);
+
+        VkSamplerCreateInfo sampler_info = {};
+        sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        sampler_info.magFilter = VK_FILTER_LINEAR;
+        sampler_info.minFilter = VK_FILTER_LINEAR;
+        vr = vkCreateSampler(ctx.device, &sampler_info, nullptr, &sampler);
+        CHECK_RESULT(vr);
+
+        VkBufferCreateInfo buffer_info = {};
+        buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        buffer_info.size = 256;
+        buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        vr = gpu_create_buffer(*ctx.allocator, buffer_info, GPU_MEMORY_USAGE_DEVICE_LOCAL, buffer, buffer_allocation);
+        CHECK_RESULT(vr);
+    }
+
+    std::cout << std::endl << "Descriptor benchmark: " << draw_count << " draws per frame with their own texture and buffer, " << frame_count << " frames" << std::endl;
+
+    for (bool bindless : { true, false })
+    {
+        if (bindless && !ctx.descriptor_indexing)
+        {
+            printf("  %-9s skipped, VK_EXT_descriptor_indexing is not enabled on this device\n", "bindless");
+            continue;
+        }
+
+        // two frames in flight, so released slots are reused two frames later as in the render loop
+        Descriptor_Heap heap = {};
+        descriptor_heap_init(heap, ctx, bindless, 2);
+
+        std::vector<u32> textures(draw_count);
+        std::vector<u32> buffers(draw_count);
+        for (u32 i = 0; i < draw_count; i++)
+        {
+            textures[i] = descriptor_heap_register_texture(heap, sampler, image_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+            buffers[i]  = descriptor_heap_register_buffer(heap, buffer, 0, VK_WHOLE_SIZE);
+        }
+        u64 writes_before = heap.descriptor_writes;
+        u64 sets_before   = heap.sets_allocated;
+
+        auto start = std::chrono::steady_clock::now();
+        for (u32 frame = 0; frame < frame_count; frame++)
+        {
+            descriptor_heap_begin_frame(heap, frame % 2);
+
+            for (u32 i = 0; i < changes_per_frame; i++)
+            {
+                u32 draw = (frame * changes_per_frame + i) % draw_count;
+                descriptor_heap_release_texture(heap, textures[draw]);
+                textures[draw] = descriptor_heap_register_texture(heap, sampler, image_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+            }
+
+            for (u32 i = 0; i < draw_count; i++) descriptor_heap_draw_set(heap, textures[i], buffers[i]);
+        }
+        f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+
+        printf("  %-9s %8.3f ms/frame  %12.0f draws/s  %12.0f descriptor writes/s  %8llu sets allocated\n", bindless ? "bindless" : "fallback",
+            seconds * 1000.0 / frame_count, (f64)draw_count * frame_count / seconds, (heap.descriptor_writes - writes_before) / seconds,
+            (unsigned long long)(heap.sets_allocated - sets_before));
+
+        descriptor_heap_destroy(heap);
+    }
+
+    gpu_destroy_buffer(*ctx.allocator, buffer, buffer_allocation);
+    vkDestroySampler(ctx.device, sampler, nullptr);
+    vkDestroyImageView(ctx.device, image_view, nullptr);
+    gpu_destroy_image(*ctx.allocator, image, image_allocation);
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "common.h"
+
+//
+// FAULT INJECTION
+// `-F site:result@call` makes one call of the frame loop report `result`, so the error paths (including device-loss recovery, see
+// main) can be exercised on any driver, lavapipe included, without a misbehaving GPU
+// The sites are the calls that report device loss and swapchain changes: the frame wait, the acquire, the submit and the present
+// `call` counts the calls of that site over the whole run, starting at 0; rebuilt devices keep counting
+// A fault replaces the call, unless the call has to happen for the frame to stay consistent: a suboptimal acquire still acquires
+// an image, and a present still consumes its wait on the render-finished semaphore. Then only the result is replaced
+//
+
+enum Fault_Site {
+    FAULT_SITE_WAIT,
+    FAULT_SITE_ACQUIRE,
+    FAULT_SITE_SUBMIT,
+    FAULT_SITE_PRESENT,
+    FAULT_SITE_COUNT,
+};
+
+const char *fault_site_names[FAULT_SITE_COUNT] = { "wait", "acquire", "submit", "present" };
+
+// the results each site may report, see fault_parse
+const VkResult fault_site_results[FAULT_SITE_COUNT][5] = {
+    { VK_ERROR_DEVICE_LOST, VK_TIMEOUT },
+    { VK_ERROR_DEVICE_LOST, VK_ERROR_OUT_OF_DATE_KHR, VK_SUBOPTIMAL_KHR, VK_TIMEOUT, VK_NOT_READY },
+    { VK_ERROR_DEVICE_LOST, VK_ERROR_OUT_OF_DEVICE_MEMORY },
+    { VK_ERROR_DEVICE_LOST, VK_ERROR_OUT_OF_DATE_KHR, VK_SUBOPTIMAL_KHR },
+};
+
+struct Fault {
+    Fault_Site site;
+    VkResult   result;
+    u64        call;
+};
+
+struct Fault_Injector {
+    std::vector<Fault> faults;
+    u64                calls[FAULT_SITE_COUNT];
+    u32                injected;
+};
+
+Fault_Injector fault_injector = {};
+
+// Parse "site:result@call", e.g. "submit:device-lost@200"
+bool fault_parse(const char *text, Fault &fault)
+{
+    static const struct { const char *name; VkResult result; } results[] = {
+        { "device-lost",   VK_ERROR_DEVICE_LOST },
+        { "out-of-date",   VK_ERROR_OUT_OF_DATE_KHR },
+        { "suboptimal",    VK_SUBOPTIMAL_KHR },
+        { "timeout",       VK_TIMEOUT },
+        { "not-ready",     VK_NOT_READY },
+        { "out-of-memory", VK_ERROR_OUT_OF_DEVICE_MEMORY },
+    };
+
+    const char *colon = strchr(text, ':');
+    const char *at = colon ? strchr(colon, '@') : nullptr;
+    if (!colon || !at) return false;
+
+    fault = {};
+    bool site_found = false;
+    for (u32 site = 0; site < FAULT_SITE_COUNT; site++)
+    {
+        if (strlen(fault_site_names[site]) != (usize)(colon - text) || strncmp(fault_site_names[site], text, colon - text) != 0) continue;
+        fault.site = (Fault_Site)site;
+        site_found = true;
+    }
+    bool result_found = false;
+    for (const auto &result : results)
+    {
+        if (strlen(result.name) != (usize)(at - colon - 1) || strncmp(result.name, colon + 1, at - colon - 1) != 0) continue;
+        fault.result = result.result;
+        result_found = true;
+    }
+
+    bool result_valid = false;
+    for (VkResult result : fault_site_results[fault.site]) result_valid |= result_found && result == fault.result;
+
+    char *end = nullptr;
+    fault.call = strtoull(at + 1, &end, 10);
+    return site_found && result_valid && end != at + 1 && *end == '\0';
+}
+
+// Count a call of `site`; returns true and sets `vr` when a fault is due for it
+bool fault_due(Fault_Site site, VkResult *vr)
+{
+    u64 call = fault_injector.calls[site]++;
+    for (const auto &fault : fault_injector.faults)
+    {
+        if (fault.site != site || fault.call != call) continue;
+        *vr = fault.result;
+        fault_injector.injected++;
+        printf("Injected %s into %s call %llu\n", vulkan_result_name(fault.result), fault_site_names[site], (unsigned long long)call);
+        return true;
+    }
+    return false;
+}
+
+bool fault_replaces_call(Fault_Site site, VkResult fault)
+{
+    return site != FAULT_SITE_PRESENT && fault != VK_SUBOPTIMAL_KHR;
+}
+
+// Make the call CALL at SITE, or inject the fault that is due for it
+#define FAULT_INJECT(SITE, CALL) ([&]() { VkResult fault = VK_SUCCESS; bool due = fault_due((SITE), &fault); if (due && fault_replaces_call((SITE), fault)) return fault; VkResult vr = (CALL); return due ? fault : vr; })()
@@ -0,0 +1,553 @@
+#pragma once
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "common.h"
+
+//
+// GPU MEMORY ALLOCATOR
+// Sub-allocates buffers and images from a small number of large VkDeviceMemory blocks
+// Drivers cap the number of live allocations (maxMemoryAllocationCount, often 4096) and vkAllocateMemory is slow, so resources must never own an allocation each
+//
+// Every memory type has two pools: one for linear resources (buffers) and one for optimal-tiling images,
+// which keeps the two apart so bufferImageGranularity never has to be considered within a block
+// Blocks are carved up with a buddy allocator: power-of-two sized nodes that are split on allocation and merged with their buddy on free
+// Requests larger than half a block bypass the pools and get a dedicated allocation
+//
+
+// What a resource is used for; decides which memory types are acceptable
+// All host-visible usages require HOST_COHERENT memory, so mapped pointers never need explicit flushes or invalidations
+enum Gpu_Memory_Usage {
+    GPU_MEMORY_USAGE_DEVICE_LOCAL, // GPU-only resources, prefers DEVICE_LOCAL
+    GPU_MEMORY_USAGE_UPLOAD,       // written once by the CPU and copied by the GPU (staging)
+    GPU_MEMORY_USAGE_DYNAMIC,      // written by the CPU every frame and read by the GPU, prefers DEVICE_LOCAL (resizable BAR)
+    GPU_MEMORY_USAGE_READBACK,     // written by the GPU and read by the CPU, prefers HOST_CACHED
+};
+
+// Device memory entry points used by the allocator, and the buffer and image calls of gpu_create_buffer/gpu_create_image
+// They default to the Vulkan loader; substituting them (along with a hand-written memory type table) runs the allocator without a GPU,
+// see tests/gpu_allocator_tests.h
+struct Gpu_Memory_Functions {
+    PFN_vkAllocateMemory                allocate_memory;
+    PFN_vkFreeMemory                    free_memory;
+    PFN_vkMapMemory                     map_memory;
+    PFN_vkUnmapMemory                   unmap_memory;
+    PFN_vkCreateBuffer                  create_buffer;
+    PFN_vkDestroyBuffer                 destroy_buffer;
+    PFN_vkGetBufferMemoryRequirements   get_buffer_memory_requirements;
+    PFN_vkBindBufferMemory              bind_buffer_memory;
+    PFN_vkCreateImage                   create_image;
+    PFN_vkDestroyImage                  destroy_image;
+    PFN_vkGetImageMemoryRequirements    get_image_memory_requirements;
+    PFN_vkBindImageMemory               bind_image_memory;
+};
+
+struct Gpu_Allocation {
+    VkDeviceMemory memory;
+    VkDeviceSize   offset;
+    VkDeviceSize   size;        // requested size
+    void          *mapped;      // host pointer to `offset` when the memory is host-visible, nullptr otherwise
+    u32            memory_type;
+    u32            pool;        // UINT32_MAX for dedicated allocations
+    u32            block;
+    u32            order;       // buddy order, the allocation occupies min_node_size << order bytes
+};
+
+struct Gpu_Memory_Block {
+    VkDeviceMemory memory;      // VK_NULL_HANDLE marks a free slot that can be reused for the next block
+    void          *mapped;
+    VkDeviceSize   used;
+    u32            allocation_count;
+    std::vector<std::set<VkDeviceSize>> free_nodes; // offsets of free nodes, indexed by order; ordered so the lowest address is handed out first
+};
+
+struct Gpu_Memory_Pool {
+    std::vector<Gpu_Memory_Block> blocks;
+};
+
+struct Gpu_Allocator_Stats {
+    u32          device_allocation_count; // live vkAllocateMemory allocations (blocks + dedicated)
+    u32          block_count;
+    u32          dedicated_count;
+    u64          allocation_count;        // live sub-allocations
+    VkDeviceSize bytes_reserved;          // device memory held by the allocator
+    VkDeviceSize bytes_used;              // bytes handed out, including rounding to buddy node sizes
+    VkDeviceSize bytes_requested;         // bytes asked for
+    VkDeviceSize largest_free_node;
+    f64          internal_fragmentation;  // share of used bytes lost to rounding
+    f64          external_fragmentation;  // share of free bytes outside the largest free node of their block
+};
+
+struct Gpu_Allocator {
+    VkDevice                         device;
+    VkPhysicalDeviceMemoryProperties mem_props;
+    Gpu_Memory_Functions             functions;
+    VkDeviceSize                     block_size;
+    VkDeviceSize                     min_node_size;
+    u32                              max_order;
+    Gpu_Memory_Pool                  pools[VK_MAX_MEMORY_TYPES * 2];
+
+    u32                              dedicated_count;
+    VkDeviceSize                     dedicated_bytes;
+    u64                              allocation_count;
+    VkDeviceSize                     bytes_requested;
+};
+
+// Default entry points, for the real device
+Gpu_Memory_Functions gpu_memory_functions_vulkan()
+{
+    Gpu_Memory_Functions functions = {};
+    functions.allocate_memory                = vkAllocateMemory;
+    functions.free_memory                    = vkFreeMemory;
+    functions.map_memory                     = vkMapMemory;
+    functions.unmap_memory                   = vkUnmapMemory;
+    functions.create_buffer                  = vkCreateBuffer;
+    functions.destroy_buffer                 = vkDestroyBuffer;
+    functions.get_buffer_memory_requirements = vkGetBufferMemoryRequirements;
+    functions.bind_buffer_memory             = vkBindBufferMemory;
+    functions.create_image                   = vkCreateImage;
+    functions.destroy_image                  = vkDestroyImage;
+    functions.get_image_memory_requirements  = vkGetImageMemoryRequirements;
+    functions.bind_image_memory              = vkBindImageMemory;
+    return functions;
+}
+
+// block_size must be a power of two multiple of min_node_size; 0 picks 64 MiB, or less on devices with small heaps
+void gpu_allocator_init(Gpu_Allocator &allocator, VkDevice device, VkPhysicalDeviceMemoryProperties &mem_props, Gpu_Memory_Functions functions, VkDeviceSize block_size = 0, VkDeviceSize min_node_size = 256)
+{
+    allocator = {};
+    allocator.device        = device;
+    allocator.mem_props     = mem_props;
+    allocator.functions     = functions;
+    allocator.min_node_size = min_node_size;
+
+    if (block_size == 0)
+    {
+        // no block should take more than an eighth of the smallest heap
+        VkDeviceSize smallest_heap = UINT64_MAX;
+        for (u32 i = 0; i < mem_props.memoryHeapCount; i++) smallest_heap = std::min(smallest_heap, mem_props.memoryHeaps[i].size);
+        block_size = 64ull << 20;
+        while (block_size > min_node_size && block_size > smallest_heap / 8) block_size >>= 1;
+    }
+    allocator.block_size = block_size;
+    while ((min_node_size << allocator.max_order) < block_size) allocator.max_order++;
+}
+
+// Find a memory type allowed by `type_bits` with all `required` flags, preferring one that also has the `preferred` flags
+// Returns -1 if there is none; `skip_type_bits` excludes types that already failed to allocate
+i32 gpu_find_memory_type(VkPhysicalDeviceMemoryProperties &mem_props, u32 type_bits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, u32 skip_type_bits = 0)
+{
+    i32 fallback = -1;
+    for (u32 i = 0; i < mem_props.memoryTypeCount; i++)
+    {
+        if (!(type_bits & (1u << i)) || (skip_type_bits & (1u << i))) continue;
+
+        VkMemoryPropertyFlags flags = mem_props.memoryTypes[i].propertyFlags;
+        if ((flags & required) != required) continue;
+        if ((flags & preferred) == preferred) return i;
+        if (fallback < 0) fallback = i;
+    }
+    return fallback;
+}
+
+void gpu_memory_usage_flags(Gpu_Memory_Usage usage, VkMemoryPropertyFlags &required, VkMemoryPropertyFlags &preferred)
+{
+    switch (usage)
+    {
+        case GPU_MEMORY_USAGE_DEVICE_LOCAL:
+            required  = 0;
+            preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            break;
+        case GPU_MEMORY_USAGE_UPLOAD:
+            required  = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            preferred = 0;
+            break;
+        case GPU_MEMORY_USAGE_DYNAMIC:
+            required  = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            break;
+        case GPU_MEMORY_USAGE_READBACK:
+            required  = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            break;
+    }
+}
+
+// BUDDY BLOCKS
+
+VkResult gpu_allocate_device_memory(Gpu_Allocator &allocator, VkDeviceSize size, u32 memory_type, VkDeviceMemory &memory, void *&mapped)
+{
+    VkMemoryAllocateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    info.allocationSize  = size;
+    info.memoryTypeIndex = memory_type;
+
+    VkResult vr = allocator.functions.allocate_memory(allocator.device, &info, nullptr, &memory);
+    if (vr != VK_SUCCESS) return vr;
+
+    // host-visible memory stays mapped for its whole lifetime
+    mapped = nullptr;
+    if (allocator.mem_props.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        vr = allocator.functions.map_memory(allocator.device, memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+        if (vr != VK_SUCCESS)
+        {
+            allocator.functions.free_memory(allocator.device, memory, nullptr);
+            return vr;
+        }
+    }
+    return VK_SUCCESS;
+}
+
+void gpu_free_device_memory(Gpu_Allocator &allocator, VkDeviceMemory memory, void *mapped)
+{
+    if (mapped) allocator.functions.unmap_memory(allocator.device, memory);
+    allocator.functions.free_memory(allocator.device, memory, nullptr);
+}
+
+// Take a free node of `order` from the block, splitting a larger node if needed; returns false if the block has no room
+bool gpu_block_take_node(Gpu_Allocator &allocator, Gpu_Memory_Block &block, u32 order, VkDeviceSize &offset)
+{
+    u32 available = order;
+    while (available <= allocator.max_order && block.free_nodes[available].empty()) available++;
+    if (available > allocator.max_order) return false;
+
+    offset = *block.free_nodes[available].begin();
+    block.free_nodes[available].erase(block.free_nodes[available].begin());
+
+    // split down to the requested order, returning the upper halves to the free lists
+    while (available > order)
+    {
+        available--;
+        block.free_nodes[available].insert(offset + (allocator.min_node_size << available));
+    }
+    return true;
+}
+
+// Return a node to the block, merging it with its buddy for as long as the buddy is free too
+void gpu_block_return_node(Gpu_Allocator &allocator, Gpu_Memory_Block &block, u32 order, VkDeviceSize offset)
+{
+    while (order < allocator.max_order)
+    {
+        VkDeviceSize buddy = offset ^ (allocator.min_node_size << order);
+        auto found = block.free_nodes[order].find(buddy);
+        if (found == block.free_nodes[order].end()) break;
+
+        block.free_nodes[order].erase(found);
+        offset = std::min(offset, buddy);
+        order++;
+    }
+    block.free_nodes[order].insert(offset);
+}
+
+VkResult gpu_allocate_from_pool(Gpu_Allocator &allocator, u32 pool_index, u32 memory_type, u32 order, Gpu_Allocation &allocation)
+{
+    Gpu_Memory_Pool &pool = allocator.pools[pool_index];
+
+    VkDeviceSize offset = 0;
+    i32 block_index = -1;
+    for (u32 i = 0; i < pool.blocks.size(); i++)
+    {
+        if (pool.blocks[i].memory == VK_NULL_HANDLE) continue;
+        if (gpu_block_take_node(allocator, pool.blocks[i], order, offset)) { block_index = i; break; }
+    }
+
+    // every block is full, so allocate a new one, reusing an empty slot if there is one
+    if (block_index < 0)
+    {
+        Gpu_Memory_Block block = {};
+        VkResult vr = gpu_allocate_device_memory(allocator, allocator.block_size, memory_type, block.memory, block.mapped);
+        if (vr != VK_SUCCESS) return vr;
+        block.free_nodes.resize(allocator.max_order + 1);
+        block.free_nodes[allocator.max_order].insert(0);
+
+        for (u32 i = 0; i < pool.blocks.size(); i++) if (pool.blocks[i].memory == VK_NULL_HANDLE) { block_index = i; break; }
+        if (block_index < 0)
+        {
+            block_index = pool.blocks.size();
+            pool.blocks.push_back({});
+        }
+        pool.blocks[block_index] = std::move(block);
+        gpu_block_take_node(allocator, pool.blocks[block_index], order, offset);
+    }
+
+    Gpu_Memory_Block &block = pool.blocks[block_index];
+    block.used += allocator.min_node_size << order;
+    block.allocation_count++;
+
+    allocation.memory      = block.memory;
+    allocation.offset      = offset;
+    allocation.mapped      = block.mapped ? (u8 *)block.mapped + offset : nullptr;
+    allocation.memory_type = memory_type;
+    allocation.pool        = pool_index;
+    allocation.block       = block_index;
+    allocation.order       = order;
+    return VK_SUCCESS;
+}
+
+// ALLOCATION
+
+// Allocate memory satisfying `requirements`; `optimal_tiling` must be set for images created with VK_IMAGE_TILING_OPTIMAL
+// Falls back to other acceptable memory types when the preferred one is out of memory
+VkResult gpu_allocate(Gpu_Allocator &allocator, VkMemoryRequirements &requirements, Gpu_Memory_Usage usage, bool optimal_tiling, Gpu_Allocation &allocation)
+{
+    allocation = {};
+
+    VkMemoryPropertyFlags required = 0, preferred = 0;
+    gpu_memory_usage_flags(usage, required, preferred);
+
+    // smallest buddy order that fits both the size and the alignment (nodes are aligned to their own size)
+    VkDeviceSize node_size = std::max(std::max(requirements.size, requirements.alignment), allocator.min_node_size);
+    u32 order = 0;
+    while ((allocator.min_node_size << order) < node_size) order++;
+    bool dedicated = (allocator.min_node_size << order) > allocator.block_size / 2;
+
+    VkResult vr = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    u32 failed_types = 0;
+    for (;;)
+    {
+        i32 memory_type = gpu_find_memory_type(allocator.mem_props, requirements.memoryTypeBits, required, preferred, failed_types);
+        if (memory_type < 0) return vr;
+
+        if (dedicated)
+        {
+            vr = gpu_allocate_device_memory(allocator, requirements.size, memory_type, allocation.memory, allocation.mapped);
+            if (vr == VK_SUCCESS)
+            {
+                allocation.memory_type = memory_type;
+                allocation.pool        = UINT32_MAX;
+                allocator.dedicated_count++;
+                allocator.dedicated_bytes += requirements.size;
+            }
+        }
+        else
+        {
+            vr = gpu_allocate_from_pool(allocator, memory_type * 2 + (optimal_tiling ? 1 : 0), memory_type, order, allocation);
+        }
+
+        if (vr == VK_SUCCESS) break;
+        if (vr != VK_ERROR_OUT_OF_DEVICE_MEMORY && vr != VK_ERROR_OUT_OF_HOST_MEMORY) return vr;
+        failed_types |= 1u << memory_type;
+    }
+
+    allocation.size = requirements.size;
+    allocator.allocation_count++;
+    allocator.bytes_requested += requirements.size;
+    return VK_SUCCESS;
+}
+
+void gpu_free(Gpu_Allocator &allocator, Gpu_Allocation &allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE) return;
+
+    allocator.allocation_count--;
+    allocator.bytes_requested -= allocation.size;
+
+    if (allocation.pool == UINT32_MAX)
+    {
+        gpu_free_device_memory(allocator, allocation.memory, allocation.mapped);
+        allocator.dedicated_count--;
+        allocator.dedicated_bytes -= allocation.size;
+        allocation = {};
+        return;
+    }
+
+    Gpu_Memory_Pool  &pool  = allocator.pools[allocation.pool];
+    Gpu_Memory_Block &block = pool.blocks[allocation.block];
+    gpu_block_return_node(allocator, block, allocation.order, allocation.offset);
+    block.used -= allocator.min_node_size << allocation.order;
+    block.allocation_count--;
+
+    // release empty blocks back to the driver, but keep one per pool around to avoid thrashing vkAllocateMemory
+    if (block.allocation_count == 0)
+    {
+        u32 empty_blocks = 0;
+        for (auto &other : pool.blocks) if (other.memory != VK_NULL_HANDLE && other.allocation_count == 0) empty_blocks++;
+        if (empty_blocks > 1)
+        {
+            gpu_free_device_memory(allocator, block.memory, block.mapped);
+            block = {};
+        }
+    }
+    allocation = {};
+}
+
+VkResult gpu_create_buffer(Gpu_Allocator &allocator, VkBufferCreateInfo &info, Gpu_Memory_Usage usage, VkBuffer &buffer, Gpu_Allocation &allocation)
+{
+    VkResult vr = allocator.functions.create_buffer(allocator.device, &info, nullptr, &buffer);
+    if (vr != VK_SUCCESS) return vr;
+
+    VkMemoryRequirements requirements = {};
+    allocator.functions.get_buffer_memory_requirements(allocator.device, buffer, &requirements);
+
+    vr = gpu_allocate(allocator, requirements, usage, false, allocation);
+    if (vr == VK_SUCCESS) vr = allocator.functions.bind_buffer_memory(allocator.device, buffer, allocation.memory, allocation.offset);
+    if (vr != VK_SUCCESS)
+    {
+        gpu_free(allocator, allocation);
+        allocator.functions.destroy_buffer(allocator.device, buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
+    }
+    return vr;
+}
+
+VkResult gpu_create_image(Gpu_Allocator &allocator, VkImageCreateInfo &info, Gpu_Memory_Usage usage, VkImage &image, Gpu_Allocation &allocation)
+{
+    VkResult vr = allocator.functions.create_image(allocator.device, &info, nullptr, &image);
+    if (vr != VK_SUCCESS) return vr;
+
+    VkMemoryRequirements requirements = {};
+    allocator.functions.get_image_memory_requirements(allocator.device, image, &requirements);
+
+    vr = gpu_allocate(allocator, requirements, usage, info.tiling == VK_IMAGE_TILING_OPTIMAL, allocation);
+    if (vr == VK_SUCCESS) vr = allocator.functions.bind_image_memory(allocator.device, image, allocation.memory, allocation.offset);
+    if (vr != VK_SUCCESS)
+    {
+        gpu_free(allocator, allocation);
+        allocator.functions.destroy_image(allocator.device, image, nullptr);
+        image = VK_NULL_HANDLE;
+    }
+    return vr;
+}
+
+void gpu_destroy_buffer(Gpu_Allocator &allocator, VkBuffer &buffer, Gpu_Allocation &allocation)
+{
+    allocator.functions.destroy_buffer(allocator.device, buffer, nullptr);
+    gpu_free(allocator, allocation);
+    buffer = VK_NULL_HANDLE;
+}
+
+void gpu_destroy_image(Gpu_Allocator &allocator, VkImage &image, Gpu_Allocation &allocation)
+{
+    allocator.functions.destroy_image(allocator.device, image, nullptr);
+    gpu_free(allocator, allocation);
+    image = VK_NULL_HANDLE;
+}
+
+// Frees every block; all allocations must have been released
+void gpu_allocator_destroy(Gpu_Allocator &allocator)
+{
+    for (auto &pool : allocator.pools)
+    {
+        for (auto &block : pool.blocks)
+        {
+            if (block.memory != VK_NULL_HANDLE) gpu_free_device_memory(allocator, block.memory, block.mapped);
+        }
+        pool.blocks.clear();
+    }
+}
+
+// STATS
+
+Gpu_Allocator_Stats gpu_allocator_stats(Gpu_Allocator &allocator)
+{
+    Gpu_Allocator_Stats stats = {};
+    stats.dedicated_count  = allocator.dedicated_count;
+    stats.allocation_count = allocator.allocation_count;
+    stats.bytes_requested  = allocator.bytes_requested;
+    stats.bytes_reserved   = allocator.dedicated_bytes;
+    stats.bytes_used       = allocator.dedicated_bytes;
+
+    VkDeviceSize bytes_free = 0;
+    VkDeviceSize largest_free_per_block = 0;
+    for (auto &pool : allocator.pools)
+    {
+        for (auto &block : pool.blocks)
+        {
+            if (block.memory == VK_NULL_HANDLE) continue;
+            stats.block_count++;
+            stats.bytes_reserved += allocator.block_size;
+            stats.bytes_used     += block.used;
+            bytes_free           += allocator.block_size - block.used;
+
+            for (u32 order = allocator.max_order + 1; order-- > 0;)
+            {
+                if (block.free_nodes[order].empty()) continue;
+                stats.largest_free_node = std::max(stats.largest_free_node, allocator.min_node_size << order);
+                largest_free_per_block += allocator.min_node_size << order;
+                break;
+            }
+        }
+    }
+    stats.device_allocation_count = stats.block_count + stats.dedicated_count;
+    stats.internal_fragmentation  = stats.bytes_used > 0 ? 1.0 - (f64)stats.bytes_requested / stats.bytes_used : 0.0;
+    stats.external_fragmentation  = bytes_free > 0 ? 1.0 - (f64)largest_free_per_block / bytes_free : 0.0;
+    return stats;
+}
+
+void gpu_allocator_log_stats(Gpu_Allocator &allocator)
+{
+    Gpu_Allocator_Stats stats = gpu_allocator_stats(allocator);
+    printf("GPU memory: %u device allocations (%u blocks, %u dedicated), %llu sub-allocations\n",
+           stats.device_allocation_count, stats.block_count, stats.dedicated_count, (unsigned long long)stats.allocation_count);
+    printf("            %.2f MiB reserved, %.2f MiB used, %.2f MiB requested, fragmentation %.1f%% internal / %.1f%% external\n",
+           stats.bytes_reserved / 1048576.0, stats.bytes_used / 1048576.0, stats.bytes_requested / 1048576.0,
+           stats.internal_fragmentation * 100.0, stats.external_fragmentation * 100.0);
+}
+
+//
+// PER-FRAME LINEAR RING
+// A persistently mapped buffer split into one region per frame in flight; transient per-frame data (uniforms, dynamic vertices)
+// is bump-allocated from the current frame's region, which is reset wholesale once that frame's fence has signalled
+//
+
+struct Gpu_Ring_Slice {
+    VkBuffer     buffer;  // VK_NULL_HANDLE when the frame's region is exhausted
+    VkDeviceSize offset;
+    void        *mapped;
+};
+
+struct Gpu_Linear_Ring {
+    VkBuffer       buffer;
+    Gpu_Allocation allocation;
+    VkDeviceSize   frame_size;
+    u32            frame_count;
+    u32            frame;
+    VkDeviceSize   head;       // offset into the current frame's region
+    VkDeviceSize   high_water; // most bytes used by any frame, for sizing
+};
+
+VkResult gpu_ring_create(Gpu_Allocator &allocator, Gpu_Linear_Ring &ring, VkDeviceSize frame_size, u32 frame_count, VkBufferUsageFlags usage)
+{
+    // regions start on 256 byte boundaries, the largest offset alignment the spec allows for uniform/storage buffers
+    ring = {};
+    ring.frame_size  = (frame_size + 255) & ~VkDeviceSize(255);
+    ring.frame_count = frame_count;
+
+    VkBufferCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    info.size = ring.frame_size * frame_count;
+    info.usage = usage;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    return gpu_create_buffer(allocator, info, GPU_MEMORY_USAGE_DYNAMIC, ring.buffer, ring.allocation);
+}
+
+void gpu_ring_destroy(Gpu_Allocator &allocator, Gpu_Linear_Ring &ring)
+{
+    gpu_destroy_buffer(allocator, ring.buffer, ring.allocation);
+}
+
+// Must only be called once the GPU has finished the frame that last used this region
+void gpu_ring_begin_frame(Gpu_Linear_Ring &ring, u64 frame_number)
+{
+    ring.frame = frame_number % ring.frame_count;
+    ring.head  = 0;
+}
+
+// `alignment` must be a power of two
+Gpu_Ring_Slice gpu_ring_allocate(Gpu_Linear_Ring &ring, VkDeviceSize size, VkDeviceSize alignment)
+{
+    Gpu_Ring_Slice slice = {};
+    VkDeviceSize offset = (ring.head + alignment - 1) & ~(alignment - 1);
+    if (offset + size > ring.frame_size) return slice;
+
+    ring.head       = offset + size;
+    ring.high_water = std::max(ring.high_water, ring.head);
+
+    slice.buffer = ring.buffer;
+    slice.offset = ring.frame * ring.frame_size + offset;
+    slice.mapped = (u8 *)ring.allocation.mapped + slice.offset;
+    return slice;
+}
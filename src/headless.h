@@ -0,0 +1,147 @@
+#pragma once
+
+#include <vector>
+
+#include "common.h"
+#include "gpu_allocator.h"
+#include "pipeline_cache.h"
+
+//
+// HEADLESS RENDER TARGETS
+// `--headless` renders into device-local images instead of a swapchain, one per frame in flight, and copies every frame into a
+// host-visible readback buffer. Readbacks are hashed in frame order once the frame's fence has signalled, so the checksum of a run
+// only depends on what was rendered, which makes runs on a software driver such as lavapipe reproducible
+//
+
+#define HEADLESS_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+
+struct Headless_Target {
+    VkExtent2D                  extent;
+    std::vector<VkImage>        images;
+    std::vector<Gpu_Allocation> image_allocations;
+    std::vector<VkImageView>    image_views;
+    std::vector<VkFramebuffer>  framebuffers;
+    std::vector<VkBuffer>       readback_buffers;
+    std::vector<Gpu_Allocation> readback_allocations;
+    std::vector<bool>           pending;         // a copy was recorded into this slot's readback buffer and not hashed yet
+
+    u64                         checksum;        // hash_bytes over every frame's pixels, in frame order
+    u64                         frames_read;
+};
+
+// `render_pass` must be compatible with the render pass the frames are drawn with; with dynamic rendering there is none and
+// the framebuffers stay VK_NULL_HANDLE
+void headless_target_create(Headless_Target &target, Gpu_Allocator &allocator, VkDevice device, VkRenderPass render_pass, VkExtent2D extent, u32 count)
+{
+    VkResult vr = VK_SUCCESS;
+
+    target = {};
+    target.extent = extent;
+    target.checksum = hash_bytes(nullptr, 0);
+    target.images.resize(count);
+    target.image_allocations.resize(count);
+    target.image_views.resize(count);
+    target.framebuffers.resize(count);
+    target.readback_buffers.resize(count);
+    target.readback_allocations.resize(count);
+    target.pending.resize(count);
+
+    for (u32 i = 0; i < count; i++)
+    {
+        VkImageCreateInfo image_info = {};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = HEADLESS_FORMAT;
+        image_info.extent = { extent.width, extent.height, 1 };
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        vr = gpu_create_image(allocator, image_info, GPU_MEMORY_USAGE_DEVICE_LOCAL, target.images[i], target.image_allocations[i]);
+        CHECK_RESULT(vr);
+
+        VkImageViewCreateInfo view_info = {};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = target.images[i];
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = HEADLESS_FORMAT;
+        view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        view_info.subresourceRange.levelCount = 1;
+        view_info.subresourceRange.layerCount = 1;
+        vr = vkCreateImageView(device, &view_info, nullptr, &target.image_views[i]);
+        CHECK_RESULT(vr);
+
+        if (render_pass != VK_NULL_HANDLE)
+        {
+            VkFramebufferCreateInfo framebuffer_info = {};
+            framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebuffer_info.renderPass = render_pass;
+            framebuffer_info.attachmentCount = 1;
+            framebuffer_info.pAttachments = &target.image_views[i];
+            framebuffer_info.width = extent.width;
+            framebuffer_info.height = extent.height;
+            framebuffer_info.layers = 1;
+            vr = vkCreateFramebuffer(device, &framebuffer_info, nullptr, &target.framebuffers[i]);
+            CHECK_RESULT(vr);
+        }
+
+        VkBufferCreateInfo buffer_info = {};
+        buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        buffer_info.size = (VkDeviceSize)extent.width * extent.height * 4;
+        buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        vr = gpu_create_buffer(allocator, buffer_info, GPU_MEMORY_USAGE_READBACK, target.readback_buffers[i], target.readback_allocations[i]);
+        CHECK_RESULT(vr);
+    }
+}
+
+void headless_target_destroy(Headless_Target &target, Gpu_Allocator &allocator, VkDevice device)
+{
+    for (usize i = 0; i < target.images.size(); i++)
+    {
+        gpu_destroy_buffer(allocator, target.readback_buffers[i], target.readback_allocations[i]);
+        vkDestroyFramebuffer(device, target.framebuffers[i], nullptr);
+        vkDestroyImageView(device, target.image_views[i], nullptr);
+        gpu_destroy_image(allocator, target.images[i], target.image_allocations[i]);
+    }
+    target = {};
+}
+
+// Record the copy of slot `index`'s image into its readback buffer
+// The image must be in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL and the copy must be made visible to the host afterwards; the
+// readback pass of the frame graph declares both, see main.cpp
+void headless_target_record_readback(Headless_Target &target, VkCommandBuffer cmd_buf, u32 index)
+{
+    VkBufferImageCopy region = {};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = { target.extent.width, target.extent.height, 1 };
+    vkCmdCopyImageToBuffer(cmd_buf, target.images[index], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target.readback_buffers[index], 1, &region);
+
+    target.pending[index] = true;
+}
+
+// Hash slot `index`'s readback into the checksum; the frame that last used the slot must have completed
+void headless_target_read(Headless_Target &target, u32 index)
+{
+    if (!target.pending[index]) return;
+    target.pending[index] = false;
+
+    // readback memory is host-coherent, see gpu_memory_usage_flags
+    target.checksum = hash_bytes(target.readback_allocations[index].mapped, (usize)target.extent.width * target.extent.height * 4, target.checksum);
+    target.frames_read++;
+}
+
+// Write slot `index`'s readback as a binary PPM, e.g. to inspect a frame whose checksum changed
+bool headless_target_write_ppm(Headless_Target &target, u32 index, const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file) return false;
+
+    fprintf(file, "P6\n%u %u\n255\n", target.extent.width, target.extent.height);
+    const u8 *pixels = (const u8 *)target.readback_allocations[index].mapped;
+    for (usize i = 0; i < (usize)target.extent.width * target.extent.height; i++) fwrite(pixels + i * 4, 1, 3, file);
+    return fclose(file) == 0;
+}
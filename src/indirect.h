@@ -0,0 +1,579 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "common.h"
+#include "compute.h"
+#include "gpu_allocator.h"
+#include "pipelines.h"
+
+//
+// GPU-DRIVEN RENDERING
+// Every object's bounds, color and transform live in one storage buffer. Each frame a compute pass (shaders/cull.comp) tests the
+// bounds against the view frustum and writes a VkDrawIndexedIndirectCommand per visible object, so the CPU records a fixed handful of
+// commands however many objects there are:
+//  - with VK_KHR_draw_indirect_count the visible commands are compacted and one vkCmdDrawIndexedIndirectCount draws exactly those
+//  - otherwise every object keeps its own command, culled ones with instanceCount 0, and one vkCmdDrawIndexedIndirect covers them all
+// Either way the object index travels in firstInstance (which needs drawIndirectFirstInstance) and shaders/object.vert reads the
+// object through gl_InstanceIndex. Without that feature objects are culled on the CPU and drawn one vkCmdDrawIndexed at a time
+//
+// Draw commands and counts are written by the GPU every frame, so there is one set per frame in flight
+//
+
+// Matches Object in shaders/cull.comp and shaders/object.vert
+struct Gpu_Object {
+    f32 bounds[4]; // bounding sphere: world-space center xyz, radius
+    f32 color[4];
+    f32 scale;
+    f32 angle;
+    f32 pad[2];
+};
+
+// Matches Push_Constants in shaders/object.vert
+struct Gpu_Scene_View {
+    f32 center[2]; // world-space point at the center of the screen
+    f32 scale;     // world units to clip space
+    f32 time;
+};
+
+// Matches Push_Constants in shaders/cull.comp
+struct Cull_Push_Constants {
+    f32 planes[6][4];
+    u32 object_count;
+    u32 compact;
+};
+
+static_assert(sizeof(Cull_Push_Constants) <= CAPTURE_MAX_PUSH_CONSTANTS, "the cull pass could no longer be captured");
+
+enum Gpu_Scene_Mode {
+    GPU_SCENE_CPU,            // culled on the CPU, one vkCmdDrawIndexed per visible object
+    GPU_SCENE_INDIRECT,       // culled on the GPU, one vkCmdDrawIndexedIndirect over a command per object
+    GPU_SCENE_INDIRECT_COUNT, // culled and compacted on the GPU, one vkCmdDrawIndexedIndirectCount
+};
+
+const char *gpu_scene_mode_name(Gpu_Scene_Mode mode)
+{
+    switch (mode)
+    {
+        case GPU_SCENE_CPU:            return "cpu";
+        case GPU_SCENE_INDIRECT:       return "indirect";
+        case GPU_SCENE_INDIRECT_COUNT: return "indirect count";
+    }
+    return "";
+}
+
+struct Gpu_Scene {
+    VkDevice                    device;
+    u32                         object_count;
+    std::vector<Gpu_Object>     objects;            // CPU copy, for the CPU path
+    VkBuffer                    object_buffer;
+    Gpu_Allocation              object_allocation;
+    VkBuffer                    index_buffer;       // the triangle's three indices
+    Gpu_Allocation              index_allocation;
+
+    std::vector<VkBuffer>       commands;           // [frame]: object_count VkDrawIndexedIndirectCommands
+    std::vector<Gpu_Allocation> command_allocations;
+    std::vector<VkBuffer>       counts;             // [frame]: number of commands written when compacting
+    std::vector<Gpu_Allocation> count_allocations;
+
+    Compute_Pipeline            cull;
+    VkDescriptorPool            descriptor_pool;
+    std::vector<VkDescriptorSet> cull_sets;         // [frame]
+    VkDescriptorSetLayout       object_set_layout;
+    VkDescriptorSet             object_set;
+    VkPipelineLayout            layout;
+    VkPipeline                  pipeline;
+
+    bool                        first_instance;     // drawIndirectFirstInstance, without it only GPU_SCENE_CPU works
+    bool                        multi_draw;         // multiDrawIndirect, otherwise every indirect command is drawn by its own call
+    u32                         max_draw_count;     // maxDrawIndirectCount
+    PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count; // nullptr without VK_KHR_draw_indirect_count
+};
+
+// `count` objects on a square grid of unit cells centered on the origin, spinning at different phases
+void gpu_scene_fill_grid(std::vector<Gpu_Object> &objects, u32 count)
+{
+    u32 side = std::max(1u, (u32)std::ceil(std::sqrt((f64)count)));
+    objects.resize(count);
+    for (u32 i = 0; i < count; i++)
+    {
+        Gpu_Object &object = objects[i];
+        object = {};
+        object.scale = 0.5f;
+        object.bounds[0] = (i % side) + 0.5f - side * 0.5f;
+        object.bounds[1] = (i / side) + 0.5f - side * 0.5f;
+        object.bounds[3] = object.scale * 0.7072f; // the farthest vertex of the triangle in shaders/object.vert is sqrt(0.5) away
+        object.color[0] = 0.5f + 0.5f * std::sin(i * 0.37f);
+        object.color[1] = 1.0f;
+        object.color[2] = 0.5f + 0.5f * std::cos(i * 0.11f);
+        object.color[3] = 1.0f;
+        object.angle = i * 0.1f;
+    }
+}
+
+// A view that shows half of a grid made by gpu_scene_fill_grid in each direction, panning around its center over time
+Gpu_Scene_View gpu_scene_grid_view(u32 count, f32 time)
+{
+    f32 side = std::max(1.0f, std::ceil(std::sqrt((f32)count)));
+    Gpu_Scene_View view = {};
+    view.center[0] = side * 0.25f * std::sin(time * 0.3f);
+    view.center[1] = side * 0.25f * std::cos(time * 0.3f);
+    view.scale = 4.0f / side;
+    view.time = time;
+    return view;
+}
+
+// The view's frustum as planes that are positive inside; the scene is flat, so near and far only bound z to [-1, 1]
+void gpu_scene_frustum(const Gpu_Scene_View &view, f32 planes[6][4])
+{
+    f32 half = 1.0f / view.scale;
+    const f32 frustum[6][4] = {
+        {  1,  0,  0, -(view.center[0] - half) },
+        { -1,  0,  0,   view.center[0] + half  },
+        {  0,  1,  0, -(view.center[1] - half) },
+        {  0, -1,  0,   view.center[1] + half  },
+        {  0,  0,  1,   1 },
+        {  0,  0, -1,   1 },
+    };
+    memcpy(planes, frustum, sizeof(frustum));
+}
+
+// The same test as shaders/cull.comp
+bool gpu_scene_is_visible(const f32 planes[6][4], const f32 bounds[4])
+{
+    for (u32 i = 0; i < 6; i++)
+    {
+        if (planes[i][0] * bounds[0] + planes[i][1] * bounds[1] + planes[i][2] * bounds[2] + planes[i][3] < -bounds[3]) return false;
+    }
+    return true;
+}
+
+// `render_pass` is the pass the objects are drawn in, or VK_NULL_HANDLE with the `rendering_format` of dynamic rendering
+// The object buffer is written through its mapping, so it is in host-visible memory
+void gpu_scene_create(Gpu_Scene &scene, Device_Context &ctx, VkPipelineCache pipeline_cache, Shader_Module_Cache &modules, VkRenderPass render_pass,
+                      const std::vector<Gpu_Object> &objects, u32 frame_count, VkFormat rendering_format = VK_FORMAT_UNDEFINED)
+{
+    VkResult vr = VK_SUCCESS;
+
+    scene = {};
+    scene.device = ctx.device;
+    scene.object_count = objects.size();
+    scene.objects = objects;
+    scene.first_instance = ctx.enabled_features.drawIndirectFirstInstance;
+    scene.multi_draw = ctx.enabled_features.multiDrawIndirect;
+    scene.max_draw_count = scene.multi_draw ? ctx.props.limits.maxDrawIndirectCount : 1;
+    if (ctx.draw_indirect_count) scene.draw_indexed_indirect_count = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(ctx.device, "vkCmdDrawIndexedIndirectCountKHR");
+
+    VkBufferCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    info.size = std::max<VkDeviceSize>(1, objects.size()) * sizeof(Gpu_Object);
+    info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    vr = gpu_create_buffer(*ctx.allocator, info, GPU_MEMORY_USAGE_DYNAMIC, scene.object_buffer, scene.object_allocation);
+    CHECK_RESULT(vr);
+    memcpy(scene.object_allocation.mapped, objects.data(), objects.size() * sizeof(Gpu_Object));
+
+    const u16 indices[3] = { 0, 1, 2 };
+    info.size = sizeof(indices);
+    info.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    vr = gpu_create_buffer(*ctx.allocator, info, GPU_MEMORY_USAGE_DYNAMIC, scene.index_buffer, scene.index_allocation);
+    CHECK_RESULT(vr);
+    memcpy(scene.index_allocation.mapped, indices, sizeof(indices));
+
+    // counts are host-visible so the number of visible objects can be reported
+    scene.commands.resize(frame_count);
+    scene.command_allocations.resize(frame_count);
+    scene.counts.resize(frame_count);
+    scene.count_allocations.resize(frame_count);
+    for (u32 f = 0; f < frame_count; f++)
+    {
+        info.size = std::max<VkDeviceSize>(1, objects.size()) * sizeof(VkDrawIndexedIndirectCommand);
+        info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+        vr = gpu_create_buffer(*ctx.allocator, info, GPU_MEMORY_USAGE_DEVICE_LOCAL, scene.commands[f], scene.command_allocations[f]);
+        CHECK_RESULT(vr);
+
+        info.size = sizeof(u32);
+        info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        vr = gpu_create_buffer(*ctx.allocator, info, GPU_MEMORY_USAGE_READBACK, scene.counts[f], scene.count_allocations[f]);
+        CHECK_RESULT(vr);
+    }
+
+    // culling: objects, commands and count of each frame
+    scene.cull = compute_pipeline_create(ctx.device, pipeline_cache, modules, SHADER_DIR "cull.comp.spv", 3, sizeof(Cull_Push_Constants), compute_local_size(ctx, 64));
+    scene.descriptor_pool = compute_descriptor_pool_create(ctx.device, frame_count + 1);
+    scene.cull_sets.resize(frame_count);
+    for (u32 f = 0; f < frame_count; f++)
+    {
+        VkDescriptorBufferInfo buffers[3] = {
+            { scene.object_buffer, 0, VK_WHOLE_SIZE },
+            { scene.commands[f],   0, VK_WHOLE_SIZE },
+            { scene.counts[f],     0, VK_WHOLE_SIZE },
+        };
+        scene.cull_sets[f] = compute_descriptor_set_create(ctx.device, scene.descriptor_pool, scene.cull, buffers);
+    }
+
+    // drawing: the object buffer in the vertex shader, the view in push constants
+    VkDescriptorSetLayoutBinding binding = {};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutCreateInfo set_layout_info = {};
+    set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    set_layout_info.bindingCount = 1;
+    set_layout_info.pBindings = &binding;
+    vr = vkCreateDescriptorSetLayout(ctx.device, &set_layout_info, nullptr, &scene.object_set_layout);
+    CHECK_RESULT(vr);
+
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = scene.descriptor_pool;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &scene.object_set_layout;
+    vr = vkAllocateDescriptorSets(ctx.device, &alloc_info, &scene.object_set);
+    CHECK_RESULT(vr);
+
+    VkDescriptorBufferInfo object_info = { scene.object_buffer, 0, VK_WHOLE_SIZE };
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = scene.object_set;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &object_info;
+    vkUpdateDescriptorSets(ctx.device, 1, &write, 0, nullptr);
+
+    VkPushConstantRange push_range = {};
+    push_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    push_range.size = sizeof(Gpu_Scene_View);
+
+    VkPipelineLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &scene.object_set_layout;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_range;
+    vr = vkCreatePipelineLayout(ctx.device, &layout_info, nullptr, &scene.layout);
+    CHECK_RESULT(vr);
+
+    scene.pipeline = create_triangle_pipeline(ctx.device, pipeline_cache, modules, render_pass, scene.layout, 0, SHADER_DIR "object.vert.spv", nullptr, rendering_format);
+}
+
+void gpu_scene_destroy(Gpu_Scene &scene, Gpu_Allocator &allocator)
+{
+    vkDestroyPipeline(scene.device, scene.pipeline, nullptr);
+    vkDestroyPipelineLayout(scene.device, scene.layout, nullptr);
+    vkDestroyDescriptorSetLayout(scene.device, scene.object_set_layout, nullptr);
+    vkDestroyDescriptorPool(scene.device, scene.descriptor_pool, nullptr);
+    compute_pipeline_destroy(scene.device, scene.cull);
+    for (usize f = 0; f < scene.commands.size(); f++)
+    {
+        gpu_destroy_buffer(allocator, scene.counts[f], scene.count_allocations[f]);
+        gpu_destroy_buffer(allocator, scene.commands[f], scene.command_allocations[f]);
+    }
+    gpu_destroy_buffer(allocator, scene.index_buffer, scene.index_allocation);
+    gpu_destroy_buffer(allocator, scene.object_buffer, scene.object_allocation);
+    scene = {};
+}
+
+// The best mode the device supports; indirect count needs every object to fit in one call
+Gpu_Scene_Mode gpu_scene_best_mode(Gpu_Scene &scene)
+{
+    if (!scene.first_instance) return GPU_SCENE_CPU;
+    if (scene.draw_indexed_indirect_count && scene.multi_draw && scene.object_count <= scene.max_draw_count) return GPU_SCENE_INDIRECT_COUNT;
+    return GPU_SCENE_INDIRECT;
+}
+
+// Record the culling dispatch of frame `frame_index` for the indirect modes, outside of a render pass
+// Writes the frame's commands and count from compute shaders; the draws must wait for them at VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
+// The dispatch is also appended to `capture` when there is one; the indirect draws are not captured, see src/capture_format.h
+void gpu_scene_record_cull(Gpu_Scene &scene, VkCommandBuffer cmd_buf, u32 frame_index, const Gpu_Scene_View &view, Gpu_Scene_Mode mode,
+                           Command_Capture *capture = nullptr)
+{
+    if (mode == GPU_SCENE_CPU || scene.object_count == 0) return;
+
+    Cull_Push_Constants push_constants = {};
+    gpu_scene_frustum(view, push_constants.planes);
+    push_constants.object_count = scene.object_count;
+    push_constants.compact = mode == GPU_SCENE_INDIRECT_COUNT;
+
+    // the count is only appended to when compacting; the last use of this frame's buffers finished with the frame's fence
+    if (push_constants.compact)
+    {
+        vkCmdFillBuffer(cmd_buf, scene.counts[frame_index], 0, sizeof(u32), 0);
+        compute_barrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    }
+    compute_dispatch(cmd_buf, scene.cull, scene.cull_sets[frame_index], &push_constants, compute_group_count(scene.object_count, scene.cull.local_size_x));
+
+    capture_pipeline(capture, CAPTURE_PIPELINE_CULL);
+    capture_push_constants(capture, &push_constants, sizeof(push_constants));
+    capture_dispatch(capture, compute_group_count(scene.object_count, scene.cull.local_size_x), 1, 1);
+}
+
+// Record the draws of frame `frame_index` inside a render pass compatible with the one the scene was created for
+// Returns the number of draw calls recorded
+u32 gpu_scene_record_draws(Gpu_Scene &scene, VkCommandBuffer cmd_buf, u32 frame_index, VkExtent2D extent, const Gpu_Scene_View &view, Gpu_Scene_Mode mode)
+{
+    VkViewport viewport = {};
+    viewport.width = (f32)extent.width;
+    viewport.height = (f32)extent.height;
+    viewport.maxDepth = 1.0f;
+    VkRect2D scissor = {};
+    scissor.extent = extent;
+
+    vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, scene.pipeline);
+    vkCmdSetViewport(cmd_buf, 0, 1, &viewport);
+    vkCmdSetScissor(cmd_buf, 0, 1, &scissor);
+    vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, scene.layout, 0, 1, &scene.object_set, 0, nullptr);
+    vkCmdPushConstants(cmd_buf, scene.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(view), &view);
+    vkCmdBindIndexBuffer(cmd_buf, scene.index_buffer, 0, VK_INDEX_TYPE_UINT16);
+
+    const u32 stride = sizeof(VkDrawIndexedIndirectCommand);
+    u32 calls = 0;
+    switch (mode)
+    {
+        case GPU_SCENE_CPU:
+        {
+            f32 planes[6][4];
+            gpu_scene_frustum(view, planes);
+            for (u32 i = 0; i < scene.object_count; i++)
+            {
+                if (!gpu_scene_is_visible(planes, scene.objects[i].bounds)) continue;
+                vkCmdDrawIndexed(cmd_buf, 3, 1, 0, 0, i);
+                calls++;
+            }
+            break;
+        }
+        case GPU_SCENE_INDIRECT:
+        {
+            // as few calls as maxDrawIndirectCount allows, which is one per object without multiDrawIndirect
+            for (u32 first = 0; first < scene.object_count; first += scene.max_draw_count)
+            {
+                vkCmdDrawIndexedIndirect(cmd_buf, scene.commands[frame_index], (VkDeviceSize)first * stride, std::min(scene.max_draw_count, scene.object_count - first), stride);
+                calls++;
+            }
+            break;
+        }
+        case GPU_SCENE_INDIRECT_COUNT:
+        {
+            scene.draw_indexed_indirect_count(cmd_buf, scene.commands[frame_index], 0, scene.counts[frame_index], 0, scene.object_count, stride);
+            calls++;
+            break;
+        }
+    }
+    return calls;
+}
+
+// Make the frame's count available to the host, recorded after the draws (outside of a render pass) of every frame whose count
+// is read back with gpu_scene_visible_count; the fence wait alone does not make device writes visible to the host
+void gpu_scene_record_count_readback(VkCommandBuffer cmd_buf, Gpu_Scene_Mode mode)
+{
+    if (mode != GPU_SCENE_INDIRECT_COUNT) return;
+    compute_barrier(cmd_buf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+}
+
+// Objects that survived culling in frame `frame_index`, once the frame has completed; only counted when compacting, and the frame
+// must have recorded gpu_scene_record_count_readback
+u32 gpu_scene_visible_count(Gpu_Scene &scene, u32 frame_index)
+{
+    // readback memory is host-coherent, see gpu_memory_usage_flags
+    return *(const u32 *)scene.count_allocations[frame_index].mapped;
+}
+
+//
+// BENCHMARK
+// CPU culling with one draw per object against GPU culling with indirect draws at 10k, 100k and 1M objects, `--bench indirect`
+// The view shows about a quarter of the objects. Recording is timed on its own, and each frame is submitted and waited for, so
+// "frame" includes the GPU (for lavapipe, CPU threads) executing the cull and the draws
+//
+
+void indirect_benchmark(Device_Context &ctx)
+{
+    const u32        object_counts[] = { 10000, 100000, 1000000 };
+    const u32        frame_count     = 10;
+    const VkExtent2D extent          = { 512, 512 };
+
+    VkResult vr = VK_SUCCESS;
+
+    VkRenderPass        render_pass = create_present_render_pass(ctx.device, VK_FORMAT_B8G8R8A8_UNORM, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    Shader_Module_Cache modules     = {};
+
+    VkImage        image = {};
+    Gpu_Allocation image_allocation = {};
+    VkImageView    image_view = {};
+    VkFramebuffer  framebuffer = {};
+    {
+        VkImageCreateInfo image_info = {};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = VK_FORMAT_B8G8R8A8_UNORM;
+        image_info.extent = { extent.width, extent.height, 1 };
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        vr = gpu_create_image(*ctx.allocator, image_info, GPU_MEMORY_USAGE_DEVICE_LOCAL, image, image_allocation);
+        CHECK_RESULT(vr);
+
+        VkImageViewCreateInfo view_info = {};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = image_info.format;
+        view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        view_info.subresourceRange.levelCount = 1;
+        view_info.subresourceRange.layerCount = 1;
+        vr = vkCreateImageView(ctx.device, &view_info, nullptr, &image_view);
+        CHECK_RESULT(vr);
+
+        VkFramebufferCreateInfo framebuffer_info = {};
+        framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebuffer_info.renderPass = render_pass;
+        framebuffer_info.attachmentCount = 1;
+        framebuffer_info.pAttachments = &image_view;
+        framebuffer_info.width = extent.width;
+        framebuffer_info.height = extent.height;
+        framebuffer_info.layers = 1;
+        vr = vkCreateFramebuffer(ctx.device, &framebuffer_info, nullptr, &framebuffer);
+        CHECK_RESULT(vr);
+    }
+
+    VkCommandPool   cmd_pool = {};
+    VkCommandBuffer cmd_buf = {};
+    VkFence         fence = {};
+    {
+        VkCommandPoolCreateInfo pool_info = {};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        pool_info.queueFamilyIndex = ctx.graphics_family;
+        vr = vkCreateCommandPool(ctx.device, &pool_info, nullptr, &cmd_pool);
+        CHECK_RESULT(vr);
+
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandPool = cmd_pool;
+        alloc_info.commandBufferCount = 1;
+        vr = vkAllocateCommandBuffers(ctx.device, &alloc_info, &cmd_buf);
+        CHECK_RESULT(vr);
+
+        VkFenceCreateInfo fence_info = {};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        vr = vkCreateFence(ctx.device, &fence_info, nullptr, &fence);
+        CHECK_RESULT(vr);
+    }
+
+    std::cout << std::endl << "Indirect benchmark: " << frame_count << " frames per mode at " << extent.width << "x" << extent.height;
+    std::cout << (ctx.enabled_features.multiDrawIndirect ? ", multi-draw indirect" : ", no multi-draw indirect") << (ctx.draw_indirect_count ? ", draw indirect count" : "") << std::endl;
+    if (!ctx.enabled_features.drawIndirectFirstInstance) std::cout << "  drawIndirectFirstInstance is not supported, only the CPU path can run" << std::endl;
+
+    std::vector<Gpu_Object> objects = {};
+    for (u32 object_count : object_counts)
+    {
+        gpu_scene_fill_grid(objects, object_count);
+        Gpu_Scene scene = {};
+        gpu_scene_create(scene, ctx, VK_NULL_HANDLE, modules, render_pass, objects, 1);
+
+        // the reference count of visible objects for the fixed view
+        Gpu_Scene_View view = gpu_scene_grid_view(object_count, 0.0f);
+        f32 planes[6][4];
+        gpu_scene_frustum(view, planes);
+        u32 expected_visible = 0;
+        for (auto &object : objects) expected_visible += gpu_scene_is_visible(planes, object.bounds);
+
+        printf("  %u objects, %u visible\n", object_count, expected_visible);
+
+        f64 cpu_frame_ms = 0.0;
+        for (Gpu_Scene_Mode mode : { GPU_SCENE_CPU, GPU_SCENE_INDIRECT, GPU_SCENE_INDIRECT_COUNT })
+        {
+            if (mode != GPU_SCENE_CPU && !scene.first_instance) continue;
+            if (mode == GPU_SCENE_INDIRECT_COUNT && gpu_scene_best_mode(scene) != GPU_SCENE_INDIRECT_COUNT) continue;
+
+            f64 record_seconds = 0.0, frame_seconds = 0.0;
+            u32 calls = 0;
+            for (u32 frame = 0; frame <= frame_count; frame++)
+            {
+                view.time = frame * 0.01f;
+                vr = vkResetCommandPool(ctx.device, cmd_pool, 0);
+                CHECK_RESULT(vr);
+
+                auto start = std::chrono::steady_clock::now();
+
+                VkCommandBufferBeginInfo begin_info = {};
+                begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                vr = vkBeginCommandBuffer(cmd_buf, &begin_info);
+                CHECK_RESULT(vr);
+
+                gpu_scene_record_cull(scene, cmd_buf, 0, view, mode);
+                if (mode != GPU_SCENE_CPU)
+                {
+                    compute_barrier(cmd_buf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+                }
+
+                VkClearValue clear_value = {};
+                VkRenderPassBeginInfo render_pass_begin_info = {};
+                render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                render_pass_begin_info.renderPass = render_pass;
+                render_pass_begin_info.framebuffer = framebuffer;
+                render_pass_begin_info.renderArea.extent = extent;
+                render_pass_begin_info.clearValueCount = 1;
+                render_pass_begin_info.pClearValues = &clear_value;
+                vkCmdBeginRenderPass(cmd_buf, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+                calls = gpu_scene_record_draws(scene, cmd_buf, 0, extent, view, mode);
+                vkCmdEndRenderPass(cmd_buf);
+                gpu_scene_record_count_readback(cmd_buf, mode);
+
+                vr = vkEndCommandBuffer(cmd_buf);
+                CHECK_RESULT(vr);
+                auto recorded = std::chrono::steady_clock::now();
+
+                VkSubmitInfo submit_info = {};
+                submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submit_info.commandBufferCount = 1;
+                submit_info.pCommandBuffers = &cmd_buf;
+                vr = vkResetFences(ctx.device, 1, &fence);
+                CHECK_RESULT(vr);
+                vr = vkQueueSubmit(ctx.graphics_queue, 1, &submit_info, fence);
+                CHECK_RESULT(vr);
+                vr = vkWaitForFences(ctx.device, 1, &fence, VK_TRUE, UINT64_MAX);
+                CHECK_RESULT(vr);
+
+                // the first frame warms up the pipeline and the driver
+                if (frame == 0) continue;
+                record_seconds += std::chrono::duration<f64>(recorded - start).count();
+                frame_seconds  += std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+            }
+
+            f64 frame_ms = frame_seconds * 1000.0 / frame_count;
+            if (mode == GPU_SCENE_CPU) cpu_frame_ms = frame_ms;
+            printf("    %-15s %8.3f ms record  %8.3f ms/frame  %5.2fx  %7u calls", gpu_scene_mode_name(mode), record_seconds * 1000.0 / frame_count, frame_ms, cpu_frame_ms / frame_ms, calls);
+            if (mode == GPU_SCENE_INDIRECT_COUNT)
+            {
+                u32 visible = gpu_scene_visible_count(scene, 0);
+                if (visible == expected_visible) printf("  %u drawn", visible);
+                else printf("  MISMATCH: %u drawn", visible);
+            }
+            printf("\n");
+        }
+
+        gpu_scene_destroy(scene, *ctx.allocator);
+    }
+
+    vr = vkDeviceWaitIdle(ctx.device);
+    CHECK_RESULT(vr);
+    vkDestroyFence(ctx.device, fence, nullptr);
+    vkDestroyCommandPool(ctx.device, cmd_pool, nullptr);
+    vkDestroyFramebuffer(ctx.device, framebuffer, nullptr);
+    vkDestroyImageView(ctx.device, image_view, nullptr);
+    gpu_destroy_image(*ctx.allocator, image, image_allocation);
+    shader_module_cache_destroy(ctx.device, modules);
+    vkDestroyRenderPass(ctx.device, render_pass, nullptr);
+}
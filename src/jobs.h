@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+
+//
+// JOB SYSTEM
+// A fixed pool of worker threads that run parallel-for style batches; the calling thread takes part as thread 0
+// Thread indices are stable for the lifetime of the job system, so callers can keep per-thread resources (e.g. command pools) indexed by them
+// An exception thrown by a task (e.g. a Vulkan_Error) cancels the items not started yet and is rethrown on the calling thread
+//
+
+struct Job_System {
+    std::vector<std::thread>      workers;
+    std::mutex                    mutex;
+    std::condition_variable       work_ready;
+    std::condition_variable       work_done;
+
+    // the current batch; only changed while no worker is running it
+    std::function<void(u32, u32)> task;         // (thread_index, item_index)
+    u32                           item_count;
+    std::atomic<u32>              next_item;
+    u32                           pending_workers; // workers that have not finished the current batch
+    u64                           generation;      // incremented for every batch
+    std::exception_ptr            error;           // the first exception a task of the current batch threw
+    bool                          quit;
+
+    ~Job_System();
+};
+
+u32 job_system_thread_count(Job_System &jobs)
+{
+    return jobs.workers.size() + 1;
+}
+
+void job_system_run_items(Job_System &jobs, u32 thread_index)
+{
+    for (u32 item = jobs.next_item++; item < jobs.item_count; item = jobs.next_item++)
+    {
+        try { jobs.task(thread_index, item); }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(jobs.mutex);
+            if (!jobs.error) jobs.error = std::current_exception();
+            jobs.next_item = jobs.item_count;
+        }
+    }
+}
+
+void job_system_worker(Job_System *jobs, u32 thread_index)
+{
+    u64 seen_generation = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(jobs->mutex);
+            jobs->work_ready.wait(lock, [&]() { return jobs->quit || jobs->generation != seen_generation; });
+            if (jobs->quit) return;
+            seen_generation = jobs->generation;
+        }
+
+        job_system_run_items(*jobs, thread_index);
+
+        std::lock_guard<std::mutex> lock(jobs->mutex);
+        if (--jobs->pending_workers == 0) jobs->work_done.notify_one();
+    }
+}
+
+// `thread_count` includes the calling thread, so 1 runs every batch inline
+void job_system_init(Job_System &jobs, u32 thread_count)
+{
+    jobs.item_count = 0;
+    jobs.next_item = 0;
+    jobs.pending_workers = 0;
+    jobs.generation = 0;
+    jobs.quit = false;
+    for (u32 i = 1; i < std::max(thread_count, 1u); i++) jobs.workers.emplace_back(job_system_worker, &jobs, i);
+}
+
+void job_system_destroy(Job_System &jobs)
+{
+    {
+        std::lock_guard<std::mutex> lock(jobs.mutex);
+        jobs.quit = true;
+    }
+    jobs.work_ready.notify_all();
+    for (auto &worker : jobs.workers) worker.join();
+    jobs.workers.clear();
+}
+
+// An exception unwinding past a job system that was never destroyed must not leave joinable workers behind
+Job_System::~Job_System()
+{
+    job_system_destroy(*this);
+}
+
+// Run task(thread_index, item) for every item in [0, item_count) across all threads and return once every item has completed
+// Items are handed out one at a time, so uneven items balance themselves
+void job_system_parallel_for(Job_System &jobs, u32 item_count, std::function<void(u32, u32)> task)
+{
+    if (jobs.workers.size() == 0)
+    {
+        for (u32 item = 0; item < item_count; item++) task(0, item);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(jobs.mutex);
+        jobs.task = std::move(task);
+        jobs.item_count = item_count;
+        jobs.next_item = 0;
+        jobs.pending_workers = jobs.workers.size();
+        jobs.generation++;
+    }
+    jobs.work_ready.notify_all();
+
+    job_system_run_items(jobs, 0);
+
+    // workers must also be done reading `task` before the next batch may replace it
+    std::unique_lock<std::mutex> lock(jobs.mutex);
+    jobs.work_done.wait(lock, [&]() { return jobs.pending_workers == 0; });
+    if (jobs.error)
+    {
+        std::exception_ptr error = jobs.error;
+        jobs.error = nullptr;
+        lock.unlock();
+        std::rethrow_exception(error);
+    }
+}
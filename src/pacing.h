@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "common.h"
+#include "profiler.h"
+
+//
+// FRAME PACING
+// The pacer hands out a start time for every frame, `1 / fps` apart, and the main loop spends the time until then blocked in
+// SDL_WaitEventTimeout, so input is handled the moment it arrives instead of once per frame and an idle loop costs no CPU
+// At 0 fps frames are not paced; the swapchain's present mode (FIFO blocks in acquire) is then the only limit
+//
+
+typedef std::chrono::steady_clock Pacer_Clock;
+
+struct Frame_Pacer {
+    f64                     interval;        // seconds between frame starts, 0 is uncapped
+    Pacer_Clock::time_point next_frame;      // when the next frame is due
+    Pacer_Clock::time_point last_frame;
+    u64                     frames;
+    u64                     late_frames;     // frames that started a whole interval after they were due; the schedule restarts from them
+    std::vector<f64>        frame_intervals; // ms between consecutive frame starts
+};
+
+void frame_pacer_init(Frame_Pacer &pacer, f64 fps)
+{
+    pacer = {};
+    pacer.interval = fps > 0.0 ? 1.0 / fps : 0.0;
+    pacer.next_frame = Pacer_Clock::now();
+}
+
+// Seconds until the next frame is due, 0 once it is
+f64 frame_pacer_remaining(Frame_Pacer &pacer)
+{
+    if (pacer.interval == 0.0) return 0.0;
+    return std::max(0.0, std::chrono::duration<f64>(pacer.next_frame - Pacer_Clock::now()).count());
+}
+
+// Sleep until the next frame is due; the main loop only gets here with less than a millisecond left, or headless, where there are
+// no events to wait on
+void frame_pacer_sleep(Frame_Pacer &pacer)
+{
+    if (pacer.interval == 0.0) return;
+    std::this_thread::sleep_until(pacer.next_frame);
+}
+
+// Mark the start of a frame and schedule the next one
+// Frames are due on a fixed grid so that a short frame makes up for a long one; a frame more than an interval late moves the grid
+// instead, otherwise the frames after a stall would be rendered back to back to catch up
+void frame_pacer_begin_frame(Frame_Pacer &pacer)
+{
+    Pacer_Clock::time_point now = Pacer_Clock::now();
+    if (pacer.frames > 0) pacer.frame_intervals.push_back(std::chrono::duration<f64, std::milli>(now - pacer.last_frame).count());
+    pacer.last_frame = now;
+    pacer.frames++;
+
+    if (pacer.interval == 0.0) return;
+    auto interval = std::chrono::duration_cast<Pacer_Clock::duration>(std::chrono::duration<f64>(pacer.interval));
+    pacer.next_frame += interval;
+    if (pacer.next_frame < now)
+    {
+        pacer.next_frame = now + interval;
+        pacer.late_frames++;
+    }
+}
+
+void frame_pacer_print_summary(Frame_Pacer &pacer)
+{
+    if (pacer.frame_intervals.size() == 0) return;
+    f64 average = 0.0, variance = 0.0;
+    for (f64 interval : pacer.frame_intervals) average += interval / pacer.frame_intervals.size();
+    for (f64 interval : pacer.frame_intervals) variance += (interval - average) * (interval - average) / pacer.frame_intervals.size();
+
+    if (pacer.interval > 0.0) printf("Pacing: target %.3f ms, %llu late frames | ", pacer.interval * 1000.0, (unsigned long long)pacer.late_frames);
+    else                      printf("Pacing: uncapped | ");
+    printf("frame interval avg %.3f stddev %.3f p99 %.3f max %.3f ms\n", average, std::sqrt(variance), percentile(pacer.frame_intervals, 0.99),
+           *std::max_element(pacer.frame_intervals.begin(), pacer.frame_intervals.end()));
+}
+
+//
+// CPU USAGE AND INPUT LATENCY
+//
+
+// User + system CPU time of the whole process (every thread) in seconds
+f64 process_cpu_seconds()
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) return 0.0;
+    u64 kernel_ticks = ((u64)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+    u64 user_ticks   = ((u64)user.dwHighDateTime << 32)   | user.dwLowDateTime;
+    return (kernel_ticks + user_ticks) * 1e-7;
+#else
+    struct rusage usage = {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+// Input-to-present latency: the time from an input event's timestamp until the first frame that handled it was queued for
+// presentation. Events are timestamped by SDL when they are queued, so the time an event waited for the loop to get to it counts too
+// The display's scanout comes on top and is not visible to Vulkan 1.0; under SDL's offscreen or dummy video driver there is none
+struct Input_Latency {
+    std::vector<u32> pending;  // timestamps (SDL ticks, ms) of the events handled since the last present
+    std::vector<f64> samples;  // ms
+};
+
+void input_latency_record_event(Input_Latency &latency, u32 timestamp)
+{
+    latency.pending.push_back(timestamp);
+}
+
+// `now` is the current SDL tick count, taken right after the frame that handled the pending events was presented
+void input_latency_frame_presented(Input_Latency &latency, u32 now)
+{
+    for (u32 timestamp : latency.pending) latency.samples.push_back((f64)(now - timestamp));
+    latency.pending.clear();
+}
+
+void input_latency_print_summary(Input_Latency &latency)
+{
+    if (latency.samples.size() == 0)
+    {
+        printf("Input to present: no input events\n");
+        return;
+    }
+    f64 average = 0.0, worst = 0.0;
+    for (f64 sample : latency.samples) { average += sample / latency.samples.size(); worst = std::max(worst, sample); }
+    printf("Input to present over %zu events: avg %.1f p95 %.1f max %.1f ms (1 ms resolution)\n", latency.samples.size(), average, percentile(latency.samples, 0.95), worst);
+}
+
+// The thread that pushes synthetic input events for latency measurements, see main
+// It is stopped and joined when it goes out of scope too, so an error unwinding the frame loop cannot leave it joinable
+struct Input_Probe {
+    std::atomic<bool> quit;
+    std::thread       thread;
+
+    ~Input_Probe();
+};
+
+void input_probe_stop(Input_Probe &probe)
+{
+    if (!probe.thread.joinable()) return;
+    probe.quit = true;
+    probe.thread.join();
+}
+
+Input_Probe::~Input_Probe()
+{
+    input_probe_stop(*this);
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
+
+//
+// PIPELINE AND SHADER MODULE CACHES
+// The VkPipelineCache is loaded from disk at startup and written back at shutdown, so pipelines compiled in a previous run are not compiled again
+// Shader modules are cached by a hash of their SPIR-V, so pipelines that share a shader share one VkShaderModule
+//
+
+// Read a whole file; returns false if it cannot be opened or read
+bool read_file(const char *path, std::vector<u8> &data)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    data.resize(size > 0 ? size : 0);
+    bool ok = size >= 0 && fread(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+    return ok;
+}
+
+// Write a whole file through a temporary file, so a crash while writing never leaves a truncated file behind
+bool write_file(const char *path, const void *data, usize size)
+{
+    char temp_path[1024];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    FILE *file = fopen(temp_path, "wb");
+    if (!file) return false;
+    bool ok = fwrite(data, 1, size, file) == size;
+    ok = fclose(file) == 0 && ok;
+
+    // rename does not replace an existing file on Windows
+    remove(path);
+    ok = ok && rename(temp_path, path) == 0;
+    if (!ok) remove(temp_path);
+    return ok;
+}
+
+// 64-bit FNV-1a
+u64 hash_bytes(const void *data, usize size, u64 hash = 0xcbf29ce484222325ull)
+{
+    const u8 *bytes = (const u8 *)data;
+    for (usize i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    return hash;
+}
+
+struct Pipeline_Cache {
+    VkPipelineCache handle;
+    usize           loaded_bytes; // size of the data the cache was created from, 0 when it started empty
+};
+
+// Check the cache header against the device, see "Pipeline Cache Header" in the spec
+// Drivers are supposed to ignore incompatible data themselves, but not all of them do so gracefully
+bool pipeline_cache_data_is_compatible(const std::vector<u8> &data, const VkPhysicalDeviceProperties &props)
+{
+    VkPipelineCacheHeaderVersionOne header = {};
+    if (data.size() < sizeof(header)) return false;
+    memcpy(&header, data.data(), sizeof(header));
+
+    return header.headerSize >= sizeof(header)
+        && header.headerSize <= data.size()
+        && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && header.vendorID == props.vendorID
+        && header.deviceID == props.deviceID
+        && memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+// Create the pipeline cache from `data`, the contents of the file at `path` read ahead of time (e.g. while the device was being
+// created, see src/startup.h), or empty if it was written by another device or driver
+VkResult pipeline_cache_create_from_data(VkDevice device, const VkPhysicalDeviceProperties &props, const char *path, std::vector<u8> &data, Pipeline_Cache &cache)
+{
+    cache = {};
+
+    if (data.size() > 0 && !pipeline_cache_data_is_compatible(data, props))
+    {
+        printf("Pipeline cache %s was created by a different device or driver, starting empty\n", path);
+        data.clear();
+    }
+
+    VkPipelineCacheCreateInfo cache_info = {};
+    cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cache_info.initialDataSize = data.size();
+    cache_info.pInitialData = data.data();
+
+    VkResult vr = vkCreatePipelineCache(device, &cache_info, nullptr, &cache.handle);
+    if (vr == VK_SUCCESS) cache.loaded_bytes = data.size();
+    return vr;
+}
+
+// Create the pipeline cache from the file at `path`, or empty if there is no file or it was written by another device or driver
+// `path` may be nullptr for a cache that only lives as long as the process
+VkResult pipeline_cache_create(VkDevice device, const VkPhysicalDeviceProperties &props, const char *path, Pipeline_Cache &cache)
+{
+    std::vector<u8> data = {};
+    if (path && !read_file(path, data)) data.clear();
+    return pipeline_cache_create_from_data(device, props, path, data, cache);
+}
+
+// Write the cache contents to `path`; failing to write is reported but not fatal
+// A cache created without a file (`path` is nullptr) is not written anywhere
+VkResult pipeline_cache_save(VkDevice device, Pipeline_Cache &cache, const char *path)
+{
+    if (!path) return VK_SUCCESS;
+
+    usize size = 0;
+    VkResult vr = vkGetPipelineCacheData(device, cache.handle, &size, nullptr);
+    if (vr != VK_SUCCESS) return vr;
+
+    std::vector<u8> data(size);
+    vr = vkGetPipelineCacheData(device, cache.handle, &size, data.data());
+    if (vr != VK_SUCCESS) return vr;
+
+    if (!write_file(path, data.data(), size)) printf("Failed to write pipeline cache %s\n", path);
+    return VK_SUCCESS;
+}
+
+void pipeline_cache_destroy(VkDevice device, Pipeline_Cache &cache)
+{
+    vkDestroyPipelineCache(device, cache.handle, nullptr);
+    cache = {};
+}
+
+struct Shader_Module_Entry {
+    std::vector<u8> code; // compared on a hash hit, so colliding shaders get modules of their own
+    VkShaderModule  module;
+};
+
+struct Shader_Module_Cache {
+    std::unordered_multimap<u64, Shader_Module_Entry> modules; // keyed by hash_bytes of the SPIR-V
+    std::unordered_map<std::string, std::vector<u8>> preloaded; // SPIR-V files read ahead of time by path, used up by shader_module_load
+    u64 hits;
+    u64 misses;
+};
+
+// Return the module for `code`, creating it on first use
+VkResult shader_module_get(VkDevice device, Shader_Module_Cache &cache, const std::vector<u8> &code, VkShaderModule &module)
+{
+    u64 size = code.size();
+    u64 key  = hash_bytes(code.data(), code.size(), hash_bytes(&size, sizeof(size)));
+
+    auto range = cache.modules.equal_range(key);
+    for (auto found = range.first; found != range.second; found++)
+    {
+        if (found->second.code != code) continue;
+        cache.hits++;
+        module = found->second.module;
+        return VK_SUCCESS;
+    }
+
+    VkShaderModuleCreateInfo module_info = {};
+    module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    module_info.codeSize = code.size();
+    module_info.pCode = (const u32 *)code.data();
+
+    VkResult vr = vkCreateShaderModule(device, &module_info, nullptr, &module);
+    if (vr != VK_SUCCESS) return vr;
+
+    cache.misses++;
+    cache.modules.insert({ key, { code, module } });
+    return VK_SUCCESS;
+}
+
+// Load a compiled shader from disk and return its module
+// A missing or malformed file throws VK_ERROR_INITIALIZATION_FAILED, since nothing can be drawn without it; the session tears down
+// what it created and run_device_sessions turns the error into the exit code
+VkShaderModule shader_module_load(VkDevice device, Shader_Module_Cache &cache, const char *path)
+{
+    std::vector<u8> code = {};
+    auto found = cache.preloaded.find(path);
+    if (found != cache.preloaded.end())
+    {
+        code = std::move(found->second);
+        cache.preloaded.erase(found);
+    }
+    else if (!read_file(path, code)) code.clear();
+
+    if (code.size() == 0 || code.size() % 4 != 0)
+    {
+        printf("Failed to read shader %s, see build.sh for how shaders are compiled\n", path);
+        throw Vulkan_Error{ VK_ERROR_INITIALIZATION_FAILED, __FILE__, __LINE__ };
+    }
+
+    VkShaderModule module = {};
+    VkResult vr = shader_module_get(device, cache, code, module);
+    CHECK_RESULT(vr);
+    return module;
+}
+
+void shader_module_cache_destroy(VkDevice device, Shader_Module_Cache &cache)
+{
+    for (auto &entry : cache.modules) vkDestroyShaderModule(device, entry.second.module, nullptr);
+    cache = {};
+}
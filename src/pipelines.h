@@ -0,0 +1,323 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "common.h"
+#include "capture_format.h"
+#include "pipeline_cache.h"
+
+//
+// RENDER PASSES AND GRAPHICS PIPELINES
+// Compiled shaders are read from SHADER_DIR at runtime, see build.sh
+//
+
+#ifndef SHADER_DIR
+#define SHADER_DIR "shaders/"
+#endif
+
+// Matches Push_Constants in shaders/triangle.vert
+struct Triangle_Push_Constants {
+    f32 color[4];
+    f32 offset[2];
+    f32 scale;
+    f32 angle;
+};
+
+static_assert(sizeof(Triangle_Push_Constants) == CAPTURE_TRIANGLE_PUSH_CONSTANTS, "Triangle_Push_Constants changed, bump CAPTURE_VERSION");
+
+// One color attachment that is cleared on load and handed to the presentation engine afterwards
+// Offscreen targets pass a different `final_layout`; render passes that only differ in layouts are compatible, so they can share pipelines
+VkRenderPass create_present_render_pass(VkDevice device, VkFormat format, VkImageLayout final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)
+{
+    VkAttachmentDescription color_attachment = {};
+    color_attachment.format = format;
+    color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; // the previous contents are cleared anyway
+    color_attachment.finalLayout = final_layout;
+
+    VkAttachmentReference color_reference = {};
+    color_reference.attachment = 0;
+    color_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &color_reference;
+
+    // the layout transition must wait for the image-acquired semaphore, which the submission waits on at COLOR_ATTACHMENT_OUTPUT
+    VkSubpassDependency acquire_dependency = {};
+    acquire_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    acquire_dependency.dstSubpass = 0;
+    acquire_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    acquire_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    acquire_dependency.srcAccessMask = 0;
+    acquire_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    VkRenderPassCreateInfo render_pass_info = {};
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    render_pass_info.attachmentCount = 1;
+    render_pass_info.pAttachments = &color_attachment;
+    render_pass_info.subpassCount = 1;
+    render_pass_info.pSubpasses = &subpass;
+    render_pass_info.dependencyCount = 1;
+    render_pass_info.pDependencies = &acquire_dependency;
+
+    VkRenderPass render_pass = {};
+    VkResult vr = vkCreateRenderPass(device, &render_pass_info, nullptr, &render_pass);
+    CHECK_RESULT(vr);
+    return render_pass;
+}
+
+// A render pass for a color attachment that a render graph keeps in VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL around it
+// The transitions in and out of the pass and their synchronisation come from the graph's barriers, see src/render_graph.h
+VkRenderPass create_color_render_pass(VkDevice device, VkFormat format)
+{
+    VkAttachmentDescription color_attachment = {};
+    color_attachment.format = format;
+    color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    color_attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference color_reference = {};
+    color_reference.attachment = 0;
+    color_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &color_reference;
+
+    VkRenderPassCreateInfo render_pass_info = {};
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    render_pass_info.attachmentCount = 1;
+    render_pass_info.pAttachments = &color_attachment;
+    render_pass_info.subpassCount = 1;
+    render_pass_info.pSubpasses = &subpass;
+
+    VkRenderPass render_pass = {};
+    VkResult vr = vkCreateRenderPass(device, &render_pass_info, nullptr, &render_pass);
+    CHECK_RESULT(vr);
+    return render_pass;
+}
+
+VkPipelineLayout create_triangle_pipeline_layout(VkDevice device)
+{
+    VkPushConstantRange push_range = {};
+    push_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    push_range.offset = 0;
+    push_range.size = sizeof(Triangle_Push_Constants);
+
+    VkPipelineLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_range;
+
+    VkPipelineLayout layout = {};
+    VkResult vr = vkCreatePipelineLayout(device, &layout_info, nullptr, &layout);
+    CHECK_RESULT(vr);
+    return layout;
+}
+
+// The triangle drawn by the render loop; `variant` feeds the fragment shader's specialization constant
+// Viewport and scissor are dynamic so the pipeline survives swapchain recreation
+// `vertex_shader` replaces triangle.vert, e.g. with object.vert for the GPU-driven path; `layout` must match it
+// `vertex_input_state` describes the vertex buffers of shaders that read any, e.g. instance.vert of the batch renderer
+// Without a render pass the pipeline is drawn with dynamic rendering into a single color attachment of `rendering_format`
+VkPipeline create_triangle_pipeline(VkDevice device, VkPipelineCache pipeline_cache, Shader_Module_Cache &modules, VkRenderPass render_pass, VkPipelineLayout layout, i32 variant = 0,
+                                    const char *vertex_shader = SHADER_DIR "triangle.vert.spv", const VkPipelineVertexInputStateCreateInfo *vertex_input_state = nullptr,
+                                    VkFormat rendering_format = VK_FORMAT_UNDEFINED)
+{
+    VkSpecializationMapEntry variant_entry = {};
+    variant_entry.constantID = 0;
+    variant_entry.offset = 0;
+    variant_entry.size = sizeof(variant);
+
+    VkSpecializationInfo specialization = {};
+    specialization.mapEntryCount = 1;
+    specialization.pMapEntries = &variant_entry;
+    specialization.dataSize = sizeof(variant);
+    specialization.pData = &variant;
+
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = shader_module_load(device, modules, vertex_shader);
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = shader_module_load(device, modules, SHADER_DIR "triangle.frag.spv");
+    stages[1].pName = "main";
+    stages[1].pSpecializationInfo = &specialization;
+
+    VkPipelineVertexInputStateCreateInfo vertex_input = {};
+    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewport_state = {};
+    viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterization = {};
+    rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterization.cullMode = VK_CULL_MODE_NONE;
+    rasterization.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterization.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample = {};
+    multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState blend_attachment = {};
+    blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo color_blend = {};
+    color_blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blend.attachmentCount = 1;
+    color_blend.pAttachments = &blend_attachment;
+
+    VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamic_state = {};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = 2;
+    dynamic_state.pDynamicStates = dynamic_states;
+
+    VkPipelineRenderingCreateInfo rendering_info = {};
+    rendering_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachmentFormats = &rendering_format;
+
+    VkGraphicsPipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    if (render_pass == VK_NULL_HANDLE) pipeline_info.pNext = &rendering_info;
+    pipeline_info.stageCount = 2;
+    pipeline_info.pStages = stages;
+    pipeline_info.pVertexInputState = vertex_input_state ? vertex_input_state : &vertex_input;
+    pipeline_info.pInputAssemblyState = &input_assembly;
+    pipeline_info.pViewportState = &viewport_state;
+    pipeline_info.pRasterizationState = &rasterization;
+    pipeline_info.pMultisampleState = &multisample;
+    pipeline_info.pColorBlendState = &color_blend;
+    pipeline_info.pDynamicState = &dynamic_state;
+    pipeline_info.layout = layout;
+    pipeline_info.renderPass = render_pass;
+    pipeline_info.subpass = 0;
+    pipeline_info.basePipelineIndex = -1;
+
+    VkPipeline pipeline = {};
+    VkResult vr = vkCreateGraphicsPipelines(device, pipeline_cache, 1, &pipeline_info, nullptr, &pipeline);
+    CHECK_RESULT(vr);
+    return pipeline;
+}
+
+// Record draws [first, first + count) of a grid of `total` spinning triangles covering the viewport
+// Binds the pipeline and sets the dynamic state itself, so it can start a secondary command buffer as well as continue a primary one
+// Every command is also appended to `capture` when there is one, see src/capture_format.h
+void record_triangle_grid(VkCommandBuffer cmd_buf, VkPipeline pipeline, VkPipelineLayout layout, VkExtent2D extent, u32 first, u32 count, u32 total, f32 time,
+                          Command_Capture *capture = nullptr)
+{
+    VkViewport viewport = {};
+    viewport.width = (f32)extent.width;
+    viewport.height = (f32)extent.height;
+    viewport.maxDepth = 1.0f;
+    VkRect2D scissor = {};
+    scissor.extent = extent;
+
+    vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdSetViewport(cmd_buf, 0, 1, &viewport);
+    vkCmdSetScissor(cmd_buf, 0, 1, &scissor);
+    capture_pipeline(capture, CAPTURE_PIPELINE_TRIANGLE);
+    capture_viewport(capture);
+
+    u32 side = (u32)std::ceil(std::sqrt((f64)total));
+    f32 cell = 2.0f / side;
+    for (u32 i = first; i < first + count; i++)
+    {
+        Triangle_Push_Constants push_constants = {};
+        push_constants.color[0] = 0.5f + 0.5f * std::sin(time + i * 0.37f);
+        push_constants.color[1] = 1.0f;
+        push_constants.color[2] = 0.5f + 0.5f * std::cos(time + i * 0.11f);
+        push_constants.color[3] = 1.0f;
+        push_constants.offset[0] = -1.0f + cell * ((i % side) + 0.5f);
+        push_constants.offset[1] = -1.0f + cell * ((i / side) + 0.5f);
+        push_constants.scale = cell * 0.5f;
+        push_constants.angle = time + i * 0.1f;
+
+        vkCmdPushConstants(cmd_buf, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push_constants), &push_constants);
+        vkCmdDraw(cmd_buf, 3, 1, 0, 0);
+        capture_push_constants(capture, &push_constants, sizeof(push_constants));
+        capture_draw(capture, 3, 1, 0, 0);
+    }
+}
+
+//
+// BENCHMARK
+// Pipeline creation time with a cold and a warm pipeline cache, `--bench pipeline-cache`
+// Each run builds `variant_count` specializations of the triangle pipeline the way startup would: cache creation, module loading, pipeline compilation
+//
+
+void pipeline_cache_benchmark(Device_Context &ctx, const char *cache_path)
+{
+    const i32 variant_count = 64;
+
+    VkRenderPass     render_pass = create_present_render_pass(ctx.device, VK_FORMAT_B8G8R8A8_UNORM);
+    VkPipelineLayout layout      = create_triangle_pipeline_layout(ctx.device);
+
+    // the benchmark must not clobber the app's own cache
+    char bench_path[1024];
+    snprintf(bench_path, sizeof(bench_path), "%s.bench", cache_path);
+    remove(bench_path);
+
+    std::cout << std::endl << "Pipeline cache benchmark: " << variant_count << " pipeline variants" << std::endl;
+
+    f64 cold_ms = 0.0;
+    for (const char *run : { "cold", "warm" })
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        Pipeline_Cache      cache = {};
+        Shader_Module_Cache modules = {};
+        VkResult vr = pipeline_cache_create(ctx.device, ctx.props, bench_path, cache);
+        CHECK_RESULT(vr);
+
+        std::vector<VkPipeline> pipelines = {};
+        for (i32 variant = 0; variant < variant_count; variant++)
+        {
+            pipelines.push_back(create_triangle_pipeline(ctx.device, cache.handle, modules, render_pass, layout, variant));
+        }
+
+        f64 ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (cold_ms == 0.0) cold_ms = ms;
+
+        printf("  %s: %8.2f ms (%6.3f ms/pipeline), loaded %zu bytes, shader modules created %llu, reused %llu",
+               run, ms, ms / variant_count, cache.loaded_bytes, (unsigned long long)modules.misses, (unsigned long long)modules.hits);
+        if (ms != cold_ms) printf(", %.2fx faster", cold_ms / ms);
+        printf("\n");
+
+        vr = pipeline_cache_save(ctx.device, cache, bench_path);
+        CHECK_RESULT(vr);
+
+        for (auto &pipeline : pipelines) vkDestroyPipeline(ctx.device, pipeline, nullptr);
+        shader_module_cache_destroy(ctx.device, modules);
+        pipeline_cache_destroy(ctx.device, cache);
+    }
+
+    remove(bench_path);
+    vkDestroyPipelineLayout(ctx.device, layout, nullptr);
+    vkDestroyRenderPass(ctx.device, render_pass, nullptr);
+}
@@ -0,0 +1,345 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "common.h"
+
+//
+// GPU PROFILER
+// Named timestamp regions and one pipeline statistics query per frame, plus CPU frame timing of the main loop
+//
+// Every frame in flight owns its own query pools. Results are read back when the frame's slot comes around again, after its fence
+// has been waited on, so they are always available and reading them never stalls; they arrive frames_in_flight frames late
+// Resolved frames go to an optional trace file (CSV, or JSON when the path ends in .json) and to a rolling avg/p95/p99 summary on the console
+//
+
+#define GPU_PROFILER_MAX_REGIONS 64
+
+// Statistics gathered per frame; pipeline_statistics_names matches the order results are written in, i.e. ascending bit order
+#define GPU_PROFILER_STATISTICS (VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT | VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT)
+const char *pipeline_statistics_names[] = { "input_vertices", "input_primitives", "vertex_shader_invocations", "clipping_primitives", "fragment_shader_invocations", "compute_shader_invocations" };
+#define GPU_PROFILER_STATISTICS_COUNT (sizeof(pipeline_statistics_names) / sizeof(*pipeline_statistics_names))
+
+struct Gpu_Profiler_Region {
+    const char *name;        // must outlive the frame, e.g. a string literal
+    u32         depth;
+    u32         begin_query;
+    u32         end_query;
+};
+
+struct Gpu_Profiler_Frame {
+    VkQueryPool                      timestamps;
+    VkQueryPool                      statistics;
+    std::vector<Gpu_Profiler_Region> regions;    // regions[0] is the whole frame
+    std::vector<u32>                 open;       // stack of regions that have not ended yet, UINT32_MAX for dropped regions
+    u32                              query_count;
+    u64                              frame_number;
+    bool                             pending;    // recorded and submitted, not yet resolved
+    std::chrono::steady_clock::time_point cpu_start;
+    f64                              cpu_ms;     // main loop iteration time, filled in once the next frame begins
+};
+
+struct Gpu_Profiler {
+    VkDevice                        device;
+    f64                             timestamp_period_ns;
+    u64                             timestamp_mask;
+    bool                            timestamps;
+    bool                            statistics;
+    std::vector<Gpu_Profiler_Frame> frames;
+    u32                             current;      // slot of the frame being recorded
+    u64                             last_frame_number;
+
+    FILE                           *trace;
+    bool                            trace_json;
+    u64                             traced_frames;
+
+    // rolling window for the console summary
+    std::vector<f64>                cpu_history;
+    std::vector<f64>                gpu_history;
+    usize                           history_head;
+    u32                             summary_interval; // resolved frames between summaries
+    u32                             since_summary;
+};
+
+// `timestamp_valid_bits` comes from the queue family the frames are submitted to; 0 means it cannot write timestamps
+// `statistics` must only be set when the pipelineStatisticsQuery feature has been enabled
+// `trace_path` may be nullptr
+void gpu_profiler_init(Gpu_Profiler &profiler, Device_Context &ctx, u32 timestamp_valid_bits, bool statistics, u32 frame_count, const char *trace_path)
+{
+    VkResult vr = VK_SUCCESS;
+
+    profiler = {};
+    profiler.device = ctx.device;
+    profiler.timestamp_period_ns = ctx.props.limits.timestampPeriod;
+    profiler.timestamp_mask = timestamp_valid_bits >= 64 ? UINT64_MAX : (1ull << timestamp_valid_bits) - 1;
+    profiler.timestamps = timestamp_valid_bits > 0;
+    profiler.statistics = statistics;
+    profiler.summary_interval = 240;
+    profiler.cpu_history.resize(profiler.summary_interval);
+    profiler.gpu_history.resize(profiler.summary_interval);
+
+    if (!profiler.timestamps) printf("Profiler: the graphics queue does not support timestamps, only CPU times are reported\n");
+
+    profiler.frames.resize(frame_count);
+    for (auto &frame : profiler.frames)
+    {
+        if (profiler.timestamps)
+        {
+            VkQueryPoolCreateInfo pool_info = {};
+            pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            pool_info.queryCount = GPU_PROFILER_MAX_REGIONS * 2;
+            vr = vkCreateQueryPool(profiler.device, &pool_info, nullptr, &frame.timestamps);
+            CHECK_RESULT(vr);
+        }
+        if (profiler.statistics)
+        {
+            VkQueryPoolCreateInfo pool_info = {};
+            pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            pool_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            pool_info.queryCount = 1;
+            pool_info.pipelineStatistics = GPU_PROFILER_STATISTICS;
+            vr = vkCreateQueryPool(profiler.device, &pool_info, nullptr, &frame.statistics);
+            CHECK_RESULT(vr);
+        }
+        frame.regions.reserve(GPU_PROFILER_MAX_REGIONS);
+    }
+
+    if (trace_path)
+    {
+        usize length = strlen(trace_path);
+        profiler.trace_json = length >= 5 && strcmp(trace_path + length - 5, ".json") == 0;
+        profiler.trace = fopen(trace_path, "w");
+        if (!profiler.trace) printf("Profiler: failed to open trace file %s\n", trace_path);
+        else if (profiler.trace_json) fprintf(profiler.trace, "[\n");
+        else fprintf(profiler.trace, "frame,name,depth,value\n");
+    }
+}
+
+f64 percentile(std::vector<f64> values, f64 p)
+{
+    if (values.size() == 0) return 0.0;
+    usize index = std::min(values.size() - 1, (usize)(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+void gpu_profiler_print_summary(Gpu_Profiler &profiler, usize count)
+{
+    std::vector<f64> cpu(profiler.cpu_history.begin(), profiler.cpu_history.begin() + count);
+    std::vector<f64> gpu(profiler.gpu_history.begin(), profiler.gpu_history.begin() + count);
+    f64 cpu_avg = 0.0, gpu_avg = 0.0;
+    for (usize i = 0; i < count; i++) { cpu_avg += cpu[i] / count; gpu_avg += gpu[i] / count; }
+
+    printf("Frame time over %zu frames: CPU avg %.3f p95 %.3f p99 %.3f ms", count, cpu_avg, percentile(cpu, 0.95), percentile(cpu, 0.99));
+    if (profiler.timestamps) printf(" | GPU avg %.3f p95 %.3f p99 %.3f ms", gpu_avg, percentile(gpu, 0.95), percentile(gpu, 0.99));
+    printf("\n");
+}
+
+// Read back a completed frame and emit it to the trace and the summary
+void gpu_profiler_resolve(Gpu_Profiler &profiler, Gpu_Profiler_Frame &frame)
+{
+    VkResult vr = VK_SUCCESS;
+    frame.pending = false;
+
+    u64 timestamps[GPU_PROFILER_MAX_REGIONS * 2] = {};
+    if (profiler.timestamps && frame.query_count > 0)
+    {
+        // no VK_QUERY_RESULT_WAIT_BIT: the frame's fence has signalled, so anything else means the frame was never executed
+        // (or the device was lost)
+        vr = vkGetQueryPoolResults(profiler.device, frame.timestamps, 0, frame.query_count, sizeof(timestamps), timestamps, sizeof(u64), VK_QUERY_RESULT_64_BIT);
+        if (vr == VK_NOT_READY || vr == VK_ERROR_DEVICE_LOST) return;
+        CHECK_RESULT(vr);
+    }
+
+    u64 statistics[GPU_PROFILER_STATISTICS_COUNT] = {};
+    if (profiler.statistics)
+    {
+        vr = vkGetQueryPoolResults(profiler.device, frame.statistics, 0, 1, sizeof(statistics), statistics, sizeof(statistics), VK_QUERY_RESULT_64_BIT);
+        if (vr == VK_NOT_READY || vr == VK_ERROR_DEVICE_LOST) return;
+        CHECK_RESULT(vr);
+    }
+
+    auto region_ms = [&](Gpu_Profiler_Region &region) {
+        u64 ticks = (timestamps[region.end_query] - timestamps[region.begin_query]) & profiler.timestamp_mask;
+        return ticks * profiler.timestamp_period_ns / 1e6;
+    };
+    f64 gpu_ms = profiler.timestamps && frame.regions.size() > 0 ? region_ms(frame.regions[0]) : 0.0;
+
+    if (profiler.trace)
+    {
+        if (profiler.trace_json)
+        {
+            fprintf(profiler.trace, "%s  {\"frame\": %llu, \"cpu_ms\": %.4f", profiler.traced_frames > 0 ? ",\n" : "", (unsigned long long)frame.frame_number, frame.cpu_ms);
+            if (profiler.timestamps)
+            {
+                fprintf(profiler.trace, ", \"gpu_ms\": %.4f, \"regions\": [", gpu_ms);
+                for (usize i = 1; i < frame.regions.size(); i++)
+                {
+                    fprintf(profiler.trace, "%s{\"name\": \"%s\", \"depth\": %u, \"ms\": %.4f}", i > 1 ? ", " : "", frame.regions[i].name, frame.regions[i].depth, region_ms(frame.regions[i]));
+                }
+                fprintf(profiler.trace, "]");
+            }
+            if (profiler.statistics)
+            {
+                fprintf(profiler.trace, ", \"statistics\": {");
+                for (usize i = 0; i < GPU_PROFILER_STATISTICS_COUNT; i++) fprintf(profiler.trace, "%s\"%s\": %llu", i > 0 ? ", " : "", pipeline_statistics_names[i], (unsigned long long)statistics[i]);
+                fprintf(profiler.trace, "}");
+            }
+            fprintf(profiler.trace, "}");
+        }
+        else
+        {
+            unsigned long long n = frame.frame_number;
+            fprintf(profiler.trace, "%llu,cpu_ms,0,%.4f\n", n, frame.cpu_ms);
+            if (profiler.timestamps)
+            {
+                fprintf(profiler.trace, "%llu,gpu_ms,0,%.4f\n", n, gpu_ms);
+                for (usize i = 1; i < frame.regions.size(); i++) fprintf(profiler.trace, "%llu,%s,%u,%.4f\n", n, frame.regions[i].name, frame.regions[i].depth, region_ms(frame.regions[i]));
+            }
+            if (profiler.statistics)
+            {
+                for (usize i = 0; i < GPU_PROFILER_STATISTICS_COUNT; i++) fprintf(profiler.trace, "%llu,%s,0,%llu\n", n, pipeline_statistics_names[i], (unsigned long long)statistics[i]);
+            }
+        }
+        profiler.traced_frames++;
+    }
+
+    // the last frame before shutdown has no CPU time, since no next iteration began
+    if (frame.cpu_ms == 0.0) return;
+
+    profiler.cpu_history[profiler.history_head] = frame.cpu_ms;
+    profiler.gpu_history[profiler.history_head] = gpu_ms;
+    profiler.history_head = (profiler.history_head + 1) % profiler.cpu_history.size();
+    if (++profiler.since_summary == profiler.summary_interval)
+    {
+        gpu_profiler_print_summary(profiler, profiler.cpu_history.size());
+        profiler.since_summary = 0;
+    }
+}
+
+void gpu_profiler_begin_region(Gpu_Profiler &profiler, VkCommandBuffer cmd_buf, const char *name)
+{
+    Gpu_Profiler_Frame &frame = profiler.frames[profiler.current];
+    if (!profiler.timestamps) return;
+
+    // keep the stack balanced for the matching end_region when the region is dropped
+    if (frame.regions.size() == GPU_PROFILER_MAX_REGIONS)
+    {
+        frame.open.push_back(UINT32_MAX);
+        return;
+    }
+
+    Gpu_Profiler_Region region = {};
+    region.name = name;
+    region.depth = frame.open.size();
+    region.begin_query = frame.query_count++;
+    frame.open.push_back(frame.regions.size());
+    frame.regions.push_back(region);
+
+    vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.timestamps, region.begin_query);
+}
+
+void gpu_profiler_end_region(Gpu_Profiler &profiler, VkCommandBuffer cmd_buf)
+{
+    Gpu_Profiler_Frame &frame = profiler.frames[profiler.current];
+    if (!profiler.timestamps || frame.open.size() == 0) return;
+
+    u32 index = frame.open.back();
+    frame.open.pop_back();
+    if (index == UINT32_MAX) return;
+
+    Gpu_Profiler_Region &region = frame.regions[index];
+    region.end_query = frame.query_count++;
+
+    vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestamps, region.end_query);
+}
+
+// Ends the region when it goes out of scope, see GPU_PROFILE_SCOPE
+struct Gpu_Profile_Scope {
+    Gpu_Profiler   *profiler;
+    VkCommandBuffer cmd_buf;
+    Gpu_Profile_Scope(Gpu_Profiler *profiler, VkCommandBuffer cmd_buf, const char *name) : profiler(profiler), cmd_buf(cmd_buf) { if (profiler) gpu_profiler_begin_region(*profiler, cmd_buf, name); }
+    ~Gpu_Profile_Scope() { if (profiler) gpu_profiler_end_region(*profiler, cmd_buf); }
+};
+
+// Time the rest of the enclosing scope; PROFILER may be nullptr when profiling is disabled
+#define GPU_PROFILE_CONCAT_(A, B) A##B
+#define GPU_PROFILE_CONCAT(A, B) GPU_PROFILE_CONCAT_(A, B)
+#define GPU_PROFILE_SCOPE(PROFILER, CMD_BUF, NAME) Gpu_Profile_Scope GPU_PROFILE_CONCAT(gpu_profile_scope_, __LINE__)((PROFILER), (CMD_BUF), (NAME))
+
+// Call at the start of recording a frame's primary command buffer, after its fence has been waited on and outside of any render pass
+// Resolves the frame that last used this slot and opens the whole-frame region and statistics query
+void gpu_profiler_begin_frame(Gpu_Profiler &profiler, VkCommandBuffer cmd_buf, u32 frame_index, u64 frame_number)
+{
+    auto now = std::chrono::steady_clock::now();
+
+    // the previous iteration of the main loop ends here
+    Gpu_Profiler_Frame &previous = profiler.frames[profiler.current];
+    if (previous.pending && previous.frame_number == profiler.last_frame_number)
+    {
+        previous.cpu_ms = std::chrono::duration<f64, std::milli>(now - previous.cpu_start).count();
+    }
+
+    profiler.current = frame_index;
+    Gpu_Profiler_Frame &frame = profiler.frames[frame_index];
+    if (frame.pending) gpu_profiler_resolve(profiler, frame);
+
+    frame.regions.clear();
+    frame.open.clear();
+    frame.query_count = 0;
+    frame.frame_number = frame_number;
+    frame.cpu_start = now;
+    frame.cpu_ms = 0.0;
+    profiler.last_frame_number = frame_number;
+
+    if (profiler.timestamps) vkCmdResetQueryPool(cmd_buf, frame.timestamps, 0, GPU_PROFILER_MAX_REGIONS * 2);
+    if (profiler.statistics)
+    {
+        vkCmdResetQueryPool(cmd_buf, frame.statistics, 0, 1);
+        vkCmdBeginQuery(cmd_buf, frame.statistics, 0, 0);
+    }
+    gpu_profiler_begin_region(profiler, cmd_buf, "frame");
+}
+
+// Call before ending the frame's primary command buffer, outside of any render pass
+void gpu_profiler_end_frame(Gpu_Profiler &profiler, VkCommandBuffer cmd_buf)
+{
+    Gpu_Profiler_Frame &frame = profiler.frames[profiler.current];
+    while (frame.open.size() > 0) gpu_profiler_end_region(profiler, cmd_buf);
+    if (profiler.statistics) vkCmdEndQuery(cmd_buf, frame.statistics, 0);
+    frame.pending = true;
+}
+
+// Call after the device is idle; resolves the frames still in flight and closes the trace
+void gpu_profiler_destroy(Gpu_Profiler &profiler)
+{
+    for (usize i = 1; i <= profiler.frames.size(); i++)
+    {
+        Gpu_Profiler_Frame &frame = profiler.frames[(profiler.current + i) % profiler.frames.size()];
+        if (frame.pending) gpu_profiler_resolve(profiler, frame);
+    }
+    usize count = std::min<usize>(profiler.since_summary, profiler.cpu_history.size());
+    if (count > 0)
+    {
+        // the history is a ring; bring the latest `count` entries to the front
+        std::rotate(profiler.cpu_history.begin(), profiler.cpu_history.begin() + (profiler.history_head + profiler.cpu_history.size() - count) % profiler.cpu_history.size(), profiler.cpu_history.end());
+        std::rotate(profiler.gpu_history.begin(), profiler.gpu_history.begin() + (profiler.history_head + profiler.gpu_history.size() - count) % profiler.gpu_history.size(), profiler.gpu_history.end());
+        gpu_profiler_print_summary(profiler, count);
+    }
+
+    if (profiler.trace)
+    {
+        if (profiler.trace_json) fprintf(profiler.trace, "\n]\n");
+        fclose(profiler.trace);
+    }
+
+    for (auto &frame : profiler.frames)
+    {
+        if (frame.timestamps) vkDestroyQueryPool(profiler.device, frame.timestamps, nullptr);
+        if (frame.statistics) vkDestroyQueryPool(profiler.device, frame.statistics, nullptr);
+    }
+    profiler = {};
+}
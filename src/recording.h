@@ -0,0 +1,299 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "common.h"
+#include "jobs.h"
+#include "pipelines.h"
+
+//
+// PARALLEL COMMAND RECORDING
+// Draws are split into chunks that the job system records into secondary command buffers in parallel; the primary then executes them in chunk order
+// Command pools are externally synchronised, so every thread owns one pool per frame in flight. A pool is reset wholesale
+// once its frame's fence has signalled, and the secondary buffers allocated from it are reused from then on
+//
+
+struct Thread_Command_Pool {
+    VkCommandPool                pool;
+    std::vector<VkCommandBuffer> secondaries;
+    u32                          used;        // secondaries handed out since the last reset
+};
+
+struct Parallel_Recorder {
+    VkDevice                         device;
+    u32                              thread_count;
+    u32                              frame_count;
+    std::vector<Thread_Command_Pool> pools;   // [frame_index * thread_count + thread_index]
+    std::vector<VkCommandBuffer>     recorded; // one slot per chunk of the current frame, in draw order
+    VkQueryPipelineStatisticFlags    inherited_statistics; // statistics of the pipeline statistics query active in the primary, needs inheritedQueries
+    VkFormat                         rendering_format;     // color attachment of the dynamic rendering the secondaries continue when there is no render pass
+};
+
+void parallel_recorder_init(Parallel_Recorder &recorder, VkDevice device, u32 queue_family_index, u32 thread_count, u32 frame_count)
+{
+    recorder = {};
+    recorder.device = device;
+    recorder.thread_count = thread_count;
+    recorder.frame_count = frame_count;
+    recorder.pools.resize(thread_count * frame_count);
+
+    for (auto &pool : recorder.pools)
+    {
+        VkCommandPoolCreateInfo pool_info = {};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        pool_info.queueFamilyIndex = queue_family_index;
+
+        VkResult vr = vkCreateCommandPool(device, &pool_info, nullptr, &pool.pool);
+        CHECK_RESULT(vr);
+    }
+}
+
+void parallel_recorder_destroy(Parallel_Recorder &recorder)
+{
+    // destroying a pool frees its command buffers
+    for (auto &pool : recorder.pools) vkDestroyCommandPool(recorder.device, pool.pool, nullptr);
+    recorder = {};
+}
+
+// Reset every thread's pool for `frame_index`; the frame's previous submission must have completed
+void parallel_recorder_begin_frame(Parallel_Recorder &recorder, u32 frame_index)
+{
+    for (u32 thread = 0; thread < recorder.thread_count; thread++)
+    {
+        Thread_Command_Pool &pool = recorder.pools[frame_index * recorder.thread_count + thread];
+        VkResult vr = vkResetCommandPool(recorder.device, pool.pool, 0);
+        CHECK_RESULT(vr);
+        pool.used = 0;
+    }
+}
+
+// Begin a secondary command buffer that continues `render_pass`, or the primary's dynamic rendering when it is VK_NULL_HANDLE
+// Only `thread_index` may call this for its pool
+VkCommandBuffer parallel_recorder_begin_secondary(Parallel_Recorder &recorder, u32 frame_index, u32 thread_index, VkRenderPass render_pass, VkFramebuffer framebuffer)
+{
+    VkResult vr = VK_SUCCESS;
+    Thread_Command_Pool &pool = recorder.pools[frame_index * recorder.thread_count + thread_index];
+
+    if (pool.used == pool.secondaries.size())
+    {
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        alloc_info.commandPool = pool.pool;
+        alloc_info.commandBufferCount = 1;
+
+        VkCommandBuffer cmd_buf = {};
+        vr = vkAllocateCommandBuffers(recorder.device, &alloc_info, &cmd_buf);
+        CHECK_RESULT(vr);
+        pool.secondaries.push_back(cmd_buf);
+    }
+    VkCommandBuffer cmd_buf = pool.secondaries[pool.used++];
+
+    VkCommandBufferInheritanceRenderingInfo rendering = {};
+    rendering.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    rendering.colorAttachmentCount = 1;
+    rendering.pColorAttachmentFormats = &recorder.rendering_format;
+    rendering.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkCommandBufferInheritanceInfo inheritance = {};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    if (render_pass == VK_NULL_HANDLE) inheritance.pNext = &rendering;
+    inheritance.renderPass = render_pass;
+    inheritance.subpass = 0;
+    inheritance.framebuffer = framebuffer;
+    inheritance.pipelineStatistics = recorder.inherited_statistics;
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    begin_info.pInheritanceInfo = &inheritance;
+
+    vr = vkBeginCommandBuffer(cmd_buf, &begin_info);
+    CHECK_RESULT(vr);
+    return cmd_buf;
+}
+
+// Number of chunks `draw_count` draws are split into; a few chunks per thread keeps the threads balanced without
+// paying for a secondary command buffer per handful of draws
+u32 parallel_recorder_chunk_count(Parallel_Recorder &recorder, u32 draw_count)
+{
+    const u32 min_chunk_draws = 256;
+    return std::max(1u, std::min(recorder.thread_count * 4, draw_count / min_chunk_draws));
+}
+
+// Record the triangle grid into secondaries across the job system and execute them from `primary`, which must be inside `render_pass`
+// begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, or without a render pass inside dynamic rendering begun with
+// VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT
+void parallel_record_triangle_grid(Parallel_Recorder &recorder, Job_System &jobs, u32 frame_index, VkCommandBuffer primary,
+                                   VkRenderPass render_pass, VkFramebuffer framebuffer, VkExtent2D extent,
+                                   VkPipeline pipeline, VkPipelineLayout layout, u32 draw_count, f32 time)
+{
+    u32 chunk_count = parallel_recorder_chunk_count(recorder, draw_count);
+    recorder.recorded.resize(chunk_count);
+
+    job_system_parallel_for(jobs, chunk_count, [&](u32 thread_index, u32 chunk)
+    {
+        u32 first = (u64)draw_count * chunk / chunk_count;
+        u32 last  = (u64)draw_count * (chunk + 1) / chunk_count;
+
+        // dynamic state is not inherited from the primary
+        VkCommandBuffer cmd_buf = parallel_recorder_begin_secondary(recorder, frame_index, thread_index, render_pass, framebuffer);
+        record_triangle_grid(cmd_buf, pipeline, layout, extent, first, last - first, draw_count, time);
+        VkResult vr = vkEndCommandBuffer(cmd_buf);
+        CHECK_RESULT(vr);
+
+        recorder.recorded[chunk] = cmd_buf;
+    });
+
+    vkCmdExecuteCommands(primary, chunk_count, recorder.recorded.data());
+}
+
+//
+// BENCHMARK
+// Draw recording throughput from 1 to N threads, `--bench recording`
+// Only recording is timed; nothing is submitted, so the numbers are not skewed by the GPU (or lavapipe's CPU threads) executing the draws
+//
+
+void recording_benchmark(Device_Context &ctx, u32 max_threads)
+{
+    const u32        draw_count  = 100000;
+    const u32        frame_count = 20;
+    const VkExtent2D extent      = { 256, 256 };
+
+    VkResult vr = VK_SUCCESS;
+
+    VkRenderPass        render_pass = create_present_render_pass(ctx.device, VK_FORMAT_B8G8R8A8_UNORM, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    VkPipelineLayout    layout      = create_triangle_pipeline_layout(ctx.device);
+    Shader_Module_Cache modules     = {};
+    VkPipeline          pipeline    = create_triangle_pipeline(ctx.device, VK_NULL_HANDLE, modules, render_pass, layout);
+
+    // offscreen target for the framebuffer the secondaries inherit
+    VkImage        image = {};
+    Gpu_Allocation image_allocation = {};
+    VkImageView    image_view = {};
+    VkFramebuffer  framebuffer = {};
+    {
+        VkImageCreateInfo image_info = {};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = VK_FORMAT_B8G8R8A8_UNORM;
+        image_info.extent = { extent.width, extent.height, 1 };
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        vr = gpu_create_image(*ctx.allocator, image_info, GPU_MEMORY_USAGE_DEVICE_LOCAL, image, image_allocation);
+        CHECK_RESULT(vr);
+
+        VkImageViewCreateInfo view_info = {};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = image_info.format;
+        view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        view_info.subresourceRange.levelCount = 1;
+        view_info.subresourceRange.layerCount = 1;
+        vr = vkCreateImageView(ctx.device, &view_info, nullptr, &image_view);
+        CHECK_RESULT(vr);
+
+        VkFramebufferCreateInfo framebuffer_info = {};
+        framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebuffer_info.renderPass = render_pass;
+        framebuffer_info.attachmentCount = 1;
+        framebuffer_info.pAttachments = &image_view;
+        framebuffer_info.width = extent.width;
+        framebuffer_info.height = extent.height;
+        framebuffer_info.layers = 1;
+        vr = vkCreateFramebuffer(ctx.device, &framebuffer_info, nullptr, &framebuffer);
+        CHECK_RESULT(vr);
+    }
+
+    VkCommandPool   primary_pool = {};
+    VkCommandBuffer primary = {};
+    {
+        VkCommandPoolCreateInfo pool_info = {};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        pool_info.queueFamilyIndex = ctx.graphics_family;
+        vr = vkCreateCommandPool(ctx.device, &pool_info, nullptr, &primary_pool);
+        CHECK_RESULT(vr);
+
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandPool = primary_pool;
+        alloc_info.commandBufferCount = 1;
+        vr = vkAllocateCommandBuffers(ctx.device, &alloc_info, &primary);
+        CHECK_RESULT(vr);
+    }
+
+    std::cout << std::endl << "Recording benchmark: " << draw_count << " draws per frame, " << frame_count << " frames per thread count" << std::endl;
+
+    f64 single_thread_rate = 0.0;
+    // 1, 2, 4, ... threads, always ending on max_threads
+    for (u32 thread_count = 1;; thread_count = std::min(thread_count * 2, max_threads))
+    {
+        Job_System jobs;
+        job_system_init(jobs, thread_count);
+        Parallel_Recorder recorder = {};
+        parallel_recorder_init(recorder, ctx.device, ctx.graphics_family, thread_count, 1);
+
+        f64 seconds = 0.0;
+        for (u32 frame = 0; frame <= frame_count; frame++)
+        {
+            vr = vkResetCommandPool(ctx.device, primary_pool, 0);
+            CHECK_RESULT(vr);
+            parallel_recorder_begin_frame(recorder, 0);
+
+            auto start = std::chrono::steady_clock::now();
+
+            VkCommandBufferBeginInfo begin_info = {};
+            begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vr = vkBeginCommandBuffer(primary, &begin_info);
+            CHECK_RESULT(vr);
+
+            VkClearValue clear_value = {};
+            VkRenderPassBeginInfo render_pass_begin_info = {};
+            render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            render_pass_begin_info.renderPass = render_pass;
+            render_pass_begin_info.framebuffer = framebuffer;
+            render_pass_begin_info.renderArea.extent = extent;
+            render_pass_begin_info.clearValueCount = 1;
+            render_pass_begin_info.pClearValues = &clear_value;
+            vkCmdBeginRenderPass(primary, &render_pass_begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+            parallel_record_triangle_grid(recorder, jobs, 0, primary, render_pass, framebuffer, extent, pipeline, layout, draw_count, frame * 0.01f);
+
+            vkCmdEndRenderPass(primary);
+            vr = vkEndCommandBuffer(primary);
+            CHECK_RESULT(vr);
+
+            // the first frame allocates the secondaries and warms up the threads
+            if (frame > 0) seconds += std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        f64 rate = (f64)draw_count * frame_count / seconds;
+        if (thread_count == 1) single_thread_rate = rate;
+        printf("  %2u threads: %8.3f ms/frame  %12.0f draws/s  %5.2fx\n", thread_count, seconds * 1000.0 / frame_count, rate, rate / single_thread_rate);
+
+        parallel_recorder_destroy(recorder);
+        job_system_destroy(jobs);
+        if (thread_count >= max_threads) break;
+    }
+
+    vkDestroyCommandPool(ctx.device, primary_pool, nullptr);
+    vkDestroyFramebuffer(ctx.device, framebuffer, nullptr);
+    vkDestroyImageView(ctx.device, image_view, nullptr);
+    gpu_destroy_image(*ctx.allocator, image, image_allocation);
+    vkDestroyPipeline(ctx.device, pipeline, nullptr);
+    shader_module_cache_destroy(ctx.device, modules);
+    vkDestroyPipelineLayout(ctx.device, layout, nullptr);
+    vkDestroyRenderPass(ctx.device, render_pass, nullptr);
+}
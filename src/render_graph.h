@@ -0,0 +1,978 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include "common.h"
+#include "gpu_allocator.h"
+#include "arena.h"
+
+//
+// RENDER GRAPH
+// Passes declare the images and buffers they read and write instead of placing barriers by hand. Compiling the graph
+//  - culls passes whose results are never read (passes that write an exported resource or have side effects are the roots)
+//  - groups the remaining passes into levels: a pass's level is one more than that of the latest pass it has a hazard with, so
+//    passes within a level are independent and run in declaration order, level after level
+//  - emits one vkCmdPipelineBarrier per level that merges every transition the level needs: image barriers for layout changes
+//    and a single global memory barrier for everything else (buffers, and images that stay in their layout); on a device with
+//    synchronization2 the same batch is recorded with vkCmdPipelineBarrier2
+//  - places transient images whose levels do not overlap in the same memory
+// Graphs are built and compiled once and executed every frame; imported resources (e.g. the swapchain image) are rebound before
+// each execution with render_graph_set_image/buffer
+//
+
+enum Render_Graph_Usage {
+    RENDER_GRAPH_COLOR_ATTACHMENT,  // write, clears or overwrites the attachment
+    RENDER_GRAPH_DEPTH_ATTACHMENT,  // write
+    RENDER_GRAPH_SAMPLED,           // read from fragment or compute shaders
+    RENDER_GRAPH_STORAGE_READ,      // read from compute shaders
+    RENDER_GRAPH_STORAGE_WRITE,     // write from compute shaders, the previous contents are kept
+    RENDER_GRAPH_TRANSFER_SRC,
+    RENDER_GRAPH_TRANSFER_DST,
+    RENDER_GRAPH_INDIRECT,          // draw or dispatch parameters read by vkCmd*Indirect*, buffers only
+};
+
+// the synchronisation state of a resource, or what an access needs it to be; `layout` is ignored for buffers
+struct Render_Graph_State {
+    VkPipelineStageFlags stage;
+    VkAccessFlags        access;
+    VkImageLayout        layout;
+};
+
+struct Render_Graph_Usage_Info {
+    Render_Graph_State   state;
+    bool                 write;
+    VkImageUsageFlags    image_usage;
+};
+
+Render_Graph_Usage_Info render_graph_usage_info(Render_Graph_Usage usage)
+{
+    switch (usage)
+    {
+        case RENDER_GRAPH_COLOR_ATTACHMENT: return { { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL }, true, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT };
+        case RENDER_GRAPH_DEPTH_ATTACHMENT: return { { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL }, true, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT };
+        case RENDER_GRAPH_SAMPLED:          return { { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL }, false, VK_IMAGE_USAGE_SAMPLED_BIT };
+        case RENDER_GRAPH_STORAGE_READ:     return { { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL }, false, VK_IMAGE_USAGE_STORAGE_BIT };
+        case RENDER_GRAPH_STORAGE_WRITE:    return { { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL }, true, VK_IMAGE_USAGE_STORAGE_BIT };
+        case RENDER_GRAPH_TRANSFER_SRC:     return { { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL }, false, VK_IMAGE_USAGE_TRANSFER_SRC_BIT };
+        case RENDER_GRAPH_TRANSFER_DST:     return { { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL }, true, VK_IMAGE_USAGE_TRANSFER_DST_BIT };
+        case RENDER_GRAPH_INDIRECT:         return { { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED }, false, 0 };
+    }
+    return {};
+}
+
+struct Render_Graph_Resource {
+    const char          *name;
+    bool                 is_image;
+    bool                 imported;
+    bool                 exported;      // imported with a final state, its last writer is never culled
+    Render_Graph_State   initial;       // imported: the state the resource is in when the graph starts executing
+    Render_Graph_State   final;         // exported: the state the graph leaves it in
+
+    // transient images, created by render_graph_compile
+    VkImageCreateInfo    image_info;
+    VkImageAspectFlags   aspect;
+    Gpu_Allocation       allocation;    // only set on the first image of an alias group, the others are bound into it
+    u32                  alias_next;    // next image in the same memory, UINT32_MAX for the last one
+    u32                  alias_previous;
+
+    VkImage              image;
+    VkImageView          view;
+    VkBuffer             buffer;
+
+    // compile state
+    u32                  first_level;
+    u32                  last_level;
+    bool                 used;
+};
+
+struct Render_Graph_Access {
+    u32                  resource;
+    Render_Graph_Usage   usage;
+};
+
+struct Render_Graph_Pass {
+    const char                          *name;
+    std::vector<Render_Graph_Access>     accesses;
+    std::function<void(VkCommandBuffer)> record;
+    bool                                 side_effects; // never culled, e.g. a readback the CPU consumes
+    bool                                 culled;
+    u32                                  level;
+};
+
+struct Render_Graph_Image_Barrier {
+    u32                  resource;
+    VkImageLayout        old_layout;
+    VkImageLayout        new_layout;
+    VkAccessFlags        src_access;
+    VkAccessFlags        dst_access;
+};
+
+// recorded before `pass` (an index into `order`), or after the last pass when pass == order.size()
+struct Render_Graph_Barrier_Batch {
+    u32                                     pass;
+    VkPipelineStageFlags                    src_stage;
+    VkPipelineStageFlags                    dst_stage;
+    VkAccessFlags                           memory_src_access;  // global memory barrier, only recorded when either access is set
+    VkAccessFlags                           memory_dst_access;
+    std::vector<Render_Graph_Image_Barrier> image_barriers;
+    u32                                     merged;             // transitions merged into this batch
+};
+
+struct Render_Graph {
+    std::vector<Render_Graph_Resource>      resources;
+    std::vector<Render_Graph_Pass>          passes;
+
+    // compiled
+    std::vector<u32>                        order;    // the passes that survived culling, in execution order
+    std::vector<Render_Graph_Barrier_Batch> batches;
+    u32                                     level_count;
+    VkDeviceSize                            transient_bytes;   // memory used by transient images after aliasing
+    VkDeviceSize                            unaliased_bytes;   // what they would take without aliasing
+    PFN_vkCmdPipelineBarrier2               pipeline_barrier2; // set when compiled for a device with synchronization2
+    bool                                    compiled;
+};
+
+// DECLARATION
+
+// `final.stage == 0` means the graph may leave the image in whatever state its last pass used
+u32 render_graph_import_image(Render_Graph &graph, const char *name, VkImageAspectFlags aspect, Render_Graph_State initial, Render_Graph_State final)
+{
+    Render_Graph_Resource resource = {};
+    resource.name     = name;
+    resource.is_image = true;
+    resource.imported = true;
+    resource.exported = final.stage != 0;
+    resource.initial  = initial;
+    resource.final    = final;
+    resource.aspect   = aspect;
+    graph.resources.push_back(resource);
+    return graph.resources.size() - 1;
+}
+
+u32 render_graph_import_buffer(Render_Graph &graph, const char *name, Render_Graph_State initial, Render_Graph_State final)
+{
+    Render_Graph_Resource resource = {};
+    resource.name     = name;
+    resource.imported = true;
+    resource.exported = final.stage != 0;
+    resource.initial  = initial;
+    resource.final    = final;
+    graph.resources.push_back(resource);
+    return graph.resources.size() - 1;
+}
+
+// A transient image only lives within one execution of the graph; its contents are undefined when its first pass starts
+// The usage flags are collected from the passes that access it
+u32 render_graph_create_image(Render_Graph &graph, const char *name, VkFormat format, VkExtent2D extent, VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT)
+{
+    Render_Graph_Resource resource = {};
+    resource.name     = name;
+    resource.is_image = true;
+    resource.aspect   = aspect;
+    resource.image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    resource.image_info.imageType = VK_IMAGE_TYPE_2D;
+    resource.image_info.format = format;
+    resource.image_info.extent = { extent.width, extent.height, 1 };
+    resource.image_info.mipLevels = 1;
+    resource.image_info.arrayLayers = 1;
+    resource.image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    resource.image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    resource.image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    resource.image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    graph.resources.push_back(resource);
+    return graph.resources.size() - 1;
+}
+
+// Passes are declared in submission order: a pass that reads a resource sees the writes of the passes declared before it
+// Writes are assumed to depend on the previous contents, so an overwritten pass is only culled when its overwriter is culled as well
+u32 render_graph_add_pass(Render_Graph &graph, const char *name, std::vector<Render_Graph_Access> accesses, std::function<void(VkCommandBuffer)> record, bool side_effects = false)
+{
+    Render_Graph_Pass pass = {};
+    pass.name         = name;
+    pass.accesses     = std::move(accesses);
+    pass.record       = std::move(record);
+    pass.side_effects = side_effects;
+    graph.passes.push_back(std::move(pass));
+    return graph.passes.size() - 1;
+}
+
+void render_graph_set_image(Render_Graph &graph, u32 resource, VkImage image, VkImageView view = VK_NULL_HANDLE)
+{
+    graph.resources[resource].image = image;
+    graph.resources[resource].view  = view;
+}
+
+void render_graph_set_buffer(Render_Graph &graph, u32 resource, VkBuffer buffer)
+{
+    graph.resources[resource].buffer = buffer;
+}
+
+// COMPILATION
+
+void render_graph_cull(Render_Graph &graph)
+{
+    // producers[pass] = the passes whose results the pass depends on (the last writer of every resource it touches)
+    std::vector<std::vector<u32>> producers(graph.passes.size());
+    std::vector<u32> last_writer(graph.resources.size(), UINT32_MAX);
+    for (u32 p = 0; p < graph.passes.size(); p++)
+    {
+        for (auto &access : graph.passes[p].accesses)
+        {
+            if (last_writer[access.resource] != UINT32_MAX) producers[p].push_back(last_writer[access.resource]);
+        }
+        for (auto &access : graph.passes[p].accesses)
+        {
+            if (render_graph_usage_info(access.usage).write) last_writer[access.resource] = p;
+        }
+    }
+
+    std::vector<u32> stack = {};
+    for (u32 p = 0; p < graph.passes.size(); p++)
+    {
+        graph.passes[p].culled = true;
+        if (graph.passes[p].side_effects) stack.push_back(p);
+    }
+    for (u32 r = 0; r < graph.resources.size(); r++)
+    {
+        if (graph.resources[r].exported && last_writer[r] != UINT32_MAX) stack.push_back(last_writer[r]);
+    }
+
+    while (!stack.empty())
+    {
+        u32 p = stack.back();
+        stack.pop_back();
+        if (!graph.passes[p].culled) continue;
+        graph.passes[p].culled = false;
+        for (u32 producer : producers[p]) stack.push_back(producer);
+    }
+}
+
+void render_graph_schedule(Render_Graph &graph)
+{
+    // per resource: the level of its last writer and the readers since then, with the layout they read in
+    struct Hazard_State {
+        u32                        write_level;
+        std::vector<std::pair<u32, VkImageLayout>> readers;
+        bool                       written;
+    };
+    std::vector<Hazard_State> hazards(graph.resources.size());
+
+    graph.level_count = 0;
+    for (auto &pass : graph.passes)
+    {
+        if (pass.culled) continue;
+
+        // read after write, write after write, write after read, and reads in a different layout than earlier reads
+        u32 level = 0;
+        for (auto &access : pass.accesses)
+        {
+            Hazard_State &hazard = hazards[access.resource];
+            Render_Graph_Usage_Info info = render_graph_usage_info(access.usage);
+            if (hazard.written) level = std::max(level, hazard.write_level + 1);
+            for (auto &reader : hazard.readers)
+            {
+                bool layout_change = graph.resources[access.resource].is_image && reader.second != info.state.layout;
+                if (info.write || layout_change) level = std::max(level, reader.first + 1);
+            }
+        }
+        pass.level = level;
+        graph.level_count = std::max(graph.level_count, level + 1);
+
+        for (auto &access : pass.accesses)
+        {
+            Hazard_State &hazard = hazards[access.resource];
+            Render_Graph_Usage_Info info = render_graph_usage_info(access.usage);
+            if (info.write)
+            {
+                hazard.written = true;
+                hazard.write_level = level;
+                hazard.readers.clear();
+            }
+            else
+            {
+                hazard.readers.push_back({ level, info.state.layout });
+            }
+
+            Render_Graph_Resource &resource = graph.resources[access.resource];
+            if (!resource.used) resource.first_level = level;
+            resource.last_level = std::max(resource.last_level, level);
+            resource.used = true;
+            resource.image_info.usage |= info.image_usage;
+        }
+    }
+
+    // level by level, declaration order within a level
+    graph.order.clear();
+    for (u32 level = 0; level < graph.level_count; level++)
+    {
+        for (u32 p = 0; p < graph.passes.size(); p++)
+        {
+            if (!graph.passes[p].culled && graph.passes[p].level == level) graph.order.push_back(p);
+        }
+    }
+}
+
+struct Render_Graph_Alias_Group {
+    std::vector<u32>     members;       // in execution order
+    VkMemoryRequirements requirements;  // covering every member
+};
+
+// Place the transient images in memory, given the requirements of each used one: images are taken largest first and each goes into
+// the first group whose images all have finished before it starts (or start after it finishes) and whose memory types it can use
+// Links the members of each group through alias_next/alias_previous; needs no device, so the placement can be checked on its own
+std::vector<Render_Graph_Alias_Group> render_graph_alias_transients(Render_Graph &graph, std::vector<std::pair<u32, VkMemoryRequirements>> images)
+{
+    std::vector<Render_Graph_Alias_Group> groups = {};
+
+    graph.transient_bytes = 0;
+    graph.unaliased_bytes = 0;
+    for (auto &image : images) graph.unaliased_bytes += image.second.size;
+    std::stable_sort(images.begin(), images.end(), [](auto &a, auto &b) { return a.second.size > b.second.size; });
+
+    for (auto &[r, requirements] : images)
+    {
+        Render_Graph_Resource &resource = graph.resources[r];
+        Render_Graph_Alias_Group *target = nullptr;
+        for (auto &group : groups)
+        {
+            if (!(group.requirements.memoryTypeBits & requirements.memoryTypeBits)) continue;
+            bool overlaps = false;
+            for (u32 member : group.members)
+            {
+                Render_Graph_Resource &other = graph.resources[member];
+                if (resource.first_level <= other.last_level && other.first_level <= resource.last_level) overlaps = true;
+            }
+            if (!overlaps) { target = &group; break; }
+        }
+        if (!target)
+        {
+            groups.push_back({ {}, requirements });
+            target = &groups.back();
+        }
+        target->members.push_back(r);
+        target->requirements.size            = std::max(target->requirements.size, requirements.size);
+        target->requirements.alignment       = std::max(target->requirements.alignment, requirements.alignment);
+        target->requirements.memoryTypeBits &= requirements.memoryTypeBits;
+    }
+
+    for (auto &group : groups)
+    {
+        // members in execution order, so each one knows whose memory it takes over
+        std::sort(group.members.begin(), group.members.end(), [&](u32 a, u32 b) { return graph.resources[a].first_level < graph.resources[b].first_level; });
+        for (u32 i = 0; i + 1 < group.members.size(); i++)
+        {
+            graph.resources[group.members[i]].alias_next = group.members[i + 1];
+            graph.resources[group.members[i + 1]].alias_previous = group.members[i];
+        }
+        graph.transient_bytes += group.requirements.size;
+    }
+    return groups;
+}
+
+// Create the transient images, alias them with render_graph_alias_transients and give every group its memory
+void render_graph_create_transients(Render_Graph &graph, Device_Context &ctx)
+{
+    VkResult vr = VK_SUCCESS;
+
+    std::vector<std::pair<u32, VkMemoryRequirements>> images = {};
+    for (u32 r = 0; r < graph.resources.size(); r++)
+    {
+        Render_Graph_Resource &resource = graph.resources[r];
+        if (resource.imported || !resource.used) continue;
+
+        vr = vkCreateImage(ctx.device, &resource.image_info, nullptr, &resource.image);
+        CHECK_RESULT(vr);
+        VkMemoryRequirements requirements = {};
+        vkGetImageMemoryRequirements(ctx.device, resource.image, &requirements);
+        images.push_back({ r, requirements });
+    }
+
+    for (auto &group : render_graph_alias_transients(graph, std::move(images)))
+    {
+        Render_Graph_Resource &first = graph.resources[group.members[0]];
+        vr = gpu_allocate(*ctx.allocator, group.requirements, GPU_MEMORY_USAGE_DEVICE_LOCAL, true, first.allocation);
+        CHECK_RESULT(vr);
+
+        for (u32 member : group.members)
+        {
+            Render_Graph_Resource &resource = graph.resources[member];
+            vr = vkBindImageMemory(ctx.device, resource.image, first.allocation.memory, first.allocation.offset);
+            CHECK_RESULT(vr);
+
+            VkImageViewCreateInfo view_info = {};
+            view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            view_info.image = resource.image;
+            view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            view_info.format = resource.image_info.format;
+            view_info.subresourceRange.aspectMask = resource.aspect;
+            view_info.subresourceRange.levelCount = 1;
+            view_info.subresourceRange.layerCount = 1;
+            vr = vkCreateImageView(ctx.device, &view_info, nullptr, &resource.view);
+            CHECK_RESULT(vr);
+        }
+    }
+}
+
+void render_graph_build_barriers(Render_Graph &graph)
+{
+    // what each resource needs to wait for before it is accessed next
+    struct Sync_State {
+        VkImageLayout        layout;
+        VkPipelineStageFlags write_stage;     // stages of the last write (layout transitions count as writes)
+        VkAccessFlags        write_access;    // accesses that still have to be made available
+        VkPipelineStageFlags read_stages;     // stages that read since the last write, later writes must wait for them
+        VkPipelineStageFlags visible_stages;  // stages and accesses the last write was already made visible to
+        VkAccessFlags        visible_access;
+        bool                 touched;
+    };
+    std::vector<Sync_State> states(graph.resources.size());
+
+    // a transient image's memory may still be in use by the image that had it before: within the frame that is the previous
+    // image in its alias group, across frames the last one (or itself)
+    auto alias_wait = [&](u32 r) {
+        Render_Graph_Resource &resource = graph.resources[r];
+        Sync_State wait = {};
+        if (resource.alias_previous != UINT32_MAX)
+        {
+            Sync_State &previous = states[resource.alias_previous];
+            wait.write_stage  = previous.write_stage | previous.read_stages;
+            wait.write_access = previous.write_access;
+            return wait;
+        }
+        for (u32 member = r; member != UINT32_MAX; member = graph.resources[member].alias_next)
+        {
+            for (auto &pass : graph.passes)
+            {
+                if (pass.culled) continue;
+                for (auto &access : pass.accesses)
+                {
+                    if (access.resource != member) continue;
+                    Render_Graph_Usage_Info info = render_graph_usage_info(access.usage);
+                    wait.write_stage |= info.state.stage;
+                    if (info.write) wait.write_access |= info.state.access;
+                }
+            }
+        }
+        return wait;
+    };
+
+    for (u32 r = 0; r < graph.resources.size(); r++)
+    {
+        Render_Graph_Resource &resource = graph.resources[r];
+        if (!resource.imported) continue;
+        states[r].layout       = resource.initial.layout;
+        states[r].write_stage  = resource.initial.stage;
+        states[r].write_access = resource.initial.access;
+        states[r].touched      = true;
+    }
+
+    // add the transition of `resource` to `target` into `batch`; returns whether anything was needed
+    auto transition = [&](Render_Graph_Barrier_Batch &batch, u32 r, Render_Graph_State target, bool write) {
+        Render_Graph_Resource &resource = graph.resources[r];
+        Sync_State &state = states[r];
+        if (!state.touched)
+        {
+            state = alias_wait(r);
+            state.layout  = VK_IMAGE_LAYOUT_UNDEFINED;
+            state.touched = true;
+        }
+
+        bool needed = false;
+        if (resource.is_image && target.layout != VK_IMAGE_LAYOUT_UNDEFINED && target.layout != state.layout)
+        {
+            Render_Graph_Image_Barrier barrier = {};
+            barrier.resource   = r;
+            barrier.old_layout = state.layout;
+            barrier.new_layout = target.layout;
+            barrier.src_access = state.write_access;
+            barrier.dst_access = target.access;
+            batch.image_barriers.push_back(barrier);
+            batch.src_stage |= state.write_stage | state.read_stages;
+            batch.dst_stage |= target.stage;
+
+            state.layout         = target.layout;
+            state.write_stage    = target.stage;
+            state.write_access   = write ? target.access : 0;
+            state.read_stages    = write ? 0 : target.stage;
+            state.visible_stages = write ? 0 : target.stage;
+            state.visible_access = write ? 0 : target.access;
+            needed = true;
+        }
+        else if (write)
+        {
+            // write after write needs the old writes made available; write after read only needs to wait for the reads
+            if (state.write_stage | state.read_stages)
+            {
+                batch.src_stage         |= state.write_stage | state.read_stages;
+                batch.dst_stage         |= target.stage;
+                batch.memory_src_access |= state.write_access;
+                if (state.write_access) batch.memory_dst_access |= target.access;
+                needed = true;
+            }
+            state.write_stage    = target.stage;
+            state.write_access   = target.access;
+            state.read_stages    = 0;
+            state.visible_stages = 0;
+            state.visible_access = 0;
+        }
+        else
+        {
+            bool visible = (state.visible_stages & target.stage) == target.stage && (state.visible_access & target.access) == target.access;
+            if (state.write_stage && !visible)
+            {
+                batch.src_stage         |= state.write_stage;
+                batch.dst_stage         |= target.stage;
+                batch.memory_src_access |= state.write_access;
+                batch.memory_dst_access |= target.access;
+                state.visible_stages    |= target.stage;
+                state.visible_access    |= target.access;
+                needed = true;
+            }
+            state.read_stages |= target.stage;
+        }
+        if (needed) batch.merged++;
+    };
+
+    graph.batches.clear();
+    for (u32 i = 0; i < graph.order.size(); i++)
+    {
+        Render_Graph_Pass &pass = graph.passes[graph.order[i]];
+        bool level_start = i == 0 || graph.passes[graph.order[i - 1]].level != pass.level;
+        if (level_start)
+        {
+            Render_Graph_Barrier_Batch batch = {};
+            batch.pass = i;
+            graph.batches.push_back(batch);
+        }
+
+        for (auto &access : pass.accesses)
+        {
+            Render_Graph_Usage_Info info = render_graph_usage_info(access.usage);
+            transition(graph.batches.back(), access.resource, info.state, info.write);
+        }
+    }
+
+    Render_Graph_Barrier_Batch final_batch = {};
+    final_batch.pass = graph.order.size();
+    graph.batches.push_back(final_batch);
+    for (u32 r = 0; r < graph.resources.size(); r++)
+    {
+        Render_Graph_Resource &resource = graph.resources[r];
+        if (resource.exported) transition(graph.batches.back(), r, resource.final, false);
+    }
+
+    // a level whose passes only ever read what was already visible needs no barrier at all
+    graph.batches.erase(std::remove_if(graph.batches.begin(), graph.batches.end(), [](auto &batch) { return batch.merged == 0; }), graph.batches.end());
+}
+
+// Cull, schedule and synchronise the declared passes; with a device context the transient images are created and aliased as well
+// (without one only the CPU-side results are produced, e.g. to inspect the barriers)
+void render_graph_compile(Render_Graph &graph, Device_Context *ctx)
+{
+    for (auto &resource : graph.resources)
+    {
+        resource.used = false;
+        resource.first_level = 0;
+        resource.last_level = 0;
+        resource.alias_next = UINT32_MAX;
+        resource.alias_previous = UINT32_MAX;
+    }
+
+    render_graph_cull(graph);
+    render_graph_schedule(graph);
+    if (ctx) render_graph_create_transients(graph, *ctx);
+    render_graph_build_barriers(graph);
+    graph.pipeline_barrier2 = ctx && ctx->synchronization2 ? ctx->cmd_pipeline_barrier2 : nullptr;
+    graph.compiled = true;
+}
+
+void render_graph_destroy(Render_Graph &graph, Device_Context &ctx)
+{
+    for (auto &resource : graph.resources)
+    {
+        if (resource.imported) continue;
+        if (resource.view)  vkDestroyImageView(ctx.device, resource.view, nullptr);
+        if (resource.image) vkDestroyImage(ctx.device, resource.image, nullptr);
+        if (resource.allocation.memory) gpu_free(*ctx.allocator, resource.allocation);
+    }
+    graph = {};
+}
+
+// EXECUTION
+
+// synchronization2 takes the stages per barrier and accepts empty stage masks; the access flags and the stage bits the graph
+// uses have the same values in both APIs
+void render_graph_record_batch2(Render_Graph &graph, VkCommandBuffer cmd_buf, Render_Graph_Barrier_Batch &batch, Arena *arena)
+{
+    VkMemoryBarrier2 memory_barrier = {};
+    memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    memory_barrier.srcStageMask = batch.src_stage;
+    memory_barrier.srcAccessMask = batch.memory_src_access;
+    memory_barrier.dstStageMask = batch.dst_stage;
+    memory_barrier.dstAccessMask = batch.memory_dst_access;
+
+    Arena_Vector<VkImageMemoryBarrier2> image_barriers(batch.image_barriers.size(), VkImageMemoryBarrier2{}, arena);
+    for (u32 i = 0; i < batch.image_barriers.size(); i++)
+    {
+        Render_Graph_Image_Barrier &barrier = batch.image_barriers[i];
+        Render_Graph_Resource &resource = graph.resources[barrier.resource];
+        VkImageMemoryBarrier2 &image_barrier = image_barriers[i];
+        image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        image_barrier.srcStageMask = batch.src_stage;
+        image_barrier.srcAccessMask = barrier.src_access;
+        image_barrier.dstStageMask = batch.dst_stage;
+        image_barrier.dstAccessMask = barrier.dst_access;
+        image_barrier.oldLayout = barrier.old_layout;
+        image_barrier.newLayout = barrier.new_layout;
+        image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        image_barrier.image = resource.image;
+        image_barrier.subresourceRange.aspectMask = resource.aspect;
+        image_barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        image_barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+    }
+
+    // without image barriers the memory barrier carries the execution dependency, see render_graph_record_batch
+    VkDependencyInfo dependency = {};
+    dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency.memoryBarrierCount = (batch.memory_src_access || batch.memory_dst_access || image_barriers.empty()) ? 1 : 0;
+    dependency.pMemoryBarriers = &memory_barrier;
+    dependency.imageMemoryBarrierCount = image_barriers.size();
+    dependency.pImageMemoryBarriers = image_barriers.data();
+    graph.pipeline_barrier2(cmd_buf, &dependency);
+}
+
+void render_graph_record_batch(Render_Graph &graph, VkCommandBuffer cmd_buf, Render_Graph_Barrier_Batch &batch, Arena *arena)
+{
+    if (graph.pipeline_barrier2) return render_graph_record_batch2(graph, cmd_buf, batch, arena);
+
+    // Vulkan 1.0 does not accept empty stage masks, e.g. when the first access to an image has nothing to wait for
+    VkPipelineStageFlags src_stage = batch.src_stage ? batch.src_stage : (VkPipelineStageFlags)VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    VkPipelineStageFlags dst_stage = batch.dst_stage ? batch.dst_stage : (VkPipelineStageFlags)VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+    VkMemoryBarrier memory_barrier = {};
+    memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory_barrier.srcAccessMask = batch.memory_src_access;
+    memory_barrier.dstAccessMask = batch.memory_dst_access;
+    u32 memory_barrier_count = (batch.memory_src_access || batch.memory_dst_access) ? 1 : 0;
+
+    Arena_Vector<VkImageMemoryBarrier> image_barriers(batch.image_barriers.size(), VkImageMemoryBarrier{}, arena);
+    for (u32 i = 0; i < batch.image_barriers.size(); i++)
+    {
+        Render_Graph_Image_Barrier &barrier = batch.image_barriers[i];
+        Render_Graph_Resource &resource = graph.resources[barrier.resource];
+        VkImageMemoryBarrier &image_barrier = image_barriers[i];
+        image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        image_barrier.srcAccessMask = barrier.src_access;
+        image_barrier.dstAccessMask = barrier.dst_access;
+        image_barrier.oldLayout = barrier.old_layout;
+        image_barrier.newLayout = barrier.new_layout;
+        image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        image_barrier.image = resource.image;
+        image_barrier.subresourceRange.aspectMask = resource.aspect;
+        image_barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        image_barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+    }
+
+    // a batch without any barriers is an execution dependency, e.g. a write that has to wait for earlier reads
+    vkCmdPipelineBarrier(cmd_buf, src_stage, dst_stage, 0, memory_barrier_count, &memory_barrier, 0, nullptr, image_barriers.size(), image_barriers.data());
+}
+
+// The barrier arrays are built in `arena` when one is given, e.g. the frame arena of the main loop
+void render_graph_execute(Render_Graph &graph, VkCommandBuffer cmd_buf, Arena *arena = nullptr)
+{
+    u32 next_batch = 0;
+    for (u32 i = 0; i <= graph.order.size(); i++)
+    {
+        while (next_batch < graph.batches.size() && graph.batches[next_batch].pass == i) render_graph_record_batch(graph, cmd_buf, graph.batches[next_batch++], arena);
+        if (i < graph.order.size()) graph.passes[graph.order[i]].record(cmd_buf);
+    }
+}
+
+const char *render_graph_layout_name(VkImageLayout layout)
+{
+    switch (layout)
+    {
+        case VK_IMAGE_LAYOUT_UNDEFINED:                        return "UNDEFINED";
+        case VK_IMAGE_LAYOUT_GENERAL:                          return "GENERAL";
+        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:         return "COLOR_ATTACHMENT";
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL: return "DEPTH_ATTACHMENT";
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:         return "SHADER_READ";
+        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:             return "TRANSFER_SRC";
+        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:             return "TRANSFER_DST";
+        case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:                  return "PRESENT_SRC";
+        default:                                               return "OTHER";
+    }
+}
+
+void render_graph_log(Render_Graph &graph)
+{
+    u32 image_barriers = 0, merged = 0, culled = 0;
+    for (auto &batch : graph.batches) { image_barriers += batch.image_barriers.size(); merged += batch.merged; }
+    for (auto &pass : graph.passes) culled += pass.culled;
+
+    printf("Render graph: %zu passes (%u culled) in %u levels, %zu barrier batches for %u transitions (%u image barriers)\n",
+        graph.passes.size(), culled, graph.level_count, graph.batches.size(), merged, image_barriers);
+    if (graph.unaliased_bytes) printf("  transient images: %.2f MiB, %.2f MiB without aliasing\n", graph.transient_bytes / 1048576.0, graph.unaliased_bytes / 1048576.0);
+
+    u32 next_batch = 0;
+    for (u32 i = 0; i <= graph.order.size(); i++)
+    {
+        while (next_batch < graph.batches.size() && graph.batches[next_batch].pass == i)
+        {
+            Render_Graph_Barrier_Batch &batch = graph.batches[next_batch++];
+            printf("    barrier  src stages %05x -> dst stages %05x, memory access %05x -> %05x\n", batch.src_stage, batch.dst_stage, batch.memory_src_access, batch.memory_dst_access);
+            for (auto &barrier : batch.image_barriers)
+            {
+                printf("      %-16s %-16s -> %-16s access %05x -> %05x\n", graph.resources[barrier.resource].name,
+                    render_graph_layout_name(barrier.old_layout), render_graph_layout_name(barrier.new_layout), barrier.src_access, barrier.dst_access);
+            }
+        }
+        if (i < graph.order.size()) printf("  [level %u] %s\n", graph.passes[graph.order[i]].level, graph.passes[graph.order[i]].name);
+    }
+    for (auto &pass : graph.passes)
+    {
+        if (pass.culled) printf("  culled: %s\n", pass.name);
+    }
+    for (auto &resource : graph.resources)
+    {
+        if (resource.alias_previous != UINT32_MAX) printf("  %s shares memory with %s\n", resource.name, graph.resources[resource.alias_previous].name);
+    }
+}
+
+// Check the compiled barriers against the declared accesses by replaying them on the CPU: every access must find its image in
+// the layout it asked for, and every hazard with an earlier pass must be covered by a batch between the two whose stage masks
+// include both sides. Returns the number of problems, which are logged
+u32 render_graph_validate(Render_Graph &graph)
+{
+    struct Last_Access {
+        u32                  position;  // in `order`, UINT32_MAX before the first pass
+        VkPipelineStageFlags stage;
+        bool                 valid;
+    };
+    std::vector<VkImageLayout> layouts(graph.resources.size(), VK_IMAGE_LAYOUT_UNDEFINED);
+    std::vector<Last_Access>   last_write(graph.resources.size());
+    std::vector<std::vector<Last_Access>> reads_since_write(graph.resources.size());
+    for (u32 r = 0; r < graph.resources.size(); r++)
+    {
+        Render_Graph_Resource &resource = graph.resources[r];
+        if (!resource.imported) continue;
+        layouts[r] = resource.initial.layout;
+        if (resource.initial.stage) last_write[r] = { UINT32_MAX, resource.initial.stage, true };
+    }
+
+    u32 errors = 0;
+    auto covered = [&](Last_Access &earlier, u32 position, VkPipelineStageFlags stage) {
+        u32 from = earlier.position == UINT32_MAX ? 0 : earlier.position + 1;
+        for (auto &batch : graph.batches)
+        {
+            if (batch.pass >= from && batch.pass <= position && (batch.src_stage & earlier.stage) && (batch.dst_stage & stage)) return true;
+        }
+        return false;
+    };
+    auto check = [&](u32 r, u32 position, Render_Graph_State state, bool write, const char *what) {
+        Render_Graph_Resource &resource = graph.resources[r];
+        if (resource.is_image && state.layout != VK_IMAGE_LAYOUT_UNDEFINED && layouts[r] != state.layout)
+        {
+            printf("  render graph: %s expects %s in layout %d, but it is in %d\n", what, resource.name, state.layout, layouts[r]);
+            errors++;
+        }
+        if (last_write[r].valid && !covered(last_write[r], position, state.stage))
+        {
+            printf("  render graph: %s accesses %s without waiting for its last write\n", what, resource.name);
+            errors++;
+        }
+        if (write)
+        {
+            for (auto &read : reads_since_write[r])
+            {
+                if (covered(read, position, state.stage)) continue;
+                printf("  render graph: %s writes %s without waiting for an earlier read\n", what, resource.name);
+                errors++;
+            }
+            last_write[r] = { position, state.stage, true };
+            reads_since_write[r].clear();
+        }
+        else
+        {
+            reads_since_write[r].push_back({ position, state.stage, true });
+        }
+    };
+
+    u32 next_batch = 0;
+    for (u32 i = 0; i <= graph.order.size(); i++)
+    {
+        while (next_batch < graph.batches.size() && graph.batches[next_batch].pass == i)
+        {
+            for (auto &barrier : graph.batches[next_batch].image_barriers)
+            {
+                if (barrier.old_layout != VK_IMAGE_LAYOUT_UNDEFINED && barrier.old_layout != layouts[barrier.resource])
+                {
+                    printf("  render graph: barrier transitions %s from layout %d, but it is in %d\n", graph.resources[barrier.resource].name, barrier.old_layout, layouts[barrier.resource]);
+                    errors++;
+                }
+                layouts[barrier.resource] = barrier.new_layout;
+            }
+            next_batch++;
+        }
+
+        if (i == graph.order.size()) break;
+        Render_Graph_Pass &pass = graph.passes[graph.order[i]];
+        for (auto &access : pass.accesses)
+        {
+            Render_Graph_Usage_Info info = render_graph_usage_info(access.usage);
+            check(access.resource, i, info.state, info.write, pass.name);
+        }
+    }
+
+    for (u32 r = 0; r < graph.resources.size(); r++)
+    {
+        Render_Graph_Resource &resource = graph.resources[r];
+        if (resource.exported) check(r, graph.order.size(), resource.final, false, "the end of the graph");
+    }
+    return errors;
+}
+
+// A deferred-style frame of transient images rendering into the imported `backbuffer`, which is returned: 8 passes, one of which
+// ("debug overlay") is never read and gets culled
+u32 render_graph_build_deferred(Render_Graph &graph)
+{
+    const VkExtent2D full = { 1920, 1080 };
+    const VkExtent2D half = { 960, 540 };
+
+    auto nothing = [](VkCommandBuffer) {};
+    u32 output = render_graph_import_image(graph, "backbuffer", VK_IMAGE_ASPECT_COLOR_BIT, { 0, 0, VK_IMAGE_LAYOUT_UNDEFINED },
+                                           { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL });
+    u32 depth    = render_graph_create_image(graph, "depth",    VK_FORMAT_D16_UNORM, full, VK_IMAGE_ASPECT_DEPTH_BIT);
+    u32 albedo   = render_graph_create_image(graph, "albedo",   VK_FORMAT_R8G8B8A8_UNORM, full);
+    u32 normals  = render_graph_create_image(graph, "normals",  VK_FORMAT_R16G16B16A16_SFLOAT, full);
+    u32 lighting = render_graph_create_image(graph, "lighting", VK_FORMAT_R16G16B16A16_SFLOAT, full);
+    u32 bloom_a  = render_graph_create_image(graph, "bloom a",  VK_FORMAT_R16G16B16A16_SFLOAT, half);
+    u32 bloom_b  = render_graph_create_image(graph, "bloom b",  VK_FORMAT_R16G16B16A16_SFLOAT, half);
+    u32 shadow   = render_graph_create_image(graph, "shadow map", VK_FORMAT_D16_UNORM, { 2048, 2048 }, VK_IMAGE_ASPECT_DEPTH_BIT);
+    u32 debug    = render_graph_create_image(graph, "debug",    VK_FORMAT_R8G8B8A8_UNORM, full);
+
+    render_graph_add_pass(graph, "depth prepass", { { depth, RENDER_GRAPH_DEPTH_ATTACHMENT } }, nothing);
+    render_graph_add_pass(graph, "shadows",       { { shadow, RENDER_GRAPH_DEPTH_ATTACHMENT } }, nothing);
+    render_graph_add_pass(graph, "gbuffer",       { { depth, RENDER_GRAPH_DEPTH_ATTACHMENT }, { albedo, RENDER_GRAPH_COLOR_ATTACHMENT }, { normals, RENDER_GRAPH_COLOR_ATTACHMENT } }, nothing);
+    render_graph_add_pass(graph, "debug overlay", { { depth, RENDER_GRAPH_SAMPLED }, { debug, RENDER_GRAPH_COLOR_ATTACHMENT } }, nothing);
+    render_graph_add_pass(graph, "lighting",      { { albedo, RENDER_GRAPH_SAMPLED }, { normals, RENDER_GRAPH_SAMPLED }, { depth, RENDER_GRAPH_SAMPLED }, { shadow, RENDER_GRAPH_SAMPLED }, { lighting, RENDER_GRAPH_COLOR_ATTACHMENT } }, nothing);
+    render_graph_add_pass(graph, "bloom down",    { { lighting, RENDER_GRAPH_SAMPLED }, { bloom_a, RENDER_GRAPH_COLOR_ATTACHMENT } }, nothing);
+    render_graph_add_pass(graph, "bloom blur",    { { bloom_a, RENDER_GRAPH_SAMPLED }, { bloom_b, RENDER_GRAPH_COLOR_ATTACHMENT } }, nothing);
+    render_graph_add_pass(graph, "composite",     { { lighting, RENDER_GRAPH_SAMPLED }, { bloom_b, RENDER_GRAPH_SAMPLED }, { output, RENDER_GRAPH_COLOR_ATTACHMENT } }, nothing);
+    return output;
+}
+
+// The deferred frame of render_graph_build_deferred compiled, validated and logged, then timed: compiling it (CPU only) and recording
+// its barriers. The pass bodies are empty, so one execution is also submitted to let the validation layer check the barriers
+void render_graph_benchmark(Device_Context &ctx)
+{
+    const VkExtent2D full = { 1920, 1080 };
+    const u32        iterations = 1000;
+
+    VkResult vr = VK_SUCCESS;
+
+    VkImage        backbuffer = {};
+    Gpu_Allocation backbuffer_allocation = {};
+    {
+        VkImageCreateInfo image_info = {};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+        image_info.extent = { full.width, full.height, 1 };
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        vr = gpu_create_image(*ctx.allocator, image_info, GPU_MEMORY_USAGE_DEVICE_LOCAL, backbuffer, backbuffer_allocation);
+        CHECK_RESULT(vr);
+    }
+
+    std::cout << std::endl << "Render graph benchmark: 8 passes, 8 transient images, " << iterations << " iterations" << std::endl;
+
+    Render_Graph graph = {};
+    u32 output = render_graph_build_deferred(graph);
+    render_graph_compile(graph, &ctx);
+    render_graph_set_image(graph, output, backbuffer);
+    render_graph_log(graph);
+    u32 errors = render_graph_validate(graph);
+    printf("  barrier validation: %s (%u problems)\n", errors ? "FAILED" : "passed", errors);
+
+    f64 compile_seconds = 0.0;
+    for (u32 i = 0; i < iterations; i++)
+    {
+        Render_Graph cpu_graph = {};
+        auto start = std::chrono::steady_clock::now();
+        render_graph_build_deferred(cpu_graph);
+        render_graph_compile(cpu_graph, nullptr);
+        compile_seconds += std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    VkCommandPool   pool = {};
+    VkCommandBuffer cmd_buf = {};
+    VkFence         fence = {};
+    {
+        VkCommandPoolCreateInfo pool_info = {};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        pool_info.queueFamilyIndex = ctx.graphics_family;
+        vr = vkCreateCommandPool(ctx.device, &pool_info, nullptr, &pool);
+        CHECK_RESULT(vr);
+
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandPool = pool;
+        alloc_info.commandBufferCount = 1;
+        vr = vkAllocateCommandBuffers(ctx.device, &alloc_info, &cmd_buf);
+        CHECK_RESULT(vr);
+
+        VkFenceCreateInfo fence_info = {};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        vr = vkCreateFence(ctx.device, &fence_info, nullptr, &fence);
+        CHECK_RESULT(vr);
+    }
+
+    f64 record_seconds = 0.0;
+    for (u32 i = 0; i <= iterations; i++)
+    {
+        vr = vkResetCommandPool(ctx.device, pool, 0);
+        CHECK_RESULT(vr);
+
+        auto start = std::chrono::steady_clock::now();
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vr = vkBeginCommandBuffer(cmd_buf, &begin_info);
+        CHECK_RESULT(vr);
+        render_graph_execute(graph, cmd_buf);
+        vr = vkEndCommandBuffer(cmd_buf);
+        CHECK_RESULT(vr);
+        if (i > 0) record_seconds += std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // the last recording goes to the GPU once
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &cmd_buf;
+    vr = vkQueueSubmit(ctx.graphics_queue, 1, &submit_info, fence);
+    CHECK_RESULT(vr);
+    vr = vkWaitForFences(ctx.device, 1, &fence, VK_TRUE, UINT64_MAX);
+    CHECK_RESULT(vr);
+
+    printf("  compile: %8.2f us   record: %8.2f us   (%zu vkCmdPipelineBarrier calls per frame)\n",
+        compile_seconds * 1e6 / iterations, record_seconds * 1e6 / iterations, graph.batches.size());
+
+    vkDestroyFence(ctx.device, fence, nullptr);
+    vkDestroyCommandPool(ctx.device, pool, nullptr);
+    render_graph_destroy(graph, ctx);
+    gpu_destroy_image(*ctx.allocator, backbuffer, backbuffer_allocation);
+}
@@ -0,0 +1,371 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "capture_format.h"
+#include "compute.h"
+#include "gpu_allocator.h"
+#include "headless.h"
+#include "pipelines.h"
+#include "profiler.h"
+
+//
+// FRAME REPLAY
+// Executes the frames of a capture (see src/capture_format.h) headless, one at a time, and times recording and submitting each of
+// them; waiting for the GPU is not part of either. Used by `--bench replay` over the committed captures/ and by tools/replay.cpp
+// The command entry points come from a table, like the allocator's memory functions: the Vulkan loader's, or no-ops for the null
+// backend, which needs no device at all and leaves the cost of decoding the capture and making the calls
+//
+
+struct Replay_Functions {
+    PFN_vkCmdBeginRenderPass cmd_begin_render_pass;
+    PFN_vkCmdEndRenderPass   cmd_end_render_pass;
+    PFN_vkCmdBindPipeline    cmd_bind_pipeline;
+    PFN_vkCmdSetViewport     cmd_set_viewport;
+    PFN_vkCmdSetScissor      cmd_set_scissor;
+    PFN_vkCmdPushConstants   cmd_push_constants;
+    PFN_vkCmdDraw            cmd_draw;
+    PFN_vkCmdDispatch        cmd_dispatch;
+};
+
+Replay_Functions replay_functions_vulkan()
+{
+    Replay_Functions functions = {};
+    functions.cmd_begin_render_pass = vkCmdBeginRenderPass;
+    functions.cmd_end_render_pass   = vkCmdEndRenderPass;
+    functions.cmd_bind_pipeline     = vkCmdBindPipeline;
+    functions.cmd_set_viewport      = vkCmdSetViewport;
+    functions.cmd_set_scissor       = vkCmdSetScissor;
+    functions.cmd_push_constants    = vkCmdPushConstants;
+    functions.cmd_draw              = vkCmdDraw;
+    functions.cmd_dispatch          = vkCmdDispatch;
+    return functions;
+}
+
+VKAPI_ATTR void VKAPI_CALL replay_null_begin_render_pass(VkCommandBuffer, const VkRenderPassBeginInfo *, VkSubpassContents) {}
+VKAPI_ATTR void VKAPI_CALL replay_null_end_render_pass(VkCommandBuffer) {}
+VKAPI_ATTR void VKAPI_CALL replay_null_bind_pipeline(VkCommandBuffer, VkPipelineBindPoint, VkPipeline) {}
+VKAPI_ATTR void VKAPI_CALL replay_null_set_viewport(VkCommandBuffer, u32, u32, const VkViewport *) {}
+VKAPI_ATTR void VKAPI_CALL replay_null_set_scissor(VkCommandBuffer, u32, u32, const VkRect2D *) {}
+VKAPI_ATTR void VKAPI_CALL replay_null_push_constants(VkCommandBuffer, VkPipelineLayout, VkShaderStageFlags, u32, u32, const void *) {}
+VKAPI_ATTR void VKAPI_CALL replay_null_draw(VkCommandBuffer, u32, u32, u32, u32) {}
+VKAPI_ATTR void VKAPI_CALL replay_null_dispatch(VkCommandBuffer, u32, u32, u32) {}
+
+Replay_Functions replay_functions_null()
+{
+    Replay_Functions functions = {};
+    functions.cmd_begin_render_pass = replay_null_begin_render_pass;
+    functions.cmd_end_render_pass   = replay_null_end_render_pass;
+    functions.cmd_bind_pipeline     = replay_null_bind_pipeline;
+    functions.cmd_set_viewport      = replay_null_set_viewport;
+    functions.cmd_set_scissor       = replay_null_set_scissor;
+    functions.cmd_push_constants    = replay_null_push_constants;
+    functions.cmd_draw              = replay_null_draw;
+    functions.cmd_dispatch          = replay_null_dispatch;
+    return functions;
+}
+
+// What replaying on a device needs: a pipeline for every Capture_Pipeline, a target for the passes and a command buffer
+// With the null backend `ctx` is nullptr and every handle stays VK_NULL_HANDLE
+struct Replay_Context {
+    Device_Context     *ctx;
+    Replay_Functions    functions;
+
+    VkRenderPass        render_pass;
+    Headless_Target     target;
+    VkCommandPool       cmd_pool;
+    VkCommandBuffer     cmd_buf;
+    VkFence             fence;
+
+    Shader_Module_Cache modules;
+    VkPipelineLayout    triangle_layout;
+    VkPipeline          triangle_pipeline;
+    Compute_Pipeline    cull;
+
+    VkPipeline          pipelines[CAPTURE_PIPELINE_COUNT];
+    VkPipelineLayout    layouts[CAPTURE_PIPELINE_COUNT];
+    VkShaderStageFlags  push_stages[CAPTURE_PIPELINE_COUNT];
+    VkPipelineBindPoint bind_points[CAPTURE_PIPELINE_COUNT];
+};
+
+// `extent` is the largest frame of the captures to replay; smaller frames render into a corner of the target
+void replay_context_create(Replay_Context &replay, Device_Context *ctx, VkExtent2D extent)
+{
+    VkResult vr = VK_SUCCESS;
+
+    replay = {};
+    replay.ctx = ctx;
+    replay.functions = ctx ? replay_functions_vulkan() : replay_functions_null();
+    replay.push_stages[CAPTURE_PIPELINE_TRIANGLE] = VK_SHADER_STAGE_VERTEX_BIT;
+    replay.push_stages[CAPTURE_PIPELINE_CULL]     = VK_SHADER_STAGE_COMPUTE_BIT;
+    replay.bind_points[CAPTURE_PIPELINE_TRIANGLE] = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    replay.bind_points[CAPTURE_PIPELINE_CULL]     = VK_PIPELINE_BIND_POINT_COMPUTE;
+    if (!ctx) return;
+
+    replay.render_pass       = create_present_render_pass(ctx->device, HEADLESS_FORMAT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    replay.triangle_layout   = create_triangle_pipeline_layout(ctx->device);
+    replay.triangle_pipeline = create_triangle_pipeline(ctx->device, VK_NULL_HANDLE, replay.modules, replay.render_pass, replay.triangle_layout);
+    replay.cull              = compute_pipeline_create(ctx->device, VK_NULL_HANDLE, replay.modules, SHADER_DIR "replay.comp.spv", 0, CAPTURE_MAX_PUSH_CONSTANTS,
+                                                       compute_local_size(*ctx, 64));
+    replay.pipelines[CAPTURE_PIPELINE_TRIANGLE] = replay.triangle_pipeline;
+    replay.layouts[CAPTURE_PIPELINE_TRIANGLE]   = replay.triangle_layout;
+    replay.pipelines[CAPTURE_PIPELINE_CULL]     = replay.cull.pipeline;
+    replay.layouts[CAPTURE_PIPELINE_CULL]       = replay.cull.layout;
+
+    headless_target_create(replay.target, *ctx->allocator, ctx->device, replay.render_pass, extent, 1);
+
+    VkCommandPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_info.queueFamilyIndex = ctx->graphics_family;
+    vr = vkCreateCommandPool(ctx->device, &pool_info, nullptr, &replay.cmd_pool);
+    CHECK_RESULT(vr);
+
+    VkCommandBufferAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandPool = replay.cmd_pool;
+    alloc_info.commandBufferCount = 1;
+    vr = vkAllocateCommandBuffers(ctx->device, &alloc_info, &replay.cmd_buf);
+    CHECK_RESULT(vr);
+
+    VkFenceCreateInfo fence_info = {};
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    vr = vkCreateFence(ctx->device, &fence_info, nullptr, &replay.fence);
+    CHECK_RESULT(vr);
+}
+
+void replay_context_destroy(Replay_Context &replay)
+{
+    if (!replay.ctx) return;
+
+    VkDevice device = replay.ctx->device;
+    vkDestroyFence(device, replay.fence, nullptr);
+    vkDestroyCommandPool(device, replay.cmd_pool, nullptr);
+    headless_target_destroy(replay.target, *replay.ctx->allocator, device);
+    compute_pipeline_destroy(device, replay.cull);
+    vkDestroyPipeline(device, replay.triangle_pipeline, nullptr);
+    vkDestroyPipelineLayout(device, replay.triangle_layout, nullptr);
+    shader_module_cache_destroy(device, replay.modules);
+    vkDestroyRenderPass(device, replay.render_pass, nullptr);
+    replay = {};
+}
+
+// The largest frame of a capture, for replay_context_create
+VkExtent2D capture_max_extent(const Capture_File &file)
+{
+    VkExtent2D extent = { 1, 1 };
+    for (usize i = 0; i + 1 < file.frames.size(); i++)
+    {
+        usize offset = file.frames[i];
+        Capture_Command command = {};
+        capture_decode(file.data, offset, command);
+        extent.width  = std::max(extent.width,  command.operands[0]);
+        extent.height = std::max(extent.height, command.operands[1]);
+    }
+    return extent;
+}
+
+// Record the commands of frame `frame` into `cmd_buf`, which is recording outside of a render pass
+void replay_record_frame(Replay_Context &replay, const Capture_File &file, u32 frame, VkCommandBuffer cmd_buf)
+{
+    const Replay_Functions &functions = replay.functions;
+    VkExtent2D extent = {};
+    u32        pipeline = 0;
+
+    usize offset = file.frames[frame];
+    while (offset < file.frames[frame + 1])
+    {
+        Capture_Command command = {};
+        capture_decode(file.data, offset, command);
+        switch (command.op)
+        {
+            case CAPTURE_OP_FRAME:
+            {
+                extent.width  = std::min(command.operands[0], std::max(replay.target.extent.width, 1u));
+                extent.height = std::min(command.operands[1], std::max(replay.target.extent.height, 1u));
+                break;
+            }
+            case CAPTURE_OP_BEGIN_PASS:
+            {
+                VkClearValue clear_value = {};
+                VkRenderPassBeginInfo begin_info = {};
+                begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                begin_info.renderPass = replay.render_pass;
+                begin_info.framebuffer = replay.target.framebuffers.size() > 0 ? replay.target.framebuffers[0] : VK_NULL_HANDLE;
+                begin_info.renderArea.extent = extent;
+                begin_info.clearValueCount = 1;
+                begin_info.pClearValues = &clear_value;
+                functions.cmd_begin_render_pass(cmd_buf, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+                break;
+            }
+            case CAPTURE_OP_END_PASS:
+                functions.cmd_end_render_pass(cmd_buf);
+                break;
+            case CAPTURE_OP_PIPELINE:
+                pipeline = command.operands[0];
+                functions.cmd_bind_pipeline(cmd_buf, replay.bind_points[pipeline], replay.pipelines[pipeline]);
+                break;
+            case CAPTURE_OP_VIEWPORT:
+            {
+                VkViewport viewport = {};
+                viewport.width = (f32)extent.width;
+                viewport.height = (f32)extent.height;
+                viewport.maxDepth = 1.0f;
+                VkRect2D scissor = {};
+                scissor.extent = extent;
+                functions.cmd_set_viewport(cmd_buf, 0, 1, &viewport);
+                functions.cmd_set_scissor(cmd_buf, 0, 1, &scissor);
+                break;
+            }
+            case CAPTURE_OP_PUSH:
+                functions.cmd_push_constants(cmd_buf, replay.layouts[pipeline], replay.push_stages[pipeline], 0, command.push_size, command.push_data);
+                break;
+            case CAPTURE_OP_DRAW:
+                functions.cmd_draw(cmd_buf, command.operands[0], command.operands[1], command.operands[2], command.operands[3]);
+                break;
+            case CAPTURE_OP_DISPATCH:
+                functions.cmd_dispatch(cmd_buf, command.operands[0], command.operands[1], command.operands[2]);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Per-frame CPU times of a replay, in microseconds
+struct Replay_Stats {
+    std::vector<f64> record_us;
+    std::vector<f64> submit_us;
+};
+
+// Replay every frame of `file` `passes` times after one untimed pass, which warms up the driver's command pools and the caches
+void replay_run(Replay_Context &replay, const Capture_File &file, u32 passes, Replay_Stats &stats)
+{
+    VkResult vr = VK_SUCCESS;
+    Device_Context *ctx = replay.ctx;
+    u32 frame_count = file.frames.size() - 1;
+
+    stats = {};
+    for (u32 pass = 0; pass <= passes; pass++)
+    {
+        for (u32 frame = 0; frame < frame_count; frame++)
+        {
+            if (ctx)
+            {
+                vr = vkResetCommandPool(ctx->device, replay.cmd_pool, 0);
+                CHECK_RESULT(vr);
+            }
+
+            auto record_start = std::chrono::steady_clock::now();
+            if (ctx)
+            {
+                VkCommandBufferBeginInfo begin_info = {};
+                begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                vr = vkBeginCommandBuffer(replay.cmd_buf, &begin_info);
+                CHECK_RESULT(vr);
+            }
+            replay_record_frame(replay, file, frame, replay.cmd_buf);
+            if (ctx)
+            {
+                vr = vkEndCommandBuffer(replay.cmd_buf);
+                CHECK_RESULT(vr);
+            }
+            auto submit_start = std::chrono::steady_clock::now();
+
+            if (ctx)
+            {
+                VkSubmitInfo submit_info = {};
+                submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submit_info.commandBufferCount = 1;
+                submit_info.pCommandBuffers = &replay.cmd_buf;
+                vr = vkQueueSubmit(ctx->graphics_queue, 1, &submit_info, replay.fence);
+                CHECK_RESULT(vr);
+            }
+            auto submit_end = std::chrono::steady_clock::now();
+
+            if (ctx)
+            {
+                vr = vkWaitForFences(ctx->device, 1, &replay.fence, VK_TRUE, UINT64_MAX);
+                CHECK_RESULT(vr);
+                vr = vkResetFences(ctx->device, 1, &replay.fence);
+                CHECK_RESULT(vr);
+            }
+
+            if (pass == 0) continue;
+            stats.record_us.push_back(std::chrono::duration<f64, std::micro>(submit_start - record_start).count());
+            stats.submit_us.push_back(std::chrono::duration<f64, std::micro>(submit_end - submit_start).count());
+        }
+    }
+}
+
+void replay_print_stats(const char *name, const char *backend, const Capture_File &file, Replay_Stats &stats)
+{
+    f64 record_total = 0.0, submit_total = 0.0;
+    for (f64 us : stats.record_us) record_total += us;
+    for (f64 us : stats.submit_us) submit_total += us;
+    usize count = std::max<usize>(stats.record_us.size(), 1);
+    u32   frame_count = file.frames.size() - 1;
+
+    printf("  %-24s %-6s %4u frames %7.0f commands/frame  record avg %9.1f p99 %9.1f us  submit avg %7.1f p99 %7.1f us\n",
+           name, backend, frame_count, (f64)file.command_count / std::max(frame_count, 1u),
+           record_total / count, percentile(stats.record_us, 0.99), submit_total / count, percentile(stats.submit_us, 0.99));
+}
+
+// Every .cap file under `path`, or `path` itself when it is a file, sorted by name
+std::vector<std::string> replay_list_captures(const char *path)
+{
+    std::vector<std::string> paths = {};
+    std::error_code error = {};
+    if (std::filesystem::is_directory(path, error))
+    {
+        for (const auto &entry : std::filesystem::directory_iterator(path, error))
+        {
+            if (entry.is_regular_file(error) && entry.path().extension() == ".cap") paths.push_back(entry.path().string());
+        }
+    }
+    else paths.push_back(path);
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+//
+// BENCHMARK
+// `--bench replay`: every capture under `dir` (the committed suite in captures/, or the `--capture` path), replayed on the selected
+// device and then on the null backend, whose times are the floor that decoding and calling through the table costs
+//
+
+void replay_benchmark(Device_Context &ctx, const char *dir, u32 passes = 4)
+{
+    std::vector<std::string> paths = replay_list_captures(dir);
+    std::cout << std::endl << "Replay benchmark: " << paths.size() << " captures from " << dir << ", " << passes << " passes each" << std::endl;
+
+    for (const auto &path : paths)
+    {
+        Capture_File file = {};
+        if (!capture_read(path.c_str(), file))
+        {
+            std::cout << "  " << path << ": not a valid capture" << std::endl;
+            continue;
+        }
+        std::string name = std::filesystem::path(path).filename().string();
+
+        Replay_Context replay = {};
+        Replay_Stats   stats = {};
+        replay_context_create(replay, &ctx, capture_max_extent(file));
+        replay_run(replay, file, passes, stats);
+        replay_print_stats(name.c_str(), "device", file, stats);
+        replay_context_destroy(replay);
+
+        replay_context_create(replay, nullptr, capture_max_extent(file));
+        replay_run(replay, file, passes, stats);
+        replay_print_stats(name.c_str(), "null", file, stats);
+    }
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
+#include "pipeline_cache.h"
+#include "asset_format.h"
+
+//
+// STARTUP TIMING
+// main() marks the end of every startup phase; the breakdown is printed once the first frame has been submitted, so the total
+// is the time to the first frame
+//
+
+typedef std::chrono::steady_clock Startup_Clock;
+
+struct Startup_Phase {
+    const char *name;
+    f64         ms;
+};
+
+struct Startup_Timer {
+    Startup_Clock::time_point  start;
+    Startup_Clock::time_point  last;   // end of the previous phase
+    std::vector<Startup_Phase> phases;
+};
+
+void startup_timer_init(Startup_Timer &timer)
+{
+    timer = {};
+    timer.start = Startup_Clock::now();
+    timer.last = timer.start;
+}
+
+// End the current phase, which started where the previous one ended
+void startup_phase(Startup_Timer &timer, const char *name)
+{
+    Startup_Clock::time_point now = Startup_Clock::now();
+    timer.phases.push_back({ name, std::chrono::duration<f64, std::milli>(now - timer.last).count() });
+    timer.last = now;
+}
+
+//
+// STARTUP PRELOAD
+// Files that startup needs but that do not depend on the device are read on a background thread while the main thread creates
+// the instance and device: the pipeline cache, the shaders and the asset pack to stream (mapped, with its tables validated)
+// The main thread collects them with startup_preload_wait right before their first use
+//
+
+struct Startup_Preload {
+    std::thread thread;
+
+    // inputs, set before startup_preload_begin
+    const char              *pipeline_cache_path; // nullptr to skip
+    std::vector<const char *> shader_paths;
+    const char              *asset_pack_path;     // nullptr to skip
+
+    // outputs, valid after startup_preload_wait
+    std::vector<u8>                                  pipeline_cache_data; // empty if there is no cache file
+    std::unordered_map<std::string, std::vector<u8>> shaders;             // only the files that could be read
+    Asset_Pack                                       asset_pack;
+    bool                                             asset_pack_valid;
+    f64                                              ms;                  // time the thread took
+    f64                                              waited_ms;           // time the main thread spent blocked on it
+};
+
+void startup_preload_run(Startup_Preload &preload)
+{
+    Startup_Clock::time_point start = Startup_Clock::now();
+
+    if (preload.pipeline_cache_path && !read_file(preload.pipeline_cache_path, preload.pipeline_cache_data)) preload.pipeline_cache_data.clear();
+
+    for (const char *path : preload.shader_paths)
+    {
+        std::vector<u8> code = {};
+        if (read_file(path, code)) preload.shaders[path] = std::move(code);
+    }
+
+    if (preload.asset_pack_path) preload.asset_pack_valid = asset_pack_open(preload.asset_pack, preload.asset_pack_path);
+
+    preload.ms = std::chrono::duration<f64, std::milli>(Startup_Clock::now() - start).count();
+}
+
+void startup_preload_begin(Startup_Preload &preload)
+{
+    preload.thread = std::thread(startup_preload_run, std::ref(preload));
+}
+
+// Block until the preload thread is done; does nothing after the first call
+void startup_preload_wait(Startup_Preload &preload)
+{
+    if (!preload.thread.joinable()) return;
+
+    Startup_Clock::time_point start = Startup_Clock::now();
+    preload.thread.join();
+    preload.waited_ms = std::chrono::duration<f64, std::milli>(Startup_Clock::now() - start).count();
+}
+
+f64 startup_total_ms(Startup_Timer &timer)
+{
+    return std::chrono::duration<f64, std::milli>(timer.last - timer.start).count();
+}
+
+// `title` names what was timed, "Startup" or "Device recovery"; `preload` may be nullptr when nothing was preloaded
+void startup_print_summary(Startup_Timer &timer, Startup_Preload *preload, const char *title)
+{
+    f64 total = startup_total_ms(timer);
+    printf("\n%s: %.1f ms to the first frame\n", title, total);
+    for (auto &phase : timer.phases) printf("  %-18s %8.1f ms %5.1f%%\n", phase.name, phase.ms, total > 0.0 ? phase.ms * 100.0 / total : 0.0);
+    if (preload) printf("  %-18s %8.1f ms on a background thread, %.1f ms of it waited for\n", "file preload", preload->ms, preload->waited_ms);
+}
+
+//
+// DEVICE RECOVERY
+// When the device is lost while rendering, main() tears down everything on it and builds it all again, see run_device_session
+// The startup timer is restarted as soon as the loss is detected, so the recovery is broken down into the same phases as startup,
+// from the teardown of the lost device to the first frame on the new one
+//
+
+struct Device_Recovery {
+    u32              count;  // devices lost and rebuilt
+    u64              frames; // frames rendered by the sessions that have ended
+    std::vector<f64> ms;     // loss to the next first frame, for every recovery that got that far
+};
+
+void device_recovery_print_summary(Device_Recovery &recovery)
+{
+    if (recovery.count == 0) return;
+
+    f64 total = 0.0;
+    f64 max = 0.0;
+    for (f64 ms : recovery.ms) { total += ms; max = std::max(max, ms); }
+    printf("Device recovery: %u lost, %zu recovered", recovery.count, recovery.ms.size());
+    if (recovery.ms.size() > 0) printf(" in %.1f ms on average, %.1f ms at most", total / recovery.ms.size(), max);
+    printf("\n");
+}
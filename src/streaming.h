@@ -0,0 +1,347 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "gpu_allocator.h"
+#include "upload.h"
+#include "asset_format.h"
+#include "assets.h"
+
+//
+// ASSET STREAMING
+// Streams the meshes and textures of an asset pack in and out of device memory while frames are rendered
+//
+// Requests are ordered by priority (lower is more important, e.g. the distance to the camera). Worker threads take the most important
+// request and prepare it: assets come from a memory-mapped pack, so preparing is faulting its pages in, which moves the disk reads off
+// the main thread. Once a frame the main thread uploads prepared assets through the upload ring, at most `frame_upload_bytes` of them,
+// so a burst of requests is spread over several frames instead of stalling one; the frame's upload batch makes them resident
+// When resident assets would exceed the budget, the least recently used ones are evicted; an asset is only evicted once no frame
+// still in flight can use it
+//
+
+enum Stream_State {
+    STREAM_STATE_NONE,
+    STREAM_STATE_QUEUED,    // waiting in the request queue
+    STREAM_STATE_PREPARING, // a worker is faulting its data in
+    STREAM_STATE_PREPARED,  // waiting for upload bandwidth and budget
+    STREAM_STATE_UPLOADING, // copies queued in upload batch `upload_serial`
+    STREAM_STATE_RESIDENT,
+    STREAM_STATE_FAILED,    // cannot be loaded on this device, e.g. an unsupported texture format
+};
+
+struct Stream_Asset {
+    Stream_State state;
+    f32          priority;
+    u64          bytes;
+    u64          upload_serial;
+    u64          last_used_frame;
+    Gpu_Mesh     mesh;
+    Gpu_Texture  texture;
+};
+
+struct Stream_Request {
+    f32  priority;
+    u32  asset;
+    bool operator<(const Stream_Request &other) const { return priority > other.priority; } // std::priority_queue pops the largest
+};
+
+struct Stream_Stats {
+    u64 requests;
+    u64 uploads;
+    u64 uploaded_bytes;
+    u64 max_frame_bytes;     // most bytes uploaded in one frame
+    u64 evictions;
+    u64 evicted_bytes;
+    u64 over_budget;         // prepared assets dropped because nothing could be evicted for them
+    u64 peak_resident_bytes;
+    f64 max_update_ms;       // longest streamer_update, i.e. the worst hitch streaming added to a frame
+};
+
+struct Streamer {
+    Device_Context             *ctx;
+    Upload_Context             *upload;
+    Asset_Pack                 *pack;
+    std::vector<Stream_Asset>   assets;    // meshes first, then textures, in pack order
+    u64                         budget;
+    u64                         frame_upload_bytes;
+    u32                         frames_in_flight;
+    u64                         resident_bytes; // resident and uploading
+
+    std::vector<std::thread>    workers;
+    std::mutex                  mutex;     // guards the queue, the prepared list and the state of queued/preparing assets
+    std::condition_variable     work_ready;
+    std::priority_queue<Stream_Request> queue; // may hold stale entries for assets whose priority changed, see streamer_request
+    std::vector<u32>            prepared;
+    std::vector<u32>            uploading;
+    bool                        quit;
+
+    Stream_Stats                stats;
+
+    ~Streamer();
+};
+
+// Half of the device-local heaps, which leaves room for everything that is not streamed
+u64 streamer_default_budget(Device_Context &ctx)
+{
+    u64 device_local = 0;
+    for (u32 i = 0; i < ctx.mem_props.memoryHeapCount; i++)
+    {
+        if (ctx.mem_props.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) device_local += ctx.mem_props.memoryHeaps[i].size;
+    }
+    return device_local / 2;
+}
+
+u64 streamer_asset_bytes(Asset_Pack &pack, u32 asset)
+{
+    if (asset < pack.header->mesh_count)
+    {
+        const Asset_Mesh &mesh = pack.meshes[asset];
+        return (u64)mesh.vertex_count * sizeof(Asset_Vertex) + (u64)mesh.index_count * sizeof(u32);
+    }
+    const Asset_Texture &texture = pack.textures[asset - pack.header->mesh_count];
+    u64 bytes = 0;
+    for (u32 level = 0; level < texture.mip_count; level++) bytes += texture.mip_sizes[level];
+    return bytes;
+}
+
+// Touch one byte per page of a block of the mapping, so the page faults (and disk reads) happen on the calling thread
+u64 streamer_fault_in(const u8 *data, u64 size)
+{
+    u64 sum = 0;
+    for (u64 offset = 0; offset < size; offset += 4096) sum += data[offset];
+    if (size > 0) sum += data[size - 1];
+    return sum;
+}
+
+void streamer_worker(Streamer *streamer)
+{
+    Asset_Pack &pack = *streamer->pack;
+    volatile u64 sink = 0;
+    for (;;)
+    {
+        u32 asset = 0;
+        {
+            std::unique_lock<std::mutex> lock(streamer->mutex);
+            streamer->work_ready.wait(lock, [&]() { return streamer->quit || !streamer->queue.empty(); });
+            if (streamer->quit) return;
+
+            Stream_Request request = streamer->queue.top();
+            streamer->queue.pop();
+            Stream_Asset &entry = streamer->assets[request.asset];
+            if (entry.state != STREAM_STATE_QUEUED || entry.priority != request.priority) continue; // stale
+            entry.state = STREAM_STATE_PREPARING;
+            asset = request.asset;
+        }
+
+        if (asset < pack.header->mesh_count)
+        {
+            const Asset_Mesh &mesh = pack.meshes[asset];
+            sink += streamer_fault_in(pack.file.data + mesh.vertex_offset, (u64)mesh.vertex_count * sizeof(Asset_Vertex));
+            sink += streamer_fault_in(pack.file.data + mesh.index_offset,  (u64)mesh.index_count  * sizeof(u32));
+        }
+        else
+        {
+            const Asset_Texture &texture = pack.textures[asset - pack.header->mesh_count];
+            for (u32 level = 0; level < texture.mip_count; level++) sink += streamer_fault_in(pack.file.data + texture.mip_offsets[level], texture.mip_sizes[level]);
+        }
+
+        std::lock_guard<std::mutex> lock(streamer->mutex);
+        streamer->assets[asset].state = STREAM_STATE_PREPARED;
+        streamer->prepared.push_back(asset);
+    }
+}
+
+// `budget` 0 uses streamer_default_budget; the pack must stay open until streamer_destroy
+void streamer_init(Streamer &streamer, Device_Context &ctx, Upload_Context &upload, Asset_Pack &pack, u32 worker_count, u64 budget, u64 frame_upload_bytes, u32 frames_in_flight)
+{
+    streamer.ctx = &ctx;
+    streamer.upload = &upload;
+    streamer.pack = &pack;
+    streamer.assets.assign(pack.header->mesh_count + pack.header->texture_count, {});
+    for (u32 i = 0; i < streamer.assets.size(); i++) streamer.assets[i].bytes = streamer_asset_bytes(pack, i);
+    streamer.budget = budget > 0 ? budget : streamer_default_budget(ctx);
+    streamer.frame_upload_bytes = frame_upload_bytes;
+    streamer.frames_in_flight = frames_in_flight;
+    streamer.resident_bytes = 0;
+    streamer.quit = false;
+    streamer.stats = {};
+
+    for (u32 i = 0; i < std::max(1u, worker_count); i++) streamer.workers.emplace_back(streamer_worker, &streamer);
+}
+
+void streamer_release(Streamer &streamer, Stream_Asset &entry)
+{
+    if (entry.mesh.vertex_buffer) gpu_mesh_destroy(entry.mesh, *streamer.ctx->allocator);
+    if (entry.texture.image) gpu_texture_destroy(entry.texture, *streamer.ctx->allocator);
+    streamer.resident_bytes -= entry.bytes;
+    entry.state = STREAM_STATE_NONE;
+}
+
+// The device must be idle
+void streamer_stop_workers(Streamer &streamer)
+{
+    {
+        std::lock_guard<std::mutex> lock(streamer.mutex);
+        streamer.quit = true;
+    }
+    streamer.work_ready.notify_all();
+    for (auto &worker : streamer.workers) worker.join();
+    streamer.workers.clear();
+}
+
+// An exception unwinding past a streamer that was never destroyed only stops its workers; the device is not usable by then anyway
+Streamer::~Streamer()
+{
+    streamer_stop_workers(*this);
+}
+
+void streamer_destroy(Streamer &streamer)
+{
+    streamer_stop_workers(streamer);
+
+    for (auto &entry : streamer.assets)
+    {
+        if (entry.state == STREAM_STATE_RESIDENT || entry.state == STREAM_STATE_UPLOADING) streamer_release(streamer, entry);
+    }
+    streamer.assets.clear();
+}
+
+// Ask for an asset with the given priority, or update the priority of a pending request; does nothing once the asset is past the queue
+void streamer_request(Streamer &streamer, u32 asset, f32 priority)
+{
+    std::lock_guard<std::mutex> lock(streamer.mutex);
+    Stream_Asset &entry = streamer.assets[asset];
+    if (entry.state != STREAM_STATE_NONE && entry.state != STREAM_STATE_QUEUED) return;
+    if (entry.state == STREAM_STATE_QUEUED && entry.priority == priority) return;
+
+    // a changed priority pushes a new entry; the old one is skipped as stale when it reaches the top
+    if (entry.state == STREAM_STATE_NONE) streamer.stats.requests++;
+    entry.state = STREAM_STATE_QUEUED;
+    entry.priority = priority;
+    streamer.queue.push({ priority, asset });
+    streamer.work_ready.notify_one();
+}
+
+// Mark an asset as used by frame `frame_number`; returns whether it is resident and may be used
+bool streamer_use(Streamer &streamer, u32 asset, u64 frame_number)
+{
+    std::lock_guard<std::mutex> lock(streamer.mutex);
+    Stream_Asset &entry = streamer.assets[asset];
+    if (entry.state != STREAM_STATE_RESIDENT) return false;
+    entry.last_used_frame = frame_number;
+    return true;
+}
+
+// Evict least recently used assets until `bytes` more fit in the budget; only assets no frame in flight uses are candidates
+bool streamer_make_room(Streamer &streamer, u64 bytes, u64 frame_number)
+{
+    if (streamer.resident_bytes + bytes <= streamer.budget) return true;
+
+    std::vector<u32> candidates;
+    for (u32 i = 0; i < streamer.assets.size(); i++)
+    {
+        Stream_Asset &entry = streamer.assets[i];
+        if (entry.state == STREAM_STATE_RESIDENT && entry.last_used_frame + streamer.frames_in_flight <= frame_number) candidates.push_back(i);
+    }
+    std::sort(candidates.begin(), candidates.end(), [&](u32 a, u32 b) { return streamer.assets[a].last_used_frame < streamer.assets[b].last_used_frame; });
+
+    for (u32 asset : candidates)
+    {
+        if (streamer.resident_bytes + bytes <= streamer.budget) break;
+        streamer.stats.evictions++;
+        streamer.stats.evicted_bytes += streamer.assets[asset].bytes;
+        streamer_release(streamer, streamer.assets[asset]);
+    }
+    return streamer.resident_bytes + bytes <= streamer.budget;
+}
+
+// Once per frame on the main thread, after the frame's fence wait and before upload_flush: finishes completed uploads, then queues
+// the most important prepared assets for upload within the per-frame limit, evicting as needed
+// Asset states only change with the mutex held; it is released while an asset's data is copied into the staging ring
+void streamer_update(Streamer &streamer, u64 frame_number)
+{
+    auto start = std::chrono::steady_clock::now();
+    Upload_Context &upload = *streamer.upload;
+    std::unique_lock<std::mutex> lock(streamer.mutex);
+
+    upload_reclaim(upload);
+    for (usize i = 0; i < streamer.uploading.size();)
+    {
+        Stream_Asset &entry = streamer.assets[streamer.uploading[i]];
+        if (upload_is_complete(upload, entry.upload_serial))
+        {
+            entry.state = STREAM_STATE_RESIDENT;
+            streamer.uploading[i] = streamer.uploading.back();
+            streamer.uploading.pop_back();
+        }
+        else i++;
+    }
+
+    std::vector<u32> prepared;
+    std::swap(prepared, streamer.prepared);
+    std::sort(prepared.begin(), prepared.end(), [&](u32 a, u32 b) { return streamer.assets[a].priority < streamer.assets[b].priority; });
+
+    u64 frame_bytes = 0;
+    u32 mesh_count = streamer.pack->header->mesh_count;
+    for (u32 asset : prepared)
+    {
+        Stream_Asset &entry = streamer.assets[asset];
+
+        // an asset larger than the limit still goes through, alone, or it would never be uploaded
+        if (frame_bytes > 0 && frame_bytes + entry.bytes > streamer.frame_upload_bytes)
+        {
+            streamer.prepared.push_back(asset);
+            continue;
+        }
+        if (!streamer_make_room(streamer, entry.bytes, frame_number))
+        {
+            // everything resident is in use; it can be requested again once something is not
+            streamer.stats.over_budget++;
+            entry.state = STREAM_STATE_NONE;
+            continue;
+        }
+
+        // the entry is PREPARED, which neither the workers nor streamer_request touch
+        lock.unlock();
+        bool ok = true;
+        if (asset < mesh_count) asset_pack_upload_mesh(*streamer.pack, asset, upload, *streamer.ctx->allocator, entry.mesh);
+        else ok = asset_pack_upload_texture(*streamer.pack, asset - mesh_count, upload, *streamer.ctx, entry.texture);
+        lock.lock();
+
+        if (!ok)
+        {
+            entry.state = STREAM_STATE_FAILED;
+            continue;
+        }
+
+        // the copies are in the next batch, or an earlier one if the ring filled up meanwhile
+        entry.state = STREAM_STATE_UPLOADING;
+        entry.upload_serial = upload.submitted_serial + 1;
+        entry.last_used_frame = frame_number;
+        streamer.uploading.push_back(asset);
+        streamer.resident_bytes += entry.bytes;
+        frame_bytes += entry.bytes;
+        streamer.stats.uploads++;
+        streamer.stats.uploaded_bytes += entry.bytes;
+    }
+
+    streamer.stats.max_frame_bytes = std::max(streamer.stats.max_frame_bytes, frame_bytes);
+    streamer.stats.peak_resident_bytes = std::max(streamer.stats.peak_resident_bytes, streamer.resident_bytes);
+    streamer.stats.max_update_ms = std::max(streamer.stats.max_update_ms, std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+void streamer_print_summary(Streamer &streamer)
+{
+    Stream_Stats &stats = streamer.stats;
+    printf("Streaming: %llu requests, %llu uploads (%.1f MB, at most %.1f MB in a frame), %llu evictions (%.1f MB), %llu over budget | resident peak %.1f of %.1f MB | longest update %.3f ms\n",
+           (unsigned long long)stats.requests, (unsigned long long)stats.uploads, stats.uploaded_bytes / 1e6, stats.max_frame_bytes / 1e6,
+           (unsigned long long)stats.evictions, stats.evicted_bytes / 1e6, (unsigned long long)stats.over_budget,
+           stats.peak_resident_bytes / 1e6, streamer.budget / 1e6, stats.max_update_ms);
+}
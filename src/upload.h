@@ -0,0 +1,513 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "common.h"
+#include "gpu_allocator.h"
+#include "arena.h"
+
+//
+// STAGING UPLOADS
+// Streams buffer and image data to device-local memory through one persistently mapped staging ring
+//
+// Callers copy their data into the ring straight away and queue the copy; nothing is recorded until upload_flush,
+// which emits one vkCmdCopyBuffer per destination buffer and one vkCmdCopyBufferToImage per destination image
+// in a single command buffer and a single submission, normally once per frame
+// Uploads run on the transfer queue, which may be a dedicated family (see select_physical_device_queues)
+//
+// Every flush is a numbered batch with its own fence; batch numbers behave like timeline semaphore values, so
+// ring space and completion can be polled without blocking. The CPU only waits when the ring is full
+//
+
+// Stages that consume uploaded data; graphics submissions wait on an upload semaphore at these stages
+#define UPLOAD_CONSUMER_STAGES (VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT)
+
+struct Upload_Buffer_Copy {
+    VkBuffer     dst;
+    VkBufferCopy region;
+};
+
+struct Upload_Image_Copy {
+    VkImage           dst;
+    VkBufferImageCopy region;
+    VkImageLayout     final_layout;
+};
+
+struct Upload_Batch {
+    VkCommandBuffer cmd_buf;
+    VkFence         fence;
+    VkSemaphore     semaphore;
+    u64             serial;    // 0 while the slot is unused
+    u64             ring_end;  // ring head when the batch was submitted; everything before it is free once the fence signals
+    bool            in_flight;
+};
+
+struct Upload_Stats {
+    u64 bytes;
+    u64 buffer_copies;
+    u64 image_copies;
+    u64 submissions;
+    u64 stalls;        // times the CPU had to wait for ring space
+};
+
+struct Upload_Context {
+    VkDevice       device;
+    VkQueue        queue;
+    u32            queue_families[2]; // transfer family, then the family that consumes the data
+    u32            queue_family_count;
+    VkCommandPool  cmd_pool;
+
+    VkBuffer       staging;
+    Gpu_Allocation staging_allocation;
+    u8            *mapped;
+    VkDeviceSize   capacity;
+    VkDeviceSize   image_alignment;
+
+    // monotonic byte counters; the ring position is counter % capacity
+    u64            head;
+    u64            tail;
+
+    std::vector<Upload_Batch>       batches;
+    u64                             submitted_serial;
+    u64                             completed_serial;
+    std::vector<Upload_Buffer_Copy> buffer_copies;
+    std::vector<Upload_Image_Copy>  image_copies;
+    Arena                           scratch;  // region and barrier arrays of the batch being recorded, reset by every flush
+
+    Upload_Stats   stats;
+};
+
+void upload_init(Upload_Context &upload, Device_Context &ctx, VkDeviceSize capacity, u32 batch_count = 4)
+{
+    VkResult vr = VK_SUCCESS;
+
+    upload = {};
+    upload.device   = ctx.device;
+    upload.queue    = ctx.transfer_queue;
+    upload.capacity = capacity;
+    upload.queue_families[0]  = ctx.transfer_family;
+    upload.queue_families[1]  = ctx.graphics_family;
+    upload.queue_family_count = ctx.transfer_family == ctx.graphics_family ? 1 : 2;
+
+    // image copies need offsets aligned to the texel block size (at most 16 bytes for the formats we use) and 4 bytes
+    upload.image_alignment = std::max<VkDeviceSize>(16, ctx.props.limits.optimalBufferCopyOffsetAlignment);
+    arena_init(upload.scratch, 16 << 10);
+
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = capacity;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    vr = gpu_create_buffer(*ctx.allocator, buffer_info, GPU_MEMORY_USAGE_UPLOAD, upload.staging, upload.staging_allocation);
+    CHECK_RESULT(vr);
+    upload.mapped = (u8 *)upload.staging_allocation.mapped;
+
+    VkCommandPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT; // batches complete out of step with each other
+    pool_info.queueFamilyIndex = ctx.transfer_family;
+    vr = vkCreateCommandPool(upload.device, &pool_info, nullptr, &upload.cmd_pool);
+    CHECK_RESULT(vr);
+
+    upload.batches.resize(batch_count);
+    for (auto &batch : upload.batches)
+    {
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandPool = upload.cmd_pool;
+        alloc_info.commandBufferCount = 1;
+        vr = vkAllocateCommandBuffers(upload.device, &alloc_info, &batch.cmd_buf);
+        CHECK_RESULT(vr);
+
+        VkFenceCreateInfo fence_info = {};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        vr = vkCreateFence(upload.device, &fence_info, nullptr, &batch.fence);
+        CHECK_RESULT(vr);
+
+        VkSemaphoreCreateInfo semaphore_info = {};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        vr = vkCreateSemaphore(upload.device, &semaphore_info, nullptr, &batch.semaphore);
+        CHECK_RESULT(vr);
+    }
+}
+
+void upload_destroy(Upload_Context &upload, Gpu_Allocator &allocator)
+{
+    for (auto &batch : upload.batches)
+    {
+        vkDestroySemaphore(upload.device, batch.semaphore, nullptr);
+        vkDestroyFence(upload.device, batch.fence, nullptr);
+    }
+    vkDestroyCommandPool(upload.device, upload.cmd_pool, nullptr);
+    gpu_destroy_buffer(allocator, upload.staging, upload.staging_allocation);
+    arena_destroy(upload.scratch);
+    upload = {};
+}
+
+// Resources written by uploads and read on the graphics queue must be shared between both families when they differ,
+// instead of transferring ownership with a release/acquire barrier pair for every upload
+void upload_apply_sharing(Upload_Context &upload, VkBufferCreateInfo &info)
+{
+    info.sharingMode           = upload.queue_family_count > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    info.queueFamilyIndexCount = upload.queue_family_count > 1 ? upload.queue_family_count : 0;
+    info.pQueueFamilyIndices   = upload.queue_family_count > 1 ? upload.queue_families : nullptr;
+}
+
+void upload_apply_sharing(Upload_Context &upload, VkImageCreateInfo &info)
+{
+    info.sharingMode           = upload.queue_family_count > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    info.queueFamilyIndexCount = upload.queue_family_count > 1 ? upload.queue_family_count : 0;
+    info.pQueueFamilyIndices   = upload.queue_family_count > 1 ? upload.queue_families : nullptr;
+}
+
+// Release the ring space of every batch that has finished, oldest first, without blocking
+void upload_reclaim(Upload_Context &upload)
+{
+    while (upload.completed_serial < upload.submitted_serial)
+    {
+        Upload_Batch &batch = upload.batches[(upload.completed_serial + 1) % upload.batches.size()];
+        if (batch.in_flight)
+        {
+            VkResult vr = vkGetFenceStatus(upload.device, batch.fence);
+            if (vr == VK_NOT_READY) break;
+            CHECK_RESULT(vr);
+            batch.in_flight = false;
+        }
+        upload.tail = std::max(upload.tail, batch.ring_end);
+        upload.completed_serial = batch.serial;
+    }
+}
+
+// Block until batch `serial` has completed
+void upload_wait(Upload_Context &upload, u64 serial)
+{
+    if (serial <= upload.completed_serial || serial > upload.submitted_serial) return;
+
+    Upload_Batch &batch = upload.batches[serial % upload.batches.size()];
+    VkResult vr = vkWaitForFences(upload.device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+    CHECK_RESULT(vr);
+    upload_reclaim(upload);
+}
+
+bool upload_is_complete(Upload_Context &upload, u64 serial)
+{
+    upload_reclaim(upload);
+    return serial <= upload.completed_serial;
+}
+
+u64 upload_flush(Upload_Context &upload, VkSemaphore *signal_semaphore = nullptr);
+
+// Reserve `size` contiguous bytes of the ring; returns the offset into the staging buffer
+// Submits the pending copies and waits for the oldest batch when the ring is full; `size` must not exceed the ring's capacity
+VkDeviceSize upload_reserve(Upload_Context &upload, VkDeviceSize size, VkDeviceSize alignment)
+{
+    for (;;)
+    {
+        upload_reclaim(upload);
+
+        // align within the ring and wrap to the start when the allocation would straddle the end
+        u64 start = (upload.head + alignment - 1) & ~(u64)(alignment - 1);
+        if ((start % upload.capacity) + size > upload.capacity) start += upload.capacity - (start % upload.capacity);
+
+        if (start + size - upload.tail <= upload.capacity)
+        {
+            upload.head = start + size;
+            return start % upload.capacity;
+        }
+
+        // out of space: make the pending copies reclaimable, then wait for the oldest batch
+        upload.stats.stalls++;
+        if (upload.buffer_copies.size() > 0 || upload.image_copies.size() > 0) upload_flush(upload);
+        upload_wait(upload, upload.completed_serial + 1);
+    }
+}
+
+// Queue a copy of `size` bytes into `dst` at `dst_offset`; data larger than the ring is split into ring-sized pieces
+void upload_buffer(Upload_Context &upload, VkBuffer dst, VkDeviceSize dst_offset, const void *data, VkDeviceSize size)
+{
+    while (size > 0)
+    {
+        VkDeviceSize chunk  = std::min(size, upload.capacity / 2);
+        VkDeviceSize offset = upload_reserve(upload, chunk, 16);
+        memcpy(upload.mapped + offset, data, chunk);
+
+        Upload_Buffer_Copy copy = {};
+        copy.dst = dst;
+        copy.region.srcOffset = offset;
+        copy.region.dstOffset = dst_offset;
+        copy.region.size      = chunk;
+        upload.buffer_copies.push_back(copy);
+
+        upload.stats.bytes += chunk;
+        upload.stats.buffer_copies++;
+        data        = (const u8 *)data + chunk;
+        dst_offset += chunk;
+        size       -= chunk;
+    }
+}
+
+// Queue a copy of one subresource region of `dst`; `region.bufferOffset` is filled in here
+// The region must cover whole mip levels: the image is transitioned from VK_IMAGE_LAYOUT_UNDEFINED, discarding the level's previous contents,
+// and left in `final_layout`. `size` must fit in the ring
+void upload_image(Upload_Context &upload, VkImage dst, VkBufferImageCopy region, const void *data, VkDeviceSize size, VkImageLayout final_layout)
+{
+    VkDeviceSize offset = upload_reserve(upload, size, upload.image_alignment);
+    memcpy(upload.mapped + offset, data, size);
+
+    Upload_Image_Copy copy = {};
+    copy.dst = dst;
+    copy.region = region;
+    copy.region.bufferOffset = offset;
+    copy.final_layout = final_layout;
+    upload.image_copies.push_back(copy);
+
+    upload.stats.bytes += size;
+    upload.stats.image_copies++;
+}
+
+// Record and submit every queued copy as one batch; returns the batch number, or the last batch number if nothing was queued
+// When `signal_semaphore` is given and the batch has work, it receives a semaphore the consuming submission MUST wait on (at UPLOAD_CONSUMER_STAGES),
+// otherwise it is set to VK_NULL_HANDLE
+u64 upload_flush(Upload_Context &upload, VkSemaphore *signal_semaphore)
+{
+    VkResult vr = VK_SUCCESS;
+
+    if (signal_semaphore) *signal_semaphore = VK_NULL_HANDLE;
+    if (upload.buffer_copies.size() == 0 && upload.image_copies.size() == 0) return upload.submitted_serial;
+
+    // the slot for this batch was last used batch_count batches ago
+    u64 serial = upload.submitted_serial + 1;
+    Upload_Batch &batch = upload.batches[serial % upload.batches.size()];
+    if (batch.in_flight) upload_wait(upload, batch.serial);
+
+    vr = vkResetCommandBuffer(batch.cmd_buf, 0);
+    CHECK_RESULT(vr);
+    arena_reset(upload.scratch);
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vr = vkBeginCommandBuffer(batch.cmd_buf, &begin_info);
+    CHECK_RESULT(vr);
+
+    // buffers: one vkCmdCopyBuffer per destination, with all of its regions
+    std::stable_sort(upload.buffer_copies.begin(), upload.buffer_copies.end(), [](const Upload_Buffer_Copy &a, const Upload_Buffer_Copy &b) { return a.dst < b.dst; });
+    Arena_Vector<VkBufferCopy> buffer_regions(&upload.scratch);
+    for (usize i = 0; i < upload.buffer_copies.size();)
+    {
+        usize first = i;
+        buffer_regions.clear();
+        for (; i < upload.buffer_copies.size() && upload.buffer_copies[i].dst == upload.buffer_copies[first].dst; i++) buffer_regions.push_back(upload.buffer_copies[i].region);
+        vkCmdCopyBuffer(batch.cmd_buf, upload.staging, upload.buffer_copies[first].dst, buffer_regions.size(), buffer_regions.data());
+    }
+
+    // images: one barrier batch into TRANSFER_DST, one vkCmdCopyBufferToImage per destination, one barrier batch into the final layouts
+    if (upload.image_copies.size() > 0)
+    {
+        std::stable_sort(upload.image_copies.begin(), upload.image_copies.end(), [](const Upload_Image_Copy &a, const Upload_Image_Copy &b) { return a.dst < b.dst; });
+
+        Arena_Vector<VkImageMemoryBarrier> to_transfer(&upload.scratch);
+        Arena_Vector<VkImageMemoryBarrier> to_final(&upload.scratch);
+        for (usize i = 0; i < upload.image_copies.size(); i++)
+        {
+            Upload_Image_Copy &copy = upload.image_copies[i];
+
+            // one transition per subresource, even if several regions target it
+            bool seen = false;
+            for (usize j = 0; j < i && !seen; j++)
+            {
+                Upload_Image_Copy &other = upload.image_copies[j];
+                seen = other.dst == copy.dst && other.region.imageSubresource.mipLevel == copy.region.imageSubresource.mipLevel && other.region.imageSubresource.baseArrayLayer == copy.region.imageSubresource.baseArrayLayer;
+            }
+            if (seen) continue;
+
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = copy.dst;
+            barrier.subresourceRange.aspectMask     = copy.region.imageSubresource.aspectMask;
+            barrier.subresourceRange.baseMipLevel   = copy.region.imageSubresource.mipLevel;
+            barrier.subresourceRange.levelCount     = 1;
+            barrier.subresourceRange.baseArrayLayer = copy.region.imageSubresource.baseArrayLayer;
+            barrier.subresourceRange.layerCount     = copy.region.imageSubresource.layerCount;
+            to_transfer.push_back(barrier);
+
+            // visibility for the consumer comes from the semaphore; a transfer-only queue cannot name shader stages here
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = copy.final_layout;
+            to_final.push_back(barrier);
+        }
+        vkCmdPipelineBarrier(batch.cmd_buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, to_transfer.size(), to_transfer.data());
+
+        Arena_Vector<VkBufferImageCopy> image_regions(&upload.scratch);
+        for (usize i = 0; i < upload.image_copies.size();)
+        {
+            usize first = i;
+            image_regions.clear();
+            for (; i < upload.image_copies.size() && upload.image_copies[i].dst == upload.image_copies[first].dst; i++) image_regions.push_back(upload.image_copies[i].region);
+            vkCmdCopyBufferToImage(batch.cmd_buf, upload.staging, upload.image_copies[first].dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, image_regions.size(), image_regions.data());
+        }
+
+        vkCmdPipelineBarrier(batch.cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, to_final.size(), to_final.data());
+    }
+
+    vr = vkEndCommandBuffer(batch.cmd_buf);
+    CHECK_RESULT(vr);
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &batch.cmd_buf;
+    if (signal_semaphore)
+    {
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &batch.semaphore;
+        *signal_semaphore = batch.semaphore;
+    }
+
+    vr = vkResetFences(upload.device, 1, &batch.fence);
+    CHECK_RESULT(vr);
+    vr = vkQueueSubmit(upload.queue, 1, &submit_info, batch.fence);
+    CHECK_RESULT(vr);
+
+    batch.serial    = serial;
+    batch.ring_end  = upload.head;
+    batch.in_flight = true;
+    upload.submitted_serial = serial;
+    upload.stats.submissions++;
+
+    upload.buffer_copies.clear();
+    upload.image_copies.clear();
+    return serial;
+}
+
+//
+// BENCHMARK
+// Upload throughput for small, large and mixed buffer uploads plus a texture, `--bench upload`
+// A "frame" is flushed every 8 MiB so batching behaves as it would in the main loop
+//
+
+void upload_benchmark(Device_Context &ctx)
+{
+    VkResult vr = VK_SUCCESS;
+
+    const VkDeviceSize ring_size  = 64ull << 20;
+    const VkDeviceSize dst_size   = 256ull << 20;
+    const VkDeviceSize frame_size = 8ull << 20;
+    const VkDeviceSize total_size = 512ull << 20;
+    const u32          texture_extent = 2048;
+
+    Upload_Context upload = {};
+    upload_init(upload, ctx, ring_size);
+
+    VkBuffer       dst_buffer = {};
+    Gpu_Allocation dst_buffer_allocation = {};
+    {
+        VkBufferCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        info.size = dst_size;
+        info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+        upload_apply_sharing(upload, info);
+        vr = gpu_create_buffer(*ctx.allocator, info, GPU_MEMORY_USAGE_DEVICE_LOCAL, dst_buffer, dst_buffer_allocation);
+        CHECK_RESULT(vr);
+    }
+
+    VkImage        dst_image = {};
+    Gpu_Allocation dst_image_allocation = {};
+    {
+        VkImageCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        info.imageType = VK_IMAGE_TYPE_2D;
+        info.format = VK_FORMAT_R8G8B8A8_UNORM;
+        info.extent = { texture_extent, texture_extent, 1 };
+        info.mipLevels = 1;
+        info.arrayLayers = 1;
+        info.samples = VK_SAMPLE_COUNT_1_BIT;
+        info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        upload_apply_sharing(upload, info);
+        vr = gpu_create_image(*ctx.allocator, info, GPU_MEMORY_USAGE_DEVICE_LOCAL, dst_image, dst_image_allocation);
+        CHECK_RESULT(vr);
+    }
+
+    // source data, deterministic so runs are comparable
+    std::vector<u8> source(16ull << 20);
+    u32 state = 0x12345678;
+    for (auto &byte : source) { state = state * 1664525u + 1013904223u; byte = state >> 24; }
+
+    // small uploads are 64 B - 4 KiB, large uploads 1 - 16 MiB
+    struct Scenario { const char *name; u32 small_percent; bool texture; };
+    const Scenario scenarios[] = {
+        { "small (64 B - 4 KiB)",   100, false },
+        { "large (1 - 16 MiB)",     0,   false },
+        { "mixed (99% small)",      99,  false },
+        { "texture (2048^2 RGBA8)", 0,   true  },
+    };
+
+    std::cout << std::endl << "Upload benchmark: " << (total_size >> 20) << " MiB per scenario, " << (ring_size >> 20) << " MiB ring, flushing every " << (frame_size >> 20) << " MiB";
+    std::cout << (ctx.transfer_family != ctx.graphics_family ? " (dedicated transfer queue)" : " (graphics queue)") << std::endl;
+
+    for (auto &scenario : scenarios)
+    {
+        upload.stats = {};
+        VkDeviceSize uploaded = 0, since_flush = 0, dst_offset = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        while (uploaded < total_size)
+        {
+            VkDeviceSize size = 0;
+            if (scenario.texture)
+            {
+                size = (VkDeviceSize)texture_extent * texture_extent * 4;
+                VkBufferImageCopy region = {};
+                region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                region.imageSubresource.layerCount = 1;
+                region.imageExtent = { texture_extent, texture_extent, 1 };
+                upload_image(upload, dst_image, region, source.data(), size, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+            }
+            else
+            {
+                state = state * 1664525u + 1013904223u;
+                bool small = (state >> 8) % 100 < scenario.small_percent;
+                VkDeviceSize min_size = small ? 64 : 1 << 20;
+                VkDeviceSize max_size = small ? 4 << 10 : 16 << 20;
+                size = min_size + (state % (max_size - min_size + 1));
+
+                if (dst_offset + size > dst_size) dst_offset = 0;
+                upload_buffer(upload, dst_buffer, dst_offset, source.data() + (source.size() - size) / 2, size);
+                dst_offset += size;
+            }
+
+            uploaded    += size;
+            since_flush += size;
+            if (since_flush >= frame_size)
+            {
+                upload_flush(upload);
+                since_flush = 0;
+            }
+        }
+        upload_wait(upload, upload_flush(upload));
+
+        f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+        u64 copies  = upload.stats.buffer_copies + upload.stats.image_copies;
+        printf("  %-26s %9.1f MB/s  %10.0f copies/s  %6llu submissions  %4llu stalls\n",
+               scenario.name, uploaded / seconds / 1e6, copies / seconds, (unsigned long long)upload.stats.submissions, (unsigned long long)upload.stats.stalls);
+    }
+
+    vr = vkDeviceWaitIdle(ctx.device);
+    CHECK_RESULT(vr);
+    gpu_destroy_image(*ctx.allocator, dst_image, dst_image_allocation);
+    gpu_destroy_buffer(*ctx.allocator, dst_buffer, dst_buffer_allocation);
+    upload_destroy(upload, *ctx.allocator);
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "test.h"
+
+//
+// DEVICE SELECTION
+// score_physical_device and select_physical_device_queues on hand-built devices, see main.cpp
+//
+
+struct Test_Queue_Family {
+    VkQueueFlags flags;
+    u32          count;
+};
+
+// A device with one device-local heap of `vram_mib`; families that can do graphics are the suitable ones, as with a surface
+// that every family can present to
+Physical_Device_Detials test_device(VkPhysicalDeviceType type, u64 vram_mib, std::vector<Test_Queue_Family> families)
+{
+    Physical_Device_Detials device = {};
+    device.props.deviceType = type;
+    device.props.limits.maxImageDimension2D = 16384;
+    device.mem_props.memoryHeapCount = 1;
+    device.mem_props.memoryHeaps[0].size = vram_mib << 20;
+    device.mem_props.memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+    for (u32 i = 0; i < families.size(); i++)
+    {
+        Queue_Family_Details family = {};
+        family.index = i;
+        family.props.queueFlags = families[i].flags;
+        family.props.queueCount = families[i].count;
+        family.present_support = true;
+        family.suitable = (families[i].flags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        device.queue_families.push_back(family);
+    }
+    device.suitable = true;
+    select_physical_device_queues(device);
+    return device;
+}
+
+const VkQueueFlags TEST_GRAPHICS = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+
+TEST(device_selection_integrated_ranks_above_discrete_by_default)
+{
+    Physical_Device_Detials discrete   = test_device(VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU,   8192, { { TEST_GRAPHICS, 1 } });
+    Physical_Device_Detials integrated = test_device(VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU, 512,  { { TEST_GRAPHICS, 1 } });
+    CHECK(score_physical_device(integrated, false) > score_physical_device(discrete, false));
+    CHECK(score_physical_device(discrete, true)    > score_physical_device(integrated, true));
+}
+
+TEST(device_selection_type_ranks_above_memory)
+{
+    Physical_Device_Detials virtual_gpu = test_device(VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU, 65536, { { TEST_GRAPHICS, 1 } });
+    Physical_Device_Detials cpu         = test_device(VK_PHYSICAL_DEVICE_TYPE_CPU,         1 << 20, { { TEST_GRAPHICS, 1 } });
+    Physical_Device_Detials discrete    = test_device(VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 256, { { TEST_GRAPHICS, 1 } });
+    CHECK(score_physical_device(discrete, true) > score_physical_device(virtual_gpu, true));
+    CHECK(score_physical_device(virtual_gpu, true) > score_physical_device(cpu, true));
+}
+
+TEST(device_selection_more_memory_wins_within_a_type)
+{
+    Physical_Device_Detials small = test_device(VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 4096, { { TEST_GRAPHICS, 1 }, { VK_QUEUE_COMPUTE_BIT, 1 } });
+    Physical_Device_Detials large = test_device(VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8192, { { TEST_GRAPHICS, 1 } });
+    CHECK(score_physical_device(large, true) > score_physical_device(small, true));
+}
+
+TEST(device_selection_dedicated_queues_break_ties)
+{
+    Physical_Device_Detials shared    = test_device(VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8192, { { TEST_GRAPHICS, 1 } });
+    Physical_Device_Detials compute   = test_device(VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8192, { { TEST_GRAPHICS, 1 }, { VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT, 2 } });
+    Physical_Device_Detials dedicated = test_device(VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8192, { { TEST_GRAPHICS, 1 }, { VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT, 2 }, { VK_QUEUE_TRANSFER_BIT, 1 } });
+    CHECK(score_physical_device(compute, true) > score_physical_device(shared, true));
+    CHECK(score_physical_device(dedicated, true) > score_physical_device(compute, true));
+}
+
+TEST(device_selection_dedicated_compute_family)
+{
+    Physical_Device_Detials device = test_device(VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8192, { { TEST_GRAPHICS, 1 }, { VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT, 2 } });
+    CHECK_EQ(device.graphics_queue.family_index, 0u);
+    CHECK_EQ(device.compute_queue.family_index,  1u);
+    CHECK_EQ(device.compute_queue.queue_index,   0u);
+    // the compute family can transfer too, so it is not a dedicated transfer family; with one graphics queue the role shares it
+    CHECK_EQ(device.transfer_queue.family_index, 0u);
+    CHECK_EQ(device.transfer_queue.queue_index,  0u);
+}
+
+TEST(device_selection_transfer_only_family)
+{
+    Physical_Device_Detials device = test_device(VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8192, { { TEST_GRAPHICS, 16 }, { VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT, 8 }, { VK_QUEUE_TRANSFER_BIT, 2 } });
+    CHECK_EQ(device.graphics_queue.family_index, 0u);
+    CHECK_EQ(device.compute_queue.family_index,  1u);
+    CHECK_EQ(device.transfer_queue.family_index, 2u);
+    CHECK_EQ(device.transfer_queue.queue_index,  0u);
+}
+
+TEST(device_selection_single_family_with_spare_queues)
+{
+    Physical_Device_Detials three = test_device(VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU, 512, { { TEST_GRAPHICS, 3 } });
+    CHECK_EQ(three.graphics_queue.family_index, 0u);
+    CHECK_EQ(three.compute_queue.family_index,  0u);
+    CHECK_EQ(three.transfer_queue.family_index, 0u);
+    CHECK_EQ(three.graphics_queue.queue_index,  0u);
+    CHECK_EQ(three.compute_queue.queue_index,   1u);
+    CHECK_EQ(three.transfer_queue.queue_index,  2u);
+
+    // once the family runs out of queues the last one is shared
+    Physical_Device_Detials two = test_device(VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU, 512, { { TEST_GRAPHICS, 2 } });
+    CHECK_EQ(two.compute_queue.queue_index,  1u);
+    CHECK_EQ(two.transfer_queue.queue_index, 1u);
+}
+
+TEST(device_selection_graphics_is_the_first_suitable_family)
+{
+    // a compute-only family first, as some drivers list them; graphics must still come from the suitable family
+    Physical_Device_Detials device = test_device(VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8192, { { VK_QUEUE_COMPUTE_BIT, 4 }, { TEST_GRAPHICS, 1 }, { TEST_GRAPHICS, 1 } });
+    CHECK_EQ(device.graphics_queue.family_index, 1u);
+    CHECK_EQ(device.compute_queue.family_index,  0u);
+}
+
+// The enumeration cache is written next to run_tests and removed again
+const char *TEST_DEVICE_CACHE_PATH = "run_tests_device_cache.bin";
+
+// Write the cache of `devices`, let `corrupt` change its bytes, and read it back into devices with the same properties
+bool test_device_cache_round_trip(std::vector<Physical_Device_Detials> devices, void (*corrupt)(std::vector<u8> &data), std::vector<Physical_Device_Detials> &read_back)
+{
+    device_cache_write(TEST_DEVICE_CACHE_PATH, true, devices);
+    std::vector<u8> data = {};
+    CHECK(read_file(TEST_DEVICE_CACHE_PATH, data));
+    if (corrupt) corrupt(data);
+    CHECK(write_file(TEST_DEVICE_CACHE_PATH, data.data(), data.size()));
+
+    read_back = devices;
+    for (auto &device : read_back) { device.queue_families.clear(); device.suitable = false; }
+    bool read = device_cache_read(TEST_DEVICE_CACHE_PATH, true, read_back);
+    remove(TEST_DEVICE_CACHE_PATH);
+    return read;
+}
+
+TEST(device_cache_round_trip)
+{
+    std::vector<Physical_Device_Detials> devices = { test_device(VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8192, { { VK_QUEUE_COMPUTE_BIT, 4 }, { TEST_GRAPHICS, 1 } }) };
+    devices[0].queue_families[0].present_support = false;
+    std::vector<Physical_Device_Detials> read_back = {};
+    CHECK(test_device_cache_round_trip(devices, nullptr, read_back));
+    CHECK(read_back[0].suitable);
+    CHECK_EQ(read_back[0].queue_families.size(), 2u);
+    CHECK_EQ(read_back[0].queue_families[1].index, 1u);
+    CHECK_EQ(read_back[0].queue_families[1].props.queueCount, 1u);
+    CHECK(!read_back[0].queue_families[0].present_support && !read_back[0].queue_families[0].suitable);
+    CHECK(read_back[0].queue_families[1].present_support && read_back[0].queue_families[1].suitable);
+}
+
+TEST(device_cache_rejects_corrupt_files)
+{
+    std::vector<Physical_Device_Detials> devices = { test_device(VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8192, { { TEST_GRAPHICS, 1 } }) };
+    std::vector<Physical_Device_Detials> read_back = {};
+
+    // a garbage family count is caught before anything is allocated for it
+    CHECK(!test_device_cache_round_trip(devices, [](std::vector<u8> &data) {
+        u32 count = 0x7fffffff;
+        memcpy(data.data() + sizeof(Device_Cache_Header) + offsetof(Device_Cache_Entry, queue_family_count), &count, sizeof(count));
+    }, read_back));
+    CHECK(!test_device_cache_round_trip(devices, [](std::vector<u8> &data) { data.resize(data.size() - 1); }, read_back));
+    CHECK(!test_device_cache_round_trip(devices, [](std::vector<u8> &data) { data.push_back(0); }, read_back));
+
+    // flags are 0 or 1
+    CHECK(!test_device_cache_round_trip(devices, [](std::vector<u8> &data) {
+        data[sizeof(Device_Cache_Header) + offsetof(Device_Cache_Entry, suitable)] = 2;
+    }, read_back));
+    CHECK(!test_device_cache_round_trip(devices, [](std::vector<u8> &data) {
+        data[sizeof(Device_Cache_Header) + sizeof(Device_Cache_Entry) + offsetof(Device_Cache_Queue_Family, present_support)] = 2;
+    }, read_back));
+    CHECK(!test_device_cache_round_trip(devices, [](std::vector<u8> &data) {
+        data[sizeof(Device_Cache_Header) + sizeof(Device_Cache_Entry) + offsetof(Device_Cache_Queue_Family, suitable)] = 0xff;
+    }, read_back));
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "test.h"
+
+//
+// FAULT INJECTION AND VULKAN RESULTS
+// fault_parse, fault_due and FAULT_INJECT, see src/faults.h, and how CHECK_RESULT tells errors from success codes, see src/common.h
+//
+
+// The injector is global; every test starts from a clean one with only `faults` armed
+void test_faults_arm(std::vector<const char *> faults)
+{
+    fault_injector = {};
+    for (const char *text : faults)
+    {
+        Fault fault = {};
+        bool parsed = fault_parse(text, fault);
+        CHECK(parsed);
+        if (parsed) fault_injector.faults.push_back(fault);
+    }
+}
+
+TEST(faults_parse)
+{
+    Fault fault = {};
+    CHECK(fault_parse("submit:device-lost@200", fault));
+    CHECK_EQ(fault.site, FAULT_SITE_SUBMIT);
+    CHECK_EQ(fault.result, VK_ERROR_DEVICE_LOST);
+    CHECK_EQ(fault.call, 200u);
+
+    CHECK(fault_parse("acquire:not-ready@0", fault));
+    CHECK_EQ(fault.site, FAULT_SITE_ACQUIRE);
+    CHECK_EQ(fault.result, VK_NOT_READY);
+    CHECK_EQ(fault.call, 0u);
+
+    CHECK(fault_parse("present:suboptimal@7", fault));
+    CHECK_EQ(fault.site, FAULT_SITE_PRESENT);
+    CHECK_EQ(fault.result, VK_SUBOPTIMAL_KHR);
+}
+
+TEST(faults_parse_rejects)
+{
+    Fault fault = {};
+    CHECK(!fault_parse("draw:device-lost@1", fault));      // unknown site
+    CHECK(!fault_parse("submits:device-lost@1", fault));   // a site name must match in full
+    CHECK(!fault_parse("submit:lost@1", fault));           // unknown result
+    CHECK(!fault_parse("submit:out-of-date@1", fault));    // a result the site cannot report
+    CHECK(!fault_parse("wait:out-of-memory@1", fault));
+    CHECK(!fault_parse("submit:device-lost", fault));      // no call
+    CHECK(!fault_parse("submit:device-lost@", fault));
+    CHECK(!fault_parse("submit:device-lost@12x", fault));
+    CHECK(!fault_parse("submit@1:device-lost", fault));
+    CHECK(!fault_parse("", fault));
+}
+
+TEST(faults_due_counts_calls_per_site)
+{
+    test_faults_arm({ "submit:device-lost@2", "wait:timeout@0" });
+
+    VkResult vr = VK_SUCCESS;
+    CHECK(fault_due(FAULT_SITE_WAIT, &vr));
+    CHECK_EQ(vr, VK_TIMEOUT);
+    CHECK(!fault_due(FAULT_SITE_WAIT, &vr));
+
+    vr = VK_SUCCESS;
+    CHECK(!fault_due(FAULT_SITE_SUBMIT, &vr));
+    CHECK(!fault_due(FAULT_SITE_SUBMIT, &vr));
+    CHECK_EQ(vr, VK_SUCCESS);
+    CHECK(fault_due(FAULT_SITE_SUBMIT, &vr));
+    CHECK_EQ(vr, VK_ERROR_DEVICE_LOST);
+    CHECK(!fault_due(FAULT_SITE_SUBMIT, &vr));
+
+    CHECK(!fault_due(FAULT_SITE_PRESENT, &vr));
+    CHECK_EQ(fault_injector.calls[FAULT_SITE_SUBMIT], 4u);
+    CHECK_EQ(fault_injector.calls[FAULT_SITE_WAIT], 2u);
+    CHECK_EQ(fault_injector.calls[FAULT_SITE_PRESENT], 1u);
+    CHECK_EQ(fault_injector.injected, 2u);
+    fault_injector = {};
+}
+
+TEST(faults_inject)
+{
+    test_faults_arm({ "submit:device-lost@1", "acquire:suboptimal@0", "present:out-of-date@0" });
+
+    u32 calls = 0;
+    auto call = [&](VkResult result) { calls++; return result; };
+
+    // no fault due: the call is made and its result passes through
+    CHECK_EQ(FAULT_INJECT(FAULT_SITE_SUBMIT, call(VK_ERROR_OUT_OF_HOST_MEMORY)), VK_ERROR_OUT_OF_HOST_MEMORY);
+    CHECK_EQ(calls, 1u);
+
+    // a fault replaces the call
+    CHECK_EQ(FAULT_INJECT(FAULT_SITE_SUBMIT, call(VK_SUCCESS)), VK_ERROR_DEVICE_LOST);
+    CHECK_EQ(calls, 1u);
+
+    // a suboptimal acquire still acquires, and a present still consumes its wait; only their result is replaced
+    CHECK_EQ(FAULT_INJECT(FAULT_SITE_ACQUIRE, call(VK_SUCCESS)), VK_SUBOPTIMAL_KHR);
+    CHECK_EQ(calls, 2u);
+    CHECK_EQ(FAULT_INJECT(FAULT_SITE_PRESENT, call(VK_SUCCESS)), VK_ERROR_OUT_OF_DATE_KHR);
+    CHECK_EQ(calls, 3u);
+    fault_injector = {};
+}
+
+// What CHECK_RESULT(vr) threw, or an error with VK_SUCCESS if it let `vr` through; `line` is set to the line of the CHECK_RESULT
+Vulkan_Error test_check_result(VkResult vr, i32 *line)
+{
+    *line = __LINE__ + 3;
+    try
+    {
+        CHECK_RESULT(vr);
+    }
+    catch (const Vulkan_Error &error)
+    {
+        return error;
+    }
+    return Vulkan_Error{ VK_SUCCESS, nullptr, 0 };
+}
+
+TEST(faults_check_result)
+{
+    i32 line = 0;
+
+    // success codes are for the caller to interpret
+    for (VkResult vr : { VK_SUCCESS, VK_NOT_READY, VK_TIMEOUT, VK_INCOMPLETE, VK_SUBOPTIMAL_KHR }) CHECK_EQ(test_check_result(vr, &line).result, VK_SUCCESS);
+
+    Vulkan_Error error = test_check_result(VK_ERROR_OUT_OF_DEVICE_MEMORY, &line);
+    CHECK_EQ(error.result, VK_ERROR_OUT_OF_DEVICE_MEMORY);
+    CHECK(error.file && strstr(error.file, "faults_tests.h"));
+    CHECK_EQ(error.line, line);
+    CHECK_EQ(test_check_result(VK_ERROR_OUT_OF_DATE_KHR, &line).result, VK_ERROR_OUT_OF_DATE_KHR);
+
+    // a lost device is let through while it is torn down, and no other error is
+    CHECK_EQ(test_check_result(VK_ERROR_DEVICE_LOST, &line).result, VK_ERROR_DEVICE_LOST);
+    vulkan_device_lost = true;
+    CHECK_EQ(test_check_result(VK_ERROR_DEVICE_LOST, &line).result, VK_SUCCESS);
+    CHECK_EQ(test_check_result(VK_ERROR_OUT_OF_HOST_MEMORY, &line).result, VK_ERROR_OUT_OF_HOST_MEMORY);
+    vulkan_device_lost = false;
+}
@@ -0,0 +1,391 @@
+#pragma once
+
+#include <map>
+
+#include "test.h"
+
+//
+// GPU MEMORY ALLOCATOR
+// gpu_allocate/gpu_free and the ring against fake memory entry points and a hand-built memory type table, see src/gpu_allocator.h
+// The fake backs every allocation with host memory, so mapped pointers can be written, and fails allocations of a type once the
+// type's budget is used up
+//
+
+struct Test_Gpu_Memory {
+    std::map<u64, std::vector<u8>> allocations;  // by VkDeviceMemory handle
+    std::map<u64, VkDeviceSize>    buffers;      // size, by VkBuffer handle
+    VkDeviceSize                   budgets[VK_MAX_MEMORY_TYPES];
+    u32                            memory_type_bits;
+    u64                            next_handle;
+    u32                            bind_errors;  // binds whose resource does not fit into the memory after the offset
+};
+
+Test_Gpu_Memory test_gpu_memory = {};
+
+VKAPI_ATTR VkResult VKAPI_CALL test_allocate_memory(VkDevice, const VkMemoryAllocateInfo *info, const VkAllocationCallbacks *, VkDeviceMemory *memory)
+{
+    if (info->allocationSize > test_gpu_memory.budgets[info->memoryTypeIndex]) return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    test_gpu_memory.budgets[info->memoryTypeIndex] -= info->allocationSize;
+
+    u64 handle = ++test_gpu_memory.next_handle;
+    test_gpu_memory.allocations[handle].resize(info->allocationSize);
+    *memory = (VkDeviceMemory)(uptr)handle;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL test_free_memory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks *)
+{
+    test_gpu_memory.allocations.erase((u64)(uptr)memory);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL test_map_memory(VkDevice, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize, VkMemoryMapFlags, void **data)
+{
+    *data = test_gpu_memory.allocations[(u64)(uptr)memory].data() + offset;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL test_unmap_memory(VkDevice, VkDeviceMemory) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL test_create_buffer(VkDevice, const VkBufferCreateInfo *info, const VkAllocationCallbacks *, VkBuffer *buffer)
+{
+    u64 handle = ++test_gpu_memory.next_handle;
+    test_gpu_memory.buffers[handle] = info->size;
+    *buffer = (VkBuffer)(uptr)handle;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL test_destroy_buffer(VkDevice, VkBuffer buffer, const VkAllocationCallbacks *)
+{
+    test_gpu_memory.buffers.erase((u64)(uptr)buffer);
+}
+
+VKAPI_ATTR void VKAPI_CALL test_get_buffer_memory_requirements(VkDevice, VkBuffer buffer, VkMemoryRequirements *requirements)
+{
+    requirements->size = test_gpu_memory.buffers[(u64)(uptr)buffer];
+    requirements->alignment = 256;
+    requirements->memoryTypeBits = test_gpu_memory.memory_type_bits;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL test_bind_buffer_memory(VkDevice, VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize offset)
+{
+    if (offset + test_gpu_memory.buffers[(u64)(uptr)buffer] > test_gpu_memory.allocations[(u64)(uptr)memory].size()) test_gpu_memory.bind_errors++;
+    return VK_SUCCESS;
+}
+
+// Images are not used by these tests
+VKAPI_ATTR VkResult VKAPI_CALL test_create_image(VkDevice, const VkImageCreateInfo *, const VkAllocationCallbacks *, VkImage *) { return VK_ERROR_FEATURE_NOT_PRESENT; }
+VKAPI_ATTR void VKAPI_CALL test_destroy_image(VkDevice, VkImage, const VkAllocationCallbacks *) {}
+VKAPI_ATTR void VKAPI_CALL test_get_image_memory_requirements(VkDevice, VkImage, VkMemoryRequirements *requirements) { *requirements = {}; }
+VKAPI_ATTR VkResult VKAPI_CALL test_bind_image_memory(VkDevice, VkImage, VkDeviceMemory, VkDeviceSize) { return VK_SUCCESS; }
+
+Gpu_Memory_Functions test_gpu_memory_functions()
+{
+    Gpu_Memory_Functions functions = {};
+    functions.allocate_memory                = test_allocate_memory;
+    functions.free_memory                    = test_free_memory;
+    functions.map_memory                     = test_map_memory;
+    functions.unmap_memory                   = test_unmap_memory;
+    functions.create_buffer                  = test_create_buffer;
+    functions.destroy_buffer                 = test_destroy_buffer;
+    functions.get_buffer_memory_requirements = test_get_buffer_memory_requirements;
+    functions.bind_buffer_memory             = test_bind_buffer_memory;
+    functions.create_image                   = test_create_image;
+    functions.destroy_image                  = test_destroy_image;
+    functions.get_image_memory_requirements  = test_get_image_memory_requirements;
+    functions.bind_image_memory              = test_bind_image_memory;
+    return functions;
+}
+
+// A discrete GPU's memory types: 0 device-local, 1 host-visible, 2 host-visible and cached, 3 device-local and host-visible (BAR)
+// Blocks of 64 KiB with 256 byte nodes, so allocations above 32 KiB are dedicated
+VkPhysicalDeviceMemoryProperties test_memory_properties()
+{
+    const VkMemoryPropertyFlags host = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    VkPhysicalDeviceMemoryProperties mem_props = {};
+    mem_props.memoryHeapCount = 2;
+    mem_props.memoryHeaps[0] = { 1ull << 30, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT };
+    mem_props.memoryHeaps[1] = { 1ull << 30, 0 };
+    mem_props.memoryTypeCount = 4;
+    mem_props.memoryTypes[0] = { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0 };
+    mem_props.memoryTypes[1] = { host, 1 };
+    mem_props.memoryTypes[2] = { host | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, 1 };
+    mem_props.memoryTypes[3] = { host | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0 };
+    return mem_props;
+}
+
+void test_allocator_init(Gpu_Allocator &allocator)
+{
+    test_gpu_memory = {};
+    for (auto &budget : test_gpu_memory.budgets) budget = 1ull << 30;
+    test_gpu_memory.memory_type_bits = 0xf;
+
+    VkPhysicalDeviceMemoryProperties mem_props = test_memory_properties();
+    gpu_allocator_init(allocator, (VkDevice)(uptr)1, mem_props, test_gpu_memory_functions(), 64 << 10, 256);
+}
+
+VkMemoryRequirements test_requirements(VkDeviceSize size, VkDeviceSize alignment = 256, u32 memory_type_bits = 0xf)
+{
+    VkMemoryRequirements requirements = {};
+    requirements.size = size;
+    requirements.alignment = alignment;
+    requirements.memoryTypeBits = memory_type_bits;
+    return requirements;
+}
+
+TEST(gpu_allocator_buddy_split)
+{
+    Gpu_Allocator allocator = {};
+    test_allocator_init(allocator);
+
+    // the first node splits the block all the way down; the next ones take the lowest free node that fits
+    Gpu_Allocation a = {}, b = {}, c = {}, d = {};
+    VkMemoryRequirements small = test_requirements(100), medium = test_requirements(512);
+    CHECK_EQ(gpu_allocate(allocator, small,  GPU_MEMORY_USAGE_DEVICE_LOCAL, false, a), VK_SUCCESS);
+    CHECK_EQ(gpu_allocate(allocator, medium, GPU_MEMORY_USAGE_DEVICE_LOCAL, false, b), VK_SUCCESS);
+    CHECK_EQ(gpu_allocate(allocator, small,  GPU_MEMORY_USAGE_DEVICE_LOCAL, false, c), VK_SUCCESS);
+    CHECK_EQ(a.offset, 0u);
+    CHECK_EQ(b.offset, 512u);
+    CHECK_EQ(c.offset, 256u);
+    CHECK_EQ(a.order, 0u);
+    CHECK_EQ(b.order, 1u);
+    CHECK(a.memory == b.memory && b.memory == c.memory);
+    CHECK_EQ(a.memory_type, 0u);
+    CHECK(a.mapped == nullptr);
+
+    // nodes are aligned to their own size, so a large alignment rounds the node up
+    VkMemoryRequirements aligned = test_requirements(100, 4096);
+    CHECK_EQ(gpu_allocate(allocator, aligned, GPU_MEMORY_USAGE_DEVICE_LOCAL, false, d), VK_SUCCESS);
+    CHECK_EQ(d.offset % 4096, 0u);
+    CHECK_EQ(d.offset, 4096u);
+
+    // buffers and optimal images never share a block
+    Gpu_Allocation image = {};
+    CHECK_EQ(gpu_allocate(allocator, small, GPU_MEMORY_USAGE_DEVICE_LOCAL, true, image), VK_SUCCESS);
+    CHECK(image.memory != a.memory);
+    CHECK_EQ(image.pool, 1u);
+    CHECK_EQ(image.offset, 0u);
+
+    for (Gpu_Allocation *allocation : { &a, &b, &c, &d, &image }) gpu_free(allocator, *allocation);
+    gpu_allocator_destroy(allocator);
+    CHECK_EQ(test_gpu_memory.allocations.size(), 0u);
+}
+
+TEST(gpu_allocator_buddy_merge)
+{
+    Gpu_Allocator allocator = {};
+    test_allocator_init(allocator);
+
+    std::vector<Gpu_Allocation> allocations(256);
+    VkMemoryRequirements node = test_requirements(256);
+    for (auto &allocation : allocations) CHECK_EQ(gpu_allocate(allocator, node, GPU_MEMORY_USAGE_DEVICE_LOCAL, false, allocation), VK_SUCCESS);
+    CHECK_EQ(gpu_allocator_stats(allocator).block_count, 1u);
+    CHECK_EQ(gpu_allocator_stats(allocator).largest_free_node, 0u);
+
+    // freeing every other node leaves no buddies to merge with, freeing the rest merges the block back into one node
+    for (u32 i = 0; i < allocations.size(); i += 2) gpu_free(allocator, allocations[i]);
+    CHECK_EQ(gpu_allocator_stats(allocator).largest_free_node, 256u);
+    for (u32 i = 1; i < allocations.size(); i += 2) gpu_free(allocator, allocations[i]);
+
+    Gpu_Memory_Block &block = allocator.pools[0].blocks[0];
+    CHECK(block.memory != VK_NULL_HANDLE);
+    CHECK_EQ(block.used, 0u);
+    for (u32 order = 0; order < allocator.max_order; order++) CHECK_EQ(block.free_nodes[order].size(), 0u);
+    CHECK_EQ(block.free_nodes[allocator.max_order].size(), 1u);
+
+    // the merged block serves a request of half its size
+    Gpu_Allocation half = {};
+    VkMemoryRequirements half_block = test_requirements(32 << 10);
+    CHECK_EQ(gpu_allocate(allocator, half_block, GPU_MEMORY_USAGE_DEVICE_LOCAL, false, half), VK_SUCCESS);
+    CHECK_EQ(half.pool, 0u);
+    CHECK_EQ(half.offset, 0u);
+    gpu_free(allocator, half);
+    gpu_allocator_destroy(allocator);
+}
+
+TEST(gpu_allocator_releases_all_but_one_empty_block)
+{
+    Gpu_Allocator allocator = {};
+    test_allocator_init(allocator);
+
+    std::vector<Gpu_Allocation> allocations(3);
+    VkMemoryRequirements half_block = test_requirements(32 << 10);
+    for (auto &allocation : allocations) CHECK_EQ(gpu_allocate(allocator, half_block, GPU_MEMORY_USAGE_DEVICE_LOCAL, false, allocation), VK_SUCCESS);
+    CHECK_EQ(gpu_allocator_stats(allocator).block_count, 2u);
+    CHECK_EQ(test_gpu_memory.allocations.size(), 2u);
+
+    for (auto &allocation : allocations) gpu_free(allocator, allocation);
+    CHECK_EQ(gpu_allocator_stats(allocator).block_count, 1u);
+    CHECK_EQ(test_gpu_memory.allocations.size(), 1u);
+
+    // the freed slot is reused for the next block
+    for (auto &allocation : allocations) CHECK_EQ(gpu_allocate(allocator, half_block, GPU_MEMORY_USAGE_DEVICE_LOCAL, false, allocation), VK_SUCCESS);
+    CHECK_EQ(allocator.pools[0].blocks.size(), 2u);
+    for (auto &allocation : allocations) gpu_free(allocator, allocation);
+    gpu_allocator_destroy(allocator);
+    CHECK_EQ(test_gpu_memory.allocations.size(), 0u);
+}
+
+TEST(gpu_allocator_memory_type_selection)
+{
+    Gpu_Allocator allocator = {};
+    test_allocator_init(allocator);
+
+    VkMemoryRequirements requirements = test_requirements(1024);
+    const Gpu_Memory_Usage usages[] = { GPU_MEMORY_USAGE_DEVICE_LOCAL, GPU_MEMORY_USAGE_UPLOAD, GPU_MEMORY_USAGE_DYNAMIC, GPU_MEMORY_USAGE_READBACK };
+    const u32 expected_types[]      = { 0, 1, 3, 2 };
+    for (u32 i = 0; i < 4; i++)
+    {
+        Gpu_Allocation allocation = {};
+        CHECK_EQ(gpu_allocate(allocator, requirements, usages[i], false, allocation), VK_SUCCESS);
+        CHECK_EQ(allocation.memory_type, expected_types[i]);
+        CHECK_EQ(allocation.mapped != nullptr, usages[i] != GPU_MEMORY_USAGE_DEVICE_LOCAL);
+        gpu_free(allocator, allocation);
+    }
+
+    // the resource's memoryTypeBits rule out the preferred type, and nothing host-visible is left for the host usages
+    Gpu_Allocation allocation = {};
+    VkMemoryRequirements device_only = test_requirements(1024, 256, 1u << 0);
+    CHECK_EQ(gpu_allocate(allocator, device_only, GPU_MEMORY_USAGE_UPLOAD, false, allocation), VK_ERROR_OUT_OF_DEVICE_MEMORY);
+    CHECK(allocation.memory == VK_NULL_HANDLE);
+    VkMemoryRequirements no_bar = test_requirements(1024, 256, 0x7);
+    CHECK_EQ(gpu_allocate(allocator, no_bar, GPU_MEMORY_USAGE_DYNAMIC, false, allocation), VK_SUCCESS);
+    CHECK_EQ(allocation.memory_type, 1u);
+    gpu_free(allocator, allocation);
+    gpu_allocator_destroy(allocator);
+}
+
+TEST(gpu_allocator_falls_back_when_a_type_is_out_of_memory)
+{
+    Gpu_Allocator allocator = {};
+    test_allocator_init(allocator);
+    test_gpu_memory.budgets[0] = 0;
+
+    // device-local memory is only preferred, so the device-local BAR type is next, and any type after that
+    Gpu_Allocation allocation = {};
+    VkMemoryRequirements requirements = test_requirements(1024);
+    CHECK_EQ(gpu_allocate(allocator, requirements, GPU_MEMORY_USAGE_DEVICE_LOCAL, false, allocation), VK_SUCCESS);
+    CHECK_EQ(allocation.memory_type, 3u);
+    gpu_free(allocator, allocation);
+
+    // the BAR type's block outlives its allocation, so start over to see the allocation go to the next type
+    gpu_allocator_destroy(allocator);
+    test_allocator_init(allocator);
+    test_gpu_memory.budgets[0] = 0;
+    test_gpu_memory.budgets[3] = 0;
+    CHECK_EQ(gpu_allocate(allocator, requirements, GPU_MEMORY_USAGE_DEVICE_LOCAL, false, allocation), VK_SUCCESS);
+    CHECK_EQ(allocation.memory_type, 1u);
+    gpu_free(allocator, allocation);
+
+    // with every acceptable type exhausted the error reaches the caller
+    // (a dedicated size, as the blocks kept from above still have room)
+    for (auto &budget : test_gpu_memory.budgets) budget = 0;
+    VkMemoryRequirements large = test_requirements(40 << 10);
+    CHECK_EQ(gpu_allocate(allocator, large, GPU_MEMORY_USAGE_READBACK, false, allocation), VK_ERROR_OUT_OF_DEVICE_MEMORY);
+    gpu_allocator_destroy(allocator);
+}
+
+TEST(gpu_allocator_dedicated_allocations)
+{
+    Gpu_Allocator allocator = {};
+    test_allocator_init(allocator);
+
+    // anything above half a block gets its own allocation of exactly the requested size
+    Gpu_Allocation pooled = {}, dedicated = {};
+    VkMemoryRequirements half_block = test_requirements(32 << 10), large = test_requirements((32 << 10) + 1);
+    CHECK_EQ(gpu_allocate(allocator, half_block, GPU_MEMORY_USAGE_UPLOAD, false, pooled), VK_SUCCESS);
+    CHECK_EQ(gpu_allocate(allocator, large,      GPU_MEMORY_USAGE_UPLOAD, false, dedicated), VK_SUCCESS);
+    CHECK_EQ(pooled.pool, 2u);
+    CHECK_EQ(dedicated.pool, UINT32_MAX);
+    CHECK_EQ(dedicated.offset, 0u);
+    CHECK(dedicated.mapped != nullptr);
+    CHECK_EQ(test_gpu_memory.allocations[(u64)(uptr)dedicated.memory].size(), (usize)large.size);
+
+    Gpu_Allocator_Stats stats = gpu_allocator_stats(allocator);
+    CHECK_EQ(stats.dedicated_count, 1u);
+    CHECK_EQ(stats.device_allocation_count, 2u);
+
+    gpu_free(allocator, dedicated);
+    CHECK_EQ(gpu_allocator_stats(allocator).dedicated_count, 0u);
+    CHECK_EQ(test_gpu_memory.allocations.size(), 1u);
+    gpu_free(allocator, pooled);
+    gpu_allocator_destroy(allocator);
+}
+
+TEST(gpu_allocator_stats)
+{
+    Gpu_Allocator allocator = {};
+    test_allocator_init(allocator);
+
+    // 300 bytes take a 512 byte node, 1024 bytes a node of their own size
+    Gpu_Allocation a = {}, b = {}, dedicated = {};
+    VkMemoryRequirements odd = test_requirements(300), exact = test_requirements(1024), large = test_requirements(40 << 10);
+    CHECK_EQ(gpu_allocate(allocator, odd,   GPU_MEMORY_USAGE_DEVICE_LOCAL, false, a), VK_SUCCESS);
+    CHECK_EQ(gpu_allocate(allocator, exact, GPU_MEMORY_USAGE_DEVICE_LOCAL, false, b), VK_SUCCESS);
+    CHECK_EQ(gpu_allocate(allocator, large, GPU_MEMORY_USAGE_DEVICE_LOCAL, false, dedicated), VK_SUCCESS);
+
+    Gpu_Allocator_Stats stats = gpu_allocator_stats(allocator);
+    CHECK_EQ(stats.allocation_count, 3u);
+    CHECK_EQ(stats.block_count, 1u);
+    CHECK_EQ(stats.dedicated_count, 1u);
+    CHECK_EQ(stats.device_allocation_count, 2u);
+    CHECK_EQ(stats.bytes_requested, 300u + 1024u + (40u << 10));
+    CHECK_EQ(stats.bytes_used,      512u + 1024u + (40u << 10));
+    CHECK_EQ(stats.bytes_reserved,  (64u << 10) + (40u << 10));
+    CHECK_EQ(stats.largest_free_node, 32u << 10);
+    CHECK(stats.internal_fragmentation > 0.0 && stats.internal_fragmentation < 0.01);
+    // free in the block: 512 + 2048 + 4096 + ... + 32768 bytes, of which the 32 KiB node is the largest
+    VkDeviceSize bytes_free = (64 << 10) - 512 - 1024;
+    CHECK(std::abs(stats.external_fragmentation - (1.0 - (32 << 10) / (f64)bytes_free)) < 1e-9);
+
+    gpu_free(allocator, a);
+    gpu_free(allocator, b);
+    gpu_free(allocator, dedicated);
+    stats = gpu_allocator_stats(allocator);
+    CHECK_EQ(stats.allocation_count, 0u);
+    CHECK_EQ(stats.bytes_requested, 0u);
+    CHECK_EQ(stats.bytes_used, 0u);
+    CHECK_EQ(stats.internal_fragmentation, 0.0);
+    CHECK_EQ(stats.external_fragmentation, 0.0);
+    gpu_allocator_destroy(allocator);
+}
+
+TEST(gpu_allocator_ring)
+{
+    Gpu_Allocator allocator = {};
+    test_allocator_init(allocator);
+
+    // frame regions are rounded up to 256 bytes, and the buffer must hold every rounded region
+    Gpu_Linear_Ring ring = {};
+    CHECK_EQ(gpu_ring_create(allocator, ring, 1000, 3, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT), VK_SUCCESS);
+    CHECK_EQ(ring.frame_size, 1024u);
+    CHECK_EQ(test_gpu_memory.buffers[(u64)(uptr)ring.buffer], 3u * 1024u);
+    CHECK_EQ(test_gpu_memory.bind_errors, 0u);
+    CHECK_EQ(ring.allocation.memory_type, 3u);
+
+    for (u64 frame_number = 0; frame_number < 6; frame_number++)
+    {
+        gpu_ring_begin_frame(ring, frame_number);
+        Gpu_Ring_Slice first  = gpu_ring_allocate(ring, 100, 64);
+        Gpu_Ring_Slice second = gpu_ring_allocate(ring, 800, 64);
+        Gpu_Ring_Slice last   = gpu_ring_allocate(ring, 96, 32);
+        Gpu_Ring_Slice full   = gpu_ring_allocate(ring, 1, 1);
+
+        VkDeviceSize region = (frame_number % 3) * 1024;
+        CHECK(first.buffer == ring.buffer);
+        CHECK_EQ(first.offset,  region);
+        CHECK_EQ(second.offset, region + 128);
+        CHECK_EQ(last.offset,   region + 928);
+        CHECK(full.buffer == VK_NULL_HANDLE);
+
+        // the region's last byte is inside the buffer and writable through the mapping
+        CHECK(last.offset + 96 <= test_gpu_memory.buffers[(u64)(uptr)ring.buffer]);
+        memset(last.mapped, 0xff, 96);
+        CHECK_EQ((u8 *)last.mapped - (u8 *)ring.allocation.mapped, (isize)last.offset);
+    }
+    CHECK_EQ(ring.high_water, 1024u);
+
+    gpu_ring_destroy(allocator, ring);
+    CHECK_EQ(test_gpu_memory.buffers.size(), 0u);
+    gpu_allocator_destroy(allocator);
+}
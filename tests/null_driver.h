@@ -0,0 +1,322 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "test.h"
+
+//
+// NULL DRIVER
+// The Vulkan entry points the application calls, defined in place of the loader so that run_tests runs on machines without an ICD
+// There is one physical device: Vulkan 1.0, no extensions, one queue family that does everything and one memory type that is
+// device-local and host-visible, so every path picks it. Objects are distinct handles that own nothing, except for memory, which is
+// backed by host memory once it is mapped. Commands are dropped and every wait returns at once
+// Every object that is created must be destroyed again; `live` counts the ones that were not, see the session tests
+// An entry point the application starts to call has to be added here as well, or run_tests does not link
+//
+
+struct Null_Driver {
+    u64                                      next_handle;
+    i64                                      live;              // objects created and not yet destroyed, pool-owned ones excluded
+    u64                                      submits;
+    std::unordered_map<u64, VkDeviceSize>    sizes;             // of every buffer and image, by handle
+    std::unordered_map<u64, VkDeviceSize>    allocation_sizes;  // by VkDeviceMemory handle
+    std::unordered_map<u64, std::vector<u8>> memory;            // host memory behind the allocations that have been mapped
+};
+
+Null_Driver null_driver = {};
+
+VkPhysicalDevice null_driver_physical_device = (VkPhysicalDevice)&null_driver;
+
+template <typename Handle>
+Handle null_driver_create()
+{
+    null_driver.live++;
+    return (Handle)(uptr)++null_driver.next_handle;
+}
+
+// Handles that belong to their pool and are freed with it
+template <typename Handle>
+Handle null_driver_create_pooled()
+{
+    return (Handle)(uptr)++null_driver.next_handle;
+}
+
+template <typename Handle>
+void null_driver_destroy(Handle handle)
+{
+    if (handle == VK_NULL_HANDLE) return;
+    null_driver.live--;
+    null_driver.sizes.erase((u64)(uptr)handle);
+}
+
+// COUNT_APPEND_HELPER-style enumeration of `items`
+template <typename T>
+VkResult null_driver_enumerate(u32 *count, T *out, const std::vector<T> &items)
+{
+    if (!out)
+    {
+        *count = (u32)items.size();
+        return VK_SUCCESS;
+    }
+    u32 written = std::min(*count, (u32)items.size());
+    for (u32 i = 0; i < written; i++) out[i] = items[i];
+    *count = written;
+    return written < items.size() ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+// Instance and physical device
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(VkInstance, const char *) { return nullptr; }
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(VkDevice, const char *) { return nullptr; }
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumeratePhysicalDevices(VkInstance, u32 *count, VkPhysicalDevice *devices)
+{
+    return null_driver_enumerate(count, devices, { null_driver_physical_device });
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties(VkPhysicalDevice, VkPhysicalDeviceProperties *props)
+{
+    *props = {};
+    props->apiVersion = VK_API_VERSION_1_0;
+    props->deviceType = VK_PHYSICAL_DEVICE_TYPE_CPU;
+    strcpy(props->deviceName, "Null device");
+    props->limits.maxImageDimension2D = 4096;
+    props->limits.maxComputeWorkGroupInvocations = 1024;
+    props->limits.maxComputeWorkGroupSize[0] = 1024;
+    props->limits.maxComputeWorkGroupSize[1] = 1024;
+    props->limits.maxComputeWorkGroupSize[2] = 64;
+    props->limits.maxDrawIndirectCount = 1;
+    props->limits.optimalBufferCopyOffsetAlignment = 16;
+    props->limits.timestampPeriod = 1.0f;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFeatures(VkPhysicalDevice, VkPhysicalDeviceFeatures *features)
+{
+    *features = {};
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(VkPhysicalDevice, VkPhysicalDeviceMemoryProperties *mem_props)
+{
+    *mem_props = {};
+    mem_props->memoryHeapCount = 1;
+    mem_props->memoryHeaps[0].size  = 1ull << 30;
+    mem_props->memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+    mem_props->memoryTypeCount = 1;
+    mem_props->memoryTypes[0].heapIndex = 0;
+    mem_props->memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFormatProperties(VkPhysicalDevice, VkFormat, VkFormatProperties *props)
+{
+    props->linearTilingFeatures  = ~0u;
+    props->optimalTilingFeatures = ~0u;
+    props->bufferFeatures        = ~0u;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceQueueFamilyProperties(VkPhysicalDevice, u32 *count, VkQueueFamilyProperties *families)
+{
+    VkQueueFamilyProperties family = {};
+    family.queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+    family.queueCount = 1;
+    family.minImageTransferGranularity = { 1, 1, 1 };
+    null_driver_enumerate(count, families, { family });
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceExtensionProperties(VkPhysicalDevice, const char *, u32 *count, VkExtensionProperties *extensions)
+{
+    return null_driver_enumerate(count, extensions, {});
+}
+
+// Surfaces and swapchains; a null surface presents nothing, so sessions on the null driver run headless
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceSupportKHR(VkPhysicalDevice, u32, VkSurfaceKHR, VkBool32 *supported) { *supported = VK_FALSE; return VK_SUCCESS; }
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceCapabilitiesKHR(VkPhysicalDevice, VkSurfaceKHR, VkSurfaceCapabilitiesKHR *caps) { *caps = {}; return VK_SUCCESS; }
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceFormatsKHR(VkPhysicalDevice, VkSurfaceKHR, u32 *count, VkSurfaceFormatKHR *formats) { return null_driver_enumerate(count, formats, {}); }
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfacePresentModesKHR(VkPhysicalDevice, VkSurfaceKHR, u32 *count, VkPresentModeKHR *modes) { return null_driver_enumerate(count, modes, {}); }
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSwapchainKHR(VkDevice, const VkSwapchainCreateInfoKHR *, const VkAllocationCallbacks *, VkSwapchainKHR *swapchain) { *swapchain = null_driver_create<VkSwapchainKHR>(); return VK_SUCCESS; }
+VKAPI_ATTR void VKAPI_CALL vkDestroySwapchainKHR(VkDevice, VkSwapchainKHR swapchain, const VkAllocationCallbacks *) { null_driver_destroy(swapchain); }
+VKAPI_ATTR VkResult VKAPI_CALL vkGetSwapchainImagesKHR(VkDevice, VkSwapchainKHR, u32 *count, VkImage *images) { return null_driver_enumerate(count, images, {}); }
+VKAPI_ATTR VkResult VKAPI_CALL vkAcquireNextImageKHR(VkDevice, VkSwapchainKHR, u64, VkSemaphore, VkFence, u32 *image_index) { *image_index = 0; return VK_SUCCESS; }
+VKAPI_ATTR VkResult VKAPI_CALL vkQueuePresentKHR(VkQueue, const VkPresentInfoKHR *) { return VK_SUCCESS; }
+
+// Device and queues
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(VkPhysicalDevice, const VkDeviceCreateInfo *, const VkAllocationCallbacks *, VkDevice *device)
+{
+    *device = null_driver_create<VkDevice>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDevice(VkDevice device, const VkAllocationCallbacks *) { null_driver_destroy(device); }
+VKAPI_ATTR VkResult VKAPI_CALL vkDeviceWaitIdle(VkDevice) { return VK_SUCCESS; }
+VKAPI_ATTR void VKAPI_CALL vkGetDeviceQueue(VkDevice, u32, u32, VkQueue *queue) { *queue = (VkQueue)&null_driver.submits; }
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue, u32, const VkSubmitInfo *, VkFence)
+{
+    null_driver.submits++;
+    return VK_SUCCESS;
+}
+
+// Synchronisation
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateFence(VkDevice, const VkFenceCreateInfo *, const VkAllocationCallbacks *, VkFence *fence) { *fence = null_driver_create<VkFence>(); return VK_SUCCESS; }
+VKAPI_ATTR void VKAPI_CALL vkDestroyFence(VkDevice, VkFence fence, const VkAllocationCallbacks *) { null_driver_destroy(fence); }
+VKAPI_ATTR VkResult VKAPI_CALL vkResetFences(VkDevice, u32, const VkFence *) { return VK_SUCCESS; }
+VKAPI_ATTR VkResult VKAPI_CALL vkGetFenceStatus(VkDevice, VkFence) { return VK_SUCCESS; }
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitForFences(VkDevice, u32, const VkFence *, VkBool32, u64) { return VK_SUCCESS; }
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSemaphore(VkDevice, const VkSemaphoreCreateInfo *, const VkAllocationCallbacks *, VkSemaphore *semaphore) { *semaphore = null_driver_create<VkSemaphore>(); return VK_SUCCESS; }
+VKAPI_ATTR void VKAPI_CALL vkDestroySemaphore(VkDevice, VkSemaphore semaphore, const VkAllocationCallbacks *) { null_driver_destroy(semaphore); }
+
+// Memory, buffers and images
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(VkDevice, const VkMemoryAllocateInfo *info, const VkAllocationCallbacks *, VkDeviceMemory *memory)
+{
+    *memory = null_driver_create<VkDeviceMemory>();
+    null_driver.allocation_sizes[(u64)(uptr)*memory] = info->allocationSize;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks *)
+{
+    null_driver.memory.erase((u64)(uptr)memory);
+    null_driver.allocation_sizes.erase((u64)(uptr)memory);
+    null_driver_destroy(memory);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize, VkMemoryMapFlags, void **data)
+{
+    std::vector<u8> &backing = null_driver.memory[(u64)(uptr)memory];
+    backing.resize(null_driver.allocation_sizes[(u64)(uptr)memory]);
+    *data = backing.data() + offset;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUnmapMemory(VkDevice, VkDeviceMemory) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateBuffer(VkDevice, const VkBufferCreateInfo *info, const VkAllocationCallbacks *, VkBuffer *buffer)
+{
+    *buffer = null_driver_create<VkBuffer>();
+    null_driver.sizes[(u64)(uptr)*buffer] = info->size;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyBuffer(VkDevice, VkBuffer buffer, const VkAllocationCallbacks *) { null_driver_destroy(buffer); }
+
+// Every image is taken for 4 bytes per texel, without mips
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateImage(VkDevice, const VkImageCreateInfo *info, const VkAllocationCallbacks *, VkImage *image)
+{
+    *image = null_driver_create<VkImage>();
+    null_driver.sizes[(u64)(uptr)*image] = (VkDeviceSize)info->extent.width * info->extent.height * info->extent.depth * info->arrayLayers * 4;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyImage(VkDevice, VkImage image, const VkAllocationCallbacks *) { null_driver_destroy(image); }
+
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements(VkDevice, VkBuffer buffer, VkMemoryRequirements *requirements)
+{
+    requirements->size = null_driver.sizes[(u64)(uptr)buffer];
+    requirements->alignment = 256;
+    requirements->memoryTypeBits = 1;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements(VkDevice, VkImage image, VkMemoryRequirements *requirements)
+{
+    requirements->size = null_driver.sizes[(u64)(uptr)image];
+    requirements->alignment = 256;
+    requirements->memoryTypeBits = 1;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice, VkBuffer, VkDeviceMemory, VkDeviceSize) { return VK_SUCCESS; }
+VKAPI_ATTR VkResult VKAPI_CALL vkBindImageMemory(VkDevice, VkImage, VkDeviceMemory, VkDeviceSize) { return VK_SUCCESS; }
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateImageView(VkDevice, const VkImageViewCreateInfo *, const VkAllocationCallbacks *, VkImageView *view) { *view = null_driver_create<VkImageView>(); return VK_SUCCESS; }
+VKAPI_ATTR void VKAPI_CALL vkDestroyImageView(VkDevice, VkImageView view, const VkAllocationCallbacks *) { null_driver_destroy(view); }
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSampler(VkDevice, const VkSamplerCreateInfo *, const VkAllocationCallbacks *, VkSampler *sampler) { *sampler = null_driver_create<VkSampler>(); return VK_SUCCESS; }
+VKAPI_ATTR void VKAPI_CALL vkDestroySampler(VkDevice, VkSampler sampler, const VkAllocationCallbacks *) { null_driver_destroy(sampler); }
+
+// Pipelines and render passes
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateShaderModule(VkDevice, const VkShaderModuleCreateInfo *, const VkAllocationCallbacks *, VkShaderModule *module) { *module = null_driver_create<VkShaderModule>(); return VK_SUCCESS; }
+VKAPI_ATTR void VKAPI_CALL vkDestroyShaderModule(VkDevice, VkShaderModule module, const VkAllocationCallbacks *) { null_driver_destroy(module); }
+VKAPI_ATTR VkResult VKAPI_CALL vkCreatePipelineCache(VkDevice, const VkPipelineCacheCreateInfo *, const VkAllocationCallbacks *, VkPipelineCache *cache) { *cache = null_driver_create<VkPipelineCache>(); return VK_SUCCESS; }
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipelineCache(VkDevice, VkPipelineCache cache, const VkAllocationCallbacks *) { null_driver_destroy(cache); }
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPipelineCacheData(VkDevice, VkPipelineCache, usize *size, void *) { *size = 0; return VK_SUCCESS; }
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateGraphicsPipelines(VkDevice, VkPipelineCache, u32 count, const VkGraphicsPipelineCreateInfo *, const VkAllocationCallbacks *, VkPipeline *pipelines)
+{
+    for (u32 i = 0; i < count; i++) pipelines[i] = null_driver_create<VkPipeline>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateComputePipelines(VkDevice, VkPipelineCache, u32 count, const VkComputePipelineCreateInfo *, const VkAllocationCallbacks *, VkPipeline *pipelines)
+{
+    for (u32 i = 0; i < count; i++) pipelines[i] = null_driver_create<VkPipeline>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipeline(VkDevice, VkPipeline pipeline, const VkAllocationCallbacks *) { null_driver_destroy(pipeline); }
+VKAPI_ATTR VkResult VKAPI_CALL vkCreatePipelineLayout(VkDevice, const VkPipelineLayoutCreateInfo *, const VkAllocationCallbacks *, VkPipelineLayout *layout) { *layout = null_driver_create<VkPipelineLayout>(); return VK_SUCCESS; }
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipelineLayout(VkDevice, VkPipelineLayout layout, const VkAllocationCallbacks *) { null_driver_destroy(layout); }
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateRenderPass(VkDevice, const VkRenderPassCreateInfo *, const VkAllocationCallbacks *, VkRenderPass *render_pass) { *render_pass = null_driver_create<VkRenderPass>(); return VK_SUCCESS; }
+VKAPI_ATTR void VKAPI_CALL vkDestroyRenderPass(VkDevice, VkRenderPass render_pass, const VkAllocationCallbacks *) { null_driver_destroy(render_pass); }
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateFramebuffer(VkDevice, const VkFramebufferCreateInfo *, const VkAllocationCallbacks *, VkFramebuffer *framebuffer) { *framebuffer = null_driver_create<VkFramebuffer>(); return VK_SUCCESS; }
+VKAPI_ATTR void VKAPI_CALL vkDestroyFramebuffer(VkDevice, VkFramebuffer framebuffer, const VkAllocationCallbacks *) { null_driver_destroy(framebuffer); }
+
+// Descriptors and queries
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorSetLayout(VkDevice, const VkDescriptorSetLayoutCreateInfo *, const VkAllocationCallbacks *, VkDescriptorSetLayout *layout) { *layout = null_driver_create<VkDescriptorSetLayout>(); return VK_SUCCESS; }
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorSetLayout(VkDevice, VkDescriptorSetLayout layout, const VkAllocationCallbacks *) { null_driver_destroy(layout); }
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorPool(VkDevice, const VkDescriptorPoolCreateInfo *, const VkAllocationCallbacks *, VkDescriptorPool *pool) { *pool = null_driver_create<VkDescriptorPool>(); return VK_SUCCESS; }
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorPool(VkDevice, VkDescriptorPool pool, const VkAllocationCallbacks *) { null_driver_destroy(pool); }
+VKAPI_ATTR VkResult VKAPI_CALL vkResetDescriptorPool(VkDevice, VkDescriptorPool, VkDescriptorPoolResetFlags) { return VK_SUCCESS; }
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateDescriptorSets(VkDevice, const VkDescriptorSetAllocateInfo *info, VkDescriptorSet *sets)
+{
+    for (u32 i = 0; i < info->descriptorSetCount; i++) sets[i] = null_driver_create_pooled<VkDescriptorSet>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUpdateDescriptorSets(VkDevice, u32, const VkWriteDescriptorSet *, u32, const VkCopyDescriptorSet *) {}
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateQueryPool(VkDevice, const VkQueryPoolCreateInfo *, const VkAllocationCallbacks *, VkQueryPool *pool) { *pool = null_driver_create<VkQueryPool>(); return VK_SUCCESS; }
+VKAPI_ATTR void VKAPI_CALL vkDestroyQueryPool(VkDevice, VkQueryPool pool, const VkAllocationCallbacks *) { null_driver_destroy(pool); }
+VKAPI_ATTR VkResult VKAPI_CALL vkGetQueryPoolResults(VkDevice, VkQueryPool, u32, u32, usize, void *, VkDeviceSize, VkQueryResultFlags) { return VK_NOT_READY; }
+
+// Command pools and buffers
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateCommandPool(VkDevice, const VkCommandPoolCreateInfo *, const VkAllocationCallbacks *, VkCommandPool *pool) { *pool = null_driver_create<VkCommandPool>(); return VK_SUCCESS; }
+VKAPI_ATTR void VKAPI_CALL vkDestroyCommandPool(VkDevice, VkCommandPool pool, const VkAllocationCallbacks *) { null_driver_destroy(pool); }
+VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandPool(VkDevice, VkCommandPool, VkCommandPoolResetFlags) { return VK_SUCCESS; }
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(VkDevice, const VkCommandBufferAllocateInfo *info, VkCommandBuffer *cmd_bufs)
+{
+    for (u32 i = 0; i < info->commandBufferCount; i++) cmd_bufs[i] = null_driver_create_pooled<VkCommandBuffer>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBeginCommandBuffer(VkCommandBuffer, const VkCommandBufferBeginInfo *) { return VK_SUCCESS; }
+VKAPI_ATTR VkResult VKAPI_CALL vkEndCommandBuffer(VkCommandBuffer) { return VK_SUCCESS; }
+VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandBuffer(VkCommandBuffer, VkCommandBufferResetFlags) { return VK_SUCCESS; }
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBeginQuery(VkCommandBuffer, VkQueryPool, u32, VkQueryControlFlags) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdEndQuery(VkCommandBuffer, VkQueryPool, u32) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdResetQueryPool(VkCommandBuffer, VkQueryPool, u32, u32) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdWriteTimestamp(VkCommandBuffer, VkPipelineStageFlagBits, VkQueryPool, u32) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier(VkCommandBuffer, VkPipelineStageFlags, VkPipelineStageFlags, VkDependencyFlags, u32, const VkMemoryBarrier *, u32, const VkBufferMemoryBarrier *, u32, const VkImageMemoryBarrier *) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdBeginRenderPass(VkCommandBuffer, const VkRenderPassBeginInfo *, VkSubpassContents) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdEndRenderPass(VkCommandBuffer) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdExecuteCommands(VkCommandBuffer, u32, const VkCommandBuffer *) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdBindPipeline(VkCommandBuffer, VkPipelineBindPoint, VkPipeline) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdBindDescriptorSets(VkCommandBuffer, VkPipelineBindPoint, VkPipelineLayout, u32, u32, const VkDescriptorSet *, u32, const u32 *) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdBindVertexBuffers(VkCommandBuffer, u32, u32, const VkBuffer *, const VkDeviceSize *) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdBindIndexBuffer(VkCommandBuffer, VkBuffer, VkDeviceSize, VkIndexType) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdPushConstants(VkCommandBuffer, VkPipelineLayout, VkShaderStageFlags, u32, u32, const void *) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdSetViewport(VkCommandBuffer, u32, u32, const VkViewport *) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdSetScissor(VkCommandBuffer, u32, u32, const VkRect2D *) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdDraw(VkCommandBuffer, u32, u32, u32, u32) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexed(VkCommandBuffer, u32, u32, u32, i32, u32) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexedIndirect(VkCommandBuffer, VkBuffer, VkDeviceSize, u32, u32) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdDispatch(VkCommandBuffer, u32, u32, u32) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdDispatchIndirect(VkCommandBuffer, VkBuffer, VkDeviceSize) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyBuffer(VkCommandBuffer, VkBuffer, VkBuffer, u32, const VkBufferCopy *) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyBufferToImage(VkCommandBuffer, VkBuffer, VkImage, VkImageLayout, u32, const VkBufferImageCopy *) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyImageToBuffer(VkCommandBuffer, VkImage, VkImageLayout, VkBuffer, u32, const VkBufferImageCopy *) {}
+VKAPI_ATTR void VKAPI_CALL vkCmdFillBuffer(VkCommandBuffer, VkBuffer, VkDeviceSize, VkDeviceSize, u32) {}
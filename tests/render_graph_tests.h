@@ -0,0 +1,273 @@
+#pragma once
+
+#include "test.h"
+
+//
+// RENDER GRAPH
+// Fixed graphs compiled without a device, with their barrier batches compared against hand-written lists, see src/render_graph.h
+// A transient image's first use in a frame waits for every stage that touches it (or its alias group) in the previous frame
+//
+
+struct Test_Barrier_Batch {
+    u32                                     pass;
+    VkPipelineStageFlags                    src_stage;
+    VkPipelineStageFlags                    dst_stage;
+    VkAccessFlags                           memory_src_access;
+    VkAccessFlags                           memory_dst_access;
+    std::vector<Render_Graph_Image_Barrier> image_barriers;
+};
+
+const VkPipelineStageFlags TEST_COLOR_STAGE  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+const VkPipelineStageFlags TEST_DEPTH_STAGE  = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+const VkPipelineStageFlags TEST_SHADER_STAGE = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+const VkAccessFlags        TEST_COLOR_RW     = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+const VkAccessFlags        TEST_DEPTH_RW     = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+const VkAccessFlags        TEST_SHADER_RW    = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+const VkImageLayout TEST_UNDEFINED    = VK_IMAGE_LAYOUT_UNDEFINED;
+const VkImageLayout TEST_COLOR        = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+const VkImageLayout TEST_DEPTH        = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+const VkImageLayout TEST_SHADER_READ  = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+const VkImageLayout TEST_TRANSFER_SRC = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+void test_check_batches(Render_Graph &graph, const std::vector<Test_Barrier_Batch> &expected)
+{
+    CHECK_EQ(graph.batches.size(), expected.size());
+    for (u32 i = 0; i < std::min(graph.batches.size(), expected.size()); i++)
+    {
+        u32 failures = test_check_failures;
+        Render_Graph_Barrier_Batch &batch = graph.batches[i];
+        CHECK_EQ(batch.pass,              expected[i].pass);
+        CHECK_EQ(batch.src_stage,         expected[i].src_stage);
+        CHECK_EQ(batch.dst_stage,         expected[i].dst_stage);
+        CHECK_EQ(batch.memory_src_access, expected[i].memory_src_access);
+        CHECK_EQ(batch.memory_dst_access, expected[i].memory_dst_access);
+        CHECK_EQ(batch.image_barriers.size(), expected[i].image_barriers.size());
+        for (u32 j = 0; j < std::min(batch.image_barriers.size(), expected[i].image_barriers.size()); j++)
+        {
+            const Render_Graph_Image_Barrier &barrier = batch.image_barriers[j], &wanted = expected[i].image_barriers[j];
+            CHECK_EQ(graph.resources[barrier.resource].name, graph.resources[wanted.resource].name);
+            CHECK_EQ(barrier.old_layout, wanted.old_layout);
+            CHECK_EQ(barrier.new_layout, wanted.new_layout);
+            CHECK_EQ(barrier.src_access, wanted.src_access);
+            CHECK_EQ(barrier.dst_access, wanted.dst_access);
+        }
+        if (test_check_failures > failures) printf("    in barrier batch %u\n", i);
+    }
+    CHECK_EQ(render_graph_validate(graph), 0u);
+}
+
+u32 test_import_backbuffer(Render_Graph &graph)
+{
+    return render_graph_import_image(graph, "backbuffer", VK_IMAGE_ASPECT_COLOR_BIT, { 0, 0, VK_IMAGE_LAYOUT_UNDEFINED },
+                                     { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL });
+}
+
+TEST(render_graph_linear_chain)
+{
+    Render_Graph graph = {};
+    auto nothing = [](VkCommandBuffer) {};
+    u32 output = test_import_backbuffer(graph);
+    u32 a = render_graph_create_image(graph, "a", VK_FORMAT_R8G8B8A8_UNORM, { 64, 64 });
+    u32 b = render_graph_create_image(graph, "b", VK_FORMAT_R8G8B8A8_UNORM, { 64, 64 });
+    render_graph_add_pass(graph, "draw a", { { a, RENDER_GRAPH_COLOR_ATTACHMENT } }, nothing);
+    render_graph_add_pass(graph, "a to b", { { a, RENDER_GRAPH_SAMPLED }, { b, RENDER_GRAPH_COLOR_ATTACHMENT } }, nothing);
+    render_graph_add_pass(graph, "b to output", { { b, RENDER_GRAPH_SAMPLED }, { output, RENDER_GRAPH_COLOR_ATTACHMENT } }, nothing);
+    render_graph_compile(graph, nullptr);
+
+    CHECK_EQ(graph.level_count, 3u);
+    CHECK(graph.order == std::vector<u32>({ 0, 1, 2 }));
+    test_check_batches(graph, {
+        { 0, TEST_COLOR_STAGE | TEST_SHADER_STAGE, TEST_COLOR_STAGE, 0, 0, {
+            { a, TEST_UNDEFINED, TEST_COLOR, TEST_COLOR_RW, TEST_COLOR_RW } } },
+        { 1, TEST_COLOR_STAGE | TEST_SHADER_STAGE, TEST_SHADER_STAGE | TEST_COLOR_STAGE, 0, 0, {
+            { a, TEST_COLOR, TEST_SHADER_READ, TEST_COLOR_RW, VK_ACCESS_SHADER_READ_BIT },
+            { b, TEST_UNDEFINED, TEST_COLOR, TEST_COLOR_RW, TEST_COLOR_RW } } },
+        // the backbuffer comes in with nothing to wait for
+        { 2, TEST_COLOR_STAGE, TEST_SHADER_STAGE | TEST_COLOR_STAGE, 0, 0, {
+            { b, TEST_COLOR, TEST_SHADER_READ, TEST_COLOR_RW, VK_ACCESS_SHADER_READ_BIT },
+            { output, TEST_UNDEFINED, TEST_COLOR, 0, TEST_COLOR_RW } } },
+        { 3, TEST_COLOR_STAGE, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, {
+            { output, TEST_COLOR, TEST_TRANSFER_SRC, TEST_COLOR_RW, VK_ACCESS_TRANSFER_READ_BIT } } },
+    });
+}
+
+TEST(render_graph_fan_in)
+{
+    // two independent compute passes feed a third, whose result is consumed as indirect arguments after the graph
+    Render_Graph graph = {};
+    auto nothing = [](VkCommandBuffer) {};
+    const Render_Graph_State none = { 0, 0, VK_IMAGE_LAYOUT_UNDEFINED };
+    u32 x      = render_graph_import_buffer(graph, "x", none, none);
+    u32 y      = render_graph_import_buffer(graph, "y", none, none);
+    u32 result = render_graph_import_buffer(graph, "result", none, { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED });
+    render_graph_add_pass(graph, "write x", { { x, RENDER_GRAPH_STORAGE_WRITE } }, nothing);
+    render_graph_add_pass(graph, "write y", { { y, RENDER_GRAPH_STORAGE_WRITE } }, nothing);
+    render_graph_add_pass(graph, "combine", { { x, RENDER_GRAPH_STORAGE_READ }, { y, RENDER_GRAPH_STORAGE_READ }, { result, RENDER_GRAPH_STORAGE_WRITE } }, nothing);
+    render_graph_compile(graph, nullptr);
+
+    CHECK_EQ(graph.level_count, 2u);
+    CHECK_EQ(graph.passes[0].level, 0u);
+    CHECK_EQ(graph.passes[1].level, 0u);
+    CHECK_EQ(graph.passes[2].level, 1u);
+
+    // the first level has nothing to wait for, and both producers are covered by one global memory barrier
+    test_check_batches(graph, {
+        { 2, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, TEST_SHADER_RW, VK_ACCESS_SHADER_READ_BIT, {} },
+        { 3, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, TEST_SHADER_RW, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, {} },
+    });
+    CHECK_EQ(graph.batches[0].merged, 2u);
+}
+
+TEST(render_graph_culled_pass)
+{
+    Render_Graph graph = {};
+    auto nothing = [](VkCommandBuffer) {};
+    const Render_Graph_State none = { 0, 0, VK_IMAGE_LAYOUT_UNDEFINED };
+    u32 output   = test_import_backbuffer(graph);
+    u32 readback = render_graph_import_buffer(graph, "readback", none, none);
+    u32 scratch  = render_graph_create_image(graph, "scratch", VK_FORMAT_R8G8B8A8_UNORM, { 64, 64 });
+    u32 unused   = render_graph_create_image(graph, "unused", VK_FORMAT_R8G8B8A8_UNORM, { 64, 64 });
+    render_graph_add_pass(graph, "scratch", { { scratch, RENDER_GRAPH_COLOR_ATTACHMENT } }, nothing);
+    render_graph_add_pass(graph, "unused", { { scratch, RENDER_GRAPH_SAMPLED }, { unused, RENDER_GRAPH_COLOR_ATTACHMENT } }, nothing);
+    render_graph_add_pass(graph, "output", { { output, RENDER_GRAPH_COLOR_ATTACHMENT } }, nothing);
+    render_graph_add_pass(graph, "readback", { { readback, RENDER_GRAPH_STORAGE_WRITE } }, nothing, true);
+    render_graph_compile(graph, nullptr);
+
+    // nothing reads `unused`, so its pass goes and takes the only pass that feeds it along; the side effect keeps the readback
+    CHECK(graph.passes[0].culled);
+    CHECK(graph.passes[1].culled);
+    CHECK(!graph.passes[2].culled);
+    CHECK(!graph.passes[3].culled);
+    CHECK(graph.order == std::vector<u32>({ 2, 3 }));
+    CHECK_EQ(graph.level_count, 1u);
+    CHECK(!graph.resources[scratch].used);
+    CHECK(!graph.resources[unused].used);
+
+    test_check_batches(graph, {
+        { 0, 0, TEST_COLOR_STAGE, 0, 0, {
+            { output, TEST_UNDEFINED, TEST_COLOR, 0, TEST_COLOR_RW } } },
+        { 2, TEST_COLOR_STAGE, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, {
+            { output, TEST_COLOR, TEST_TRANSFER_SRC, TEST_COLOR_RW, VK_ACCESS_TRANSFER_READ_BIT } } },
+    });
+}
+
+// resource indices of render_graph_build_deferred
+enum { TEST_BACKBUFFER, TEST_DEPTH_IMAGE, TEST_ALBEDO, TEST_NORMALS, TEST_LIGHTING, TEST_BLOOM_A, TEST_BLOOM_B, TEST_SHADOW, TEST_DEBUG };
+
+TEST(render_graph_deferred)
+{
+    Render_Graph graph = {};
+    render_graph_build_deferred(graph);
+    render_graph_compile(graph, nullptr);
+
+    CHECK(graph.passes[3].culled);
+    CHECK(!graph.resources[TEST_DEBUG].used);
+    CHECK_EQ(graph.level_count, 6u);
+    CHECK(graph.order == std::vector<u32>({ 0, 1, 2, 4, 5, 6, 7 }));
+
+    // one batch per level, and after the composite the backbuffer is handed over for the copy; the composite's read of the
+    // lighting image needs nothing, bloom down already made it visible to the shader stages
+    test_check_batches(graph, {
+        { 0, TEST_DEPTH_STAGE | TEST_SHADER_STAGE, TEST_DEPTH_STAGE, 0, 0, {
+            { TEST_DEPTH_IMAGE, TEST_UNDEFINED, TEST_DEPTH, TEST_DEPTH_RW, TEST_DEPTH_RW },
+            { TEST_SHADOW,      TEST_UNDEFINED, TEST_DEPTH, TEST_DEPTH_RW, TEST_DEPTH_RW } } },
+        { 2, TEST_DEPTH_STAGE | TEST_COLOR_STAGE | TEST_SHADER_STAGE, TEST_DEPTH_STAGE | TEST_COLOR_STAGE, TEST_DEPTH_RW, TEST_DEPTH_RW, {
+            { TEST_ALBEDO,  TEST_UNDEFINED, TEST_COLOR, TEST_COLOR_RW, TEST_COLOR_RW },
+            { TEST_NORMALS, TEST_UNDEFINED, TEST_COLOR, TEST_COLOR_RW, TEST_COLOR_RW } } },
+        { 3, TEST_DEPTH_STAGE | TEST_COLOR_STAGE | TEST_SHADER_STAGE, TEST_SHADER_STAGE | TEST_COLOR_STAGE, 0, 0, {
+            { TEST_ALBEDO,      TEST_COLOR,     TEST_SHADER_READ, TEST_COLOR_RW, VK_ACCESS_SHADER_READ_BIT },
+            { TEST_NORMALS,     TEST_COLOR,     TEST_SHADER_READ, TEST_COLOR_RW, VK_ACCESS_SHADER_READ_BIT },
+            { TEST_DEPTH_IMAGE, TEST_DEPTH,     TEST_SHADER_READ, TEST_DEPTH_RW, VK_ACCESS_SHADER_READ_BIT },
+            { TEST_SHADOW,      TEST_DEPTH,     TEST_SHADER_READ, TEST_DEPTH_RW, VK_ACCESS_SHADER_READ_BIT },
+            { TEST_LIGHTING,    TEST_UNDEFINED, TEST_COLOR,       TEST_COLOR_RW, TEST_COLOR_RW } } },
+        { 4, TEST_COLOR_STAGE | TEST_SHADER_STAGE, TEST_SHADER_STAGE | TEST_COLOR_STAGE, 0, 0, {
+            { TEST_LIGHTING, TEST_COLOR,     TEST_SHADER_READ, TEST_COLOR_RW, VK_ACCESS_SHADER_READ_BIT },
+            { TEST_BLOOM_A,  TEST_UNDEFINED, TEST_COLOR,       TEST_COLOR_RW, TEST_COLOR_RW } } },
+        { 5, TEST_COLOR_STAGE | TEST_SHADER_STAGE, TEST_SHADER_STAGE | TEST_COLOR_STAGE, 0, 0, {
+            { TEST_BLOOM_A, TEST_COLOR,     TEST_SHADER_READ, TEST_COLOR_RW, VK_ACCESS_SHADER_READ_BIT },
+            { TEST_BLOOM_B, TEST_UNDEFINED, TEST_COLOR,       TEST_COLOR_RW, TEST_COLOR_RW } } },
+        { 6, TEST_COLOR_STAGE, TEST_SHADER_STAGE | TEST_COLOR_STAGE, 0, 0, {
+            { TEST_BLOOM_B,    TEST_COLOR,     TEST_SHADER_READ, TEST_COLOR_RW, VK_ACCESS_SHADER_READ_BIT },
+            { TEST_BACKBUFFER, TEST_UNDEFINED, TEST_COLOR,       0,             TEST_COLOR_RW } } },
+        { 7, TEST_COLOR_STAGE, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, {
+            { TEST_BACKBUFFER, TEST_COLOR, TEST_TRANSFER_SRC, TEST_COLOR_RW, VK_ACCESS_TRANSFER_READ_BIT } } },
+    });
+}
+
+// Memory requirements for the used transient images as a driver might report them: the texel size of the format, 64 KiB aligned
+std::vector<std::pair<u32, VkMemoryRequirements>> test_transient_requirements(Render_Graph &graph)
+{
+    std::vector<std::pair<u32, VkMemoryRequirements>> images = {};
+    for (u32 r = 0; r < graph.resources.size(); r++)
+    {
+        Render_Graph_Resource &resource = graph.resources[r];
+        if (resource.imported || !resource.used) continue;
+
+        VkDeviceSize texel_size = 4;
+        if (resource.image_info.format == VK_FORMAT_D16_UNORM) texel_size = 2;
+        if (resource.image_info.format == VK_FORMAT_R16G16B16A16_SFLOAT) texel_size = 8;
+
+        VkMemoryRequirements requirements = {};
+        requirements.size = resource.image_info.extent.width * resource.image_info.extent.height * texel_size;
+        requirements.alignment = 65536;
+        requirements.memoryTypeBits = 1;
+        images.push_back({ r, requirements });
+    }
+    return images;
+}
+
+TEST(render_graph_deferred_aliasing)
+{
+    Render_Graph graph = {};
+    render_graph_build_deferred(graph);
+    render_graph_compile(graph, nullptr);
+
+    // levels: depth and shadow map 0-2, albedo and normals 1-2, lighting 2-5, bloom a 3-4, bloom b 4-5
+    // largest first, bloom a fits after the normals and bloom b after the shadow map; the rest overlap everything else
+    std::vector<Render_Graph_Alias_Group> groups = render_graph_alias_transients(graph, test_transient_requirements(graph));
+    CHECK_EQ(groups.size(), 5u);
+    CHECK(groups[0].members == std::vector<u32>({ TEST_NORMALS, TEST_BLOOM_A }));
+    CHECK(groups[1].members == std::vector<u32>({ TEST_LIGHTING }));
+    CHECK(groups[2].members == std::vector<u32>({ TEST_SHADOW, TEST_BLOOM_B }));
+    CHECK(groups[3].members == std::vector<u32>({ TEST_ALBEDO }));
+    CHECK(groups[4].members == std::vector<u32>({ TEST_DEPTH_IMAGE }));
+    CHECK_EQ(graph.resources[TEST_NORMALS].alias_next, (u32)TEST_BLOOM_A);
+    CHECK_EQ(graph.resources[TEST_BLOOM_A].alias_previous, (u32)TEST_NORMALS);
+    CHECK_EQ(graph.resources[TEST_BLOOM_B].alias_previous, (u32)TEST_SHADOW);
+    CHECK_EQ(graph.resources[TEST_LIGHTING].alias_next, UINT32_MAX);
+
+    const VkDeviceSize full_rgba16f = 1920 * 1080 * 8, full_rgba8 = 1920 * 1080 * 4, full_d16 = 1920 * 1080 * 2;
+    const VkDeviceSize half_rgba16f = 960 * 540 * 8, shadow_d16 = 2048 * 2048 * 2;
+    CHECK_EQ(graph.unaliased_bytes, 2 * full_rgba16f + full_rgba8 + full_d16 + 2 * half_rgba16f + shadow_d16);
+    CHECK_EQ(graph.transient_bytes, 2 * full_rgba16f + full_rgba8 + full_d16 + shadow_d16);
+
+    // the shadow map's first use also waits for last frame's bloom b in the same memory; bloom a and b take over memory whose
+    // last use was a read, so they only wait for the shader stages and have no writes to make available
+    render_graph_build_barriers(graph);
+    test_check_batches(graph, {
+        { 0, TEST_DEPTH_STAGE | TEST_SHADER_STAGE | TEST_COLOR_STAGE, TEST_DEPTH_STAGE, 0, 0, {
+            { TEST_DEPTH_IMAGE, TEST_UNDEFINED, TEST_DEPTH, TEST_DEPTH_RW, TEST_DEPTH_RW },
+            { TEST_SHADOW,      TEST_UNDEFINED, TEST_DEPTH, TEST_DEPTH_RW | TEST_COLOR_RW, TEST_DEPTH_RW } } },
+        { 2, TEST_DEPTH_STAGE | TEST_COLOR_STAGE | TEST_SHADER_STAGE, TEST_DEPTH_STAGE | TEST_COLOR_STAGE, TEST_DEPTH_RW, TEST_DEPTH_RW, {
+            { TEST_ALBEDO,  TEST_UNDEFINED, TEST_COLOR, TEST_COLOR_RW, TEST_COLOR_RW },
+            { TEST_NORMALS, TEST_UNDEFINED, TEST_COLOR, TEST_COLOR_RW, TEST_COLOR_RW } } },
+        { 3, TEST_DEPTH_STAGE | TEST_COLOR_STAGE | TEST_SHADER_STAGE, TEST_SHADER_STAGE | TEST_COLOR_STAGE, 0, 0, {
+            { TEST_ALBEDO,      TEST_COLOR,     TEST_SHADER_READ, TEST_COLOR_RW, VK_ACCESS_SHADER_READ_BIT },
+            { TEST_NORMALS,     TEST_COLOR,     TEST_SHADER_READ, TEST_COLOR_RW, VK_ACCESS_SHADER_READ_BIT },
+            { TEST_DEPTH_IMAGE, TEST_DEPTH,     TEST_SHADER_READ, TEST_DEPTH_RW, VK_ACCESS_SHADER_READ_BIT },
+            { TEST_SHADOW,      TEST_DEPTH,     TEST_SHADER_READ, TEST_DEPTH_RW, VK_ACCESS_SHADER_READ_BIT },
+            { TEST_LIGHTING,    TEST_UNDEFINED, TEST_COLOR,       TEST_COLOR_RW, TEST_COLOR_RW } } },
+        { 4, TEST_COLOR_STAGE | TEST_SHADER_STAGE, TEST_SHADER_STAGE | TEST_COLOR_STAGE, 0, 0, {
+            { TEST_LIGHTING, TEST_COLOR,     TEST_SHADER_READ, TEST_COLOR_RW, VK_ACCESS_SHADER_READ_BIT },
+            { TEST_BLOOM_A,  TEST_UNDEFINED, TEST_COLOR,       0,             TEST_COLOR_RW } } },
+        { 5, TEST_COLOR_STAGE | TEST_SHADER_STAGE, TEST_SHADER_STAGE | TEST_COLOR_STAGE, 0, 0, {
+            { TEST_BLOOM_A, TEST_COLOR,     TEST_SHADER_READ, TEST_COLOR_RW, VK_ACCESS_SHADER_READ_BIT },
+            { TEST_BLOOM_B, TEST_UNDEFINED, TEST_COLOR,       0,             TEST_COLOR_RW } } },
+        { 6, TEST_COLOR_STAGE, TEST_SHADER_STAGE | TEST_COLOR_STAGE, 0, 0, {
+            { TEST_BLOOM_B,    TEST_COLOR,     TEST_SHADER_READ, TEST_COLOR_RW, VK_ACCESS_SHADER_READ_BIT },
+            { TEST_BACKBUFFER, TEST_UNDEFINED, TEST_COLOR,       0,             TEST_COLOR_RW } } },
+        { 7, TEST_COLOR_STAGE, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, {
+            { TEST_BACKBUFFER, TEST_COLOR, TEST_TRANSFER_SRC, TEST_COLOR_RW, VK_ACCESS_TRANSFER_READ_BIT } } },
+    });
+}
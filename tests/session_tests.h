@@ -0,0 +1,159 @@
+#pragma once
+
+#include "test.h"
+#include "null_driver.h"
+#include "faults_tests.h"
+
+//
+// DEVICE SESSIONS
+// run_device_session and run_device_sessions, see main.cpp, headless on the null driver with faults injected into the frame loop
+// Whichever way a session ends, everything it created on the device has to be destroyed again
+//
+
+// A headless run of `frame_count` frames with `faults` armed and nothing read from or written to disk
+void test_session_setup(u64 frame_count, std::vector<const char *> faults)
+{
+    test_faults_arm(faults);
+    null_driver = {};
+    vulkan_device_lost = false;
+    main_headless = true;
+    main_frame_count = frame_count;
+    main_pipeline_cache_path = nullptr;
+    main_device_cache_path = nullptr;
+}
+
+// The shaders come in as if preloaded, so none have to be compiled; the null driver never looks past the SPIR-V magic number
+void test_session_preload(Startup_Preload &preload)
+{
+    const u32 spirv_magic = 0x07230203;
+    std::vector<u8> code((const u8 *)&spirv_magic, (const u8 *)&spirv_magic + sizeof(spirv_magic));
+    preload.shaders[SHADER_DIR "triangle.vert.spv"] = code;
+    preload.shaders[SHADER_DIR "triangle.frag.spv"] = code;
+}
+
+Session_Result test_session_run(Device_Recovery &recovery)
+{
+    Startup_Timer startup = {};
+    startup_timer_init(startup);
+    Startup_Preload preload = {};
+    test_session_preload(preload);
+    return run_device_session(nullptr, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_API_VERSION_1_0, startup, preload, recovery, nullptr);
+}
+
+i32 test_sessions_run(Device_Recovery &recovery)
+{
+    Startup_Timer startup = {};
+    startup_timer_init(startup);
+    Startup_Preload preload = {};
+    test_session_preload(preload);
+    return run_device_sessions(nullptr, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_API_VERSION_1_0, startup, preload, recovery, nullptr);
+}
+
+TEST(session_runs_to_the_frame_count)
+{
+    test_session_setup(5, {});
+    Device_Recovery recovery = {};
+    CHECK_EQ(test_session_run(recovery), SESSION_DONE);
+    CHECK_EQ(recovery.frames, 5u);
+    CHECK_EQ(null_driver.submits, 5u);
+    CHECK_EQ(null_driver.live, 0);
+}
+
+TEST(session_device_lost)
+{
+    test_session_setup(8, { "submit:device-lost@3" });
+    Device_Recovery recovery = {};
+    CHECK_EQ(test_session_run(recovery), SESSION_DEVICE_LOST);
+    CHECK_EQ(recovery.frames, 3u);
+    CHECK_EQ(null_driver.live, 0);
+    CHECK(!vulkan_device_lost);
+
+    // the next session renders the rest of the frames on a new device
+    CHECK_EQ(test_session_run(recovery), SESSION_DONE);
+    CHECK_EQ(recovery.frames, 8u);
+    CHECK_EQ(null_driver.live, 0);
+    CHECK_EQ(fault_injector.injected, 1u);
+    fault_injector = {};
+}
+
+TEST(session_device_lost_is_recovered)
+{
+    test_session_setup(8, { "submit:device-lost@3" });
+    Device_Recovery recovery = {};
+    CHECK_EQ(test_sessions_run(recovery), 0);
+    CHECK_EQ(recovery.count, 1u);
+    CHECK_EQ(recovery.frames, 8u);
+    CHECK_EQ(recovery.ms.size(), 1u);
+    CHECK_EQ(null_driver.live, 0);
+    fault_injector = {};
+}
+
+TEST(session_hung_gpu_is_lost)
+{
+    // every attempt at waiting for frame 2 times out
+    std::vector<std::string> faults = {};
+    for (u32 attempt = 0; attempt < FRAME_WAIT_ATTEMPTS; attempt++) faults.push_back("wait:timeout@" + std::to_string(2 + attempt));
+    std::vector<const char *> fault_texts = {};
+    for (auto &fault : faults) fault_texts.push_back(fault.c_str());
+
+    test_session_setup(4, fault_texts);
+    Device_Recovery recovery = {};
+    CHECK_EQ(test_sessions_run(recovery), 0);
+    CHECK_EQ(recovery.count, 1u);
+    CHECK_EQ(recovery.frames, 4u);
+    CHECK_EQ(fault_injector.injected, FRAME_WAIT_ATTEMPTS);
+    CHECK_EQ(null_driver.live, 0);
+    fault_injector = {};
+}
+
+TEST(session_gives_up_on_losses_before_the_first_frame)
+{
+    test_session_setup(8, { "submit:device-lost@0", "submit:device-lost@1", "submit:device-lost@2" });
+    Device_Recovery recovery = {};
+    CHECK_EQ(test_sessions_run(recovery), VK_ERROR_DEVICE_LOST);
+    CHECK_EQ(recovery.frames, 0u);
+    CHECK_EQ(recovery.count, 2u);
+    CHECK_EQ(null_driver.live, 0);
+    fault_injector = {};
+}
+
+TEST(session_error_destroys_the_device)
+{
+    // an error other than a device loss ends the run, but not before everything on the device is gone
+    test_session_setup(8, { "submit:out-of-memory@2" });
+    Device_Recovery recovery = {};
+    VkResult thrown = VK_SUCCESS;
+    try
+    {
+        test_session_run(recovery);
+    }
+    catch (const Vulkan_Error &error)
+    {
+        thrown = error.result;
+    }
+    CHECK_EQ(thrown, VK_ERROR_OUT_OF_DEVICE_MEMORY);
+    CHECK_EQ(recovery.frames, 2u);
+    CHECK_EQ(null_driver.live, 0);
+    CHECK(!vulkan_device_lost);
+
+    test_session_setup(8, { "submit:out-of-memory@2" });
+    recovery = {};
+    CHECK_EQ(test_sessions_run(recovery), VK_ERROR_OUT_OF_DEVICE_MEMORY);
+    CHECK_EQ(null_driver.live, 0);
+    fault_injector = {};
+}
+
+TEST(session_missing_shader_is_an_error)
+{
+    // a shader that is not SPIR-V ends the run with an exit code instead of exiting in the middle of the session
+    test_session_setup(4, {});
+    Device_Recovery recovery = {};
+    Startup_Timer startup = {};
+    startup_timer_init(startup);
+    Startup_Preload preload = {};
+    test_session_preload(preload);
+    preload.shaders[SHADER_DIR "triangle.frag.spv"].resize(3);
+    CHECK_EQ(run_device_sessions(nullptr, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_API_VERSION_1_0, startup, preload, recovery, nullptr), VK_ERROR_INITIALIZATION_FAILED);
+    CHECK_EQ(recovery.frames, 0u);
+    CHECK_EQ(null_driver.submits, 0u);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "../src/common.h"
+
+//
+// TESTS
+// A minimal harness for the CPU-side tests under tests/: TEST(name) defines and registers a test, CHECK and CHECK_EQ report a failure
+// with its location and let the test carry on. tests/tests.cpp builds every test into one program, run_tests, which needs no GPU
+//
+
+struct Test {
+    const char *name;
+    void      (*run)();
+};
+
+std::vector<Test> &test_registry()
+{
+    static std::vector<Test> tests;
+    return tests;
+}
+
+struct Test_Registration {
+    Test_Registration(const char *name, void (*run)()) { test_registry().push_back({ name, run }); }
+};
+
+u32 test_check_failures = 0; // of the running test
+
+void test_fail(const char *file, i32 line, const char *expression)
+{
+    printf("    %s(%d): CHECK(%s) failed\n", file, line, expression);
+    test_check_failures++;
+}
+
+template <typename A, typename B>
+void test_check_eq(const A &a, const B &b, const char *a_expression, const char *b_expression, const char *file, i32 line)
+{
+    if (a == b) return;
+    std::cout << "    " << file << "(" << line << "): CHECK_EQ(" << a_expression << ", " << b_expression << ") failed: " << a << " != " << b << std::endl;
+    test_check_failures++;
+}
+
+#define TEST(NAME) void test_##NAME(); Test_Registration test_registration_##NAME(#NAME, test_##NAME); void test_##NAME()
+#define CHECK(EXPR) ((EXPR) ? (void)0 : test_fail(__FILE__, __LINE__, #EXPR))
+#define CHECK_EQ(A, B) test_check_eq((A), (B), #A, #B, __FILE__, __LINE__)
+
+// Run every test whose name contains `filter`, or all of them when it is nullptr; returns the number of tests that failed
+u32 test_run_all(const char *filter)
+{
+    u32 run = 0, failed = 0;
+    for (const auto &test : test_registry())
+    {
+        if (filter && !strstr(test.name, filter)) continue;
+        test_check_failures = 0;
+        test.run();
+        run++;
+        if (test_check_failures > 0) failed++;
+        printf("%-60s %s\n", test.name, test_check_failures > 0 ? "FAILED" : "ok");
+    }
+    printf("\n%u of %u tests passed\n", run - failed, run);
+    return failed;
+}
@@ -0,0 +1,21 @@
+// CPU-side tests of the modules under src/ and of main.cpp, which is built without its entry point
+//
+//   run_tests [filter]   runs the tests whose name contains `filter`, or all of them; the exit code is the number that failed
+//
+// Built by build.sh/build.bat; run it from the repository root
+
+#define APP_NO_MAIN
+#include "../main.cpp"
+
+#include "test.h"
+
+#include "device_selection_tests.h"
+#include "faults_tests.h"
+#include "gpu_allocator_tests.h"
+#include "render_graph_tests.h"
+#include "session_tests.h"
+
+int main(int argc, char **argv)
+{
+    return (int)test_run_all(argc > 1 ? argv[1] : nullptr);
+}
@@ -0,0 +1,418 @@
+// Offline converter from OBJ meshes and PPM images to the asset pack format of src/asset_format.h
+//
+//   asset_pack [-f rgba8|bc1] -o <out.pack> <inputs...>   inputs are .obj and .ppm files, or directories holding them
+//   asset_pack --generate <dir> <MiB>                      write a synthetic dataset of about <MiB> of OBJ and PPM files
+//
+// Textures get a full box-filtered mip chain and are stored as RGBA8 or compressed to BC1 (default); meshes are stored before
+// textures so the runtime reads the file front to back when it loads the meshes first
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/asset_format.h"
+
+// simple macro to safely and easily compare command-line arguments
+#define STREQ(STR, EXPR) (strncmp((STR), (EXPR), sizeof(STR)/sizeof(*(STR))) == 0)
+
+//
+// TEXTURE PROCESSING
+//
+
+// Halve an RGBA8 image with a 2x2 box filter; odd edges repeat their last texel
+void downsample_rgba(const std::vector<u8> &src, u32 width, u32 height, std::vector<u8> &dst)
+{
+    u32 dst_width = std::max(1u, width / 2), dst_height = std::max(1u, height / 2);
+    dst.resize((usize)dst_width * dst_height * 4);
+    for (u32 y = 0; y < dst_height; y++)
+    {
+        for (u32 x = 0; x < dst_width; x++)
+        {
+            u32 x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+            u32 y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+            for (u32 c = 0; c < 4; c++)
+            {
+                u32 sum = src[((usize)y0 * width + x0) * 4 + c] + src[((usize)y0 * width + x1) * 4 + c]
+                        + src[((usize)y1 * width + x0) * 4 + c] + src[((usize)y1 * width + x1) * 4 + c];
+                dst[((usize)y * dst_width + x) * 4 + c] = (u8)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+u16 pack_565(const u8 *rgb)
+{
+    return (u16)(((rgb[0] * 31 + 127) / 255) << 11 | ((rgb[1] * 63 + 127) / 255) << 5 | ((rgb[2] * 31 + 127) / 255));
+}
+
+void unpack_565(u16 color, u8 *rgb)
+{
+    rgb[0] = (u8)(((color >> 11) & 31) * 255 / 31);
+    rgb[1] = (u8)(((color >> 5)  & 63) * 255 / 63);
+    rgb[2] = (u8)(( color        & 31) * 255 / 31);
+}
+
+// BC1 (opaque) with the endpoints taken from the corners of the block's colour bounding box, inset by 1/16 to reduce the error of
+// the extremes; the quality of a proper encoder is not the point here, the compressed layout is
+void compress_bc1(const std::vector<u8> &rgba, u32 width, u32 height, std::vector<u8> &blocks)
+{
+    u32 blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+    blocks.resize((usize)blocks_x * blocks_y * 8);
+
+    for (u32 by = 0; by < blocks_y; by++)
+    {
+        for (u32 bx = 0; bx < blocks_x; bx++)
+        {
+            u8 texels[16][3];
+            u8 low[3] = { 255, 255, 255 }, high[3] = { 0, 0, 0 };
+            for (u32 i = 0; i < 16; i++)
+            {
+                u32 x = std::min(bx * 4 + i % 4, width - 1), y = std::min(by * 4 + i / 4, height - 1);
+                for (u32 c = 0; c < 3; c++)
+                {
+                    texels[i][c] = rgba[((usize)y * width + x) * 4 + c];
+                    low[c]  = std::min(low[c],  texels[i][c]);
+                    high[c] = std::max(high[c], texels[i][c]);
+                }
+            }
+            for (u32 c = 0; c < 3; c++)
+            {
+                u8 inset = (high[c] - low[c]) / 16;
+                low[c] += inset;
+                high[c] -= inset;
+            }
+
+            // color0 > color1 selects the four colour mode
+            u16 color0 = pack_565(high), color1 = pack_565(low);
+            if (color0 < color1) std::swap(color0, color1);
+
+            u32 indices = 0;
+            if (color0 != color1)
+            {
+                u8 palette[4][3];
+                unpack_565(color0, palette[0]);
+                unpack_565(color1, palette[1]);
+                for (u32 c = 0; c < 3; c++)
+                {
+                    palette[2][c] = (u8)((2 * palette[0][c] + palette[1][c]) / 3);
+                    palette[3][c] = (u8)((palette[0][c] + 2 * palette[1][c]) / 3);
+                }
+                for (u32 i = 0; i < 16; i++)
+                {
+                    u32 best = 0, best_error = UINT32_MAX;
+                    for (u32 p = 0; p < 4; p++)
+                    {
+                        u32 error = 0;
+                        for (u32 c = 0; c < 3; c++) error += (texels[i][c] - palette[p][c]) * (texels[i][c] - palette[p][c]);
+                        if (error < best_error) { best = p; best_error = error; }
+                    }
+                    indices |= best << (i * 2);
+                }
+            }
+
+            u8 *block = blocks.data() + ((usize)by * blocks_x + bx) * 8;
+            memcpy(block + 0, &color0, 2);
+            memcpy(block + 2, &color1, 2);
+            memcpy(block + 4, &indices, 4);
+        }
+    }
+}
+
+//
+// PACK WRITER
+// Data blocks are streamed to the file as the inputs are converted; the header and tables, whose size is known from the number of
+// inputs, are written last into the space left for them at the start
+//
+
+struct Pack_Writer {
+    FILE                      *file;
+    u64                        offset;
+    std::vector<Asset_Mesh>    meshes;
+    std::vector<Asset_Texture> textures;
+};
+
+bool pack_write_block(Pack_Writer &writer, const void *data, u64 size, u64 &block_offset)
+{
+    static const u8 zeros[ASSET_ALIGNMENT] = {};
+    u64 aligned = asset_align(writer.offset);
+    if (fwrite(zeros, 1, aligned - writer.offset, writer.file) != aligned - writer.offset) return false;
+    if (fwrite(data, 1, size, writer.file) != size) return false;
+    block_offset = aligned;
+    writer.offset = aligned + size;
+    return true;
+}
+
+void copy_name(char (&name)[ASSET_NAME_LENGTH], const std::string &path)
+{
+    std::string stem = std::filesystem::path(path).stem().string();
+    snprintf(name, ASSET_NAME_LENGTH, "%s", stem.c_str());
+}
+
+bool convert_obj(Pack_Writer &writer, const std::string &path)
+{
+    std::vector<Asset_Vertex> vertices;
+    std::vector<u32>          indices;
+    if (!parse_obj(path.c_str(), vertices, indices)) return false;
+
+    Asset_Mesh mesh = {};
+    copy_name(mesh.name, path);
+    mesh.vertex_count = vertices.size();
+    mesh.index_count = indices.size();
+
+    // bounding sphere around the centre of the bounding box
+    f32 low[3] = { INFINITY, INFINITY, INFINITY }, high[3] = { -INFINITY, -INFINITY, -INFINITY };
+    for (auto &vertex : vertices) for (u32 c = 0; c < 3; c++) { low[c] = std::min(low[c], vertex.position[c]); high[c] = std::max(high[c], vertex.position[c]); }
+    for (u32 c = 0; c < 3 && vertices.size() > 0; c++) mesh.bounds[c] = (low[c] + high[c]) * 0.5f;
+    for (auto &vertex : vertices)
+    {
+        f32 dx = vertex.position[0] - mesh.bounds[0], dy = vertex.position[1] - mesh.bounds[1], dz = vertex.position[2] - mesh.bounds[2];
+        mesh.bounds[3] = std::max(mesh.bounds[3], std::sqrt(dx * dx + dy * dy + dz * dz));
+    }
+
+    if (!pack_write_block(writer, vertices.data(), vertices.size() * sizeof(Asset_Vertex), mesh.vertex_offset)) return false;
+    if (!pack_write_block(writer, indices.data(),  indices.size()  * sizeof(u32),          mesh.index_offset))  return false;
+    writer.meshes.push_back(mesh);
+    return true;
+}
+
+bool convert_ppm(Pack_Writer &writer, const std::string &path, VkFormat format)
+{
+    Asset_Texture texture = {};
+    std::vector<u8> level, next, blocks;
+    if (!parse_ppm(path.c_str(), texture.width, texture.height, level)) return false;
+
+    copy_name(texture.name, path);
+    texture.format = format;
+    texture.mip_count = std::min<u32>(ASSET_MAX_MIPS, (u32)std::log2(std::max(texture.width, texture.height)) + 1);
+
+    u32 width = texture.width, height = texture.height;
+    for (u32 i = 0; i < texture.mip_count; i++)
+    {
+        const std::vector<u8> *data = &level;
+        if (format == VK_FORMAT_BC1_RGB_UNORM_BLOCK)
+        {
+            compress_bc1(level, width, height, blocks);
+            data = &blocks;
+        }
+        texture.mip_sizes[i] = data->size();
+        if (!pack_write_block(writer, data->data(), data->size(), texture.mip_offsets[i])) return false;
+
+        downsample_rgba(level, width, height, next);
+        std::swap(level, next);
+        width = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+    }
+    writer.textures.push_back(texture);
+    return true;
+}
+
+int write_pack(const char *out_path, std::vector<std::string> &meshes, std::vector<std::string> &images, VkFormat format)
+{
+    std::string temp_path = std::string(out_path) + ".tmp";
+    Pack_Writer writer = {};
+    writer.file = fopen(temp_path.c_str(), "wb");
+    if (!writer.file)
+    {
+        std::cout << "Failed to open " << temp_path << std::endl;
+        return 1;
+    }
+
+    // leave room for the header and tables
+    Asset_Header header = {};
+    header.magic = ASSET_MAGIC;
+    header.version = ASSET_VERSION;
+    header.meshes_offset = sizeof(Asset_Header);
+    header.textures_offset = header.meshes_offset + meshes.size() * sizeof(Asset_Mesh);
+    std::vector<u8> tables(header.textures_offset + images.size() * sizeof(Asset_Texture));
+    bool ok = fwrite(tables.data(), 1, tables.size(), writer.file) == tables.size();
+    writer.offset = tables.size();
+
+    for (auto &path : meshes)
+    {
+        if (ok && !convert_obj(writer, path)) std::cout << "Skipping " << path << ": not a readable OBJ file" << std::endl;
+    }
+    for (auto &path : images)
+    {
+        if (ok && !convert_ppm(writer, path, format)) std::cout << "Skipping " << path << ": not a readable binary PPM file" << std::endl;
+    }
+    ok = ok && !ferror(writer.file);
+
+    // skipped inputs leave unused table entries behind, which is harmless; the counts only cover the converted ones
+    header.mesh_count = writer.meshes.size();
+    header.texture_count = writer.textures.size();
+    header.file_size = writer.offset;
+    ok = ok && fseek(writer.file, 0, SEEK_SET) == 0
+            && fwrite(&header, sizeof(header), 1, writer.file) == 1
+            && fseek(writer.file, header.meshes_offset, SEEK_SET) == 0
+            && fwrite(writer.meshes.data(), sizeof(Asset_Mesh), writer.meshes.size(), writer.file) == writer.meshes.size()
+            && fseek(writer.file, header.textures_offset, SEEK_SET) == 0
+            && fwrite(writer.textures.data(), sizeof(Asset_Texture), writer.textures.size(), writer.file) == writer.textures.size();
+    ok = fclose(writer.file) == 0 && ok;
+
+    // rename does not replace an existing file on Windows
+    remove(out_path);
+    ok = ok && rename(temp_path.c_str(), out_path) == 0;
+    if (!ok)
+    {
+        remove(temp_path.c_str());
+        std::cout << "Failed to write " << out_path << std::endl;
+        return 1;
+    }
+
+    printf("Wrote %s: %zu meshes, %zu textures (%s), %.1f MB\n", out_path, writer.meshes.size(), writer.textures.size(),
+           format == VK_FORMAT_BC1_RGB_UNORM_BLOCK ? "BC1" : "RGBA8", writer.offset / 1e6);
+    return 0;
+}
+
+//
+// SYNTHETIC DATASET
+// Heightfield meshes of 256x256 vertices (about 10 MB of OBJ text each) and 1024x1024 images, alternating until the size is reached
+//
+
+u32 random_next(u32 &state)
+{
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+bool generate_mesh(const std::string &path, u32 seed)
+{
+    const u32 n = 256;
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) return false;
+
+    f32 phase = (seed % 64) * 0.1f;
+    for (u32 y = 0; y < n; y++)
+    {
+        for (u32 x = 0; x < n; x++)
+        {
+            f32 u = x / (f32)(n - 1), v = y / (f32)(n - 1);
+            f32 height = 0.1f * std::sin(u * 12.0f + phase) * std::cos(v * 9.0f - phase);
+            fprintf(file, "v %f %f %f\n", u * 2.0f - 1.0f, height, v * 2.0f - 1.0f);
+            fprintf(file, "vt %f %f\n", u, v);
+            fprintf(file, "vn %f %f %f\n", 0.0f, 1.0f, 0.0f);
+        }
+    }
+    for (u32 y = 0; y + 1 < n; y++)
+    {
+        for (u32 x = 0; x + 1 < n; x++)
+        {
+            u32 a = y * n + x + 1, b = a + 1, c = a + n, d = c + 1;
+            fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, c, c, c, b, b, b);
+            fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", b, b, b, c, c, c, d, d, d);
+        }
+    }
+    return fclose(file) == 0;
+}
+
+bool generate_image(const std::string &path, u32 seed)
+{
+    const u32 n = 1024;
+    std::vector<u8> rgb((usize)n * n * 3);
+    u32 state = seed;
+    u8 base[3] = { (u8)random_next(state), (u8)random_next(state), (u8)random_next(state) };
+    for (u32 y = 0; y < n; y++)
+    {
+        for (u32 x = 0; x < n; x++)
+        {
+            bool check = ((x / 64) + (y / 64)) % 2 == 0;
+            u8 noise = random_next(state) & 31;
+            for (u32 c = 0; c < 3; c++) rgb[((usize)y * n + x) * 3 + c] = (u8)((check ? base[c] : 255 - base[c]) / 2 + noise);
+        }
+    }
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    fprintf(file, "P6\n%u %u\n255\n", n, n);
+    bool ok = fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+    return fclose(file) == 0 && ok;
+}
+
+int generate_dataset(const char *directory, u64 target_bytes)
+{
+    namespace fs = std::filesystem;
+    std::error_code error;
+    fs::create_directories(directory, error);
+
+    u64 written = 0;
+    for (u32 i = 0; written < target_bytes; i++)
+    {
+        char name[64];
+        snprintf(name, sizeof(name), i % 2 == 0 ? "mesh_%05u.obj" : "image_%05u.ppm", i / 2);
+        std::string path = (fs::path(directory) / name).string();
+        if (!(i % 2 == 0 ? generate_mesh(path, i) : generate_image(path, i)))
+        {
+            std::cout << "Failed to write " << path << std::endl;
+            return 1;
+        }
+        written += fs::file_size(path, error);
+    }
+    printf("Wrote %.1f MB of OBJ and PPM files to %s\n", written / 1e6, directory);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    namespace fs = std::filesystem;
+
+    const char *out_path = nullptr;
+    VkFormat format = VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    std::vector<std::string> meshes, images;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (STREQ("--generate", argv[i]))
+        {
+            if (i + 2 < argc) return generate_dataset(argv[i + 1], strtoull(argv[i + 2], nullptr, 10) << 20);
+            std::cout << "Missing value for argument: " << argv[i] << std::endl;
+            return 1;
+        }
+        else if (STREQ("-o", argv[i]))
+        {
+            if (i + 1 < argc) out_path = argv[++i];
+            else std::cout << "Missing value for argument: " << argv[i] << std::endl;
+        }
+        else if (STREQ("-f", argv[i]))
+        {
+            if (i + 1 < argc)
+            {
+                i++;
+                if      (STREQ("rgba8", argv[i])) format = VK_FORMAT_R8G8B8A8_UNORM;
+                else if (STREQ("bc1",   argv[i])) format = VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+                else std::cout << "Unkown texture format: " << argv[i] << std::endl;
+            }
+            else std::cout << "Missing value for argument: " << argv[i] << std::endl;
+        }
+        else
+        {
+            // a directory contributes every OBJ and PPM file in it, in name order
+            std::vector<std::string> paths;
+            std::error_code error;
+            if (fs::is_directory(argv[i], error))
+            {
+                for (auto &entry : fs::directory_iterator(argv[i], error)) paths.push_back(entry.path().string());
+                std::sort(paths.begin(), paths.end());
+            }
+            else paths.push_back(argv[i]);
+
+            for (auto &path : paths)
+            {
+                std::string extension = fs::path(path).extension().string();
+                if      (extension == ".obj") meshes.push_back(path);
+                else if (extension == ".ppm") images.push_back(path);
+                else if (paths.size() == 1) std::cout << "Unkown input: " << path << std::endl;
+            }
+        }
+    }
+
+    if (!out_path || meshes.size() + images.size() == 0)
+    {
+        std::cout << "Usage: asset_pack [-f rgba8|bc1] -o <out.pack> <.obj/.ppm files or directories...>" << std::endl;
+        std::cout << "       asset_pack --generate <dir> <MiB>" << std::endl;
+        return 1;
+    }
+    return write_pack(out_path, meshes, images, format);
+}
@@ -0,0 +1,159 @@
+// Headless player for the frame captures of src/capture_format.h, written by `--capture`
+//
+//   replay [--null] [-n <passes>] <captures...>   captures are .cap files, or directories holding them
+//
+// Every frame of a capture is recorded into a command buffer, submitted and waited for, one at a time, and the CPU time of recording
+// and of submitting is reported per capture. It runs on the first device with a graphics queue, so pointing the loader at a software
+// driver (e.g. VK_ICD_FILENAMES=.../lvp_icd.x86_64.json for lavapipe) gives numbers that are comparable between machines without a GPU
+// --null replays through no-op entry points without creating an instance, which times decoding the capture and nothing else
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/replay.h"
+
+// simple macro to safely and easily compare command-line arguments
+#define STREQ(STR, EXPR) (strncmp((STR), (EXPR), sizeof(STR)/sizeof(*(STR))) == 0)
+
+//
+// DEVICE
+// A Vulkan 1.0 instance and device with one graphics queue, which is all replay needs; no layers, extensions or features
+//
+
+bool replay_device_create(Device_Context &ctx, Gpu_Allocator &allocator)
+{
+    VkResult vr = VK_SUCCESS;
+
+    VkApplicationInfo app_info = {};
+    app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    app_info.pApplicationName = "replay";
+    app_info.apiVersion = VK_API_VERSION_1_0;
+
+    VkInstanceCreateInfo instance_info = {};
+    instance_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instance_info.pApplicationInfo = &app_info;
+    vr = vkCreateInstance(&instance_info, nullptr, &ctx.instance);
+    CHECK_RESULT(vr);
+
+    std::vector<VkPhysicalDevice> physical_devices;
+    vr = COUNT_APPEND_HELPER(physical_devices, vkEnumeratePhysicalDevices, ctx.instance);
+    CHECK_RESULT(vr);
+    for (VkPhysicalDevice physical_device : physical_devices)
+    {
+        std::vector<VkQueueFamilyProperties> families;
+        COUNT_APPEND_HELPER(families, vkGetPhysicalDeviceQueueFamilyProperties, physical_device);
+        for (u32 family = 0; family < families.size() && !ctx.physical_device; family++)
+        {
+            if (!(families[family].queueFlags & VK_QUEUE_GRAPHICS_BIT)) continue;
+            ctx.physical_device = physical_device;
+            ctx.graphics_family = family;
+        }
+        if (ctx.physical_device) break;
+    }
+    if (!ctx.physical_device) return false;
+    vkGetPhysicalDeviceProperties(ctx.physical_device, &ctx.props);
+    vkGetPhysicalDeviceMemoryProperties(ctx.physical_device, &ctx.mem_props);
+
+    f32 priority = 1.0f;
+    VkDeviceQueueCreateInfo queue_info = {};
+    queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queue_info.queueFamilyIndex = ctx.graphics_family;
+    queue_info.queueCount = 1;
+    queue_info.pQueuePriorities = &priority;
+
+    VkDeviceCreateInfo device_info = {};
+    device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    device_info.queueCreateInfoCount = 1;
+    device_info.pQueueCreateInfos = &queue_info;
+    vr = vkCreateDevice(ctx.physical_device, &device_info, nullptr, &ctx.device);
+    CHECK_RESULT(vr);
+
+    vkGetDeviceQueue(ctx.device, ctx.graphics_family, 0, &ctx.graphics_queue);
+    ctx.compute_queue   = ctx.graphics_queue;
+    ctx.compute_family  = ctx.graphics_family;
+    ctx.transfer_queue  = ctx.graphics_queue;
+    ctx.transfer_family = ctx.graphics_family;
+    ctx.api_version     = VK_API_VERSION_1_0;
+
+    gpu_allocator_init(allocator, ctx.device, ctx.mem_props, gpu_memory_functions_vulkan());
+    ctx.allocator = &allocator;
+    return true;
+}
+
+void replay_device_destroy(Device_Context &ctx, Gpu_Allocator &allocator)
+{
+    if (ctx.device)
+    {
+        gpu_allocator_destroy(allocator);
+        vkDestroyDevice(ctx.device, nullptr);
+    }
+    if (ctx.instance) vkDestroyInstance(ctx.instance, nullptr);
+    ctx = {};
+}
+
+int main(int argc, char **argv)
+{
+    bool null_backend = false;
+    u32  passes = 4;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (STREQ("--null", argv[i])) null_backend = true;
+        else if (STREQ("-n", argv[i]))
+        {
+            if (i + 1 < argc) passes = std::max(1, atoi(argv[++i]));
+            else std::cout << "Missing value for argument: " << argv[i] << std::endl;
+        }
+        else
+        {
+            for (const auto &path : replay_list_captures(argv[i])) paths.push_back(path);
+        }
+    }
+    if (paths.empty())
+    {
+        std::cout << "Usage: replay [--null] [-n <passes>] <captures...>" << std::endl;
+        return 1;
+    }
+
+    Device_Context ctx = {};
+    Gpu_Allocator  allocator = {};
+    i32 exit_code = 0;
+    try
+    {
+        if (!null_backend && !replay_device_create(ctx, allocator))
+        {
+            std::cerr << "No device with a graphics queue found" << std::endl;
+            replay_device_destroy(ctx, allocator);
+            return 1;
+        }
+        std::cout << "Replaying " << paths.size() << " captures on " << (null_backend ? "the null backend" : ctx.props.deviceName) << ", " << passes << " passes each" << std::endl;
+
+        for (const auto &path : paths)
+        {
+            Capture_File file = {};
+            if (!capture_read(path.c_str(), file))
+            {
+                std::cout << "  " << path << ": not a valid capture" << std::endl;
+                exit_code = 1;
+                continue;
+            }
+
+            Replay_Context replay = {};
+            Replay_Stats   stats = {};
+            replay_context_create(replay, null_backend ? nullptr : &ctx, capture_max_extent(file));
+            replay_run(replay, file, passes, stats);
+            replay_print_stats(path.c_str(), null_backend ? "null" : "device", file, stats);
+            replay_context_destroy(replay);
+        }
+    }
+    catch (const Vulkan_Error &error)
+    {
+        vulkan_error_report(error);
+        exit_code = error.result;
+    }
+
+    replay_device_destroy(ctx, allocator);
+    return exit_code;
+}